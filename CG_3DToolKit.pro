@@ -1,4 +1,4 @@
-QT       += core gui opengl openglextensions
+QT       += core gui opengl openglextensions concurrent
 
 greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
 
@@ -19,9 +19,14 @@ SOURCES += \
     src/common/ccOverlayDialog.cpp \
     src/common/ccPickingHub.cpp \
     src/common/ccPluginManager.cpp \
+    src/common/ccRateLimitedFileLog.cpp \
+    src/common/ccRingBufferLog.cpp \
+    src/qCC/ccCommandLineCommands.cpp \
+    src/qCC/ccCommandLineParser.cpp \
     src/qCC/ccGLWindow.cpp \
     src/qCC/ccPointPickingGenericInterface.cpp \
     src/qCC/ccPointPropertiesDlg.cpp \
+    src/qCC/ccTiledImageWriter.cpp \
     src/ui/CGAboutDialog.cpp \
     src/view/CGConsoleView.cpp
 
@@ -31,14 +36,20 @@ HEADERS += \
     src/common/ccOverlayDialog.h \
     src/common/ccPickingHub.h \
     src/common/ccPluginManager.h \
+    src/common/ccRateLimitedFileLog.h \
+    src/common/ccRingBufferLog.h \
+    src/plugins/ccCommandLineInterface.h \
     src/plugins/ccMainAppInterface.h \
     src/plugins/ccStdPluginInterface.h \
     src/plugins/ccGLPluginInterface.h \
     src/plugins/ccIOPluginInterface.h \
+    src/qCC/ccCommandLineCommands.h \
+    src/qCC/ccCommandLineParser.h \
     src/qCC/ccGLWindow.h \
     src/qCC/ccPersistentSettings.h \
     src/qCC/ccPointPickingGenericInterface.h \
     src/qCC/ccPointPropertiesDlg.h \
+    src/qCC/ccTiledImageWriter.h \
     src/ui/CGAboutDialog.h \
     src/util/CCCommon.h \
     src/view/CGConsoleView.h
@@ -24,13 +24,13 @@
 //Local
 #include "CCToolbox.h"
 #include "CCTypes.h"
+#include "DgmOctree.h"
 
 namespace CCLib
 {
 
 class GenericIndexedCloudPersist;
 class GenericProgressCallback;
-class DgmOctree;
 class ReferenceCloud;
 
 //! A standard container to store several subsets of points
@@ -63,13 +63,15 @@ public:
 		\param sixConnexity indicates if the CC's 3D connexity should be 6 (26 otherwise)
 		\param progressCb the client application can get some notification of the process progress through this callback mechanism (see GenericProgressCallback)
 		\param inputOctree the cloud octree if it has already been computed
+		\param componentsInfo if not null, will be filled with the statistics (point count, bounding-box) of each component
 		\return the number of components (>= 0) or an error code (< 0 - see DgmOctree::extractCCs)
 	**/
 	static int labelConnectedComponents(GenericIndexedCloudPersist* theCloud,
 										unsigned char level,
 										bool sixConnexity = false,
 										CCLib::GenericProgressCallback* progressCb = nullptr,
-										CCLib::DgmOctree* inputOctree = nullptr);
+										CCLib::DgmOctree* inputOctree = nullptr,
+										DgmOctree::ConnectedComponentInfoContainer* componentsInfo = nullptr);
 
 	//! Extracts connected components from a point cloud
 	/** This method shloud only be called after the connected components have been
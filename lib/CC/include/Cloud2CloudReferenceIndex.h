@@ -0,0 +1,158 @@
+//##########################################################################
+//#                                                                        #
+//#                               CCLIB                                    #
+//#                                                                        #
+//#  This program is free software; you can redistribute it and/or modify  #
+//#  it under the terms of the GNU Library General Public License as       #
+//#  published by the Free Software Foundation; version 2 or later of the  #
+//#  License.                                                              #
+//#                                                                        #
+//#  This program is distributed in the hope that it will be useful,       #
+//#  but WITHOUT ANY WARRANTY; without even the implied warranty of        #
+//#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the          #
+//#  GNU General Public License for more details.                          #
+//#                                                                        #
+//#          COPYRIGHT: EDF R&D / TELECOM ParisTech (ENST-TSI)             #
+//#                                                                        #
+//##########################################################################
+
+#ifndef CLOUD_2_CLOUD_REFERENCE_INDEX_HEADER
+#define CLOUD_2_CLOUD_REFERENCE_INDEX_HEADER
+
+//Local
+#include "DistanceComputationTools.h"
+
+//system
+#include <algorithm>
+#include <vector>
+
+namespace CCLib
+{
+
+class GenericIndexedCloudPersist;
+class GenericProgressCallback;
+
+//! Persistent search structure on a reference cloud for cloud-to-cloud distances computation
+/** The reference octree is built once and can then be used to compute the
+	distances of any number of compared clouds (without building their octree).
+	As computeDistances is const, several compared clouds can be processed
+	concurrently with the same index.
+
+	The compared points are sorted by Morton code (relatively to the reference
+	octree) and processed by batches of points lying in the same cell, so that
+	the nearest neighbour search structure is shared by the points of a batch
+	(as with DistanceComputationTools::computeCloud2CloudDistance). The level
+	of each batch is adapted to the local density of the reference cloud:
+	starting from the level matching the average density, cells are subdivided
+	as long as they hold more than 'maxCellPopulation' reference points.
+
+	\warning The reference cloud shouldn't be modified as long as the index is used.
+**/
+class CC_CORE_LIB_API Cloud2CloudReferenceIndex
+{
+public:
+
+	//! Default max number of reference points per cell (for the adaptive level)
+	static const unsigned DEFAULT_MAX_CELL_POPULATION = 32;
+
+	//! Max number of compared points per batch
+	static const unsigned MAX_BATCH_SIZE = 4096;
+
+	//! Default constructor
+	/** \param referenceCloud reference cloud
+		\param referenceOctree reference cloud octree (optional, if already computed - the index won't take its ownership)
+	**/
+	explicit Cloud2CloudReferenceIndex(GenericIndexedCloudPersist* referenceCloud, DgmOctree* referenceOctree = nullptr);
+
+	//! Destructor
+	virtual ~Cloud2CloudReferenceIndex();
+
+	//! Builds the reference octree (if necessary)
+	/** \param progressCb the client method can be notified of the process progress through a callback mechanism (see GenericProgressCallback)
+		\return success
+	**/
+	bool build(GenericProgressCallback* progressCb = nullptr);
+
+	//! Returns whether the index is ready to be used
+	bool isBuilt() const { return m_octree && m_octree->getNumberOfProjectedPoints() != 0; }
+
+	//! Returns the reference cloud
+	GenericIndexedCloudPersist* getReferenceCloud() const { return m_referenceCloud; }
+
+	//! Returns the reference octree
+	const DgmOctree* getOctree() const { return m_octree; }
+
+	//! Sets the max number of reference points per cell (for the adaptive level)
+	void setMaxCellPopulation(unsigned count) { m_maxCellPopulation = std::max(1u, count); }
+
+	//! Returns the max number of reference points per cell (for the adaptive level)
+	unsigned getMaxCellPopulation() const { return m_maxCellPopulation; }
+
+	//! Computes the distances between a compared cloud and the reference cloud
+	/** Same output as DistanceComputationTools::computeCloud2CloudDistance (the distances are
+		stored in the compared cloud active scalar field, plus the optional closest point set
+		and split distances). The batches are processed in parallel if params.multiThread is true.
+		If params.octreeLevel is not 0, the batches level is fixed (no adaptive level).
+		\warning Local models (params.localModel) are not supported.
+		\param comparedCloud the compared cloud
+		\param params distance computation parameters
+		\param progressCb the client application can get some notification of the process progress through this callback mechanism (see GenericProgressCallback)
+		\return 0 if ok, a negative value otherwise (see DistanceComputationTools::DISTANCE_COMPUTATION_RESULTS)
+	**/
+	int computeDistances(	GenericIndexedCloudPersist* comparedCloud,
+							DistanceComputationTools::Cloud2CloudDistanceComputationParams& params,
+							GenericProgressCallback* progressCb = nullptr) const;
+
+protected:
+
+	//! Batch of compared points (lying in the same cell)
+	struct Batch
+	{
+		//! First point (in the sorted points array)
+		unsigned first = 0;
+		//! Last point (excluded)
+		unsigned last = 0;
+		//! Truncated cell code (for inside points)
+		DgmOctree::CellCode truncatedCode = 0;
+		//! Level of subdivision
+		unsigned char level = 0;
+		//! Whether the points lie outside of the reference octree
+		bool outside = false;
+	};
+
+	//! Compared point and its (full) cell code in the reference octree
+	struct IndexAndCode
+	{
+		DgmOctree::CellCode code;
+		unsigned index;
+
+		bool operator < (const IndexAndCode& other) const { return code < other.code; }
+	};
+
+	//! Returns the number of reference points in a given cell (up to 'maxCount')
+	unsigned countReferencePoints(DgmOctree::CellCode truncatedCode, unsigned char level, unsigned maxCount) const;
+
+	//! Splits a range of (sorted) compared points into batches
+	/** Cells holding more than m_maxCellPopulation reference points are subdivided
+		(unless 'adaptive' is false).
+	**/
+	void splitIntoBatches(	const std::vector<IndexAndCode>& points,
+							unsigned first,
+							unsigned last,
+							unsigned char level,
+							bool adaptive,
+							std::vector<Batch>& batches) const;
+
+	//! Associated reference cloud
+	GenericIndexedCloudPersist* m_referenceCloud;
+	//! Reference octree
+	DgmOctree* m_octree;
+	//! Whether the octree is owned by this index
+	bool m_ownOctree;
+	//! Max number of reference points per cell (adaptive level)
+	unsigned m_maxCellPopulation;
+};
+
+}
+
+#endif //CLOUD_2_CLOUD_REFERENCE_INDEX_HEADER
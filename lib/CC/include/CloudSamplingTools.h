@@ -146,7 +146,9 @@ public:
 
 	//! Resamples a point cloud (process based on inter point distance)
 	/** The cloud is resampled so that there is no point nearer than a given distance to other points
-		It works by picking a reference point, removing all points which are to close to this point, and repeating these two steps until the result is reached
+		It works by picking a reference point, removing all points which are to close to this point, and repeating these two steps until the result is reached.
+		The octree cells (at least as big as the largest distance) are processed in 8 phases so that
+		non-adjacent cells can be processed concurrently. The result only depends on the input cloud.
 		\param cloud the point cloud to resample
 		\param minDistance the distance under which a point in the resulting cloud cannot have any neighbour
 		\param modParams parameters of the subsampling behavior modulation with a scalar field (optional)
@@ -201,6 +203,53 @@ public:
 										DgmOctree* octree = nullptr,
 										GenericProgressCallback* progressCb = nullptr);
 
+	//! Statistical Outliers Removal (SOR) filter (tiled version)
+	/** Same filter as sorFilter, but the cloud is processed by spatial tiles (with a halo)
+		so that only a small octree is built at a time. The global statistics are accumulated
+		tile by tile. The neighbourhoods are the same as with a global octree (the points with
+		neighbours beyond the halo are processed again with the whole cloud).
+		\param cloud the point cloud to resample
+		\param knn number of neighbors
+		\param nSigma number of sigmas under which the points should be kept
+		\param maxTilePointCount indicative max number of points per tile
+		\param progressCb the client application can get some notification of the process progress through this callback mechanism (see GenericProgressCallback)
+		\return a reference cloud corresponding to the filtered cloud
+	**/
+	static ReferenceCloud* sorFilterTiled(	GenericIndexedCloudPersist* cloud,
+											int knn = 6,
+											double nSigma = 1.0,
+											unsigned maxTilePointCount = (1 << 20),
+											GenericProgressCallback* progressCb = nullptr);
+
+	//! Noise filter based on the distance to the approximate local surface (tiled version)
+	/** Same filter as noiseFilter, but the cloud is processed by spatial tiles (with a halo)
+		so that only a small octree is built at a time. The selected points are appended to
+		the output tile after tile. The neighbourhoods are the same as with noiseFilter (with a
+		constant number of neighbors, the points with neighbours beyond the halo are processed
+		again with the whole cloud), so the result is the same.
+		\param cloud the point cloud to resample
+		\param kernelRadius neighborhood radius
+		\param nSigma number of sigmas under which the points should be kept
+		\param removeIsolatedPoints whether to remove isolated points (i.e. with 3 points or less in the neighborhood)
+		\param useKnn whether to use a constant number of neighbors instead of a radius
+		\param knn number of neighbors (if useKnn is true)
+		\param useAbsoluteError whether to use an absolute error instead of 'n' sigmas
+		\param absoluteError absolute error (if useAbsoluteError is true)
+		\param maxTilePointCount indicative max number of points per tile
+		\param progressCb the client application can get some notification of the process progress through this callback mechanism (see GenericProgressCallback)
+		\return a reference cloud corresponding to the filtered cloud
+	**/
+	static ReferenceCloud* noiseFilterTiled(GenericIndexedCloudPersist* cloud,
+											PointCoordinateType kernelRadius,
+											double nSigma,
+											bool removeIsolatedPoints = false,
+											bool useKnn = false,
+											int knn = 6,
+											bool useAbsoluteError = true,
+											double absoluteError = 0.0,
+											unsigned maxTilePointCount = (1 << 20),
+											GenericProgressCallback* progressCb = nullptr);
+
 protected:
 
 	//! "Cellular" function to replace one set of points (contained in an octree cell) by a unique point
@@ -236,6 +285,17 @@ protected:
 	//! "Cellular" function to apply the noise filter inside an octree cell
 	/** This function is meant to be applied to all cells of the octree
 		(it is of the form DgmOctree::localFunctionPtr).
+		Method parameters (defined in "additionalParameters") are :
+		- (ReferenceCloud*) reference cloud to store the selected points
+		- (PointCoordinateType*) kernel radius
+		- (double*) n sigma
+		- (bool*) whether to remove isolated points
+		- (bool*) whether to use a constant number of neighbors
+		- (int*) number of neighbors
+		- (bool*) whether to use an absolute error
+		- (double*) absolute error
+		- (unsigned*) optional: only the points with a lower index are processed (or nullptr)
+		- (std::vector<PointCoordinateType>*) optional: distance to the farthest neighbor of each point (or nullptr)
 		\param cell structure describing the cell on which processing is applied
 		\param additionalParameters see method description
 		\param nProgress optional (normalized) progress notification (per-point)
@@ -247,6 +307,11 @@ protected:
 	//! "Cellular" function to apply the SOR filter inside an octree cell
 	/** This function is meant to be applied to all cells of the octree
 		(it is of the form DgmOctree::localFunctionPtr).
+		Method parameters (defined in "additionalParameters") are :
+		- (int*) number of neighbors
+		- (std::vector<PointCoordinateType>*) mean distance to the neighbors of each point
+		- (unsigned*) optional: only the points with a lower index are processed (or nullptr)
+		- (std::vector<PointCoordinateType>*) optional: distance to the farthest neighbor of each point (or nullptr)
 		\param cell structure describing the cell on which processing is applied
 		\param additionalParameters see method description
 		\param nProgress optional (normalized) progress notification (per-point)
@@ -254,6 +319,22 @@ protected:
 	static bool applySORFilterAtLevel(	const DgmOctree::octreeCell& cell,
 										void** additionalParameters,
 										NormalizedProgress* nProgress = nullptr);
+
+	//! Decides whether a point should be kept by the noise filter
+	/** \param P query point
+		\param neighbours neighbors of the query point (without the query point itself)
+		\param nSigma number of sigmas under which the points should be kept
+		\param removeIsolatedPoints whether to remove isolated points (i.e. with 3 points or less in the neighborhood)
+		\param useAbsoluteError whether to use an absolute error instead of 'n' sigmas
+		\param absoluteError absolute error (if useAbsoluteError is true)
+		\return whether the point should be kept
+	**/
+	static bool keepPointAfterNoiseFiltering(	const CCVector3& P,
+												GenericIndexedCloudPersist* neighbours,
+												double nSigma,
+												bool removeIsolatedPoints,
+												bool useAbsoluteError,
+												double absoluteError);
 };
 
 }
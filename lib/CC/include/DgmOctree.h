@@ -1024,15 +1024,35 @@ public:	/***** CELLS POSITION HANDLING *****/
 
 	/**** ADVANCED METHODS ****/
 
+	//! Connected component statistics (see DgmOctree::extractCCs)
+	struct ConnectedComponentInfo
+	{
+		//! Number of points
+		unsigned pointCount = 0;
+		//! Number of octree cells
+		unsigned cellCount = 0;
+		//! Bounding-box of the points (min corner)
+		CCVector3 bbMin;
+		//! Bounding-box of the points (max corner)
+		CCVector3 bbMax;
+	};
+
+	//! Connected components statistics (component #i has label i+1)
+	using ConnectedComponentInfoContainer = std::vector<ConnectedComponentInfo>;
+
 	//! Computes the connected components (considering the octree cells only) for a given level of subdivision (partial)
 	/** The octree is seen as a regular 3D grid, and each cell of this grid is either set to 0
 		(if no points lies in it) or to 1 (if some points lie in it, e.g. if it is indeed a
 		cell of this octree). This version of the algorithm can be applied by considering only
 		a specified list of octree cells (ignoring the others).
+		Cells are labelled with a (multi-threaded) union-find on their sorted codes,
+		and the points of each component are flagged with its label (starting
+		from 1) in the current scalar field of the associated cloud.
 		\param cellCodes the cell codes to consider for the CC computation
 		\param level the level of subdivision at which to perform the algorithm
 		\param sixConnexity indicates if the CC's 3D connexity should be 6 (26 otherwise)
 		\param progressCb the client application can get some notification of the process progress through this callback mechanism (see GenericProgressCallback)
+		\param componentsInfo if not null, will be filled with the statistics of each component
 		\return error code:
 			- '>= 0' = number of components
 			- '-1' = no cells (input)
@@ -1042,7 +1062,8 @@ public:	/***** CELLS POSITION HANDLING *****/
 	int extractCCs(	const cellCodesContainer& cellCodes,
 					unsigned char level,
 					bool sixConnexity,
-					GenericProgressCallback* progressCb = nullptr) const;
+					GenericProgressCallback* progressCb = nullptr,
+					ConnectedComponentInfoContainer* componentsInfo = nullptr) const;
 
 	//! Computes the connected components (considering the octree cells only) for a given level of subdivision (complete)
 	/** The octree is seen as a regular 3D grid, and each cell of this grid is either set to 0
@@ -1052,6 +1073,7 @@ public:	/***** CELLS POSITION HANDLING *****/
 		\param level the level of subdivision at which to perform the algorithm
 		\param sixConnexity indicates if the CC's 3D connexity should be 6 (26 otherwise)
 		\param progressCb the client application can get some notification of the process progress through this callback mechanism (see GenericProgressCallback)
+		\param componentsInfo if not null, will be filled with the statistics of each component
 		\return error code:
 			- '>= 0' = number of components
 			- '-1' = no cells (input)
@@ -1060,7 +1082,8 @@ public:	/***** CELLS POSITION HANDLING *****/
 	**/
 	int extractCCs(	unsigned char level,
 					bool sixConnexity,
-					GenericProgressCallback* progressCb = nullptr) const;
+					GenericProgressCallback* progressCb = nullptr,
+					ConnectedComponentInfoContainer* componentsInfo = nullptr) const;
 
 	/**** OCTREE VISITOR ****/
 
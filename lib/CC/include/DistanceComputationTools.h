@@ -44,6 +44,27 @@ class CC_CORE_LIB_API DistanceComputationTools : public CCToolbox
 {
 public: //distance to clouds or meshes
 
+	//! Local models statistics (cloud-to-cloud distance with local models)
+	struct LocalModelStatistics
+	{
+		//! Number of models fitted
+		std::size_t fittedModels = 0;
+		//! Number of models found in the shared cache
+		std::size_t cacheHits = 0;
+		//! Number of models not found in the shared cache
+		std::size_t cacheMisses = 0;
+		//! Number of models evicted from the shared cache
+		std::size_t evictedModels = 0;
+		//! Number of models reused because they 'include' the nearest point (see Cloud2CloudDistanceComputationParams::reuseExistingLocalModels)
+		std::size_t reusedModels = 0;
+
+		//! Returns the cache hit rate (between 0 and 1)
+		inline double hitRate() const { return (cacheHits + cacheMisses != 0 ? static_cast<double>(cacheHits) / (cacheHits + cacheMisses) : 0.0); }
+	};
+
+	//! Default max number of local models kept in the shared cache
+	static const unsigned DEFAULT_LOCAL_MODEL_CACHE_SIZE = 65536;
+
 	//! Cloud-to-cloud "Hausdorff" distance computation parameters
 	struct Cloud2CloudDistanceComputationParams
 	{
@@ -94,6 +115,21 @@ public: //distance to clouds or meshes
 		**/
 		bool reuseExistingLocalModels;
 
+		//! Max number of local models kept in the shared cache (0 = no cache)
+		/** For local models only (i.e. ignored if localModel = NO_MODEL).
+			The models are indexed by the reference point around which they are fitted,
+			so that the compared points sharing the same nearest neighbour (in any cell,
+			and in any thread) share the same model. The least recently used models are
+			discarded first. Only used with a constant number of neighbours (i.e. ignored
+			if useSphericalSearchForLocalModel is true).
+		**/
+		unsigned localModelCacheSize;
+
+		//! Local models statistics (output)
+		/** For local models only (i.e. ignored if localModel = NO_MODEL).
+		**/
+		LocalModelStatistics localModelStats;
+
 		//! Container of (references to) points to store the "Closest Point Set"
 		/** The Closest Point Set corresponds to (the reference to) each compared point's closest neighbour.
 			\warning Not compatible with max search distance (see maxSearchDist)
@@ -120,6 +156,7 @@ public: //distance to clouds or meshes
 			, kNNForLocalModel(0)
 			, radiusForLocalModel(0)
 			, reuseExistingLocalModels(false)
+			, localModelCacheSize(DEFAULT_LOCAL_MODEL_CACHE_SIZE)
 			, CPSet(nullptr)
 			, resetFormerDistances(true)
 		{
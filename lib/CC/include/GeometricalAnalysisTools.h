@@ -76,6 +76,32 @@ public:
 											GenericProgressCallback* progressCb = nullptr,
 											DgmOctree* inputOctree = nullptr);
 
+	//! Geometric feature request (see ComputeGeomFeatures)
+	struct GeomFeatureRequest
+	{
+		//! Feature type
+		Neighbourhood::GeomFeature feature;
+		//! Neighbouring sphere radius
+		PointCoordinateType radius;
+		//! Output scalar field (must be at least as large as the cloud)
+		ScalarField* sf;
+	};
+
+	//! Computes several geometric features (at one or several scales) at once
+	/** Each neighbourhood is extracted only once (with the largest radius). The covariance matrices
+		of all the requested scales are then accumulated in a single pass over the neighbours and
+		decomposed with a closed-form 3x3 eigen solver.
+		\param cloud cloud to compute the features on
+		\param requests features to compute (each one with its own radius and output scalar field)
+		\param progressCb client application can get some notification of the process progress through this callback mechanism (see GenericProgressCallback)
+		\param inputOctree if not set as input, octree will be automatically computed.
+		\return success (0) or error code (<0)
+	**/
+	static ErrorCode ComputeGeomFeatures(	GenericIndexedCloudPersist* cloud,
+											const std::vector<GeomFeatureRequest>& requests,
+											GenericProgressCallback* progressCb = nullptr,
+											DgmOctree* inputOctree = nullptr);
+
 	//! Computes the local density (approximate)
 	/** Old method (based only on the distance to the nearest neighbor).
 		\warning As only one neighbor is extracted, the DENSITY_KNN type corresponds in fact to the (inverse) distance to the nearest neighbor.
@@ -184,6 +210,71 @@ public:
 											double confidence = 0.99,
 											unsigned seed = 0);
 
+	//! Primitive types (see DetectPrimitivesRobust)
+	enum PrimitiveType {	PRIMITIVE_PLANE = 1,
+							PRIMITIVE_SPHERE = 2,
+							PRIMITIVE_CYLINDER = 4
+	};
+
+	//! Robust primitives detection parameters
+	struct PrimitiveDetectionParams
+	{
+		//! Primitive types to look for (combination of PrimitiveType flags)
+		unsigned types = PRIMITIVE_PLANE | PRIMITIVE_SPHERE | PRIMITIVE_CYLINDER;
+		//! Max distance between a point and a primitive for this point to be an inlier
+		PointCoordinateType maxDistance = 0;
+		//! Radius of the neighbourhood in which the samples are drawn (automatic if <= 0: diag/20, bounded by the points density)
+		PointCoordinateType samplingRadius = 0;
+		//! Min number of inliers for a primitive to be kept
+		unsigned minSupport = 100;
+		//! Max number of primitives (0 = no limit)
+		unsigned maxPrimitives = 0;
+		//! Probability of not missing the best primitive when a detection round stops
+		double confidence = 0.99;
+		//! Max number of hypotheses per detection round
+		unsigned maxHypotheses = 10000;
+		//! Number of points used to pre-score the hypotheses
+		unsigned subsampleSize = 4096;
+		//! Random seed (a random one is used if 0)
+		unsigned seed = 0;
+	};
+
+	//! Primitive detected by DetectPrimitivesRobust
+	struct DetectedPrimitive
+	{
+		//! Primitive type
+		PrimitiveType type = PRIMITIVE_PLANE;
+		//! Plane: inliers gravity center / Sphere: center / Cylinder: point on the axis
+		CCVector3 center;
+		//! Plane: normal / Cylinder: axis direction (unit vector)
+		CCVector3 axis;
+		//! Sphere or cylinder radius
+		PointCoordinateType radius = 0;
+		//! Inliers distances RMS
+		double rms = 0;
+		//! Inliers (indexes in the input cloud)
+		std::vector<unsigned> inliers;
+	};
+
+	//! Detects several primitives (planes, spheres, cylinders) with a multi-threaded RANSAC
+	/** Primitives are extracted one after the other (the inliers of a primitive are removed
+		from the cloud before looking for the next one). Each round draws batches of hypotheses
+		from local (octree) neighbourhoods, pre-scores them in parallel on a random subsample and
+		only scores the most promising ones on all the remaining points. A round stops as soon as
+		the best primitive can't be missed with the given confidence.
+		\param[in] cloud input cloud
+		\param[in] params detection parameters (params.maxDistance must be > 0)
+		\param[out] primitives detected primitives (in detection order)
+		\param[in] progressCb for progress notification (optional)
+		\param[in] inputOctree if not set as input, octree will be automatically computed.
+		\return success (0) or error code (<0)
+	**/
+	static ErrorCode DetectPrimitivesRobust(	GenericIndexedCloudPersist* cloud,
+												const PrimitiveDetectionParams& params,
+												std::vector<DetectedPrimitive>& primitives,
+												GenericProgressCallback* progressCb = nullptr,
+												DgmOctree* inputOctree = nullptr);
+
 	//! Computes the center and radius of a sphere passing through 4 points
 	/** \param[in] A first point
 		\param[in] B second point
@@ -210,6 +301,16 @@ protected:
 	static bool ComputeGeomCharacteristicAtLevel(	const DgmOctree::octreeCell& cell,
 													void** additionalParameters,
 													NormalizedProgress* nProgress = nullptr);
+
+	//! Computes several geom features (at several scales) inside a cell
+	/**	\param cell structure describing the cell on which processing is applied
+		\param additionalParameters see method description
+		\param nProgress optional (normalized) progress notification (per-point)
+	**/
+	static bool ComputeGeomFeaturesAtLevel(	const DgmOctree::octreeCell& cell,
+											void** additionalParameters,
+											NormalizedProgress* nProgress = nullptr);
+
 	//! Computes approximate point density inside a cell
 	/**	\param cell structure describing the cell on which processing is applied
 		\param additionalParameters see method description
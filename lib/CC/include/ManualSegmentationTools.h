@@ -25,6 +25,7 @@
 namespace CCLib
 {
 
+class DgmOctree;
 class GenericIndexedCloud;
 class GenericIndexedCloudPersist;
 class GenericIndexedMesh;
@@ -42,13 +43,20 @@ public:
 	/** The camera parameters of the screen must be transmitted to this method,
 		as well as the polyline (generally drawn on the screen by a user)
 		expressed in the screen coordinates.
+		Points are processed by chunks (in parallel if possible). Chunks (or octree cells)
+		falling entirely inside or outside the polyline are handled at once.
 		\param aCloud the cloud to segment
 		\param poly the polyline
 		\param keepInside if true (resp. false), the points falling inside (resp. outside) the polyline will be extracted
-		\param viewMat the optional 4x4 visualization matrix (OpenGL style)
+		\param viewMat the optional 4x4 visualization matrix (OpenGL style - only the affine part is considered)
+		\param octree the optional octree of the cloud (used to classify whole cells at once)
 		\return a cloud structure containing references to the extracted points (references to - no duplication)
 	**/
-	static ReferenceCloud* segment(GenericIndexedCloudPersist* aCloud, const Polyline* poly, bool keepInside, const float* viewMat = nullptr);
+	static ReferenceCloud* segment(	GenericIndexedCloudPersist* aCloud,
+									const Polyline* poly,
+									bool keepInside,
+									const float* viewMat = nullptr,
+									const DgmOctree* octree = nullptr);
 
 	//! Selects the points which associated scalar value fall inside or outside a specified interval
 	/** \warning: be sure to activate an OUTPUT scalar field on the input cloud
@@ -198,6 +198,16 @@ class CC_CORE_LIB_API Neighbourhood
 		**/
 		double computeFeature(GeomFeature feature);
 
+		//! Computes the given feature from already computed eigen values/vectors
+		/** \param feature feature type
+			\param l1 largest eigenvalue
+			\param l2 middle eigenvalue
+			\param l3 smallest eigenvalue
+			\param e3 eigenvector associated to the smallest eigenvalue (only used by Verticality)
+			\return feature value (NaN if it can't be computed)
+		**/
+		static double ComputeFeature(GeomFeature feature, double l1, double l2, double l3, const CCVector3d& e3);
+
 		//! Computes the 1st order moment of a set of point (based on the eigenvalues)
 		/** \return 1st order moment at a given position P
 			DGM: The article states that the result should be between 0 and 1,
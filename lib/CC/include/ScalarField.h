@@ -24,6 +24,7 @@
 #include "CCShareable.h"
 
 //System
+#include <atomic>
 #include <vector>
 
 namespace CCLib
@@ -50,6 +51,11 @@ public:
 		\warning May throw a std::bad_alloc exception
 	**/
 	CC_CORE_LIB_API ScalarField(const ScalarField& sf);
+
+	//! Assignment operator
+	/** \warning May throw a std::bad_alloc exception
+	**/
+	CC_CORE_LIB_API ScalarField& operator = (const ScalarField& sf);
 	
 	//! Sets scalar field name
 	CC_CORE_LIB_API void setName(const char* name);
@@ -73,7 +79,18 @@ public:
 	static inline bool ValidValue(ScalarType value) { return value == value; } //'value == value' fails for NaN values
 
 	//! Sets the value as 'invalid' (i.e. NAN_VALUE)
-	inline void flagValueAsInvalid(std::size_t index) { at(index) = NaN(); }
+	inline void flagValueAsInvalid(std::size_t index) { at(index) = NaN(); notifyValuesModified(); }
+
+	//! Flags the values as modified
+	/** Automatically called by the methods of this class that modify the values.
+		Must be called explicitly after writing the values through 'data()',
+		the iterators or the (non const) references.
+		Thread safe (and cheap once the flag is set).
+	**/
+	inline void notifyValuesModified() { if (!m_valuesModified.load(std::memory_order_relaxed)) m_valuesModified.store(true, std::memory_order_relaxed); }
+
+	//! Returns whether the values may have been modified since the last call to computeMinAndMax
+	inline bool valuesModified() const { return m_valuesModified.load(std::memory_order_relaxed); }
 
 	//! Returns the minimum value
 	inline ScalarType getMin() const { return m_minVal; }
@@ -81,7 +98,7 @@ public:
 	inline ScalarType getMax() const { return m_maxVal; }
 
 	//! Fills the array with a particular value
-	inline void fill(ScalarType fillValue = 0) { if (empty()) resize(capacity(), fillValue); else std::fill(begin(), end(), fillValue); }
+	inline void fill(ScalarType fillValue = 0) { if (empty()) resize(capacity(), fillValue); else std::fill(begin(), end(), fillValue); notifyValuesModified(); }
 
 	//! Reserves memory (no exception thrown)
 	CC_CORE_LIB_API bool reserveSafe(std::size_t count);
@@ -91,10 +108,10 @@ public:
 	//Shortcuts (for backward compatibility)
 	inline ScalarType& getValue(std::size_t index) { return at(index); }
 	inline const ScalarType& getValue(std::size_t index) const { return at(index); }
-	inline void setValue(std::size_t index, ScalarType value) { at(index) = value; }
-	inline void addElement(ScalarType value) { emplace_back(value); }
+	inline void setValue(std::size_t index, ScalarType value) { at(index) = value; notifyValuesModified(); }
+	inline void addElement(ScalarType value) { emplace_back(value); notifyValuesModified(); }
 	inline unsigned currentSize() const { return static_cast<unsigned>(size()); }
-	inline void swap(std::size_t i1, std::size_t i2) { std::swap(at(i1), at(i2)); }
+	inline void swap(std::size_t i1, std::size_t i2) { std::swap(at(i1), at(i2)); notifyValuesModified(); }
 
 protected: //methods
 
@@ -112,10 +129,16 @@ protected: //members
 	ScalarType m_minVal;
 	//! Maximum value
 	ScalarType m_maxVal;
+
+	//! Whether the values may have been modified since the last call to computeMinAndMax
+	std::atomic<bool> m_valuesModified{ true };
 };
 
 inline void ScalarField::computeMinAndMax()
 {
+	//(reset first, so that any concurrent modification is not missed)
+	m_valuesModified.store(false, std::memory_order_relaxed);
+
 	if (!empty())
 	{
 		bool minMaxInitialized = false;
@@ -31,6 +31,7 @@ class GenericCloud;
 class GenericIndexedCloud;
 class GenericIndexedCloudPersist;
 class GenericProgressCallback;
+class ScalarField;
 
 //! A K-mean class position and boundaries
 struct KMeanClass
@@ -145,9 +146,10 @@ public:
 	static unsigned countScalarFieldValidValues(const GenericCloud* theCloud);
 
 	//! Classifies automaticaly a scalar field in K classes with the K-means algorithm
-	/** The initial K classes positions are regularly spaced between the
-		lowest and the highest values of the scalar field. Eventually the
-		algorithm will converge and produce K classes.
+	/** The initial K classes positions are chosen with the k-means++ heuristic
+		(deterministic) and pre-converged on a histogram of the values. The
+		algorithm then iterates (multi-threaded) on the values themselves until
+		the classes stop changing. Classes are sorted by ascending mean value.
 		\param theCloud a point cloud (associated to scalar values)
 		\param K the number of classes
 		\param kmcc an array of size K which will be filled with the computed classes limits (see ScalarFieldTools::KmeanClass)
@@ -158,6 +160,29 @@ public:
 								KMeanClass kmcc[], 
 								GenericProgressCallback* progressCb = nullptr);
 
+	//! Class index of the points with (at least) one invalid value (see the multi-dimensional ScalarFieldTools::computeKmeans)
+	static const unsigned char INVALID_KMEAN_CLASS = 255;
+
+	//! Classifies points in K classes with the K-means algorithm, based on several scalar fields
+	/** Each point is described by its values in all the input scalar fields
+		(e.g. one per color component for RGB). Values are not normalized: the
+		scalar fields should be scaled beforehand if their ranges are different.
+		The initial K classes positions are chosen with the k-means++ heuristic
+		(deterministic) on a subsample of the points.
+		\param features the scalar fields (all of the same size)
+		\param K the number of classes
+		\param centers output class centers (K x features.size() values, class by class)
+		\param belongings output class of each point (or INVALID_KMEAN_CLASS if one of its values is invalid)
+		\param maxIterationCount max number of iterations
+		\param progressCb the client application can get some notification of the process progress through this callback mechanism (see GenericProgressCallback)
+	**/
+	static bool computeKmeans(	const std::vector<const ScalarField*>& features,
+								unsigned char K,
+								std::vector<ScalarType>& centers,
+								std::vector<unsigned char>& belongings,
+								unsigned maxIterationCount = 100,
+								GenericProgressCallback* progressCb = nullptr);
+
 	//! Sets the distance value associated to a point
 	/** Generic function that can be used with the GenericCloud::foreach() method.
 		\param P a 3D point
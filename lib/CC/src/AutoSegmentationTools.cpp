@@ -34,7 +34,8 @@ int AutoSegmentationTools::labelConnectedComponents(GenericIndexedCloudPersist*
 													unsigned char level,
 													bool sixConnexity/*=false*/,
 													GenericProgressCallback* progressCb/*=0*/,
-													DgmOctree* inputOctree/*=0*/)
+													DgmOctree* inputOctree/*=0*/,
+													DgmOctree::ConnectedComponentInfoContainer* componentsInfo/*=nullptr*/)
 {
 	if (!theCloud)
 	{
@@ -60,7 +61,7 @@ int AutoSegmentationTools::labelConnectedComponents(GenericIndexedCloudPersist*
 		return -1;
 	}
 
-	int result = theOctree->extractCCs(level, sixConnexity, progressCb);
+	int result = theOctree->extractCCs(level, sixConnexity, progressCb, componentsInfo);
 
 	//remove octree if it was not provided as input
 	if (theOctree && !inputOctree)
@@ -0,0 +1,410 @@
+//##########################################################################
+//#                                                                        #
+//#                               CCLIB                                    #
+//#                                                                        #
+//#  This program is free software; you can redistribute it and/or modify  #
+//#  it under the terms of the GNU Library General Public License as       #
+//#  published by the Free Software Foundation; version 2 or later of the  #
+//#  License.                                                              #
+//#                                                                        #
+//#  This program is distributed in the hope that it will be useful,       #
+//#  but WITHOUT ANY WARRANTY; without even the implied warranty of        #
+//#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the          #
+//#  GNU General Public License for more details.                          #
+//#                                                                        #
+//#          COPYRIGHT: EDF R&D / TELECOM ParisTech (ENST-TSI)             #
+//#                                                                        #
+//##########################################################################
+
+#include <Cloud2CloudReferenceIndex.h>
+
+//local
+#include <GenericIndexedCloudPersist.h>
+#include <GenericProgressCallback.h>
+#include <ParallelSort.h>
+#include <ReferenceCloud.h>
+#include <ScalarField.h>
+
+//system
+#include <atomic>
+#include <cassert>
+#include <cmath>
+#include <cstdio>
+
+#ifdef USE_QT
+#ifndef CC_DEBUG
+//enables multi-threading handling
+#define ENABLE_MT_C2C_INDEX
+#endif
+#endif
+
+#ifdef ENABLE_MT_C2C_INDEX
+#include <QThread>
+#include <QThreadPool>
+#include <QtConcurrentMap>
+#endif
+
+using namespace CCLib;
+
+Cloud2CloudReferenceIndex::Cloud2CloudReferenceIndex(GenericIndexedCloudPersist* referenceCloud, DgmOctree* referenceOctree/*=nullptr*/)
+	: m_referenceCloud(referenceCloud)
+	, m_octree(referenceOctree)
+	, m_ownOctree(false)
+	, m_maxCellPopulation(DEFAULT_MAX_CELL_POPULATION)
+{
+	assert(m_referenceCloud);
+	assert(!m_octree || m_octree->associatedCloud() == m_referenceCloud);
+}
+
+Cloud2CloudReferenceIndex::~Cloud2CloudReferenceIndex()
+{
+	if (m_ownOctree)
+	{
+		delete m_octree;
+		m_octree = nullptr;
+	}
+}
+
+bool Cloud2CloudReferenceIndex::build(GenericProgressCallback* progressCb/*=nullptr*/)
+{
+	if (isBuilt())
+	{
+		//nothing to do
+		return true;
+	}
+
+	if (!m_referenceCloud || m_referenceCloud->size() == 0)
+	{
+		return false;
+	}
+
+	if (!m_octree)
+	{
+		m_octree = new DgmOctree(m_referenceCloud);
+		m_ownOctree = true;
+	}
+
+	return (m_octree->build(progressCb) > 0);
+}
+
+unsigned Cloud2CloudReferenceIndex::countReferencePoints(DgmOctree::CellCode truncatedCode, unsigned char level, unsigned maxCount) const
+{
+	const unsigned char bitDec = DgmOctree::GET_BIT_SHIFT(level);
+	const unsigned pointCount = m_octree->getNumberOfProjectedPoints();
+
+	unsigned index = m_octree->getCellIndex(truncatedCode, bitDec);
+	if (index >= pointCount)
+	{
+		//no such cell
+		return 0;
+	}
+
+	const DgmOctree::cellsContainer& codes = m_octree->pointsAndTheirCellCodes();
+	unsigned count = 0;
+	for (; index < pointCount && count < maxCount; ++index, ++count)
+	{
+		if ((codes[index].theCode >> bitDec) != truncatedCode)
+			break;
+	}
+
+	return count;
+}
+
+void Cloud2CloudReferenceIndex::splitIntoBatches(	const std::vector<IndexAndCode>& points,
+													unsigned first,
+													unsigned last,
+													unsigned char level,
+													bool adaptive,
+													std::vector<Batch>& batches) const
+{
+	const unsigned char bitDec = DgmOctree::GET_BIT_SHIFT(level);
+
+	for (unsigned i = first; i < last; )
+	{
+		//points lying in the same cell (at this level) are contiguous
+		const DgmOctree::CellCode truncatedCode = (points[i].code >> bitDec);
+		unsigned j = i + 1;
+		while (j < last && (points[j].code >> bitDec) == truncatedCode)
+		{
+			++j;
+		}
+
+		if (	adaptive
+			&&	level < DgmOctree::MAX_OCTREE_LEVEL
+			&&	countReferencePoints(truncatedCode, level, m_maxCellPopulation + 1) > m_maxCellPopulation)
+		{
+			//too many reference points in this cell: we subdivide it
+			splitIntoBatches(points, i, j, level + 1, adaptive, batches);
+		}
+		else
+		{
+			for (unsigned k = i; k < j; k += MAX_BATCH_SIZE)
+			{
+				Batch batch;
+				batch.first = k;
+				batch.last = std::min(j, k + MAX_BATCH_SIZE);
+				batch.truncatedCode = truncatedCode;
+				batch.level = level;
+				batches.push_back(batch);
+			}
+		}
+
+		i = j;
+	}
+}
+
+int Cloud2CloudReferenceIndex::computeDistances(	GenericIndexedCloudPersist* comparedCloud,
+													DistanceComputationTools::Cloud2CloudDistanceComputationParams& params,
+													GenericProgressCallback* progressCb/*=nullptr*/) const
+{
+	using Results = DistanceComputationTools::DISTANCE_COMPUTATION_RESULTS;
+
+	if (!comparedCloud)
+	{
+		assert(false);
+		return Results::ERROR_NULL_COMPAREDCLOUD;
+	}
+
+	const unsigned pointCount = comparedCloud->size();
+	if (pointCount == 0)
+	{
+		assert(false);
+		return Results::ERROR_EMPTY_COMPAREDCLOUD;
+	}
+
+	if (!isBuilt())
+	{
+		assert(false);
+		return Results::ERROR_NULL_OCTREE;
+	}
+
+	if (params.CPSet && params.maxSearchDist > 0)
+	{
+		//we can't use a 'max search distance' criterion if the "Closest Point Set" is requested
+		assert(false);
+		return Results::ERROR_CANT_USE_MAX_SEARCH_DIST_AND_CLOSEST_POINT_SET;
+	}
+
+	if (params.localModel != NO_MODEL)
+	{
+		//local models require the compared cloud octree (see DistanceComputationTools::computeCloud2CloudDistance)
+		assert(false);
+		return Results::ERROR_COMPUTE_CLOUD2_CLOUD_DISTANCE_FAILURE;
+	}
+
+	if (params.octreeLevel > DgmOctree::MAX_OCTREE_LEVEL)
+	{
+		return Results::ERROR_OCTREE_LEVEL_GT_MAX_OCTREE_LEVEL;
+	}
+
+	//we 'enable' a scalar field  (if it is not already done) to store resulting distances
+	if (!comparedCloud->enableScalarField())
+	{
+		//not enough memory
+		return Results::ERROR_OUT_OF_MEMORY;
+	}
+
+	//closest point set
+	if (params.CPSet && !params.CPSet->resize(pointCount))
+	{
+		//not enough memory
+		return Results::ERROR_OUT_OF_MEMORY;
+	}
+
+	//internally we don't use the maxSearchDist parameters as is, but the square of it
+	const double maxSearchSquareDistd = params.maxSearchDist <= 0 ? 0 : static_cast<double>(params.maxSearchDist) * params.maxSearchDist;
+
+	//by default we reset any former value stored in the 'enabled' scalar field
+	if (params.resetFormerDistances)
+	{
+		const ScalarType resetValue = maxSearchSquareDistd <= 0 ? NAN_VALUE : params.maxSearchDist;
+		for (unsigned i = 0; i < pointCount; ++i)
+		{
+			comparedCloud->setPointScalarValue(i, resetValue);
+		}
+	}
+
+	//whether to compute split distances or not
+	bool computeSplitDistances = false;
+	for (int i = 0; i < 3; ++i)
+	{
+		if (params.splitDistances[i] && params.splitDistances[i]->currentSize() == pointCount)
+		{
+			computeSplitDistances = true;
+			params.splitDistances[i]->fill(NAN_VALUE);
+		}
+	}
+
+	//base level: either the input one, or the one matching the average density
+	const bool adaptive = (params.octreeLevel == 0);
+	const unsigned char baseLevel = adaptive ? m_octree->findBestLevelForAGivenPopulationPerCell(m_maxCellPopulation) : params.octreeLevel;
+
+	//Morton ordering of the compared points (relatively to the reference octree)
+	std::vector<IndexAndCode> points;
+	std::vector<Batch> batches;
+	try
+	{
+		points.resize(pointCount);
+		for (unsigned i = 0; i < pointCount; ++i)
+		{
+			Tuple3i cellPos;
+			bool inBounds = false;
+			m_octree->getTheCellPosWhichIncludesThePoint(comparedCloud->getPoint(i), cellPos, DgmOctree::MAX_OCTREE_LEVEL, inBounds);
+
+			points[i].index = i;
+			//the points outside of the octree are pushed at the end
+			points[i].code = (inBounds ? DgmOctree::GenerateTruncatedCellCode(cellPos, DgmOctree::MAX_OCTREE_LEVEL) : DgmOctree::INVALID_CELL_CODE);
+		}
+		ParallelSort(points.begin(), points.end());
+
+		unsigned insideCount = pointCount;
+		while (insideCount != 0 && points[insideCount - 1].code == DgmOctree::INVALID_CELL_CODE)
+		{
+			--insideCount;
+		}
+
+		splitIntoBatches(points, 0, insideCount, baseLevel, adaptive, batches);
+
+		for (unsigned k = insideCount; k < pointCount; k += MAX_BATCH_SIZE)
+		{
+			Batch batch;
+			batch.first = k;
+			batch.last = std::min(pointCount, k + MAX_BATCH_SIZE);
+			batch.level = baseLevel;
+			batch.outside = true;
+			batches.push_back(batch);
+		}
+	}
+	catch (const std::bad_alloc&)
+	{
+		//not enough memory
+		return Results::ERROR_OUT_OF_MEMORY;
+	}
+
+	//progress notification
+	NormalizedProgress* nProgress = nullptr;
+	if (progressCb)
+	{
+		if (progressCb->textCanBeEdited())
+		{
+			progressCb->setMethodTitle("Cloud-Cloud Distance");
+			char buffer[256];
+			sprintf(buffer, "Compared points: %u\nBatches: %u\nBase level: %i", pointCount, static_cast<unsigned>(batches.size()), static_cast<int>(baseLevel));
+			progressCb->setInfo(buffer);
+		}
+		progressCb->update(0);
+		nProgress = new NormalizedProgress(progressCb, pointCount);
+		progressCb->start();
+	}
+
+	std::atomic<bool> canceled(false);
+
+	auto processBatch = [&](const Batch& batch)
+	{
+		if (canceled)
+			return;
+
+		//structure for the nearest neighbor search (shared by the points of the batch)
+		DgmOctree::NearestNeighboursSearchStruct nNSS;
+		nNSS.level								= batch.level;
+		nNSS.alreadyVisitedNeighbourhoodSize	= 0;
+		nNSS.theNearestPointIndex				= 0;
+		nNSS.maxSearchSquareDistd				= maxSearchSquareDistd;
+
+		if (!batch.outside)
+		{
+			m_octree->getCellPos(batch.truncatedCode, batch.level, nNSS.cellPos, true);
+			m_octree->computeCellCenter(nNSS.cellPos, batch.level, nNSS.cellCenter);
+		}
+
+		for (unsigned k = batch.first; k < batch.last; ++k)
+		{
+			const unsigned index = points[k].index;
+			comparedCloud->getPoint(index, nNSS.queryPoint);
+
+			if (batch.outside)
+			{
+				//each point has its own cell (outside of the octree, hence the 'floor')
+				const PointCoordinateType& cs = m_octree->getCellSize(batch.level);
+				const CCVector3& octreeMin = m_octree->getOctreeMins();
+				for (unsigned char d = 0; d < 3; ++d)
+				{
+					nNSS.cellPos.u[d] = static_cast<int>(std::floor((nNSS.queryPoint.u[d] - octreeMin.u[d]) / cs));
+				}
+				m_octree->computeCellCenter(nNSS.cellPos, batch.level, nNSS.cellCenter);
+				nNSS.minimalCellsSetToVisit.clear();
+				nNSS.pointsInNeighbourhood.clear();
+				nNSS.alreadyVisitedNeighbourhoodSize = 0;
+			}
+
+			if (params.CPSet || m_referenceCloud->testVisibility(nNSS.queryPoint) == POINT_VISIBLE) //to build the closest point set up we must process the point whatever its visibility is!
+			{
+				double squareDist = m_octree->findTheNearestNeighborStartingFromCell(nNSS);
+				if (squareDist >= 0)
+				{
+					comparedCloud->setPointScalarValue(index, static_cast<ScalarType>(sqrt(squareDist)));
+
+					if (params.CPSet)
+					{
+						params.CPSet->setPointIndex(index, nNSS.theNearestPointIndex);
+					}
+
+					if (computeSplitDistances)
+					{
+						CCVector3 P;
+						m_referenceCloud->getPoint(nNSS.theNearestPointIndex, P);
+
+						if (params.splitDistances[0])
+							params.splitDistances[0]->setValue(index, static_cast<ScalarType>(nNSS.queryPoint.x - P.x));
+						if (params.splitDistances[1])
+							params.splitDistances[1]->setValue(index, static_cast<ScalarType>(nNSS.queryPoint.y - P.y));
+						if (params.splitDistances[2])
+							params.splitDistances[2]->setValue(index, static_cast<ScalarType>(nNSS.queryPoint.z - P.z));
+					}
+				}
+				else
+				{
+					assert(!params.CPSet);
+				}
+			}
+			else
+			{
+				comparedCloud->setPointScalarValue(index, NAN_VALUE);
+			}
+		}
+
+		if (nProgress && !nProgress->steps(batch.last - batch.first))
+		{
+			canceled = true;
+		}
+	};
+
+#ifdef ENABLE_MT_C2C_INDEX
+	if (params.multiThread)
+	{
+		int maxThreadCount = params.maxThreadCount;
+		if (maxThreadCount == 0)
+		{
+			maxThreadCount = QThread::idealThreadCount();
+		}
+		QThreadPool::globalInstance()->setMaxThreadCount(maxThreadCount);
+		QtConcurrent::blockingMap(batches, processBatch);
+	}
+	else
+#endif
+	{
+		for (const Batch& batch : batches)
+		{
+			processBatch(batch);
+		}
+	}
+
+	if (progressCb)
+	{
+		progressCb->stop();
+		delete nProgress;
+		nProgress = nullptr;
+	}
+
+	return canceled ? Results::CANCELED_BY_USER : Results::SUCCESS;
+}
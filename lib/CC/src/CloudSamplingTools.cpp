@@ -31,10 +31,270 @@
 
 //system
 #include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <limits>
 #include <random>
 
+#ifdef USE_QT
+#ifndef CC_DEBUG
+//enables multi-threading handling
+#define ENABLE_MT_RESAMPLING
+#endif
+#endif
+
+#ifdef ENABLE_MT_RESAMPLING
+#include <QtConcurrentMap>
+#endif
+
 using namespace CCLib;
 
+//! Running mean and variance (Welford's algorithm)
+/** Partial statistics (e.g. computed on different tiles) can be merged (Chan et al.)
+**/
+struct RunningStatistics
+{
+	double count = 0;
+	double mean = 0;
+	double m2 = 0;
+
+	//! Adds a value
+	inline void add(double value)
+	{
+		count += 1.0;
+		double delta = value - mean;
+		mean += delta / count;
+		m2 += delta * (value - mean);
+	}
+
+	//! Merges other (partial) statistics
+	void merge(const RunningStatistics& other)
+	{
+		if (other.count == 0)
+			return;
+		double total = count + other.count;
+		double delta = other.mean - mean;
+		mean += delta * (other.count / total);
+		m2 += other.m2 + delta * delta * (count * other.count / total);
+		count = total;
+	}
+
+	//! Returns the (population) standard deviation
+	inline double stdDev() const { return (count > 0 ? sqrt(m2 / count) : 0.0); }
+};
+
+//! Regular 2D tiling of a cloud (along the two largest dimensions of its bounding-box)
+class CloudTiling
+{
+public:
+
+	//! Default constructor
+	CloudTiling()
+		: m_cloud(nullptr)
+		, m_dimX(0)
+		, m_dimY(1)
+		, m_bbMin(0, 0, 0)
+		, m_bbMax(0, 0, 0)
+		, m_tileSizeX(0)
+		, m_tileSizeY(0)
+		, m_tileCountX(1)
+		, m_tileCountY(1)
+	{}
+
+	//! Dispatches the points in the tiles
+	/** \return false if there's not enough memory
+	**/
+	bool init(GenericIndexedCloudPersist* cloud, unsigned maxTilePointCount)
+	{
+		m_cloud = cloud;
+		unsigned pointCount = cloud->size();
+
+		cloud->getBoundingBox(m_bbMin, m_bbMax);
+		CCVector3 diag = m_bbMax - m_bbMin;
+
+		//we use the two largest dimensions
+		unsigned char minDim = 0;
+		if (diag.u[1] < diag.u[minDim])
+			minDim = 1;
+		if (diag.u[2] < diag.u[minDim])
+			minDim = 2;
+		m_dimX = (minDim + 1) % 3;
+		m_dimY = (m_dimX + 1) % 3;
+
+		unsigned tileCount1D = 1;
+		if (maxTilePointCount != 0 && pointCount > maxTilePointCount)
+			tileCount1D = static_cast<unsigned>(ceil(sqrt(static_cast<double>(pointCount) / maxTilePointCount)));
+		m_tileCountX = (diag.u[m_dimX] > 0 ? tileCount1D : 1);
+		m_tileCountY = (diag.u[m_dimY] > 0 ? tileCount1D : 1);
+		m_tileSizeX = diag.u[m_dimX] / m_tileCountX;
+		m_tileSizeY = diag.u[m_dimY] / m_tileCountY;
+
+		try
+		{
+			//counting sort of the points indexes
+			std::vector<unsigned> pointTiles(pointCount);
+			m_tileStart.clear();
+			m_tileStart.resize(tileCount() + 1, 0);
+			for (unsigned i = 0; i < pointCount; ++i)
+			{
+				unsigned t = tileIndex(*cloud->getPoint(i));
+				pointTiles[i] = t;
+				++m_tileStart[t + 1];
+			}
+			for (unsigned t = 0; t < tileCount(); ++t)
+				m_tileStart[t + 1] += m_tileStart[t];
+
+			m_tileIndexes.resize(pointCount);
+			std::vector<unsigned> fillPos(m_tileStart.begin(), m_tileStart.end() - 1);
+			for (unsigned i = 0; i < pointCount; ++i)
+				m_tileIndexes[fillPos[pointTiles[i]]++] = i;
+		}
+		catch (const std::bad_alloc&)
+		{
+			//not enough memory
+			m_tileStart.clear();
+			m_tileIndexes.clear();
+			return false;
+		}
+
+		return true;
+	}
+
+	//! Returns the number of tiles
+	inline unsigned tileCount() const { return m_tileCountX * m_tileCountY; }
+
+	//! Returns the number of points in a given tile
+	inline unsigned tilePointCount(unsigned t) const { return m_tileStart[t + 1] - m_tileStart[t]; }
+
+	//! Returns the max extent of the cloud (a halo this big covers the whole cloud)
+	inline PointCoordinateType maxExtent() const
+	{
+		return std::max(m_bbMax.u[m_dimX] - m_bbMin.u[m_dimX], m_bbMax.u[m_dimY] - m_bbMin.u[m_dimY]);
+	}
+
+	//! Returns a (rough) estimation of the halo size required to get 'knn' neighbors
+	PointCoordinateType estimateHalo(unsigned t, int knn) const
+	{
+		PointCoordinateType extent = std::max(m_tileSizeX, m_tileSizeY);
+		double area = static_cast<double>(m_tileSizeX > 0 ? m_tileSizeX : extent) * (m_tileSizeY > 0 ? m_tileSizeY : extent);
+		double spacing = sqrt(area * knn / (M_PI * std::max(1u, tilePointCount(t))));
+		//sparse tiles shouldn't gather their whole neighbourhood
+		return std::max(std::min(static_cast<PointCoordinateType>(2 * spacing), extent), extent / 1000);
+	}
+
+	//! Gathers the points of a tile (first) and the ones of its halo
+	/** \return the number of points of the tile itself
+	**/
+	unsigned gatherTile(unsigned t, PointCoordinateType halo, ReferenceCloud& tileCloud) const
+	{
+		tileCloud.clear(false);
+
+		//the tile points first
+		unsigned coreCount = tilePointCount(t);
+		if (!tileCloud.reserve(coreCount))
+			return 0;
+		for (unsigned k = m_tileStart[t]; k < m_tileStart[t + 1]; ++k)
+			tileCloud.addPointIndex(m_tileIndexes[k]);
+
+		//then the halo
+		int ti = static_cast<int>(t % m_tileCountX);
+		int tj = static_cast<int>(t / m_tileCountX);
+		PointCoordinateType minX = m_bbMin.u[m_dimX] + ti * m_tileSizeX - halo;
+		PointCoordinateType maxX = m_bbMin.u[m_dimX] + (ti + 1) * m_tileSizeX + halo;
+		PointCoordinateType minY = m_bbMin.u[m_dimY] + tj * m_tileSizeY - halo;
+		PointCoordinateType maxY = m_bbMin.u[m_dimY] + (tj + 1) * m_tileSizeY + halo;
+
+		int di = (m_tileSizeX > 0 ? static_cast<int>(ceil(halo / m_tileSizeX)) : 0);
+		int dj = (m_tileSizeY > 0 ? static_cast<int>(ceil(halo / m_tileSizeY)) : 0);
+		for (int j = std::max(0, tj - dj); j <= std::min(static_cast<int>(m_tileCountY) - 1, tj + dj); ++j)
+		{
+			for (int i = std::max(0, ti - di); i <= std::min(static_cast<int>(m_tileCountX) - 1, ti + di); ++i)
+			{
+				unsigned n = static_cast<unsigned>(i + j * static_cast<int>(m_tileCountX));
+				if (n == t)
+					continue;
+				for (unsigned k = m_tileStart[n]; k < m_tileStart[n + 1]; ++k)
+				{
+					const CCVector3* P = m_cloud->getPoint(m_tileIndexes[k]);
+					if (	P->u[m_dimX] >= minX && P->u[m_dimX] <= maxX
+						&&	P->u[m_dimY] >= minY && P->u[m_dimY] <= maxY)
+					{
+						if (!tileCloud.addPointIndex(m_tileIndexes[k]))
+							return 0;
+					}
+				}
+			}
+		}
+
+		return coreCount;
+	}
+
+	//! Gathers all the points closer than a given radius (sorted by increasing distance)
+	bool gatherNeighbours(const CCVector3& P, PointCoordinateType radius, DgmOctree::NeighboursSet& neighbours) const
+	{
+		neighbours.clear();
+		double squareRadius = static_cast<double>(radius) * radius;
+
+		int ti0, tj0, ti1, tj1;
+		tilePos(P.u[m_dimX] - radius, P.u[m_dimY] - radius, ti0, tj0);
+		tilePos(P.u[m_dimX] + radius, P.u[m_dimY] + radius, ti1, tj1);
+		try
+		{
+			for (int j = tj0; j <= tj1; ++j)
+			{
+				for (int i = ti0; i <= ti1; ++i)
+				{
+					unsigned n = static_cast<unsigned>(i + j * static_cast<int>(m_tileCountX));
+					for (unsigned k = m_tileStart[n]; k < m_tileStart[n + 1]; ++k)
+					{
+						const CCVector3* Q = m_cloud->getPoint(m_tileIndexes[k]);
+						double squareDist = (*Q - P).norm2d();
+						if (squareDist <= squareRadius)
+							neighbours.emplace_back(Q, m_tileIndexes[k], squareDist);
+					}
+				}
+			}
+		}
+		catch (const std::bad_alloc&)
+		{
+			//not enough memory
+			return false;
+		}
+
+		std::sort(neighbours.begin(), neighbours.end(), DgmOctree::PointDescriptor::distComp);
+		return true;
+	}
+
+protected:
+
+	//! Returns the (clamped) position of the tile including a given 2D position
+	inline void tilePos(PointCoordinateType x, PointCoordinateType y, int& i, int& j) const
+	{
+		i = (m_tileSizeX > 0 ? static_cast<int>(floor((x - m_bbMin.u[m_dimX]) / m_tileSizeX)) : 0);
+		j = (m_tileSizeY > 0 ? static_cast<int>(floor((y - m_bbMin.u[m_dimY]) / m_tileSizeY)) : 0);
+		i = std::max(0, std::min(i, static_cast<int>(m_tileCountX) - 1));
+		j = std::max(0, std::min(j, static_cast<int>(m_tileCountY) - 1));
+	}
+
+	//! Returns the index of the tile including a given point
+	inline unsigned tileIndex(const CCVector3& P) const
+	{
+		int i, j;
+		tilePos(P.u[m_dimX], P.u[m_dimY], i, j);
+		return static_cast<unsigned>(i + j * static_cast<int>(m_tileCountX));
+	}
+
+	GenericIndexedCloudPersist* m_cloud;
+	unsigned char m_dimX, m_dimY;
+	CCVector3 m_bbMin, m_bbMax;
+	PointCoordinateType m_tileSizeX, m_tileSizeY;
+	unsigned m_tileCountX, m_tileCountY;
+	//! Tiles start (CSR layout)
+	std::vector<unsigned> m_tileStart;
+	//! Points indexes per tile (CSR layout)
+	std::vector<unsigned> m_tileIndexes;
+};
+
 GenericIndexedCloud* CloudSamplingTools::resampleCloudWithOctree(	GenericIndexedCloudPersist* inputCloud,
 																	int newNumberOfPoints,
 																	RESAMPLING_CELL_METHOD resamplingMethod,
@@ -251,6 +511,205 @@ ReferenceCloud* CloudSamplingTools::subsampleCloudRandomly(GenericIndexedCloudPe
 	return newCloud;
 }
 
+//! Spatial resampling job (shared by all the tasks)
+struct SpatialResamplingJob
+{
+	GenericIndexedCloudPersist* cloud = nullptr;
+	const DgmOctree* octree = nullptr;
+	unsigned char level = 0;
+	//! Default min distance between points
+	PointCoordinateType minDistance = 0;
+	//! Number of sub-cells (along each dimension) of the accepted points grid of each cell
+	int gridSize = 1;
+	//! Min distance modulation (if enabled)
+	const CloudSamplingTools::SFModulationParams* modParams = nullptr;
+	//! Truncated codes of the (non empty) cells
+	std::vector<DgmOctree::CellCode> cellCodes;
+	//! First point of each cell in the octree container (+ total count at the end)
+	std::vector<unsigned> cellStart;
+	//! Accepted points for each cell (each cell only writes its own list)
+	std::vector< std::vector<unsigned> > acceptedPoints;
+	//! Progress notification
+	NormalizedProgress* normProgress = nullptr;
+	//! Process status
+	std::atomic<bool> canceled{ false };
+	std::atomic<bool> memoryError{ false };
+
+	//! Returns the min distance around a given point
+	inline PointCoordinateType minDistanceAround(unsigned pointIndex) const
+	{
+		if (modParams)
+		{
+			ScalarType sfVal = cloud->getPointScalarValue(pointIndex);
+			if (ScalarField::ValidValue(sfVal))
+				return static_cast<PointCoordinateType>(sfVal * modParams->a + modParams->b);
+		}
+		return minDistance;
+	}
+
+	//! Returns the index of a cell (or -1 if the cell is empty)
+	inline int cellIndex(const Tuple3i& cellPos) const
+	{
+		const int cellCount = (1 << level);
+		if (	cellPos.x < 0 || cellPos.x >= cellCount
+			||	cellPos.y < 0 || cellPos.y >= cellCount
+			||	cellPos.z < 0 || cellPos.z >= cellCount)
+		{
+			return -1;
+		}
+		DgmOctree::CellCode code = DgmOctree::GenerateTruncatedCellCode(cellPos, level);
+		std::vector<DgmOctree::CellCode>::const_iterator it = std::lower_bound(cellCodes.begin(), cellCodes.end(), code);
+		return (it != cellCodes.end() && *it == code ? static_cast<int>(it - cellCodes.begin()) : -1);
+	}
+};
+
+//! Processes one cell of the spatial resampling
+/** A point is kept if it's not closer than 'minDistance' (modulated by the
+	accepted point) to any point already accepted in this cell or in one of
+	its 26 neighbours. Cells are at least as big as the largest distance, and
+	cells of the same phase are never adjacent: they can be processed concurrently.
+
+	As the cells may be much bigger than the smallest (modulated) distance, the
+	accepted points are registered in a finer grid covering the current cell:
+	each accepted point is added to all the sub-cells its exclusion sphere
+	intersects, so that a candidate is only tested against the points of its
+	own sub-cell.
+**/
+struct SpatialResamplingFunctor
+{
+	SpatialResamplingFunctor(SpatialResamplingJob& job) : m_job(job) {}
+
+	void operator () (unsigned cellIndex) const
+	{
+		if (m_job.canceled || m_job.memoryError)
+			return;
+
+		const DgmOctree::cellsContainer& codes = m_job.octree->pointsAndTheirCellCodes();
+		unsigned first = m_job.cellStart[cellIndex];
+		unsigned last = m_job.cellStart[cellIndex + 1];
+
+		try
+		{
+			//we process the points of the cell in their original order (deterministic)
+			std::vector<unsigned> pointIndexes;
+			pointIndexes.reserve(last - first);
+			for (unsigned i = first; i < last; ++i)
+				pointIndexes.push_back(codes[i].theIndex);
+			std::sort(pointIndexes.begin(), pointIndexes.end());
+
+			//accepted points grid (covering the current cell)
+			SubGrid grid;
+			m_job.octree->computeCellLimits(m_job.cellCodes[cellIndex], m_job.level, grid.origin, grid.corner, true);
+			grid.size = m_job.gridSize;
+			grid.step = m_job.octree->getCellSize(m_job.level) / grid.size;
+			grid.cells.resize(static_cast<std::size_t>(grid.size) * grid.size * grid.size);
+
+			//points already accepted in the neighbour cells
+			Tuple3i cellPos;
+			m_job.octree->getCellPos(m_job.cellCodes[cellIndex], m_job.level, cellPos, true);
+			for (int i = -1; i <= 1; ++i)
+				for (int j = -1; j <= 1; ++j)
+					for (int k = -1; k <= 1; ++k)
+					{
+						int neighbourIndex = m_job.cellIndex(Tuple3i(cellPos.x + i, cellPos.y + j, cellPos.z + k));
+						if (neighbourIndex >= 0 && neighbourIndex != static_cast<int>(cellIndex))
+						{
+							for (unsigned acceptedIndex : m_job.acceptedPoints[neighbourIndex])
+								addToGrid(grid, acceptedIndex);
+						}
+					}
+
+			std::vector<unsigned>& accepted = m_job.acceptedPoints[cellIndex];
+			for (unsigned pointIndex : pointIndexes)
+			{
+				const CCVector3* P = m_job.cloud->getPoint(pointIndex);
+				if (isFarEnough(*P, grid.cells[grid.cellIndex(*P)]))
+				{
+					accepted.push_back(pointIndex);
+					addToGrid(grid, pointIndex);
+				}
+			}
+		}
+		catch (const std::bad_alloc&)
+		{
+			m_job.memoryError = true;
+			return;
+		}
+
+		if (m_job.normProgress && !m_job.normProgress->steps(last - first))
+		{
+			m_job.canceled = true;
+		}
+	}
+
+protected:
+
+	//! Grid of accepted points (covering one cell)
+	struct SubGrid
+	{
+		CCVector3 origin;
+		CCVector3 corner;
+		PointCoordinateType step = 0;
+		int size = 1;
+		//! Accepted points whose exclusion sphere intersects each sub-cell
+		std::vector< std::vector<unsigned> > cells;
+
+		//! Returns the (clamped) sub-cell position along one dimension
+		inline int cellCoord(PointCoordinateType value, unsigned char dim) const
+		{
+			int c = static_cast<int>(std::floor((value - origin.u[dim]) / step));
+			return std::max(0, std::min(size - 1, c));
+		}
+
+		//! Returns the index of the sub-cell containing a given point
+		inline std::size_t cellIndex(const CCVector3& P) const
+		{
+			return (static_cast<std::size_t>(cellCoord(P.z, 2)) * size + cellCoord(P.y, 1)) * size + cellCoord(P.x, 0);
+		}
+	};
+
+	//! Registers an accepted point in all the sub-cells its exclusion sphere intersects
+	inline void addToGrid(SubGrid& grid, unsigned acceptedIndex) const
+	{
+		const CCVector3* A = m_job.cloud->getPoint(acceptedIndex);
+		PointCoordinateType r = std::abs(m_job.minDistanceAround(acceptedIndex));
+
+		//the sphere may not reach the current cell at all
+		for (unsigned char d = 0; d < 3; ++d)
+		{
+			if (A->u[d] + r < grid.origin.u[d] || A->u[d] - r > grid.corner.u[d])
+				return;
+		}
+
+		int minPos[3];
+		int maxPos[3];
+		for (unsigned char d = 0; d < 3; ++d)
+		{
+			minPos[d] = grid.cellCoord(A->u[d] - r, d);
+			maxPos[d] = grid.cellCoord(A->u[d] + r, d);
+		}
+
+		for (int k = minPos[2]; k <= maxPos[2]; ++k)
+			for (int j = minPos[1]; j <= maxPos[1]; ++j)
+				for (int i = minPos[0]; i <= maxPos[0]; ++i)
+					grid.cells[(static_cast<std::size_t>(k) * grid.size + j) * grid.size + i].push_back(acceptedIndex);
+	}
+
+	//! Checks that a point is not too close to already accepted points
+	inline bool isFarEnough(const CCVector3& P, const std::vector<unsigned>& accepted) const
+	{
+		for (unsigned acceptedIndex : accepted)
+		{
+			double r = m_job.minDistanceAround(acceptedIndex);
+			if ((*m_job.cloud->getPoint(acceptedIndex) - P).norm2d() <= r * r)
+				return false;
+		}
+		return true;
+	}
+
+	SpatialResamplingJob& m_job;
+};
+
 ReferenceCloud* CloudSamplingTools::resampleCloudSpatially(GenericIndexedCloudPersist* inputCloud,
 															PointCoordinateType minDistance,
 															const SFModulationParams& modParams,
@@ -272,76 +731,71 @@ ReferenceCloud* CloudSamplingTools::resampleCloudSpatially(GenericIndexedCloudPe
 	}
 	assert(octree && octree->associatedCloud() == inputCloud);
 
-	//output cloud
-	ReferenceCloud* sampledCloud = new ReferenceCloud(inputCloud);
-	const unsigned c_reserveStep = 65536;
-	if (!sampledCloud->reserve(std::min(cloudSize, c_reserveStep)))
-	{
-		if (!inputOctree)
-			delete octree;
-		return nullptr;
-	}
+	SpatialResamplingJob job;
+	job.cloud = inputCloud;
+	job.octree = octree;
+	job.minDistance = minDistance;
 
-	std::vector<char> markers; //DGM: upgraded from vector, as this can be quite huge!
-	try
+	//largest and smallest distances between points (there may be several of them if we use parameter modulation)
+	PointCoordinateType maxDistance = minDistance;
+	PointCoordinateType smallestDistance = minDistance;
+	if (modParams.enabled)
 	{
-		markers.resize(cloudSize, 1); //true by default
+		//compute min and max sf values
+		ScalarType sfMin = 0;
+		ScalarType sfMax = 0;
+		ScalarFieldTools::computeScalarFieldExtremas(inputCloud, sfMin, sfMax);
+
+		//if all SF values are NAN, the modulation is simply ignored
+		if (ScalarField::ValidValue(sfMin))
+		{
+			job.modParams = &modParams;
+			PointCoordinateType dist0 = static_cast<PointCoordinateType>(sfMin * modParams.a + modParams.b);
+			PointCoordinateType dist1 = static_cast<PointCoordinateType>(sfMax * modParams.a + modParams.b);
+			maxDistance = std::max(maxDistance, std::max(dist0, dist1));
+			smallestDistance = std::min(smallestDistance, std::min(std::abs(dist0), std::abs(dist1)));
+		}
 	}
-	catch (const std::bad_alloc&)
+
+	//the cells must be at least as big as the largest distance
+	job.level = 0;
+	while (job.level < DgmOctree::MAX_OCTREE_LEVEL && octree->getCellSize(job.level + 1) >= maxDistance)
+		++job.level;
+
+	//the accepted points grid of each cell should be (roughly) as fine as the smallest distance
+	static const int MAX_GRID_SIZE = 16;
 	{
-		if (!inputOctree)
-			delete octree;
-		delete sampledCloud;
-		return nullptr;
+		PointCoordinateType cellSize = octree->getCellSize(job.level);
+		job.gridSize = (smallestDistance * MAX_GRID_SIZE > cellSize ? std::max(1, static_cast<int>(std::ceil(cellSize / smallestDistance))) : MAX_GRID_SIZE);
 	}
 
-	//best octree level (there may be several of them if we use parameter modulation)
-	std::vector<unsigned char> bestOctreeLevel;
-	bool modParamsEnabled = modParams.enabled;
-	ScalarType sfMin = 0;
-	ScalarType sfMax = 0;
+	//list the non empty cells and dispatch them in 8 phases (so that two
+	//cells of the same phase are never adjacent)
+	std::vector<unsigned> phaseCells[8];
 	try
 	{
-		if (modParams.enabled)
-		{
-			//compute min and max sf values
-			ScalarFieldTools::computeScalarFieldExtremas(inputCloud, sfMin, sfMax);
+		const DgmOctree::cellsContainer& codes = octree->pointsAndTheirCellCodes();
+		const unsigned char bitDec = DgmOctree::GET_BIT_SHIFT(job.level);
 
-			if (!ScalarField::ValidValue(sfMin))
+		DgmOctree::CellCode currentCode = 0;
+		for (unsigned i = 0; i < cloudSize; ++i)
+		{
+			DgmOctree::CellCode truncatedCode = (codes[i].theCode >> bitDec);
+			if (i == 0 || truncatedCode != currentCode)
 			{
-				//all SF values are NAN?!
-				modParamsEnabled = false;
-			}
-			else
-			{
-				//compute min and max 'best' levels
-				PointCoordinateType dist0 = static_cast<PointCoordinateType>(sfMin * modParams.a + modParams.b);
-				PointCoordinateType dist1 = static_cast<PointCoordinateType>(sfMax * modParams.a + modParams.b);
-				unsigned char level0 = octree->findBestLevelForAGivenNeighbourhoodSizeExtraction(dist0);
-				unsigned char level1 = octree->findBestLevelForAGivenNeighbourhoodSizeExtraction(dist1);
-
-				bestOctreeLevel.push_back(level0);
-				if (level1 != level0)
-				{
-					//add intermediate levels if necessary
-					std::size_t levelCount = (level1 < level0 ? level0 - level1 : level1 - level0) + 1;
-					assert(levelCount != 0);
-
-					for (std::size_t i = 1; i < levelCount - 1; ++i) //we already know level0 and level1!
-					{
-						ScalarType sfVal = sfMin + i*((sfMax - sfMin) / levelCount);
-						PointCoordinateType dist = static_cast<PointCoordinateType>(sfVal * modParams.a + modParams.b);
-						unsigned char level = octree->findBestLevelForAGivenNeighbourhoodSizeExtraction(dist);
-						bestOctreeLevel.push_back(level);
-					}
-				}
-				bestOctreeLevel.push_back(level1);
+				currentCode = truncatedCode;
+				job.cellCodes.push_back(truncatedCode);
+				job.cellStart.push_back(i);
 			}
 		}
-		else
+		job.cellStart.push_back(cloudSize);
+		job.acceptedPoints.resize(job.cellCodes.size());
+
+		for (unsigned c = 0; c < job.cellCodes.size(); ++c)
 		{
-			unsigned char defaultLevel = octree->findBestLevelForAGivenNeighbourhoodSizeExtraction(minDistance);
-			bestOctreeLevel.push_back(defaultLevel);
+			Tuple3i cellPos;
+			octree->getCellPos(job.cellCodes[c], job.level, cellPos, true);
+			phaseCells[(cellPos.x & 1) | ((cellPos.y & 1) << 1) | ((cellPos.z & 1) << 2)].push_back(c);
 		}
 	}
 	catch (const std::bad_alloc&)
@@ -351,7 +805,6 @@ ReferenceCloud* CloudSamplingTools::resampleCloudSpatially(GenericIndexedCloudPe
 		{
 			delete octree;
 		}
-		delete sampledCloud;
 		return nullptr;
 	}
 
@@ -368,89 +821,54 @@ ReferenceCloud* CloudSamplingTools::resampleCloudSpatially(GenericIndexedCloudPe
 		}
 		progressCb->update(0);
 		progressCb->start();
+		job.normProgress = &normProgress;
 	}
 
-	//for each point in the cloud that is still 'marked', we look
-	//for its neighbors and remove their own marks
-	bool error = false;
-	//default octree level
-	assert(!bestOctreeLevel.empty());
-	unsigned char octreeLevel = bestOctreeLevel.front();
-	//default distance between points
-	PointCoordinateType minDistBetweenPoints = minDistance;
-	for (unsigned i = 0; i < cloudSize; i++)
+	//the phases are processed one after the other (the cells of each phase concurrently)
+	SpatialResamplingFunctor functor(job);
+	for (unsigned phase = 0; phase < 8 && !job.canceled && !job.memoryError; ++phase)
 	{
-		//no mark? we skip this point
-		if (markers[i] != 0)
-		{
-			//init neighbor search structure
-			const CCVector3* P = inputCloud->getPoint(i);
-
-			//parameters modulation
-			if (modParamsEnabled)
-			{
-				ScalarType sfVal = inputCloud->getPointScalarValue(i);
-				if (ScalarField::ValidValue(sfVal))
-				{
-					//modulate minDistance
-					minDistBetweenPoints = static_cast<PointCoordinateType>(sfVal * modParams.a + modParams.b);
-					//get (approximate) best level
-					std::size_t levelIndex = static_cast<std::size_t>(bestOctreeLevel.size() * ((sfVal - sfMin) / (sfMax - sfMin)));
-					if (levelIndex == bestOctreeLevel.size())
-						--levelIndex;
-					octreeLevel = bestOctreeLevel[levelIndex];
-				}
-				else
-				{
-					minDistBetweenPoints = minDistance;
-					octreeLevel = bestOctreeLevel.front();
-				}
-			}
+#ifdef ENABLE_MT_RESAMPLING
+		QtConcurrent::blockingMap(phaseCells[phase], functor);
+#else
+		for (unsigned cellIndex : phaseCells[phase])
+			functor(cellIndex);
+#endif
+	}
 
-			//look for neighbors and 'de-mark' them
-			{
-				DgmOctree::NeighboursSet neighbours;
-				octree->getPointsInSphericalNeighbourhood(*P, minDistBetweenPoints, neighbours, octreeLevel);
-				for (DgmOctree::NeighboursSet::iterator it = neighbours.begin(); it != neighbours.end(); ++it)
-					if (it->pointIndex != i)
-						markers[it->pointIndex] = 0;
-			}
+	//output cloud (in the points order)
+	ReferenceCloud* sampledCloud = nullptr;
+	if (!job.canceled && !job.memoryError)
+	{
+		std::size_t sampledCount = 0;
+		for (const std::vector<unsigned>& accepted : job.acceptedPoints)
+			sampledCount += accepted.size();
 
-			//At this stage, the ith point is the only one marked in a radius of <minDistance>.
-			//Therefore it will necessarily be in the final cloud!
-			if (sampledCloud->size() == sampledCloud->capacity() && !sampledCloud->reserve(sampledCloud->capacity() + c_reserveStep))
-			{
-				//not enough memory
-				error = true;
-				break;
-			}
-			if (!sampledCloud->addPointIndex(i))
-			{
-				//not enough memory
-				error = true;
-				break;
-			}
+		sampledCloud = new ReferenceCloud(inputCloud);
+		std::vector<unsigned> sampledIndexes;
+		try
+		{
+			sampledIndexes.reserve(sampledCount);
+			for (const std::vector<unsigned>& accepted : job.acceptedPoints)
+				sampledIndexes.insert(sampledIndexes.end(), accepted.begin(), accepted.end());
 		}
-
-		//progress indicator
-		if (progressCb && !normProgress.oneStep())
+		catch (const std::bad_alloc&)
 		{
-			//cancel process
-			error = true;
-			break;
+			job.memoryError = true;
 		}
-	}
 
-	//remove unnecessarily allocated memory
-	if (!error)
-	{
-		if (sampledCloud->capacity() > sampledCloud->size())
-			sampledCloud->resize(sampledCloud->size());
-	}
-	else
-	{
-		delete sampledCloud;
-		sampledCloud = nullptr;
+		if (!job.memoryError && sampledCloud->resize(static_cast<unsigned>(sampledCount)))
+		{
+			std::sort(sampledIndexes.begin(), sampledIndexes.end());
+			for (std::size_t i = 0; i < sampledCount; ++i)
+				sampledCloud->setPointIndex(static_cast<unsigned>(i), sampledIndexes[i]);
+		}
+		else
+		{
+			//not enough memory
+			delete sampledCloud;
+			sampledCloud = nullptr;
+		}
 	}
 
 	if (progressCb)
@@ -518,7 +936,9 @@ ReferenceCloud* CloudSamplingTools::sorFilter(	GenericIndexedCloudPersist* input
 		{
 			//additional parameters
 			void* additionalParameters[] = {reinterpret_cast<void*>(&knn),
-											reinterpret_cast<void*>(&meanDistances)
+											reinterpret_cast<void*>(&meanDistances),
+											nullptr,
+											nullptr
 			};
 
 			unsigned char octreeLevel = octree->findBestLevelForAGivenPopulationPerCell(knn);
@@ -535,15 +955,13 @@ ReferenceCloud* CloudSamplingTools::sorFilter(	GenericIndexedCloudPersist* input
 			}
 
 			//deduce the average distance and std. dev.
-			double sumDist = 0;
-			double sumSquareDist = 0;
+			RunningStatistics stats;
 			for (unsigned i = 0; i < pointCount; ++i)
 			{
-				sumDist += meanDistances[i];
-				sumSquareDist += meanDistances[i] * meanDistances[i];
+				stats.add(meanDistances[i]);
 			}
-			avgDist = sumDist / pointCount;
-			stdDev = sqrt(std::abs(sumSquareDist / pointCount - avgDist*avgDist));
+			avgDist = stats.mean;
+			stdDev = stats.stdDev();
 		}
 
 		//2nd step: remove the farthest points 
@@ -630,14 +1048,16 @@ ReferenceCloud* CloudSamplingTools::noiseFilter(GenericIndexedCloudPersist* inpu
 									reinterpret_cast<void*>(&useKnn),
 									reinterpret_cast<void*>(&knn),
 									reinterpret_cast<void*>(&useAbsoluteError),
-									reinterpret_cast<void*>(&absoluteError)
+									reinterpret_cast<void*>(&absoluteError),
+									nullptr,
+									nullptr
 	};
 
 	unsigned char octreeLevel = 0;
 	if (useKnn)
-		octreeLevel = octree->findBestLevelForAGivenNeighbourhoodSizeExtraction(kernelRadius);
-	else
 		octreeLevel = octree->findBestLevelForAGivenPopulationPerCell(knn);
+	else
+		octreeLevel = octree->findBestLevelForAGivenNeighbourhoodSizeExtraction(kernelRadius);
 
 	if (octree->executeFunctionForAllCellsAtLevel(	octreeLevel,
 													&applyNoiseFilterAtLevel,
@@ -665,6 +1085,490 @@ ReferenceCloud* CloudSamplingTools::noiseFilter(GenericIndexedCloudPersist* inpu
 	return filteredCloud;
 }
 
+//! Gathers a tile (and its halo) and builds the corresponding octree
+/** The halo is enlarged if necessary so that there's more than 'minPointCount' points.
+	\return the number of points of the tile itself (or 0 if an error occurred)
+**/
+static unsigned PrepareTile(const CloudTiling& tiling,
+							unsigned t,
+							PointCoordinateType& halo,
+							unsigned minPointCount,
+							ReferenceCloud& tileCloud,
+							DgmOctree& tileOctree)
+{
+	unsigned coreCount = 0;
+	while (true)
+	{
+		coreCount = tiling.gatherTile(t, halo, tileCloud);
+		if (coreCount == 0 || tileCloud.size() > minPointCount || halo >= tiling.maxExtent())
+			break;
+		halo *= 2;
+	}
+
+	if (coreCount != 0 && tileOctree.build() < 1)
+	{
+		return 0;
+	}
+
+	return coreCount;
+}
+
+//! Whether too many points of a tile have neighbors beyond the halo (they would be processed again one by one)
+static inline bool TooManyTileFallbacks(unsigned fallbackCount, unsigned coreCount)
+{
+	//at most 1% of the points (or a few points for sparse tiles)
+	return (fallbackCount > 64 && fallbackCount > coreCount / 100);
+}
+
+ReferenceCloud* CloudSamplingTools::sorFilterTiled(	GenericIndexedCloudPersist* inputCloud,
+													int knn/*=6*/,
+													double nSigma/*=1.0*/,
+													unsigned maxTilePointCount/*=(1<<20)*/,
+													GenericProgressCallback* progressCb/*=0*/)
+{
+	if (!inputCloud || knn <= 0 || inputCloud->size() <= static_cast<unsigned>(knn))
+	{
+		//invalid input
+		assert(false);
+		return nullptr;
+	}
+
+	unsigned pointCount = inputCloud->size();
+
+	CloudTiling tiling;
+	std::vector<PointCoordinateType> meanDistances;
+	try
+	{
+		meanDistances.resize(pointCount, 0);
+	}
+	catch (const std::bad_alloc&)
+	{
+		//not enough memory
+		return nullptr;
+	}
+	if (!tiling.init(inputCloud, maxTilePointCount))
+	{
+		//not enough memory
+		return nullptr;
+	}
+
+	//progress notification
+	NormalizedProgress normProgress(progressCb, pointCount);
+	if (progressCb)
+	{
+		if (progressCb->textCanBeEdited())
+		{
+			progressCb->setMethodTitle("SOR filter");
+			char buffer[256];
+			sprintf(buffer, "Points: %u\nTiles: %u", pointCount, tiling.tileCount());
+			progressCb->setInfo(buffer);
+		}
+		progressCb->update(0);
+		progressCb->start();
+	}
+
+	//1st step: compute the average distance to the neighbors (tile by tile)
+	RunningStatistics stats;
+	bool error = false;
+	{
+		ReferenceCloud tileCloud(inputCloud);
+		DgmOctree tileOctree(&tileCloud);
+		std::vector<PointCoordinateType> tileMeanDistances;
+		std::vector<PointCoordinateType> tileMaxDistances;
+		DgmOctree::NeighboursSet neighbours;
+
+		for (unsigned t = 0; t < tiling.tileCount() && !error; ++t)
+		{
+			if (tiling.tilePointCount(t) == 0)
+				continue;
+
+			//we need at least knn points in the tile + its halo
+			PointCoordinateType halo = tiling.estimateHalo(t, knn);
+			unsigned coreCount = 0;
+			while (true)
+			{
+				coreCount = PrepareTile(tiling, t, halo, static_cast<unsigned>(knn), tileCloud, tileOctree);
+				if (coreCount == 0)
+				{
+					error = true;
+					break;
+				}
+
+				try
+				{
+					tileMeanDistances.resize(tileCloud.size());
+					tileMaxDistances.resize(tileCloud.size());
+				}
+				catch (const std::bad_alloc&)
+				{
+					//not enough memory
+					error = true;
+					break;
+				}
+
+				//additional parameters
+				void* additionalParameters[] = {reinterpret_cast<void*>(&knn),
+												reinterpret_cast<void*>(&tileMeanDistances),
+												reinterpret_cast<void*>(&coreCount),
+												reinterpret_cast<void*>(&tileMaxDistances)
+				};
+
+				unsigned char octreeLevel = tileOctree.findBestLevelForAGivenPopulationPerCell(knn);
+				if (tileOctree.executeFunctionForAllCellsAtLevel(	octreeLevel,
+																	&applySORFilterAtLevel,
+																	additionalParameters,
+																	true,
+																	nullptr) == 0)
+				{
+					//something went wrong
+					error = true;
+					break;
+				}
+
+				//if too many points may have nearer neighbors outside of the halo, we enlarge it
+				unsigned fallbackCount = 0;
+				for (unsigned i = 0; i < coreCount; ++i)
+				{
+					if (tileMaxDistances[i] > halo)
+						++fallbackCount;
+				}
+				if (!TooManyTileFallbacks(fallbackCount, coreCount) || halo >= tiling.maxExtent())
+					break;
+				halo *= 2;
+			}
+			if (error)
+			{
+				break;
+			}
+
+			RunningStatistics tileStats;
+			for (unsigned i = 0; i < coreCount; ++i)
+			{
+				unsigned globalIndex = tileCloud.getPointGlobalIndex(i);
+				PointCoordinateType meanDist = tileMeanDistances[i];
+
+				//some nearer neighbors may lie outside of the halo
+				if (tileMaxDistances[i] > halo)
+				{
+					const CCVector3* P = inputCloud->getPoint(globalIndex);
+					if (!tiling.gatherNeighbours(*P, tileMaxDistances[i], neighbours))
+					{
+						//not enough memory
+						error = true;
+						break;
+					}
+
+					double sumDist = 0;
+					unsigned count = 0;
+					for (int j = 0; j < knn && j < static_cast<int>(neighbours.size()); ++j)
+					{
+						if (neighbours[j].pointIndex != globalIndex)
+						{
+							sumDist += sqrt(neighbours[j].squareDistd);
+							++count;
+						}
+					}
+					if (count)
+					{
+						meanDist = static_cast<PointCoordinateType>(sumDist / count);
+					}
+				}
+
+				meanDistances[globalIndex] = meanDist;
+				tileStats.add(meanDist);
+			}
+			stats.merge(tileStats);
+
+			if (progressCb && !normProgress.steps(coreCount))
+			{
+				//cancel process
+				error = true;
+			}
+		}
+	}
+
+	//2nd step: remove the farthest points
+	ReferenceCloud* filteredCloud = nullptr;
+	if (!error)
+	{
+		//deduce the max distance
+		double maxDist = stats.mean + nSigma * stats.stdDev();
+
+		filteredCloud = new ReferenceCloud(inputCloud);
+		if (filteredCloud->reserve(pointCount))
+		{
+			for (unsigned i = 0; i < pointCount; ++i)
+			{
+				if (meanDistances[i] <= maxDist)
+				{
+					filteredCloud->addPointIndex(i);
+				}
+			}
+
+			filteredCloud->resize(filteredCloud->size());
+		}
+		else
+		{
+			//not enough memory
+			delete filteredCloud;
+			filteredCloud = nullptr;
+		}
+	}
+
+	if (progressCb)
+	{
+		progressCb->stop();
+	}
+
+	return filteredCloud;
+}
+
+//! Selects the neighbors used by the noise filter
+/** The query point is moved out of the neighbors range. With a constant number of neighbors, only the (knn-1)
+	nearest neighbors are kept (knn includes the query point itself, as with the octree search). They are
+	sorted by increasing distance, then by index, so that the selection doesn't depend on the search
+	structure (octree cells, tiles, etc.).
+	\return the number of neighbors (at the beginning of the set, without the query point)
+**/
+static unsigned SelectNoiseFilterNeighbours(DgmOctree::NeighboursSet& neighbours,
+											unsigned neighborCount,
+											unsigned queryIndex,
+											bool useKnn,
+											int knn)
+{
+	//find the query point in the neighbors set and place it at the end
+	for (unsigned j = 0; j < neighborCount; ++j)
+	{
+		if (neighbours[j].pointIndex == queryIndex)
+		{
+			std::swap(neighbours[j], neighbours[neighborCount - 1]);
+			--neighborCount;
+			break;
+		}
+	}
+
+	if (useKnn && neighborCount + 1 > static_cast<unsigned>(knn))
+	{
+		std::partial_sort(	neighbours.begin(),
+							neighbours.begin() + (knn - 1),
+							neighbours.begin() + neighborCount,
+							[](const DgmOctree::PointDescriptor& a, const DgmOctree::PointDescriptor& b)
+							{
+								return (a.squareDistd < b.squareDistd || (a.squareDistd == b.squareDistd && a.pointIndex < b.pointIndex));
+							});
+		neighborCount = static_cast<unsigned>(knn - 1);
+	}
+
+	return neighborCount;
+}
+
+ReferenceCloud* CloudSamplingTools::noiseFilterTiled(	GenericIndexedCloudPersist* inputCloud,
+														PointCoordinateType kernelRadius,
+														double nSigma,
+														bool removeIsolatedPoints/*=false*/,
+														bool useKnn/*=false*/,
+														int knn/*=6*/,
+														bool useAbsoluteError/*=true*/,
+														double absoluteError/*=0.0*/,
+														unsigned maxTilePointCount/*=(1<<20)*/,
+														GenericProgressCallback* progressCb/*=0*/)
+{
+	if (!inputCloud || inputCloud->size() < 2 || (useKnn && knn <= 0) || (!useKnn && kernelRadius <= 0))
+	{
+		//invalid input
+		assert(false);
+		return nullptr;
+	}
+
+	unsigned pointCount = inputCloud->size();
+
+	CloudTiling tiling;
+	if (!tiling.init(inputCloud, maxTilePointCount))
+	{
+		//not enough memory
+		return nullptr;
+	}
+
+	//progress notification
+	NormalizedProgress normProgress(progressCb, pointCount);
+	if (progressCb)
+	{
+		if (progressCb->textCanBeEdited())
+		{
+			progressCb->setMethodTitle("Noise filter");
+			char buffer[256];
+			sprintf(buffer, "Points: %u\nTiles: %u", pointCount, tiling.tileCount());
+			progressCb->setInfo(buffer);
+		}
+		progressCb->update(0);
+		progressCb->start();
+	}
+
+	//the selected points are appended tile after tile
+	ReferenceCloud* filteredCloud = new ReferenceCloud(inputCloud);
+	bool error = false;
+	{
+		ReferenceCloud tileCloud(inputCloud);
+		DgmOctree tileOctree(&tileCloud);
+		ReferenceCloud tileFilteredCloud(&tileCloud);
+		std::vector<PointCoordinateType> tileMaxDistances;
+		std::vector<bool> tileKeptPoints;
+		DgmOctree::NeighboursSet neighbours;
+
+		for (unsigned t = 0; t < tiling.tileCount() && !error; ++t)
+		{
+			if (tiling.tilePointCount(t) == 0)
+				continue;
+
+			//with a radius, the halo is simply the radius (otherwise, we need at least knn points)
+			PointCoordinateType halo = (useKnn ? tiling.estimateHalo(t, knn) : kernelRadius);
+			unsigned coreCount = 0;
+			while (true)
+			{
+				coreCount = PrepareTile(tiling, t, halo, useKnn ? static_cast<unsigned>(knn) : 0, tileCloud, tileOctree);
+				if (coreCount == 0)
+				{
+					error = true;
+					break;
+				}
+
+				tileFilteredCloud.clear(false);
+				try
+				{
+					tileMaxDistances.resize(tileCloud.size());
+					tileKeptPoints.assign(coreCount, false);
+				}
+				catch (const std::bad_alloc&)
+				{
+					//not enough memory
+					error = true;
+					break;
+				}
+				if (!tileFilteredCloud.reserve(coreCount))
+				{
+					//not enough memory
+					error = true;
+					break;
+				}
+
+				//additional parameters
+				void* additionalParameters[] = {reinterpret_cast<void*>(&tileFilteredCloud),
+												reinterpret_cast<void*>(&kernelRadius),
+												reinterpret_cast<void*>(&nSigma),
+												reinterpret_cast<void*>(&removeIsolatedPoints),
+												reinterpret_cast<void*>(&useKnn),
+												reinterpret_cast<void*>(&knn),
+												reinterpret_cast<void*>(&useAbsoluteError),
+												reinterpret_cast<void*>(&absoluteError),
+												reinterpret_cast<void*>(&coreCount),
+												reinterpret_cast<void*>(&tileMaxDistances)
+				};
+
+				unsigned char octreeLevel = 0;
+				if (useKnn)
+					octreeLevel = tileOctree.findBestLevelForAGivenPopulationPerCell(knn);
+				else
+					octreeLevel = tileOctree.findBestLevelForAGivenNeighbourhoodSizeExtraction(kernelRadius);
+
+				if (tileOctree.executeFunctionForAllCellsAtLevel(	octreeLevel,
+																	&applyNoiseFilterAtLevel,
+																	additionalParameters,
+																	true,
+																	nullptr) == 0)
+				{
+					//something went wrong
+					error = true;
+					break;
+				}
+
+				if (!useKnn)
+					break;
+
+				//if too many points may have nearer neighbors outside of the halo, we enlarge it
+				unsigned fallbackCount = 0;
+				for (unsigned i = 0; i < coreCount; ++i)
+				{
+					if (tileMaxDistances[i] > halo)
+						++fallbackCount;
+				}
+				if (!TooManyTileFallbacks(fallbackCount, coreCount) || halo >= tiling.maxExtent())
+					break;
+				halo *= 2;
+			}
+			if (error)
+			{
+				break;
+			}
+
+			for (unsigned i = 0; i < tileFilteredCloud.size(); ++i)
+			{
+				tileKeptPoints[tileFilteredCloud.getPointGlobalIndex(i)] = true;
+			}
+
+			for (unsigned i = 0; i < coreCount; ++i)
+			{
+				unsigned globalIndex = tileCloud.getPointGlobalIndex(i);
+				bool keepPoint = tileKeptPoints[i];
+
+				//with a constant number of neighbors, some nearer neighbors may lie outside of the halo
+				if (useKnn && tileMaxDistances[i] > halo)
+				{
+					const CCVector3* P = inputCloud->getPoint(globalIndex);
+					//the k-th neighbor in the tile is at least as far as the real one (the radius is rounded up)
+					PointCoordinateType radius = std::nextafter(tileMaxDistances[i], std::numeric_limits<PointCoordinateType>::max());
+					if (!tiling.gatherNeighbours(*P, radius, neighbours))
+					{
+						//not enough memory
+						error = true;
+						break;
+					}
+
+					unsigned realNeighborCount = SelectNoiseFilterNeighbours(neighbours, static_cast<unsigned>(neighbours.size()), globalIndex, true, knn);
+					if (realNeighborCount >= 3)
+					{
+						DgmOctreeReferenceCloud neighboursCloud(&neighbours, realNeighborCount);
+						keepPoint = keepPointAfterNoiseFiltering(*P, &neighboursCloud, nSigma, removeIsolatedPoints, useAbsoluteError, absoluteError);
+					}
+					else
+					{
+						keepPoint = !removeIsolatedPoints;
+					}
+				}
+
+				if (keepPoint && !filteredCloud->addPointIndex(globalIndex))
+				{
+					//not enough memory
+					error = true;
+					break;
+				}
+			}
+
+			if (progressCb && !normProgress.steps(coreCount))
+			{
+				//cancel process
+				error = true;
+			}
+		}
+	}
+
+	if (error)
+	{
+		delete filteredCloud;
+		filteredCloud = nullptr;
+	}
+	else
+	{
+		filteredCloud->resize(filteredCloud->size());
+	}
+
+	if (progressCb)
+	{
+		progressCb->stop();
+	}
+
+	return filteredCloud;
+}
+
 bool CloudSamplingTools::resampleCellAtLevel(	const DgmOctree::octreeCell& cell,
 												void** additionalParameters,
 												NormalizedProgress* nProgress/*=0*/)
@@ -739,6 +1643,53 @@ bool CloudSamplingTools::subsampleCellAtLevel(	const DgmOctree::octreeCell& cell
 	return cloud->addPointIndex(cell.points->getPointGlobalIndex(selectedPointIndex));
 }
 
+bool CloudSamplingTools::keepPointAfterNoiseFiltering(	const CCVector3& P,
+														GenericIndexedCloudPersist* neighbours,
+														double nSigma,
+														bool removeIsolatedPoints,
+														bool useAbsoluteError,
+														double absoluteError)
+{
+	unsigned realNeighborCount = neighbours->size();
+	if (realNeighborCount < 3) //we want 3 points or more (other than the point itself!)
+	{
+		//not enough points to fit a plane AND compute distances to it
+		return !removeIsolatedPoints;
+	}
+
+	Neighbourhood Z(neighbours);
+
+	const PointCoordinateType* lsPlane = Z.getLSPlane();
+	if (!lsPlane)
+	{
+		//degenerate neighborhood (e.g. collinear points): the point can't be validated
+		return false;
+	}
+
+	double maxD = absoluteError;
+	if (!useAbsoluteError)
+	{
+		//compute the std. dev. to this plane
+		double sum_d = 0;
+		double sum_d2 = 0;
+		for (unsigned j = 0; j < realNeighborCount; ++j)
+		{
+			const CCVector3* Q = neighbours->getPoint(j);
+			double d = CCLib::DistanceComputationTools::computePoint2PlaneDistance(Q, lsPlane);
+			sum_d += d;
+			sum_d2 += d*d;
+		}
+
+		double stddev = sqrt(std::abs(sum_d2*realNeighborCount - sum_d*sum_d)) / realNeighborCount;
+		maxD = stddev * nSigma;
+	}
+
+	//distance from the query point to the plane
+	double d = std::abs(CCLib::DistanceComputationTools::computePoint2PlaneDistance(&P, lsPlane));
+
+	return (d <= maxD);
+}
+
 bool CloudSamplingTools::applyNoiseFilterAtLevel(	const DgmOctree::octreeCell& cell,
 													void** additionalParameters,
 													NormalizedProgress* nProgress/*=0*/)
@@ -751,6 +1702,8 @@ bool CloudSamplingTools::applyNoiseFilterAtLevel(	const DgmOctree::octreeCell& c
 	int knn								= *static_cast<int*>(additionalParameters[5]);
 	bool useAbsoluteError				= *static_cast<bool*>(additionalParameters[6]);
 	double absoluteError				= *static_cast<double*>(additionalParameters[7]);
+	const unsigned* maxIndex			=  static_cast<unsigned*>(additionalParameters[8]);
+	std::vector<PointCoordinateType>* maxDistances = static_cast<std::vector<PointCoordinateType>*>(additionalParameters[9]);
 
 	//structure for nearest neighbors search
 	DgmOctree::NearestNeighboursSphericalSearchStruct nNSS;
@@ -768,6 +1721,17 @@ bool CloudSamplingTools::applyNoiseFilterAtLevel(	const DgmOctree::octreeCell& c
 	//for each point in the cell
 	for (unsigned i = 0; i < n; ++i)
 	{
+		const unsigned globalIndex = cell.points->getPointGlobalIndex(i);
+		if (maxIndex && globalIndex >= *maxIndex)
+		{
+			//we skip this point
+			if (nProgress && !nProgress->oneStep())
+			{
+				return false;
+			}
+			continue;
+		}
+
 		cell.points->getPoint(i, nNSS.queryPoint);
 
 		//look for neighbors (either inside a sphere or the k nearest ones)
@@ -779,67 +1743,32 @@ bool CloudSamplingTools::applyNoiseFilterAtLevel(	const DgmOctree::octreeCell& c
 		else
 			neighborCount = cell.parentOctree->findNeighborsInASphereStartingFromCell(nNSS, kernelRadius, false);
 
-		if (neighborCount > 3) //we want 3 points or more (other than the point itself!)
+		//the knn search may return more (eligible) points than requested: we only keep the knn nearest ones
+		unsigned realNeighborCount = SelectNoiseFilterNeighbours(nNSS.pointsInNeighbourhood, neighborCount, globalIndex, useKnn, knn);
+
+		if (maxDistances)
 		{
-			//find the query point in the nearest neighbors set and place it at the end
-			const unsigned globalIndex = cell.points->getPointGlobalIndex(i);
-			unsigned localIndex = 0;
-			while (localIndex < neighborCount && nNSS.pointsInNeighbourhood[localIndex].pointIndex != globalIndex)
-				++localIndex;
-			//the query point should be in the nearest neighbors set!
-			assert(localIndex < neighborCount);
-			if (localIndex + 1 < neighborCount) //no need to swap with another point if it's already at the end!
-			{
-				std::swap(nNSS.pointsInNeighbourhood[localIndex], nNSS.pointsInNeighbourhood[neighborCount - 1]);
-			}
+			double maxSquareDist = 0;
+			for (unsigned j = 0; j < realNeighborCount; ++j)
+				maxSquareDist = std::max(maxSquareDist, nNSS.pointsInNeighbourhood[j].squareDistd);
+			(*maxDistances)[globalIndex] = static_cast<PointCoordinateType>(sqrt(maxSquareDist));
+		}
 
-			unsigned realNeighborCount = neighborCount - 1;
+		bool keepPoint = false;
+		if (realNeighborCount >= 3) //we want 3 points or more (other than the point itself!)
+		{
 			DgmOctreeReferenceCloud neighboursCloud(&nNSS.pointsInNeighbourhood, realNeighborCount); //we don't take the query point into account!
-			Neighbourhood Z(&neighboursCloud);
-
-			const PointCoordinateType* lsPlane = Z.getLSPlane();
-			if (lsPlane)
-			{
-				double maxD = absoluteError;
-				if (!useAbsoluteError)
-				{
-					//compute the std. dev. to this plane
-					double sum_d = 0;
-					double sum_d2 = 0;
-					for (unsigned j = 0; j < realNeighborCount; ++j)
-					{
-						const CCVector3* P = neighboursCloud.getPoint(j);
-						double d = CCLib::DistanceComputationTools::computePoint2PlaneDistance(P, lsPlane);
-						sum_d += d;
-						sum_d2 += d*d;
-					}
-
-					double stddev = sqrt(std::abs(sum_d2*realNeighborCount - sum_d*sum_d)) / realNeighborCount;
-					maxD = stddev * nSigma;
-				}
-
-				//distance from the query point to the plane
-				double d = std::abs(CCLib::DistanceComputationTools::computePoint2PlaneDistance(&nNSS.queryPoint, lsPlane));
-
-				if (d <= maxD)
-				{
-					cloud->addPointIndex(globalIndex);
-				}
-			}
-			else
-			{
-				//TODO: ???
-			}
+			keepPoint = keepPointAfterNoiseFiltering(nNSS.queryPoint, &neighboursCloud, nSigma, removeIsolatedPoints, useAbsoluteError, absoluteError);
 		}
 		else
 		{
 			//not enough points to fit a plane AND compute distances to it
-			if (!removeIsolatedPoints)
-			{
-				//we keep the point
-				unsigned globalIndex = cell.points->getPointGlobalIndex(i);
-				cloud->addPointIndex(globalIndex);
-			}
+			keepPoint = !removeIsolatedPoints;
+		}
+
+		if (keepPoint)
+		{
+			cloud->addPointIndex(globalIndex);
 		}
 
 		if (nProgress && !nProgress->oneStep())
@@ -857,6 +1786,8 @@ bool CloudSamplingTools::applySORFilterAtLevel(	const DgmOctree::octreeCell& cel
 {
 	int knn											= *static_cast<int*>(additionalParameters[0]);
 	std::vector<PointCoordinateType>& meanDistances = *static_cast<std::vector<PointCoordinateType>*>(additionalParameters[1]);
+	const unsigned* maxIndex						=  static_cast<unsigned*>(additionalParameters[2]);
+	std::vector<PointCoordinateType>* maxDistances	=  static_cast<std::vector<PointCoordinateType>*>(additionalParameters[3]);
 
 	//structure for nearest neighbors search
 	DgmOctree::NearestNeighboursSphericalSearchStruct nNSS;
@@ -870,8 +1801,18 @@ bool CloudSamplingTools::applySORFilterAtLevel(	const DgmOctree::octreeCell& cel
 	//for each point in the cell
 	for (unsigned i = 0; i < n; ++i)
 	{
-		cell.points->getPoint(i, nNSS.queryPoint);
 		const unsigned globalIndex = cell.points->getPointGlobalIndex(i);
+		if (maxIndex && globalIndex >= *maxIndex)
+		{
+			//we skip this point
+			if (nProgress && !nProgress->oneStep())
+			{
+				return false;
+			}
+			continue;
+		}
+
+		cell.points->getPoint(i, nNSS.queryPoint);
 
 		//look for the k nearest neighbors
 		cell.parentOctree->findNearestNeighborsStartingFromCell(nNSS);
@@ -885,6 +1826,11 @@ bool CloudSamplingTools::applySORFilterAtLevel(	const DgmOctree::octreeCell& cel
 				++count;
 			}
 		}
+		if (maxDistances)
+		{
+			//the neighbors are sorted
+			(*maxDistances)[globalIndex] = static_cast<PointCoordinateType>(sqrt(nNSS.pointsInNeighbourhood[knn - 1].squareDistd));
+		}
 
 		if (count)
 		{
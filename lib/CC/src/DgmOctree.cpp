@@ -27,7 +27,11 @@
 #include <ScalarField.h>
 
 //system
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
 #include <cstdio>
+#include <memory>
 #include <set>
 
 //DGM: tests in progress
@@ -41,6 +45,10 @@
 #endif
 #endif
 
+#ifdef ENABLE_MT_OCTREE
+#include <QtConcurrentMap>
+#endif
+
 using namespace CCLib;
 
 /**********************************/
@@ -130,6 +138,15 @@ int DgmOctree::OCTREE_LENGTH(int level)
 	return (1 << level);
 }
 
+//! Returns whether a cell position lies inside the octree grid at a given level
+static inline bool CellPosIsInsideOctree(const Tuple3i& cellPos, unsigned char level)
+{
+	const int cellCount = DgmOctree::OCTREE_LENGTH(level);
+	return (	cellPos.x >= 0 && cellPos.x < cellCount
+			&&	cellPos.y >= 0 && cellPos.y < cellCount
+			&&	cellPos.z >= 0 && cellPos.z < cellCount );
+}
+
 DgmOctree::CellCode DgmOctree::GenerateTruncatedCellCode(const Tuple3i& cellPos, unsigned char level)
 {
 	assert( cellPos.x >= 0 && cellPos.x < MonoDimensionalCellCodes::VALUE_COUNT
@@ -1365,7 +1382,8 @@ double DgmOctree::findTheNearestNeighborStartingFromCell(NearestNeighboursSearch
 		assert(nNSS.minimalCellsSetToVisit.empty());
 
 		//check for existence of an 'including' cell
-		CellCode truncatedCellCode = GenerateTruncatedCellCode(nNSS.cellPos, nNSS.level);
+		//(the query point may lie outside of the octree)
+		CellCode truncatedCellCode = (CellPosIsInsideOctree(nNSS.cellPos, nNSS.level) ? GenerateTruncatedCellCode(nNSS.cellPos, nNSS.level) : INVALID_CELL_CODE);
 		unsigned index = (truncatedCellCode == INVALID_CELL_CODE ? m_numberOfProjectedPoints : getCellIndex(truncatedCellCode,bitDec));
 
 		visitedCellDistance = 1;
@@ -1384,6 +1402,7 @@ double DgmOctree::findTheNearestNeighborStartingFromCell(NearestNeighboursSearch
 			//fill indexes for current level
 			const int* _fillIndexes = m_fillIndexes + 6*nNSS.level;
 			int diagonalDistance = 0;
+			int minCellSquareDist = 0;
 			for (int dim=0; dim<3; ++dim)
 			{
 				//distance to min border of octree along each axis
@@ -1399,6 +1418,8 @@ double DgmOctree::findTheNearestNeighborStartingFromCell(NearestNeighboursSearch
 				{
 					visitedCellDistance = std::max(distToBorder,visitedCellDistance);
 					diagonalDistance += distToBorder*distToBorder;
+					//the query point may lie anywhere in its cell
+					minCellSquareDist += (distToBorder-1)*(distToBorder-1);
 				}
 
 				//next dimension
@@ -1411,10 +1432,10 @@ double DgmOctree::findTheNearestNeighborStartingFromCell(NearestNeighboursSearch
 
 			if (nNSS.maxSearchSquareDistd > 0)
 			{
-				//Distance to the nearest point
-				double minDist = static_cast<double>(eligibleCellDistance-1) * cs;
+				//Distance to the nearest point (lower bound)
+				double minBorderSquareDist = static_cast<double>(minCellSquareDist) * cs * cs;
 				//if we are already outside of the search limit, we can quit
-				if (minDist*minDist > nNSS.maxSearchSquareDistd)
+				if (minBorderSquareDist > nNSS.maxSearchSquareDistd)
 				{
 					return -1.0;
 				}
@@ -1534,7 +1555,8 @@ unsigned DgmOctree::findNearestNeighborsStartingFromCell(	NearestNeighboursSearc
 		assert(nNSS.pointsInNeighbourhood.empty());
 
 		//check for existence of 'including' cell
-		CellCode truncatedCellCode = GenerateTruncatedCellCode(nNSS.cellPos, nNSS.level);
+		//(the query point may lie outside of the octree)
+		CellCode truncatedCellCode = (CellPosIsInsideOctree(nNSS.cellPos, nNSS.level) ? GenerateTruncatedCellCode(nNSS.cellPos, nNSS.level) : INVALID_CELL_CODE);
 		unsigned index = (truncatedCellCode == INVALID_CELL_CODE ? m_numberOfProjectedPoints : getCellIndex(truncatedCellCode,bitDec));
 
 		visitedCellDistance = 1;
@@ -1562,6 +1584,7 @@ unsigned DgmOctree::findNearestNeighborsStartingFromCell(	NearestNeighboursSearc
 			//fill indexes for current level
 			const int* _fillIndexes = m_fillIndexes + 6*nNSS.level;
 			int diagonalDistance = 0;
+			int minCellSquareDist = 0;
 			for (int dim=0; dim<3; ++dim)
 			{
 				//distance to min border of octree along each axis
@@ -1577,6 +1600,8 @@ unsigned DgmOctree::findNearestNeighborsStartingFromCell(	NearestNeighboursSearc
 				{
 					visitedCellDistance = std::max(distToBorder,visitedCellDistance);
 					diagonalDistance += distToBorder*distToBorder;
+					//the query point may lie anywhere in its cell
+					minCellSquareDist += (distToBorder-1)*(distToBorder-1);
 				}
 
 				//next dimension
@@ -1589,10 +1614,10 @@ unsigned DgmOctree::findNearestNeighborsStartingFromCell(	NearestNeighboursSearc
 
 			if (nNSS.maxSearchSquareDistd > 0)
 			{
-				//Distance of the nearest point
-				double minDist = static_cast<double>(eligibleCellDistance-1) * cs;
+				//Distance to the nearest point (lower bound)
+				double minBorderSquareDist = static_cast<double>(minCellSquareDist) * cs * cs;
 				//if we are already outside of the search limit, we can quit
-				if (minDist*minDist > nNSS.maxSearchSquareDistd)
+				if (minBorderSquareDist > nNSS.maxSearchSquareDistd)
 				{
 					return 0;
 				}
@@ -2789,176 +2814,283 @@ bool DgmOctree::diff(unsigned char octreeLevel, const cellsContainer &codesA, co
 	return true;
 }
 
-int DgmOctree::extractCCs(unsigned char level, bool sixConnexity, GenericProgressCallback* progressCb) const
+int DgmOctree::extractCCs(unsigned char level, bool sixConnexity, GenericProgressCallback* progressCb, ConnectedComponentInfoContainer* componentsInfo) const
 {
 	std::vector<CellCode> cellCodes;
 	getCellCodes(level,cellCodes);
-	return extractCCs(cellCodes, level, sixConnexity, progressCb);
+	return extractCCs(cellCodes, level, sixConnexity, progressCb, componentsInfo);
 }
 
-struct IndexAndCodeExt
+//! Number of cells processed by each connected components labelling task
+static const std::size_t CC_LABELLING_CHUNK_SIZE = 4096;
+
+//! Connected components labelling job (shared by all the tasks)
+/** Cells are the nodes of a union-find forest. Each cell is merged with its
+	already 'visited' neighbours (half of the 6 or 26 neighbours) found by a
+	binary search in the sorted cell codes: there's no dense grid. Union is
+	lock-free and always links the greatest root below the smallest one, so
+	that each component root ends up being its first cell (in code order).
+**/
+struct CCLabellingJob
 {
-#ifdef OCTREE_CODES_64_BITS
-	using IndexType = unsigned long long;
-#else
-	using IndexType = unsigned;
-#endif
-	
-	//! index
-	IndexType theIndex;
-
-	//! cell code
-	DgmOctree::CellCode theCode;
-
-	//! Default constructor
-	IndexAndCodeExt()
-		: theIndex(0)
-		, theCode(0)
-	{}
-
-	//! Compares two IndexAndCodeExt instances based on their index
-	/** \param a first IndexAndCode structure
-		\param b second IndexAndCode structure
-		\return whether the index of 'a' is smaller than the index of 'b'
-	**/
-	static bool indexComp(const IndexAndCodeExt& a, const IndexAndCodeExt& b) throw()
+	enum Pass { UNION, RELABEL };
+
+	const DgmOctree* octree = nullptr;
+	GenericIndexedCloudPersist* cloud = nullptr;
+	unsigned char level = 0;
+	unsigned char bitDec = 0;
+	Pass pass = UNION;
+	//! Sorted (unique) truncated codes of the input cells
+	DgmOctree::cellCodesContainer cellCodes;
+	//! Shifts to the 'preceding' neighbours
+	std::vector<Tuple3i> neighbourShifts;
+	//! Parent of each cell in the union-find forest
+	std::unique_ptr< std::atomic<unsigned>[] > parents;
+	//! Position of each cell in the (z,y,x) grid scanning order
+	std::vector<std::uint64_t> scanIndexes;
+	//! Label of each component (indexed by the component root)
+	std::vector<int> rootLabels;
+	//! Statistics of each cell (only if required)
+	DgmOctree::ConnectedComponentInfoContainer* cellInfo = nullptr;
+	//! Progress notification
+	NormalizedProgress* normProgress = nullptr;
+
+	//! Bits of each dimension in the truncated cell codes (x = bits 0, 3, 6, etc.)
+	DgmOctree::CellCode dimMasks[3] = { 0, 0, 0 };
+
+	//! Computes the code of a neighbour cell directly on the interleaved bits (returns false if it's outside the octree)
+	inline bool neighbourCode(DgmOctree::CellCode code, const Tuple3i& shift, DgmOctree::CellCode& neighbour) const
 	{
-		return a.theIndex < b.theIndex;
-	}
-
-};
+		neighbour = code;
+		for (unsigned char d = 0; d < 3; ++d)
+		{
+			if (shift.u[d] == 0)
+				continue;
 
-int DgmOctree::extractCCs(const cellCodesContainer& cellCodes, unsigned char level, bool sixConnexity, GenericProgressCallback* progressCb) const
-{
-	std::size_t numberOfCells = cellCodes.size();
-	if (numberOfCells == 0) //no cells!
-		return -1;
+			const DgmOctree::CellCode mask = dimMasks[d];
+			const DgmOctree::CellCode one = (static_cast<DgmOctree::CellCode>(1) << d);
+			DgmOctree::CellCode v = (code & mask);
+			if (shift.u[d] < 0)
+			{
+				if (v == 0)
+					return false;
+				v = ((v - one) & mask);
+			}
+			else
+			{
+				if (v == mask)
+					return false;
+				v = (((v | ~mask) + one) & mask);
+			}
+			neighbour = ((neighbour & ~mask) | v);
+		}
+		return true;
+	}
 
-	//filled octree cells
-	std::vector<IndexAndCodeExt> ccCells;
-	try
+	//! Returns the index of a cell (or the number of cells if it doesn't exist)
+	/** Neighbour cells are generally close in the codes order: we look for the
+		code around the current cell with an exponential search first.
+		\param code cell code
+		\param hint start index (generally the index of the current cell)
+	**/
+	inline std::size_t findCell(DgmOctree::CellCode code, std::size_t hint) const
 	{
-		ccCells.resize(numberOfCells);
+		const std::size_t cellCount = cellCodes.size();
+		std::size_t first = 0;
+		std::size_t last = cellCount;
+		if (code < cellCodes[hint])
+		{
+			last = hint;
+			for (std::size_t step = 1; step <= hint; step *= 2)
+			{
+				if (cellCodes[hint - step] <= code)
+				{
+					first = hint - step;
+					break;
+				}
+				last = hint - step;
+			}
+		}
+		else
+		{
+			first = hint;
+			for (std::size_t step = 1; hint + step < cellCount; step *= 2)
+			{
+				if (cellCodes[hint + step] >= code)
+				{
+					last = hint + step + 1;
+					break;
+				}
+				first = hint + step;
+			}
+		}
+
+		std::size_t index = static_cast<std::size_t>(std::lower_bound(cellCodes.begin() + first, cellCodes.begin() + last, code) - cellCodes.begin());
+		return (index < cellCount && cellCodes[index] == code ? index : cellCount);
 	}
-	catch (const std::bad_alloc&)
+
+	//! Returns the root of a cell (with path halving)
+	inline unsigned findRoot(unsigned cellIndex) const
 	{
-		//not enough memory
-		return -2;
+		unsigned parent = parents[cellIndex].load();
+		while (parent != cellIndex)
+		{
+			unsigned grandParent = parents[parent].load();
+			if (grandParent != parent)
+				parents[cellIndex].compare_exchange_weak(parent, grandParent);
+			cellIndex = grandParent;
+			parent = parents[cellIndex].load();
+		}
+		return cellIndex;
 	}
 
-	//we compute the position of each cell (grid coordinates)
-	Tuple3i indexMin;
-	Tuple3i indexMax;
+	//! Merges the components of two cells
+	inline void unite(unsigned cellA, unsigned cellB) const
 	{
-		//binary shift for cell code truncation
-		unsigned char bitDec = GET_BIT_SHIFT(level);
-
-		for (std::size_t i = 0; i < numberOfCells; i++)
+		while (true)
 		{
-			ccCells[i].theCode = (cellCodes[i] >> bitDec);
+			unsigned rootA = findRoot(cellA);
+			unsigned rootB = findRoot(cellB);
+			if (rootA == rootB)
+				return;
+			if (rootA < rootB)
+				std::swap(rootA, rootB);
+			//rootA is the greatest: we link it below rootB (if it's still a root)
+			unsigned expected = rootA;
+			if (parents[rootA].compare_exchange_strong(expected, rootB))
+				return;
+			cellA = rootA;
+			cellB = rootB;
+		}
+	}
+};
 
-			Tuple3i cellPos;
-			getCellPos(ccCells[i].theCode, level, cellPos, true);
+//! Processes a chunk of cells for the current pass of the connected components labelling
+struct CCLabellingFunctor
+{
+	CCLabellingFunctor(CCLabellingJob& job) : m_job(job) {}
 
-			//we look for the actual min and max dimensions of the input cells set
-			//(which may not be the whole set of octree cells!)
-			if (i != 0)
+	void operator () (const std::pair<std::size_t, std::size_t>& range) const
+	{
+		for (std::size_t i = range.first; i < range.second; ++i)
+		{
+			const DgmOctree::CellCode code = m_job.cellCodes[i];
+			if (m_job.pass == CCLabellingJob::UNION)
 			{
-				for (unsigned char k = 0; k < 3; k++)
+				Tuple3i cellPos;
+				m_job.octree->getCellPos(code, m_job.level, cellPos, true);
+				m_job.scanIndexes[i] =	(static_cast<std::uint64_t>(cellPos.z) << (2 * m_job.level))
+									+	(static_cast<std::uint64_t>(cellPos.y) << m_job.level)
+									+	 static_cast<std::uint64_t>(cellPos.x);
+
+				for (const Tuple3i& shift : m_job.neighbourShifts)
 				{
-					if (cellPos.u[k] < indexMin.u[k])
-						indexMin.u[k] = cellPos.u[k];
-					else if (cellPos.u[k] > indexMax.u[k])
-						indexMax.u[k] = cellPos.u[k];
+					DgmOctree::CellCode neighbourCode = 0;
+					if (!m_job.neighbourCode(code, shift, neighbourCode))
+						continue;
+
+					std::size_t neighbourIndex = m_job.findCell(neighbourCode, i);
+					if (neighbourIndex < m_job.cellCodes.size())
+						m_job.unite(static_cast<unsigned>(i), static_cast<unsigned>(neighbourIndex));
 				}
 			}
-			else
+			else //RELABEL
 			{
-				indexMin.x = indexMax.x = cellPos.x;
-				indexMin.y = indexMax.y = cellPos.y;
-				indexMin.z = indexMax.z = cellPos.z;
-			}
+				int label = m_job.rootLabels[m_job.findRoot(static_cast<unsigned>(i))];
+				assert(label > 0);
+				ScalarType d = static_cast<ScalarType>(label);
 
-			//Warning: the cells will have to be sorted inside a slice afterwards!
-			ccCells[i].theIndex = (static_cast<IndexAndCodeExt::IndexType>(cellPos.x))
-								+ (static_cast<IndexAndCodeExt::IndexType>(cellPos.y) << level)
-								+ (static_cast<IndexAndCodeExt::IndexType>(cellPos.z) << (2 * level));
+				DgmOctree::ConnectedComponentInfo* info = (m_job.cellInfo ? &m_job.cellInfo->at(i) : nullptr);
+
+				const DgmOctree::cellsContainer& pointsAndCodes = m_job.octree->pointsAndTheirCellCodes();
+				unsigned pointCount = m_job.octree->getNumberOfProjectedPoints();
+				for (unsigned j = m_job.octree->getCellIndex(code, m_job.bitDec); j < pointCount && (pointsAndCodes[j].theCode >> m_job.bitDec) == code; ++j)
+				{
+					unsigned pointIndex = pointsAndCodes[j].theIndex;
+					m_job.cloud->setPointScalarValue(pointIndex, d);
+
+					if (info)
+					{
+						const CCVector3* P = m_job.cloud->getPoint(pointIndex);
+						if (info->pointCount++ == 0)
+						{
+							info->bbMin = info->bbMax = *P;
+						}
+						else
+						{
+							info->bbMin.x = std::min(info->bbMin.x, P->x);
+							info->bbMin.y = std::min(info->bbMin.y, P->y);
+							info->bbMin.z = std::min(info->bbMin.z, P->z);
+							info->bbMax.x = std::max(info->bbMax.x, P->x);
+							info->bbMax.y = std::max(info->bbMax.y, P->y);
+							info->bbMax.z = std::max(info->bbMax.z, P->z);
+						}
+					}
+				}
+			}
 		}
-	}
 
-	//we deduce the size of the grid that totally includes input cells
-	Tuple3i gridSize = indexMax - indexMin + Tuple3i(1, 1, 1);
+		if (m_job.normProgress)
+			m_job.normProgress->oneStep();
+	}
 
-	//we sort the cells
-	ParallelSort(ccCells.begin(), ccCells.end(), IndexAndCodeExt::indexComp); //ascending index code order
+protected:
+	CCLabellingJob& m_job;
+};
 
-	const int& di = gridSize.x;
-	const int& dj = gridSize.y;
-	const int& step = gridSize.z;
+int DgmOctree::extractCCs(	const cellCodesContainer& cellCodes,
+							unsigned char level,
+							bool sixConnexity,
+							GenericProgressCallback* progressCb,
+							ConnectedComponentInfoContainer* componentsInfo) const
+{
+	if (cellCodes.empty()) //no cells!
+		return -1;
 
-	//relative neighbos positions (either 6 or 26 total - but we only use half of it)
-	unsigned char neighborsInCurrentSlice = 0;
-	unsigned char neighborsInPrecedingSlice = 0;
-	int currentSliceNeighborsShifts[4];
-	int precedingSliceNeighborsShifts[9]; //maximum size to simplify code...
+	CCLabellingJob job;
+	job.octree = this;
+	job.cloud = m_theAssociatedCloud;
+	job.level = level;
+	job.bitDec = GET_BIT_SHIFT(level);
+	for (unsigned char k = 0; k < level; ++k)
+		for (unsigned char d = 0; d < 3; ++d)
+			job.dimMasks[d] |= (static_cast<CellCode>(1) << (3 * k + d));
 
+	//relative neighbours positions (either 6 or 26 total - but we only use the 'preceding' half)
 	if (sixConnexity) //6-connexity
 	{
-		neighborsInCurrentSlice = 2;
-		currentSliceNeighborsShifts[0] = -(di + 2);
-		currentSliceNeighborsShifts[1] = -1;
-
-		neighborsInPrecedingSlice = 1;
-		precedingSliceNeighborsShifts[0] = 0;
+		job.neighbourShifts = { Tuple3i(-1, 0, 0), Tuple3i(0, -1, 0), Tuple3i(0, 0, -1) };
 	}
 	else //26-connexity
 	{
-		neighborsInCurrentSlice = 4;
-		currentSliceNeighborsShifts[0] = -1 - (di + 2);
-		currentSliceNeighborsShifts[1] = -(di + 2);
-		currentSliceNeighborsShifts[2] = 1 - (di + 2);
-		currentSliceNeighborsShifts[3] = -1;
-
-		neighborsInPrecedingSlice = 9;
-		precedingSliceNeighborsShifts[0] = -1 - (di + 2);
-		precedingSliceNeighborsShifts[1] = -(di + 2);
-		precedingSliceNeighborsShifts[2] = 1 - (di + 2);
-		precedingSliceNeighborsShifts[3] = -1;
-		precedingSliceNeighborsShifts[4] = 0;
-		precedingSliceNeighborsShifts[5] = 1;
-		precedingSliceNeighborsShifts[6] = -1 + (di + 2);
-		precedingSliceNeighborsShifts[7] = (di + 2);
-		precedingSliceNeighborsShifts[8] = 1 + (di + 2);
+		for (int k = -1; k <= 0; ++k)
+			for (int j = -1; j <= 1; ++j)
+				for (int i = -1; i <= 1; ++i)
+					if (k < 0 || j < 0 || (j == 0 && i < 0))
+						job.neighbourShifts.emplace_back(i, j, k);
+		assert(job.neighbourShifts.size() == 13);
 	}
 
-	//shared structures (to avoid repeated allocations)
-	std::vector<int> neighboursVal;
-	std::vector<int> neighboursMin;
+	//filled octree cells (sorted truncated codes)
+	std::vector< std::pair<std::size_t, std::size_t> > chunks;
+	std::size_t numberOfCells = 0;
 	try
 	{
-		neighboursVal.reserve(neighborsInCurrentSlice + neighborsInPrecedingSlice);
-		neighboursMin.reserve(neighborsInCurrentSlice + neighborsInPrecedingSlice);
-	}
-	catch (const std::bad_alloc&)
-	{
-		//not enough memory
-		return -2;
-	}
-
-	//temporary virtual 'slices'
-	int sliceSize = (di + 2) * (dj + 2); //add a margin to avoid "boundary effects"
-	std::vector<int> slice;
-	std::vector<int> oldSlice;
-	//equivalence table between 'on the fly' labels
-	std::vector<int> equivalentLabels;
-	std::vector<int> cellIndexToLabel;
-
-	try
-	{
-		slice.resize(sliceSize);
-		oldSlice.resize(sliceSize, 0); //previous slice is empty by default
-		equivalentLabels.resize(numberOfCells + 2, 0);
-		cellIndexToLabel.resize(numberOfCells, 0);
+		job.cellCodes.resize(cellCodes.size());
+		for (std::size_t i = 0; i < cellCodes.size(); ++i)
+			job.cellCodes[i] = (cellCodes[i] >> job.bitDec);
+		if (!std::is_sorted(job.cellCodes.begin(), job.cellCodes.end()))
+			ParallelSort(job.cellCodes.begin(), job.cellCodes.end());
+		job.cellCodes.erase(std::unique(job.cellCodes.begin(), job.cellCodes.end()), job.cellCodes.end());
+		numberOfCells = job.cellCodes.size();
+
+		job.parents.reset(new std::atomic<unsigned>[numberOfCells]);
+		for (std::size_t i = 0; i < numberOfCells; ++i)
+			job.parents[i].store(static_cast<unsigned>(i));
+		job.scanIndexes.resize(numberOfCells);
+
+		for (std::size_t first = 0; first < numberOfCells; first += CC_LABELLING_CHUNK_SIZE)
+			chunks.emplace_back(first, std::min(numberOfCells, first + CC_LABELLING_CHUNK_SIZE));
 	}
 	catch (const std::bad_alloc&)
 	{
@@ -2973,209 +3105,88 @@ int DgmOctree::extractCCs(const cellCodesContainer& cellCodes, unsigned char lev
 		{
 			progressCb->setMethodTitle("Components Labeling");
 			char buffer[256];
-			sprintf(buffer, "Box: [%i*%i*%i]", gridSize.x, gridSize.y, gridSize.z);
+			sprintf(buffer, "Cells: %u", static_cast<unsigned>(numberOfCells));
 			progressCb->setInfo(buffer);
 		}
 		progressCb->update(0);
 		progressCb->start();
 	}
 
-	//current label
-	std::size_t currentLabel = 1;
+	CCLabellingFunctor functor(job);
+	NormalizedProgress nprogress(progressCb, static_cast<unsigned>(chunks.size()));
+	job.normProgress = &nprogress;
 
-	//process each slice
+	//merge the neighbour cells
+	job.pass = CCLabellingJob::UNION;
+#ifdef ENABLE_MT_OCTREE
+	QtConcurrent::blockingMap(chunks, functor);
+#else
+	for (const std::pair<std::size_t, std::size_t>& range : chunks)
+		functor(range);
+#endif
+
+	if (progressCb)
 	{
-		unsigned counter = 0;
-		const IndexAndCodeExt::IndexType gridCoordMask = (static_cast<IndexAndCodeExt::IndexType>(1) << level) - 1;
-		std::vector<IndexAndCodeExt>::const_iterator _ccCells = ccCells.begin();
-		NormalizedProgress nprogress(progressCb, step);
+		progressCb->stop();
+	}
 
-		for (int k = indexMin.z; k < indexMin.z + step; k++)
+	//components are numbered in the order of their first cell in the (z,y,x) grid
+	//scanning order (as with the previous slice-based algorithm)
+	int numberOfComponents = 0;
+	try
+	{
+		std::vector< std::pair<std::uint64_t, unsigned> > roots;
 		{
-			//initialize the 'current' slice
-			std::fill(slice.begin(), slice.end(), 0);
-
-			//for each cell of the slice
-			while (counter < numberOfCells && static_cast<int>(_ccCells->theIndex >> (level << 1)) == k)
+			for (std::size_t i = 0; i < numberOfCells; ++i)
 			{
-				int iind = static_cast<int>(_ccCells->theIndex & gridCoordMask);
-				int jind = static_cast<int>((_ccCells->theIndex >> level) & gridCoordMask);
-				int cellIndex = (iind - indexMin.x + 1) + (jind - indexMin.y + 1)*(di + 2);
-				++_ccCells;
-
-				//we look if the cell has neighbors inside the slice
-				int* _slice = &(slice[cellIndex]);
-				{
-					for (unsigned char n = 0; n < neighborsInCurrentSlice; n++)
-					{
-						assert(cellIndex + currentSliceNeighborsShifts[n] < sliceSize);
-						const int& neighborLabel = _slice[currentSliceNeighborsShifts[n]];
-						if (neighborLabel > 1)
-							neighboursVal.push_back(neighborLabel);
-					}
-				}
-
-				//and in the previous slice
-				const int* _oldSlice = &(oldSlice[cellIndex]);
-				{
-					for (unsigned char n = 0; n < neighborsInPrecedingSlice; n++)
-					{
-						assert(cellIndex + precedingSliceNeighborsShifts[n] < sliceSize);
-						const int& neighborLabel = _oldSlice[precedingSliceNeighborsShifts[n]];
-						if (neighborLabel > 1)
-							neighboursVal.push_back(neighborLabel);
-					}
-				}
-
-				//number of neighbors for current cell
-				std::size_t p = neighboursVal.size();
-
-				if (p == 0) //no neighbor
-				{
-					*_slice = static_cast<int>(++currentLabel); //we create a new label
-				}
-				else if (p == 1) //1 neighbor
-				{
-					*_slice = neighboursVal.back(); //we'll use its label
-					neighboursVal.pop_back();
-				}
-				else //more than 1 neighbor?
-				{
-					//we get the smallest label
-					ParallelSort(neighboursVal.begin(), neighboursVal.end());
-					
-					int smallestLabel = neighboursVal[0];
-
-					//if they are not the same
-					if (smallestLabel != neighboursVal.back())
-					{
-						int lastLabel = 0;
-						neighboursMin.clear();
-						//we get the smallest equivalent label for each neighbor's branch
-						{
-							for (std::size_t n = 0; n < p; n++)
-							{
-								// ... we start from its C.C. index
-								int label = neighboursVal[n];
-								//if it's not the same as the previous neighbor's
-								if (label != lastLabel)
-								{
-									//we update the 'before' value
-									assert(label < static_cast<int>(numberOfCells)+2);
-									lastLabel = label;
-
-									//we look for its real equivalent value
-									while (equivalentLabels[label] > 1)
-									{
-										label = equivalentLabels[label];
-										assert(label < static_cast<int>(numberOfCells)+2);
-									}
-
-									neighboursMin.push_back(label);
-								}
-							}
-						}
-
-						//get the smallest one
-						ParallelSort(neighboursMin.begin(), neighboursMin.end());
-						
-						smallestLabel = neighboursMin.front();
-
-						//update the equivalence table by the way
-						//for all other branches
-						lastLabel = smallestLabel;
-						{
-							for (std::size_t n = 1; n < neighboursMin.size(); n++)
-							{
-								int label = neighboursMin[n];
-								assert(label < static_cast<int>(numberOfCells)+2);
-								//we don't process it if it's the same label as the previous neighbor
-								if (label != lastLabel)
-								{
-									equivalentLabels[label] = smallestLabel;
-									lastLabel = label;
-								}
-							}
-						}
-					}
-
-					//update current cell label
-					*_slice = smallestLabel;
-					neighboursVal.clear();
-				}
-
-				cellIndexToLabel[counter++] = *_slice;
+				unsigned root = job.findRoot(static_cast<unsigned>(i));
+				if (root == i)
+					roots.emplace_back(job.scanIndexes[i], root);
+				else if (job.scanIndexes[i] < job.scanIndexes[root])
+					job.scanIndexes[root] = job.scanIndexes[i];
 			}
-
-			if (counter == numberOfCells)
-				break;
-
-			std::swap(slice, oldSlice);
-
-			nprogress.oneStep();
+			//update the roots scan index (it may have been lowered after they were inserted)
+			for (std::pair<std::uint64_t, unsigned>& root : roots)
+				root.first = job.scanIndexes[root.second];
 		}
-	}
+		ParallelSort(roots.begin(), roots.end());
 
-	//release some memory
-	slice.resize(0);
-	oldSlice.resize(0);
+		job.scanIndexes.clear();
+		job.scanIndexes.shrink_to_fit();
 
-	if (progressCb)
+		job.rootLabels.resize(numberOfCells, 0);
+		for (const std::pair<std::uint64_t, unsigned>& root : roots)
+			job.rootLabels[root.second] = ++numberOfComponents; //labels start at '1'
+	}
+	catch (const std::bad_alloc&)
 	{
-		progressCb->stop();
+		//not enough memory
+		return -2;
 	}
 
-	if (currentLabel < 2)
+	if (numberOfComponents == 0)
 	{
 		//No component found
 		return -3;
 	}
 
-	//path compression (http://en.wikipedia.org/wiki/Union_find)
-	assert(currentLabel < numberOfCells + 2);
-	{
-		for (std::size_t i = 2; i <= currentLabel; i++)
-		{
-			int label = equivalentLabels[i];
-			assert(label < static_cast<int>(numberOfCells)+2);
-			while (equivalentLabels[label] > 1) //equivalentLabels[0] == 0 !!!
-			{
-				label = equivalentLabels[label];
-				assert(label < static_cast<int>(numberOfCells)+2);
-			}
-			equivalentLabels[i] = label;
-		}
-	}
-
-	//update leaves
+	//per-cell statistics (if required)
+	ConnectedComponentInfoContainer cellInfo;
+	if (componentsInfo)
 	{
-		for (std::size_t i = 0; i < numberOfCells; i++)
+		try
 		{
-			int label = cellIndexToLabel[i];
-			assert(label < static_cast<int>(numberOfCells)+2);
-			if (equivalentLabels[label] > 1)
-				cellIndexToLabel[i] = equivalentLabels[label];
+			cellInfo.resize(numberOfCells);
+			componentsInfo->clear();
+			componentsInfo->resize(numberOfComponents);
 		}
-	}
-
-	//hack: we use "equivalentLabels" to count how many components will have to be created
-	int numberOfComponents = 0;
-	{
-		std::fill(equivalentLabels.begin(), equivalentLabels.end(), 0);
-
-		for (std::size_t i = 0; i < numberOfCells; i++)
+		catch (const std::bad_alloc&)
 		{
-			assert(cellIndexToLabel[i] > 1 && cellIndexToLabel[i] < static_cast<int>(numberOfCells)+2);
-			equivalentLabels[cellIndexToLabel[i]] = 1;
+			//not enough memory
+			return -2;
 		}
-
-		//we create (following) indexes for each components
-		for (std::size_t i = 2; i < numberOfCells + 2; i++)
-			if (equivalentLabels[i] == 1)
-				equivalentLabels[i] = ++numberOfComponents; //labels start at '1'
+		job.cellInfo = &cellInfo;
 	}
-	assert(equivalentLabels[0] == 0);
-	assert(equivalentLabels[1] == 0);
 
 	//we flag each component's points with its label
 	{
@@ -3191,26 +3202,15 @@ int DgmOctree::extractCCs(const cellCodesContainer& cellCodes, unsigned char lev
 			progressCb->update(0);
 			progressCb->start();
 		}
-		NormalizedProgress nprogress(progressCb, static_cast<unsigned>(numberOfCells));
+		nprogress.reset();
 
-		ReferenceCloud Y(m_theAssociatedCloud);
-		for (std::size_t i = 0; i < numberOfCells; i++)
-		{
-			assert(cellIndexToLabel[i] < static_cast<int>(numberOfCells)+2);
-
-			const int& label = equivalentLabels[cellIndexToLabel[i]];
-			assert(label > 0);
-			getPointsInCell(ccCells[i].theCode, level, &Y, true);
-			Y.placeIteratorAtBeginning();
-			ScalarType d = static_cast<ScalarType>(label);
-			for (unsigned j = 0; j < Y.size(); ++j)
-			{
-				Y.setCurrentPointScalarValue(d);
-				Y.forwardIterator();
-			}
-
-			nprogress.oneStep();
-		}
+		job.pass = CCLabellingJob::RELABEL;
+#ifdef ENABLE_MT_OCTREE
+		QtConcurrent::blockingMap(chunks, functor);
+#else
+		for (const std::pair<std::size_t, std::size_t>& range : chunks)
+			functor(range);
+#endif
 
 		if (progressCb)
 		{
@@ -3218,6 +3218,31 @@ int DgmOctree::extractCCs(const cellCodesContainer& cellCodes, unsigned char lev
 		}
 	}
 
+	//merge the cells statistics
+	if (componentsInfo)
+	{
+		for (std::size_t i = 0; i < numberOfCells; ++i)
+		{
+			const ConnectedComponentInfo& info = cellInfo[i];
+			ConnectedComponentInfo& compInfo = componentsInfo->at(job.rootLabels[job.findRoot(static_cast<unsigned>(i))] - 1);
+			if (compInfo.cellCount++ == 0)
+			{
+				compInfo.bbMin = info.bbMin;
+				compInfo.bbMax = info.bbMax;
+			}
+			else
+			{
+				compInfo.bbMin.x = std::min(compInfo.bbMin.x, info.bbMin.x);
+				compInfo.bbMin.y = std::min(compInfo.bbMin.y, info.bbMin.y);
+				compInfo.bbMin.z = std::min(compInfo.bbMin.z, info.bbMin.z);
+				compInfo.bbMax.x = std::max(compInfo.bbMax.x, info.bbMax.x);
+				compInfo.bbMax.y = std::max(compInfo.bbMax.y, info.bbMax.y);
+				compInfo.bbMax.z = std::max(compInfo.bbMax.z, info.bbMax.z);
+			}
+			compInfo.pointCount += info.pointCount;
+		}
+	}
+
 	return numberOfComponents;
 }
 
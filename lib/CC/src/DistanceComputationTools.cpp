@@ -33,7 +33,12 @@
 
 //system
 #include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
 
 #ifdef USE_QT
 #ifndef CC_DEBUG
@@ -117,6 +122,146 @@ namespace CCLib
 			}
 		}
 	};
+
+	//! Local models cache shared by all the cells (and threads) of a cloud-to-cloud distance computation
+	/** The models are indexed by the reference point around which they are fitted.
+		The cache is split in several shards (each with its own lock and LRU list)
+		so as to limit the contention between threads.
+	**/
+	class LocalModelCache
+	{
+	public:
+
+		//! Shared model
+		using ModelPtr = std::shared_ptr<const LocalModel>;
+
+		//! Default constructor
+		/** \param capacity max number of models (0 = no cache)
+		**/
+		explicit LocalModelCache(std::size_t capacity)
+			: m_shardCapacity(capacity == 0 ? 0 : std::max<std::size_t>(1, capacity / SHARD_COUNT))
+			, m_fitted(0)
+			, m_hits(0)
+			, m_misses(0)
+			, m_evicted(0)
+			, m_reused(0)
+		{}
+
+		//! Returns the model fitted around a given reference point (if any)
+		ModelPtr find(unsigned pointIndex)
+		{
+			if (m_shardCapacity == 0)
+			{
+				++m_misses;
+				return ModelPtr();
+			}
+
+			Shard& shard = m_shards[pointIndex % SHARD_COUNT];
+			std::lock_guard<std::mutex> lock(shard.mutex);
+
+			auto it = shard.map.find(pointIndex);
+			if (it == shard.map.end())
+			{
+				++m_misses;
+				return ModelPtr();
+			}
+
+			//move the entry at the front of the LRU list
+			shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+			++m_hits;
+			return it->second->second;
+		}
+
+		//! Inserts a newly fitted model
+		/** \return the cached model (may differ from the input one if another thread was faster)
+		**/
+		ModelPtr insert(unsigned pointIndex, ModelPtr model)
+		{
+			++m_fitted;
+			if (m_shardCapacity == 0)
+			{
+				return model;
+			}
+
+			Shard& shard = m_shards[pointIndex % SHARD_COUNT];
+			std::lock_guard<std::mutex> lock(shard.mutex);
+
+			auto it = shard.map.find(pointIndex);
+			if (it != shard.map.end())
+			{
+				return it->second->second;
+			}
+
+			//if there's not enough memory, we simply don't cache the model
+			try
+			{
+				shard.lru.emplace_front(pointIndex, model);
+			}
+			catch (const std::bad_alloc&)
+			{
+				return model;
+			}
+			try
+			{
+				shard.map[pointIndex] = shard.lru.begin();
+			}
+			catch (const std::bad_alloc&)
+			{
+				shard.lru.pop_front();
+				return model;
+			}
+
+			//discard the least recently used models
+			while (shard.lru.size() > m_shardCapacity)
+			{
+				shard.map.erase(shard.lru.back().first);
+				shard.lru.pop_back();
+				++m_evicted;
+			}
+
+			return model;
+		}
+
+		//! Counts a model reused because it 'includes' the nearest point
+		inline void countReused() { ++m_reused; }
+
+		//! Returns the statistics
+		DistanceComputationTools::LocalModelStatistics statistics() const
+		{
+			DistanceComputationTools::LocalModelStatistics stats;
+			stats.fittedModels = m_fitted;
+			stats.cacheHits = m_hits;
+			stats.cacheMisses = m_misses;
+			stats.evictedModels = m_evicted;
+			stats.reusedModels = m_reused;
+			return stats;
+		}
+
+	protected:
+
+		//! Number of shards
+		static const unsigned SHARD_COUNT = 64;
+
+		//! Cache shard
+		struct Shard
+		{
+			//! Lock
+			std::mutex mutex;
+			//! Models (most recently used first)
+			std::list< std::pair<unsigned, ModelPtr> > lru;
+			//! Models by reference point index
+			std::unordered_map<unsigned, std::list< std::pair<unsigned, ModelPtr> >::iterator> map;
+		};
+
+		//! Shards
+		Shard m_shards[SHARD_COUNT];
+		//! Max number of models per shard
+		std::size_t m_shardCapacity;
+
+		//! Statistics
+		std::atomic<std::size_t> m_fitted, m_hits, m_misses, m_evicted, m_reused;
+	};
+
 } //namespace CCLib
 
 using namespace CCLib;
@@ -169,6 +314,8 @@ int DistanceComputationTools::computeCloud2CloudDistance(	GenericIndexedCloudPer
 		return DISTANCE_COMPUTATION_RESULTS::ERROR_CANT_USE_MAX_SEARCH_DIST_AND_CLOSEST_POINT_SET;
 	}
 
+	params.localModelStats = LocalModelStatistics();
+
 	//we spatially 'synchronize' the octrees
 	DgmOctree *comparedOctree = compOctree;
 	DgmOctree *referenceOctree = refOctree;
@@ -247,12 +394,34 @@ int DistanceComputationTools::computeCloud2CloudDistance(	GenericIndexedCloudPer
 		}
 	}
 
+	//local models shared cache
+	//(only with a constant number of neighbours: the spherical neighbourhoods are not sorted, and their order
+	//depends on the previous queries, so a model fitted in another cell could differ from the one we would fit)
+	std::unique_ptr<LocalModelCache> modelCache;
+	if (params.localModel != NO_MODEL)
+	{
+		try
+		{
+			modelCache.reset(new LocalModelCache(params.useSphericalSearchForLocalModel ? 0 : params.localModelCacheSize));
+		}
+		catch (const std::bad_alloc&)
+		{
+			//not enough memory
+			if (comparedOctree && !compOctree)
+				delete comparedOctree;
+			if (referenceOctree && !refOctree)
+				delete referenceOctree;
+			return DISTANCE_COMPUTATION_RESULTS::ERROR_OUT_OF_MEMORY;
+		}
+	}
+
 	//additional parameters
 	void* additionalParameters[] = {	reinterpret_cast<void*>(referenceCloud),
 										reinterpret_cast<void*>(referenceOctree),
 										reinterpret_cast<void*>(&params),
 										reinterpret_cast<void*>(&maxSearchSquareDistd),
-										reinterpret_cast<void*>(&computeSplitDistances)
+										reinterpret_cast<void*>(&computeSplitDistances),
+										reinterpret_cast<void*>(modelCache.get())
 	};
 
 	int result = DISTANCE_COMPUTATION_RESULTS::SUCCESS;
@@ -274,6 +443,11 @@ int DistanceComputationTools::computeCloud2CloudDistance(	GenericIndexedCloudPer
 		//something went wrong
 		result = DISTANCE_COMPUTATION_RESULTS::ERROR_EXECUTE_FUNCTION_FOR_ALL_CELLS_AT_LEVEL_FAILURE;				
 	}
+
+	if (modelCache)
+	{
+		params.localModelStats = modelCache->statistics();
+	}
 	
 
 	if (comparedOctree && !compOctree)
@@ -526,6 +700,8 @@ bool DistanceComputationTools::computeCellHausdorffDistance(const DgmOctree::oct
 // [1] -> (Octree*): reference cloud octree
 // [2] -> (Cloud2CloudDistanceComputationParams*): parameters
 // [3] -> (ScalarType*): max search distance (squared)
+// [4] -> (bool*): whether to compute split distances
+// [5] -> (LocalModelCache*): shared local models cache (can be null)
 bool DistanceComputationTools::computeCellHausdorffDistanceWithLocalModel(	const DgmOctree::octreeCell& cell,
 																			void** additionalParameters,
 																			NormalizedProgress* nProgress/*=0*/)
@@ -536,6 +712,7 @@ bool DistanceComputationTools::computeCellHausdorffDistanceWithLocalModel(	const
 	Cloud2CloudDistanceComputationParams* params	= reinterpret_cast<Cloud2CloudDistanceComputationParams*>(additionalParameters[2]);
 	const double* maxSearchSquareDistd				= reinterpret_cast<double*>(additionalParameters[3]);
 	bool computeSplitDistances						= *reinterpret_cast<bool*>(additionalParameters[4]);
+	LocalModelCache* modelCache						= reinterpret_cast<LocalModelCache*>(additionalParameters[5]);
 
 	assert(params && params->localModel != NO_MODEL);
 
@@ -563,8 +740,8 @@ bool DistanceComputationTools::computeCellHausdorffDistanceWithLocalModel(	const
 		nNSS_Model.minNumberOfNeighbors = params->kNNForLocalModel;
 	}
 
-	//already computed models
-	std::vector<const LocalModel*> models;
+	//already computed models (for this cell)
+	std::vector<LocalModelCache::ModelPtr> models;
 
 	//for each point of the current cell (compared octree) we look for its nearest neighbour in the reference cloud
 	unsigned pointCount = cell.points->size();
@@ -588,22 +765,32 @@ bool DistanceComputationTools::computeCellHausdorffDistanceWithLocalModel(	const
 				referenceCloud->getPoint(nNSS.theNearestPointIndex, nearestPoint);
 
 				//local model for the 'nearest point'
-				const LocalModel* lm = nullptr;
+				LocalModelCache::ModelPtr lm;
 
 				if (params->reuseExistingLocalModels)
 				{
 					//we look if the nearest point is close to existing models
-					for (std::vector<const LocalModel*>::const_iterator it = models.begin(); it != models.end(); ++it)
+					for (const LocalModelCache::ModelPtr& model : models)
 					{
 						//we take the first model that 'includes' the nearest point
-						if ( ((*it)->getCenter() - nearestPoint).norm2() <= (*it)->getSquareSize())
+						if ((model->getCenter() - nearestPoint).norm2() <= model->getSquareSize())
 						{
-							lm = *it;
+							lm = model;
+							if (modelCache)
+								modelCache->countReused();
 							break;
 						}
 					}
 				}
 
+				//maybe the model has already been fitted around this point (for another compared point)
+				bool newForThisCell = false; //whether the model should be added to the cell's models
+				if (!lm && modelCache)
+				{
+					lm = modelCache->find(nNSS.theNearestPointIndex);
+					newForThisCell = static_cast<bool>(lm);
+				}
+
 				//create new local model
 				if (!lm)
 				{
@@ -640,8 +827,17 @@ bool DistanceComputationTools::computeCellHausdorffDistanceWithLocalModel(	const
 					}
 					else
 					{
-						kNN = referenceOctree->findNearestNeighborsStartingFromCell(nNSS_Model);
-						kNN = std::min(kNN, params->kNNForLocalModel);
+						unsigned eligibleCount = referenceOctree->findNearestNeighborsStartingFromCell(nNSS_Model);
+						kNN = std::min(eligibleCount, params->kNNForLocalModel);
+						//equidistant neighbours are sorted by index, so that the model only depends on the reference
+						//point and not on the previous queries (it may be shared with other cells by the cache)
+						std::partial_sort(	nNSS_Model.pointsInNeighbourhood.begin(),
+											nNSS_Model.pointsInNeighbourhood.begin() + kNN,
+											nNSS_Model.pointsInNeighbourhood.begin() + eligibleCount,
+											[](const DgmOctree::PointDescriptor& a, const DgmOctree::PointDescriptor& b)
+											{
+												return (a.squareDistd < b.squareDistd || (a.squareDistd == b.squareDistd && a.pointIndex < b.pointIndex));
+											});
 					}
 
 					//if there's enough neighbours
@@ -655,30 +851,31 @@ bool DistanceComputationTools::computeCellHausdorffDistanceWithLocalModel(	const
 						const double& maxSquareDist = nNSS_Model.pointsInNeighbourhood[kNN-1].squareDistd;
 						if (maxSquareDist > 0) //DGM: with duplicate points, all neighbors can be at the same place :(
 						{
-							lm = LocalModel::New(params->localModel, Z, nearestPoint, static_cast<PointCoordinateType>(maxSquareDist));
-							if (lm && params->reuseExistingLocalModels)
+							lm.reset(LocalModel::New(params->localModel, Z, nearestPoint, static_cast<PointCoordinateType>(maxSquareDist)));
+							if (lm && modelCache)
 							{
-								//we add the model to the 'existing models' list
-								try
-								{
-									models.push_back(lm);
-								}
-								catch (const std::bad_alloc&)
-								{
-									//not enough memory!
-									while (!models.empty())
-									{
-										delete models.back();
-										models.pop_back();
-									}
-									return false;
-								}
+								lm = modelCache->insert(nNSS.theNearestPointIndex, lm);
 							}
+							newForThisCell = static_cast<bool>(lm);
 						}
 						//neighbours->clear();
 					}
 				}
 
+				if (newForThisCell && params->reuseExistingLocalModels)
+				{
+					//we add the model to the 'existing models' list
+					try
+					{
+						models.push_back(lm);
+					}
+					catch (const std::bad_alloc&)
+					{
+						//not enough memory!
+						return false;
+					}
+				}
+
 				//if we have a local model
 				if (lm)
 				{
@@ -698,13 +895,6 @@ bool DistanceComputationTools::computeCellHausdorffDistanceWithLocalModel(	const
 						nearestPoint = nearestModelPoint;
 					}
 
-					if (!params->reuseExistingLocalModels)
-					{
-						//we don't need the local model anymore!
-						delete lm;
-						lm = nullptr;
-					}
-
 					if (computeSplitDistances)
 					{
 						unsigned index = cell.points->getPointGlobalIndex(i);
@@ -740,13 +930,6 @@ bool DistanceComputationTools::computeCellHausdorffDistanceWithLocalModel(	const
 		}
 	}
 
-	//clear all models for this cell
-	while (!models.empty())
-	{
-		delete models.back();
-		models.pop_back();
-	}
-
 	return true;
 }
 
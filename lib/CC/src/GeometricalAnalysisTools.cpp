@@ -28,8 +28,20 @@
 
 //system
 #include <algorithm>
+#include <limits>
 #include <random>
 
+#ifdef USE_QT
+#ifndef CC_DEBUG
+//enables multi-threading handling
+#define ENABLE_MT_PRIMITIVES
+#endif
+#endif
+
+#ifdef ENABLE_MT_PRIMITIVES
+#include <QtConcurrentMap>
+#endif
+
 using namespace CCLib;
 
 //volume of a unit sphere
@@ -306,6 +318,384 @@ bool GeometricalAnalysisTools::ComputeGeomCharacteristicAtLevel(const DgmOctree:
 	return true;
 }
 
+//! Multi-scale geometric features computation parameters
+struct GeomFeaturesJob
+{
+	//! Requested features
+	const std::vector<GeometricalAnalysisTools::GeomFeatureRequest>* requests = nullptr;
+	//! Distinct radii (sorted in increasing order)
+	std::vector<PointCoordinateType> radii;
+	//! Distinct squared radii (same order)
+	std::vector<double> squareRadii;
+	//! Scale index of each request
+	std::vector<unsigned> scaleIndexes;
+};
+
+//! First and second order moments of a set of points (relatively to the query point)
+struct NeighbourhoodMoments
+{
+	//! count, sum(x), sum(y), sum(z), sum(xx), sum(yy), sum(zz), sum(xy), sum(xz), sum(yz)
+	double m[10];
+
+	inline void clear() { std::fill(m, m + 10, 0.0); }
+
+	inline void add(const NeighbourhoodMoments& other)
+	{
+		for (unsigned k = 0; k < 10; ++k)
+			m[k] += other.m[k];
+	}
+
+	//! Adds a point (relatively to the reference point)
+	inline void addPoint(double dx, double dy, double dz)
+	{
+		m[0] += 1.0;
+		m[1] += dx;
+		m[2] += dy;
+		m[3] += dz;
+		m[4] += dx * dx;
+		m[5] += dy * dy;
+		m[6] += dz * dz;
+		m[7] += dx * dy;
+		m[8] += dx * dz;
+		m[9] += dy * dz;
+	}
+
+	//! Computes the covariance matrix (xx, yy, zz, xy, xz, yz) and the centroid (relatively to the reference point)
+	/** \warning There should be at least one point.
+	**/
+	inline void computeCovariance(double covMat[6], CCVector3d& centroid) const
+	{
+		const double count = m[0];
+		centroid = CCVector3d(m[1] / count, m[2] / count, m[3] / count);
+		covMat[0] = m[4] / count - centroid.x * centroid.x;
+		covMat[1] = m[5] / count - centroid.y * centroid.y;
+		covMat[2] = m[6] / count - centroid.z * centroid.z;
+		covMat[3] = m[7] / count - centroid.x * centroid.y;
+		covMat[4] = m[8] / count - centroid.x * centroid.z;
+		covMat[5] = m[9] / count - centroid.y * centroid.z;
+	}
+};
+
+//! Computes the eigenvalues (decreasing order) and the smallest eigenvector of a 3x3 covariance matrix
+/** Closed-form (trigonometric) solution.
+	\param A (symmetric) matrix coefficients (xx, yy, zz, xy, xz, yz)
+	\param l1 largest eigenvalue
+	\param l2 middle eigenvalue
+	\param l3 smallest eigenvalue
+	\param e3 (unit) eigenvector associated to the smallest eigenvalue
+**/
+static void ComputeSymmetricEigen3(const double A[6], double& l1, double& l2, double& l3, CCVector3d& e3)
+{
+	const double p1 = A[3] * A[3] + A[4] * A[4] + A[5] * A[5];
+	if (p1 == 0)
+	{
+		//diagonal matrix
+		unsigned minIndex = (A[0] <= A[1] ? (A[0] <= A[2] ? 0 : 2) : (A[1] <= A[2] ? 1 : 2));
+		double d[3] = { A[0], A[1], A[2] };
+		std::sort(d, d + 3);
+		l1 = d[2];
+		l2 = d[1];
+		l3 = d[0];
+		e3 = CCVector3d(0, 0, 0);
+		e3.u[minIndex] = 1.0;
+		return;
+	}
+
+	const double q = (A[0] + A[1] + A[2]) / 3;
+	const double b0 = A[0] - q;
+	const double b1 = A[1] - q;
+	const double b2 = A[2] - q;
+	const double p = sqrt((b0 * b0 + b1 * b1 + b2 * b2 + 2 * p1) / 6);
+
+	//r = det((A - q.I) / p) / 2
+	double det = b0 * (b1 * b2 - A[5] * A[5])
+		- A[3] * (A[3] * b2 - A[5] * A[4])
+		+ A[4] * (A[3] * A[5] - b1 * A[4]);
+	double r = det / (2 * p * p * p);
+	r = std::max(-1.0, std::min(1.0, r));
+
+	const double phi = acos(r) / 3;
+	l1 = q + 2 * p * cos(phi);
+	l3 = q + 2 * p * cos(phi + 2 * M_PI / 3);
+	l2 = 3 * q - l1 - l3;
+
+	//a covariance matrix is positive semi-definite: discard the rounding noise
+	const double zeroThreshold = l1 * std::numeric_limits<double>::epsilon();
+	if (l3 < zeroThreshold)
+		l3 = 0;
+	if (l2 < zeroThreshold)
+		l2 = 0;
+
+	//the eigenvector associated to l3 is orthogonal to the rows of (A - l3.I)
+	CCVector3d r0(A[0] - l3, A[3], A[4]);
+	CCVector3d r1(A[3], A[1] - l3, A[5]);
+	CCVector3d r2(A[4], A[5], A[2] - l3);
+
+	CCVector3d c01 = r0.cross(r1);
+	CCVector3d c02 = r0.cross(r2);
+	CCVector3d c12 = r1.cross(r2);
+	double n01 = c01.norm2();
+	double n02 = c02.norm2();
+	double n12 = c12.norm2();
+
+	if (n01 >= n02 && n01 >= n12 && n01 > 0)
+	{
+		e3 = c01 / sqrt(n01);
+	}
+	else if (n02 >= n12 && n02 > 0)
+	{
+		e3 = c02 / sqrt(n02);
+	}
+	else if (n12 > 0)
+	{
+		e3 = c12 / sqrt(n12);
+	}
+	else
+	{
+		//l2 = l3: (A - l3.I) is of rank 1 (or 0), any vector orthogonal to its rows will do
+		CCVector3d u = r0;
+		if (r1.norm2() > u.norm2())
+			u = r1;
+		if (r2.norm2() > u.norm2())
+			u = r2;
+		if (u.norm2() == 0)
+		{
+			e3 = CCVector3d(0, 0, 1);
+		}
+		else
+		{
+			//pick the axis the least aligned with u
+			CCVector3d axis(0, 0, 0);
+			unsigned minDim = (std::abs(u.x) <= std::abs(u.y) ? (std::abs(u.x) <= std::abs(u.z) ? 0 : 2) : (std::abs(u.y) <= std::abs(u.z) ? 1 : 2));
+			axis.u[minDim] = 1.0;
+			e3 = u.cross(axis);
+			e3.normalize();
+		}
+	}
+}
+
+GeometricalAnalysisTools::ErrorCode GeometricalAnalysisTools::ComputeGeomFeatures(
+	GenericIndexedCloudPersist* cloud,
+	const std::vector<GeomFeatureRequest>& requests,
+	GenericProgressCallback* progressCb/*=nullptr*/,
+	DgmOctree* inputOctree/*=nullptr*/)
+{
+	if (!cloud || requests.empty())
+	{
+		//invalid input
+		return InvalidInput;
+	}
+
+	unsigned numberOfPoints = cloud->size();
+	if (numberOfPoints < 4)
+	{
+		return NotEnoughPoints;
+	}
+
+	GeomFeaturesJob job;
+	job.requests = &requests;
+	try
+	{
+		for (const GeomFeatureRequest& request : requests)
+		{
+			if (!request.sf || request.sf->currentSize() < numberOfPoints || request.radius <= 0)
+			{
+				return InvalidInput;
+			}
+			job.radii.push_back(request.radius);
+		}
+		std::sort(job.radii.begin(), job.radii.end());
+		job.radii.erase(std::unique(job.radii.begin(), job.radii.end()), job.radii.end());
+
+		job.squareRadii.reserve(job.radii.size());
+		for (PointCoordinateType radius : job.radii)
+		{
+			job.squareRadii.push_back(static_cast<double>(radius) * radius);
+		}
+
+		job.scaleIndexes.reserve(requests.size());
+		for (const GeomFeatureRequest& request : requests)
+		{
+			job.scaleIndexes.push_back(static_cast<unsigned>(std::lower_bound(job.radii.begin(), job.radii.end(), request.radius) - job.radii.begin()));
+		}
+	}
+	catch (const std::bad_alloc&)
+	{
+		return NotEnoughMemory;
+	}
+
+	DgmOctree* octree = inputOctree;
+	if (!octree)
+	{
+		//try to build the octree if none was provided
+		octree = new DgmOctree(cloud);
+		if (octree->build(progressCb) < 1)
+		{
+			delete octree;
+			return OctreeComputationFailed;
+		}
+	}
+
+	//the neighbourhoods are extracted once, with the largest radius
+	PointCoordinateType maxRadius = job.radii.back();
+	unsigned char level = octree->findBestLevelForAGivenNeighbourhoodSizeExtraction(maxRadius);
+
+	//parameters
+	void* additionalParameters[] =
+	{
+		static_cast<void*>(&job),
+		static_cast<void*>(&maxRadius)
+	};
+
+	ErrorCode result = NoError;
+
+	if (octree->executeFunctionForAllCellsAtLevel(	level,
+													&ComputeGeomFeaturesAtLevel,
+													additionalParameters,
+													true,
+													progressCb,
+													"Features computation") == 0)
+	{
+		//something went wrong
+		result = ProcessFailed;
+	}
+
+	if (!inputOctree)
+	{
+		delete octree;
+		octree = nullptr;
+	}
+
+	return result;
+}
+
+//"PER-CELL" METHOD: MULTI-SCALE GEOMETRIC FEATURES
+//ADDITIONAL PARAMETERS (2):
+// [0] -> (GeomFeaturesJob*) job: requests and scales
+// [1] -> (PointCoordinateType*) maxRadius: largest radius
+bool GeometricalAnalysisTools::ComputeGeomFeaturesAtLevel(	const DgmOctree::octreeCell& cell,
+															void** additionalParameters,
+															NormalizedProgress* nProgress/*=0*/)
+{
+	//parameters
+	const GeomFeaturesJob& job = *static_cast<GeomFeaturesJob*>(additionalParameters[0]);
+	PointCoordinateType maxRadius = *static_cast<PointCoordinateType*>(additionalParameters[1]);
+
+	const std::vector<GeomFeatureRequest>& requests = *job.requests;
+	const std::size_t scaleCount = job.radii.size();
+
+	//structure for nearest neighbors search
+	DgmOctree::NearestNeighboursSphericalSearchStruct nNSS;
+	nNSS.level = cell.level;
+	nNSS.prepare(maxRadius, cell.parentOctree->getCellSize(nNSS.level));
+	cell.parentOctree->getCellPos(cell.truncatedCode, cell.level, nNSS.cellPos, true);
+	cell.parentOctree->computeCellCenter(nNSS.cellPos, cell.level, nNSS.cellCenter);
+
+	unsigned n = cell.points->size(); //number of points in the current cell
+
+	std::vector<NeighbourhoodMoments> moments;
+	std::vector<unsigned char> scaleValid;
+	std::vector<double> eigenValues; //3 per scale
+	std::vector<CCVector3d> smallestEigenVectors; //1 per scale
+
+	//we already know some of the neighbours: the points in the current cell!
+	try
+	{
+		moments.resize(scaleCount);
+		scaleValid.resize(scaleCount);
+		eigenValues.resize(3 * scaleCount);
+		smallestEigenVectors.resize(scaleCount);
+		nNSS.pointsInNeighbourhood.resize(n);
+	}
+	catch (const std::bad_alloc&)
+	{
+		//out of memory
+		return false;
+	}
+
+	{
+		DgmOctree::NeighboursSet::iterator it = nNSS.pointsInNeighbourhood.begin();
+		for (unsigned i = 0; i < n; ++i, ++it)
+		{
+			it->point = cell.points->getPointPersistentPtr(i);
+			it->pointIndex = cell.points->getPointGlobalIndex(i);
+		}
+	}
+	nNSS.alreadyVisitedNeighbourhoodSize = 1;
+
+	//for each point in the cell
+	for (unsigned i = 0; i < n; ++i)
+	{
+		cell.points->getPoint(i, nNSS.queryPoint);
+
+		//look for neighbors in the largest sphere
+		//warning: there may be more points at the end of nNSS.pointsInNeighbourhood than the actual nearest neighbors (neighborCount)!
+		unsigned neighborCount = cell.parentOctree->findNeighborsInASphereStartingFromCell(nNSS, maxRadius, false);
+
+		//single pass: accumulate the moments of each neighbour (relatively to the query point) in the smallest scale that contains it
+		for (NeighbourhoodMoments& m : moments)
+		{
+			m.clear();
+		}
+		for (unsigned j = 0; j < neighborCount; ++j)
+		{
+			const CCVector3 d = *nNSS.pointsInNeighbourhood[j].point - nNSS.queryPoint;
+			const double d2 = d.norm2d();
+
+			std::size_t scaleIndex = 0;
+			while (scaleIndex + 1 < scaleCount && d2 > job.squareRadii[scaleIndex])
+			{
+				++scaleIndex;
+			}
+
+			moments[scaleIndex].addPoint(d.x, d.y, d.z);
+		}
+
+		//each scale also contains the neighbours of the smaller ones
+		for (std::size_t k = 0; k < scaleCount; ++k)
+		{
+			if (k != 0)
+			{
+				moments[k].add(moments[k - 1]);
+			}
+
+			scaleValid[k] = (moments[k].m[0] > 3);
+			if (!scaleValid[k])
+			{
+				continue;
+			}
+
+			//covariance matrix (the centroid is expressed relatively to the query point)
+			double covMat[6];
+			CCVector3d centroid;
+			moments[k].computeCovariance(covMat, centroid);
+
+			double* l = eigenValues.data() + 3 * k;
+			ComputeSymmetricEigen3(covMat, l[0], l[1], l[2], smallestEigenVectors[k]);
+		}
+
+		const unsigned globalIndex = cell.points->getPointGlobalIndex(i);
+		for (std::size_t r = 0; r < requests.size(); ++r)
+		{
+			const unsigned k = job.scaleIndexes[r];
+			ScalarType value = NAN_VALUE;
+			if (scaleValid[k])
+			{
+				const double* l = eigenValues.data() + 3 * k;
+				value = static_cast<ScalarType>(Neighbourhood::ComputeFeature(requests[r].feature, l[0], l[1], l[2], smallestEigenVectors[k]));
+			}
+			requests[r].sf->setValue(globalIndex, value);
+		}
+
+		if (nProgress && !nProgress->oneStep())
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
 
 GeometricalAnalysisTools::ErrorCode GeometricalAnalysisTools::FlagDuplicatePoints(
 	GenericIndexedCloudPersist* cloud,
@@ -1131,3 +1521,792 @@ GeometricalAnalysisTools::ErrorCode GeometricalAnalysisTools::ComputeSphereFrom4
 
 	return NoError;
 }
+
+//! Primitive model (see DetectPrimitivesRobust)
+struct PrimitiveModel
+{
+	//! Primitive type
+	GeometricalAnalysisTools::PrimitiveType type = GeometricalAnalysisTools::PRIMITIVE_PLANE;
+	//! Plane: point on the plane / Sphere: center / Cylinder: point on the axis
+	CCVector3d center;
+	//! Plane: normal / Cylinder: axis direction (unit vectors)
+	CCVector3d axis;
+	//! Sphere or cylinder radius
+	double radius = 0;
+};
+
+//! Returns the distance between a point and a primitive
+static inline double DistanceToPrimitive(const PrimitiveModel& model, const CCVector3& P)
+{
+	CCVector3d d = CCVector3d::fromArray(P.u) - model.center;
+	switch (model.type)
+	{
+	case GeometricalAnalysisTools::PRIMITIVE_PLANE:
+		return std::abs(d.dot(model.axis));
+	case GeometricalAnalysisTools::PRIMITIVE_SPHERE:
+		return std::abs(d.normd() - model.radius);
+	case GeometricalAnalysisTools::PRIMITIVE_CYLINDER:
+		{
+			double t = d.dot(model.axis);
+			return std::abs(sqrt(std::max(0.0, d.norm2() - t * t)) - model.radius);
+		}
+	default:
+		assert(false);
+		break;
+	}
+	return std::numeric_limits<double>::max();
+}
+
+//! Returns the number of points required to build a primitive hypothesis
+static unsigned PrimitiveSampleSize(GeometricalAnalysisTools::PrimitiveType type)
+{
+	switch (type)
+	{
+	case GeometricalAnalysisTools::PRIMITIVE_PLANE:
+		return 3;
+	case GeometricalAnalysisTools::PRIMITIVE_SPHERE:
+		return 4;
+	case GeometricalAnalysisTools::PRIMITIVE_CYLINDER:
+		return 2; //+ the normals
+	default:
+		assert(false);
+		break;
+	}
+	return 0;
+}
+
+//! Primitive hypothesis
+struct PrimitiveHypothesis
+{
+	//! Hypothesis index (in the current round)
+	unsigned index = 0;
+	//! Whether the hypothesis could be built
+	bool valid = false;
+	//! Model
+	PrimitiveModel model;
+	//! Number of inliers in the subsample
+	unsigned subsampleSupport = 0;
+};
+
+//! Chunk of points (to score the best hypotheses on all the remaining points)
+struct PrimitiveScoringChunk
+{
+	//! First index (in PrimitiveDetectionJob::remaining)
+	std::size_t first = 0;
+	//! Last index (excluded)
+	std::size_t last = 0;
+	//! Number of inliers (one per candidate)
+	std::vector<unsigned> supports;
+};
+
+//! Robust primitives detection job
+struct PrimitiveDetectionJob
+{
+	GenericIndexedCloudPersist* cloud = nullptr;
+	const DgmOctree* octree = nullptr;
+	//! Octree level used to extract the sampling neighbourhoods
+	unsigned char samplingLevel = 0;
+	//! Sampling neighbourhood radius
+	PointCoordinateType samplingRadius = 0;
+	//! Max distance for inliers
+	double maxDistance = 0;
+	//! Max sphere or cylinder radius
+	double maxRadius = 0;
+	//! Random seed
+	unsigned seed = 0;
+	//! Current detection round
+	unsigned round = 0;
+	//! Primitive types to look for
+	std::vector<GeometricalAnalysisTools::PrimitiveType> types;
+	//! Whether each point has already been assigned to a primitive
+	std::vector<unsigned char> assigned;
+	//! Indexes of the points not assigned yet
+	std::vector<unsigned> remaining;
+	//! Random subset of the remaining points (to pre-score the hypotheses)
+	std::vector<unsigned> subsample;
+	//! Hypotheses to score on all the remaining points
+	std::vector<PrimitiveModel> candidates;
+};
+
+//! Estimates the normal at a given position from a set of (local) points
+static bool EstimateLocalNormal(const std::vector<const CCVector3*>& points, const CCVector3& P, double squareRadius, CCVector3d& N)
+{
+	NeighbourhoodMoments moments;
+	moments.clear();
+	for (const CCVector3* Q : points)
+	{
+		const CCVector3 d = *Q - P;
+		if (d.norm2d() <= squareRadius)
+			moments.addPoint(d.x, d.y, d.z);
+	}
+
+	if (moments.m[0] < 5)
+	{
+		//not enough points
+		return false;
+	}
+
+	double covMat[6];
+	CCVector3d centroid;
+	moments.computeCovariance(covMat, centroid);
+
+	double l1 = 0;
+	double l2 = 0;
+	double l3 = 0;
+	ComputeSymmetricEigen3(covMat, l1, l2, l3, N);
+
+	//the points shouldn't be aligned
+	return (l2 > 0);
+}
+
+//! Builds a primitive from a (minimal) set of samples
+static bool FitPrimitive(	PrimitiveModel& model,
+							const CCVector3* samples[],
+							const std::vector<const CCVector3*>& localPoints,
+							const PrimitiveDetectionJob& job)
+{
+	switch (model.type)
+	{
+	case GeometricalAnalysisTools::PRIMITIVE_PLANE:
+		{
+			CCVector3d A = CCVector3d::fromArray(samples[0]->u);
+			CCVector3d AB = CCVector3d::fromArray(samples[1]->u) - A;
+			CCVector3d AC = CCVector3d::fromArray(samples[2]->u) - A;
+			CCVector3d N = AB.cross(AC);
+			double normN = N.normd();
+			//the 3 points shouldn't be aligned
+			if (normN <= std::numeric_limits<double>::epsilon() * AB.normd() * AC.normd())
+				return false;
+
+			model.center = A;
+			model.axis = N / normN;
+			model.radius = 0;
+		}
+		return true;
+
+	case GeometricalAnalysisTools::PRIMITIVE_SPHERE:
+		{
+			CCVector3 center;
+			PointCoordinateType radius = 0;
+			if (GeometricalAnalysisTools::ComputeSphereFrom4(*samples[0], *samples[1], *samples[2], *samples[3], center, radius) != GeometricalAnalysisTools::NoError)
+				return false;
+			if (radius > job.maxRadius)
+				return false;
+
+			model.center = CCVector3d::fromArray(center.u);
+			model.axis = CCVector3d(0, 0, 0);
+			model.radius = radius;
+		}
+		return true;
+
+	case GeometricalAnalysisTools::PRIMITIVE_CYLINDER:
+		{
+			//we need the normals at both samples
+			double normalSquareRadius = static_cast<double>(job.samplingRadius) * job.samplingRadius / 9;
+			CCVector3d N1;
+			CCVector3d N2;
+			if (	!EstimateLocalNormal(localPoints, *samples[0], normalSquareRadius, N1)
+				||	!EstimateLocalNormal(localPoints, *samples[1], normalSquareRadius, N2))
+			{
+				return false;
+			}
+
+			//the axis is orthogonal to both normals
+			CCVector3d axis = N1.cross(N2);
+			double normAxis = axis.normd();
+			if (normAxis < 0.05) //~3 degrees
+				return false;
+			axis /= normAxis;
+
+			//the normal lines should (nearly) intersect the axis
+			CCVector3d P1 = CCVector3d::fromArray(samples[0]->u);
+			CCVector3d P2 = CCVector3d::fromArray(samples[1]->u);
+			CCVector3d w = P1 - P2;
+			double b = N1.dot(N2);
+			double d = N1.dot(w);
+			double e = N2.dot(w);
+			double denom = 1.0 - b * b;
+			double s = (b * e - d) / denom;
+			double t = (e - b * d) / denom;
+			CCVector3d center = (P1 + N1 * s + P2 + N2 * t) / 2;
+
+			//radius = mean distance of both samples to the axis
+			double radius = 0;
+			for (const CCVector3d& P : { P1, P2 })
+			{
+				CCVector3d u = P - center;
+				double h = u.dot(axis);
+				radius += sqrt(std::max(0.0, u.norm2() - h * h));
+			}
+			radius /= 2;
+
+			if (radius > job.maxRadius)
+				return false;
+
+			model.center = center;
+			model.axis = axis;
+			model.radius = radius;
+		}
+		return true;
+
+	default:
+		assert(false);
+		break;
+	}
+
+	return false;
+}
+
+//! Builds and pre-scores a primitive hypothesis
+struct PrimitiveHypothesisFunctor
+{
+	PrimitiveHypothesisFunctor(const PrimitiveDetectionJob& job) : m_job(job) {}
+
+	void operator () (PrimitiveHypothesis& hypothesis) const
+	{
+		hypothesis.valid = false;
+		hypothesis.subsampleSupport = 0;
+
+		//each hypothesis has its own generator (so that the result doesn't depend on the threads scheduling)
+		std::seed_seq seedSequence{ m_job.seed, m_job.round, hypothesis.index };
+		std::mt19937 gen(seedSequence);
+
+		PrimitiveModel& model = hypothesis.model;
+		model.type = m_job.types[hypothesis.index % m_job.types.size()];
+		const unsigned sampleSize = PrimitiveSampleSize(model.type);
+
+		//the first sample is drawn among all the remaining points
+		std::uniform_int_distribution<std::size_t> seedDist(0, m_job.remaining.size() - 1);
+		const CCVector3* samples[4] = { m_job.cloud->getPoint(m_job.remaining[seedDist(gen)]), nullptr, nullptr, nullptr };
+
+		//and the other ones in its neighbourhood
+		std::vector<const CCVector3*> localPoints;
+		try
+		{
+			DgmOctree::NeighboursSet neighbours;
+			m_job.octree->getPointsInSphericalNeighbourhood(*samples[0], m_job.samplingRadius, neighbours, m_job.samplingLevel);
+
+			localPoints.reserve(neighbours.size());
+			for (const DgmOctree::PointDescriptor& neighbour : neighbours)
+			{
+				if (!m_job.assigned[neighbour.pointIndex])
+					localPoints.push_back(neighbour.point);
+			}
+		}
+		catch (const std::bad_alloc&)
+		{
+			//not enough memory
+			return;
+		}
+
+		if (localPoints.size() < std::max(sampleSize, 5u))
+		{
+			//not enough points
+			return;
+		}
+
+		std::uniform_int_distribution<std::size_t> localDist(0, localPoints.size() - 1);
+		for (unsigned j = 1; j < sampleSize; ++j)
+		{
+			//we make a few attempts to get distinct points
+			bool isOK = false;
+			for (unsigned attempt = 0; attempt < 8 && !isOK; ++attempt)
+			{
+				samples[j] = localPoints[localDist(gen)];
+				isOK = true;
+				for (unsigned k = 0; k < j && isOK; ++k)
+					if (samples[j] == samples[k])
+						isOK = false;
+			}
+			if (!isOK)
+				return;
+		}
+
+		if (!FitPrimitive(model, samples, localPoints, m_job))
+			return;
+
+		hypothesis.valid = true;
+
+		//pre-score
+		unsigned support = 0;
+		for (unsigned index : m_job.subsample)
+		{
+			if (DistanceToPrimitive(model, *m_job.cloud->getPoint(index)) <= m_job.maxDistance)
+				++support;
+		}
+		hypothesis.subsampleSupport = support;
+	}
+
+protected:
+	const PrimitiveDetectionJob& m_job;
+};
+
+//! Scores the candidate hypotheses on a chunk of the remaining points
+struct PrimitiveScoringFunctor
+{
+	PrimitiveScoringFunctor(const PrimitiveDetectionJob& job) : m_job(job) {}
+
+	void operator () (PrimitiveScoringChunk& chunk) const
+	{
+		chunk.supports.assign(m_job.candidates.size(), 0);
+		for (std::size_t i = chunk.first; i < chunk.last; ++i)
+		{
+			const CCVector3* P = m_job.cloud->getPoint(m_job.remaining[i]);
+			for (std::size_t c = 0; c < m_job.candidates.size(); ++c)
+			{
+				if (DistanceToPrimitive(m_job.candidates[c], *P) <= m_job.maxDistance)
+					++chunk.supports[c];
+			}
+		}
+	}
+
+protected:
+	const PrimitiveDetectionJob& m_job;
+};
+
+//! Runs a primitives detection pass on all the items
+template <class Item, class Functor> static void RunPrimitivesPass(std::vector<Item>& items, const Functor& functor)
+{
+#ifdef ENABLE_MT_PRIMITIVES
+	QtConcurrent::blockingMap(items, functor);
+#else
+	for (Item& item : items)
+		functor(item);
+#endif
+}
+
+//! Collects the remaining points lying close enough to a primitive
+static void CollectPrimitiveInliers(const PrimitiveDetectionJob& job, const PrimitiveModel& model, std::vector<unsigned>& inliers)
+{
+	inliers.clear();
+	for (unsigned index : job.remaining)
+	{
+		if (DistanceToPrimitive(model, *job.cloud->getPoint(index)) <= job.maxDistance)
+			inliers.push_back(index);
+	}
+}
+
+//! Refines a plane or a cylinder by least squares on its inliers
+static void RefinePrimitive(GenericIndexedCloudPersist* cloud, const std::vector<unsigned>& inliers, PrimitiveModel& model)
+{
+	if (inliers.empty())
+		return;
+
+	switch (model.type)
+	{
+	case GeometricalAnalysisTools::PRIMITIVE_PLANE:
+		{
+			//least squares plane (moments relatively to the first inlier, for the sake of precision)
+			const CCVector3 O = *cloud->getPoint(inliers.front());
+			NeighbourhoodMoments moments;
+			moments.clear();
+			for (unsigned index : inliers)
+			{
+				const CCVector3 d = *cloud->getPoint(index) - O;
+				moments.addPoint(d.x, d.y, d.z);
+			}
+
+			double covMat[6];
+			CCVector3d centroid;
+			moments.computeCovariance(covMat, centroid);
+
+			double l1 = 0;
+			double l2 = 0;
+			double l3 = 0;
+			CCVector3d N;
+			ComputeSymmetricEigen3(covMat, l1, l2, l3, N);
+			if (l2 > 0)
+			{
+				model.center = CCVector3d::fromArray(O.u) + centroid;
+				model.axis = N;
+			}
+		}
+		break;
+
+	case GeometricalAnalysisTools::PRIMITIVE_SPHERE:
+		//see GeometricalAnalysisTools::RefineSphereLS
+		break;
+
+	case GeometricalAnalysisTools::PRIMITIVE_CYLINDER:
+		{
+			PrimitiveModel refined = model;
+
+			//move the axis point to the middle of the inliers (for the sake of stability)
+			double meanH = 0;
+			for (unsigned index : inliers)
+			{
+				meanH += (CCVector3d::fromArray(cloud->getPoint(index)->u) - refined.center).dot(refined.axis);
+			}
+			refined.center += refined.axis * (meanH / inliers.size());
+
+			//Gauss-Newton iterations on the axis position (2), the axis orientation (2) and the radius
+			for (unsigned iteration = 0; iteration < 5; ++iteration)
+			{
+				CCVector3d U = refined.axis.orthogonal();
+				CCVector3d V = refined.axis.cross(U);
+
+				//normal equations (column-major) + right hand side
+				double a[5 * 6] = { 0 };
+				for (unsigned index : inliers)
+				{
+					CCVector3d q = CCVector3d::fromArray(cloud->getPoint(index)->u) - refined.center;
+					double qu = q.dot(U);
+					double qv = q.dot(V);
+					double qa = q.dot(refined.axis);
+					double dist = sqrt(qu * qu + qv * qv);
+					if (dist < std::numeric_limits<double>::epsilon())
+						continue;
+
+					double nu = qu / dist;
+					double nv = qv / dist;
+					double J[5] = { -nu, -nv, -qa * nu, -qa * nv, -1.0 };
+					double residual = dist - refined.radius;
+					for (int k = 0; k < 5; ++k)
+					{
+						for (int l = 0; l < 5; ++l)
+							a[k + l * 5] += J[k] * J[l];
+						a[k + 25] -= J[k] * residual;
+					}
+				}
+
+				if (dmat_solve(5, 1, a) != 0)
+					break;
+
+				const double* delta = a + 25;
+				refined.center += U * delta[0] + V * delta[1];
+				refined.axis += U * delta[2] + V * delta[3];
+				refined.axis.normalize();
+				refined.radius += delta[4];
+
+				if (std::abs(delta[2]) + std::abs(delta[3]) < 1.0e-9)
+					break;
+			}
+
+			if (refined.radius > 0)
+			{
+				model = refined;
+			}
+		}
+		break;
+
+	default:
+		assert(false);
+		break;
+	}
+}
+
+GeometricalAnalysisTools::ErrorCode GeometricalAnalysisTools::DetectPrimitivesRobust(
+	GenericIndexedCloudPersist* cloud,
+	const PrimitiveDetectionParams& params,
+	std::vector<DetectedPrimitive>& primitives,
+	GenericProgressCallback* progressCb/*=nullptr*/,
+	DgmOctree* inputOctree/*=nullptr*/)
+{
+	primitives.clear();
+
+	if (	!cloud
+		||	params.maxDistance <= 0
+		||	params.confidence <= 0
+		||	params.confidence >= 1.0
+		||	params.maxHypotheses == 0)
+	{
+		assert(false);
+		return InvalidInput;
+	}
+
+	PrimitiveDetectionJob job;
+	job.cloud = cloud;
+	job.maxDistance = params.maxDistance;
+
+	if (params.types & PRIMITIVE_PLANE)
+		job.types.push_back(PRIMITIVE_PLANE);
+	if (params.types & PRIMITIVE_SPHERE)
+		job.types.push_back(PRIMITIVE_SPHERE);
+	if (params.types & PRIMITIVE_CYLINDER)
+		job.types.push_back(PRIMITIVE_CYLINDER);
+	if (job.types.empty())
+	{
+		return InvalidInput;
+	}
+
+	unsigned n = cloud->size();
+	const unsigned minSupport = std::max(params.minSupport, 4u);
+	if (n < minSupport)
+	{
+		return NotEnoughPoints;
+	}
+
+	//the cloud extents bound the spheres and cylinders radii (and gives the default sampling radius)
+	{
+		CCVector3 bbMin;
+		CCVector3 bbMax;
+		cloud->getBoundingBox(bbMin, bbMax);
+		double diag = (bbMax - bbMin).normd();
+		job.maxRadius = diag;
+		job.samplingRadius = params.samplingRadius > 0 ? params.samplingRadius : static_cast<PointCoordinateType>(std::max(diag / 20, 4.0 * params.maxDistance));
+	}
+
+	job.seed = params.seed;
+	if (job.seed == 0)
+	{
+		std::random_device randomGenerator;   // non-deterministic generator
+		job.seed = randomGenerator();
+	}
+
+	const unsigned batchSize = 256; //number of hypotheses built in parallel
+	const std::size_t maxCandidateCount = 8; //number of hypotheses (per batch) scored on all the remaining points
+	const std::size_t minChunkSize = 4096;
+
+	std::vector<PrimitiveHypothesis> hypotheses;
+	std::vector<PrimitiveScoringChunk> chunks;
+	try
+	{
+		job.assigned.resize(n, 0);
+		job.remaining.resize(n);
+		for (unsigned i = 0; i < n; ++i)
+			job.remaining[i] = i;
+		hypotheses.reserve(batchSize);
+	}
+	catch (const std::bad_alloc&)
+	{
+		return NotEnoughMemory;
+	}
+
+	DgmOctree* octree = inputOctree;
+	if (!octree)
+	{
+		//try to build the octree if none was provided
+		octree = new DgmOctree(cloud);
+		if (octree->build(progressCb) < 1)
+		{
+			delete octree;
+			return OctreeComputationFailed;
+		}
+	}
+	job.octree = octree;
+
+	//on large clouds, the default sampling radius (diag/20) may contain a huge number of points: it is also bounded by the local density
+	if (params.samplingRadius <= 0)
+	{
+		static const unsigned MAX_SAMPLING_CELL_POPULATION = 1024;
+		PointCoordinateType densityRadius = octree->getCellSize(octree->findBestLevelForAGivenPopulationPerCell(MAX_SAMPLING_CELL_POPULATION));
+		job.samplingRadius = std::max(std::min(job.samplingRadius, densityRadius), static_cast<PointCoordinateType>(4.0 * params.maxDistance));
+	}
+	job.samplingLevel = octree->findBestLevelForAGivenNeighbourhoodSizeExtraction(job.samplingRadius);
+
+	if (progressCb)
+	{
+		if (progressCb->textCanBeEdited())
+		{
+			progressCb->setMethodTitle("Detect primitives");
+			char buffer[64];
+			sprintf(buffer, "Points: %u", n);
+			progressCb->setInfo(buffer);
+		}
+		progressCb->update(0);
+		progressCb->start();
+	}
+
+	std::mt19937 gen(job.seed);
+	ErrorCode result = NoError;
+
+	while (job.remaining.size() >= minSupport && (params.maxPrimitives == 0 || primitives.size() < params.maxPrimitives))
+	{
+		try
+		{
+			//random subset of the remaining points
+			job.subsample = job.remaining;
+			if (job.subsample.size() > params.subsampleSize)
+			{
+				for (std::size_t i = 0; i < params.subsampleSize; ++i)
+				{
+					std::uniform_int_distribution<std::size_t> dist(i, job.subsample.size() - 1);
+					std::swap(job.subsample[i], job.subsample[dist(gen)]);
+				}
+				job.subsample.resize(std::max(params.subsampleSize, 1u));
+			}
+
+			//chunks of remaining points
+			std::size_t chunkSize = std::max(minChunkSize, job.remaining.size() / 256 + 1);
+			chunks.resize((job.remaining.size() + chunkSize - 1) / chunkSize);
+			for (std::size_t i = 0; i < chunks.size(); ++i)
+			{
+				chunks[i].first = i * chunkSize;
+				chunks[i].last = std::min(job.remaining.size(), (i + 1) * chunkSize);
+			}
+		}
+		catch (const std::bad_alloc&)
+		{
+			result = NotEnoughMemory;
+			break;
+		}
+
+		const double subsampleRatio = static_cast<double>(job.remaining.size()) / job.subsample.size();
+
+		PrimitiveModel bestModel;
+		unsigned bestSupport = 0;
+		unsigned hypothesisCount = 0;
+		unsigned requiredCount = params.maxHypotheses;
+		while (hypothesisCount < requiredCount)
+		{
+			hypotheses.resize(std::min(batchSize, requiredCount - hypothesisCount));
+			for (std::size_t i = 0; i < hypotheses.size(); ++i)
+			{
+				hypotheses[i].index = hypothesisCount + static_cast<unsigned>(i);
+			}
+			RunPrimitivesPass(hypotheses, PrimitiveHypothesisFunctor(job));
+			hypothesisCount += static_cast<unsigned>(hypotheses.size());
+
+			//only the most promising hypotheses are scored on all the remaining points
+			std::size_t candidateCount = std::min(maxCandidateCount, hypotheses.size());
+			std::partial_sort(	hypotheses.begin(),
+								hypotheses.begin() + candidateCount,
+								hypotheses.end(),
+								[](const PrimitiveHypothesis& a, const PrimitiveHypothesis& b) { return a.subsampleSupport > b.subsampleSupport; });
+
+			job.candidates.clear();
+			for (std::size_t i = 0; i < candidateCount; ++i)
+			{
+				const PrimitiveHypothesis& hypothesis = hypotheses[i];
+				double estimatedSupport = hypothesis.subsampleSupport * subsampleRatio;
+				if (hypothesis.valid && estimatedSupport >= minSupport / 2 && estimatedSupport >= bestSupport / 2)
+				{
+					job.candidates.push_back(hypothesis.model);
+				}
+			}
+
+			if (!job.candidates.empty())
+			{
+				RunPrimitivesPass(chunks, PrimitiveScoringFunctor(job));
+
+				for (std::size_t c = 0; c < job.candidates.size(); ++c)
+				{
+					unsigned support = 0;
+					for (const PrimitiveScoringChunk& chunk : chunks)
+						support += chunk.supports[c];
+					if (support > bestSupport)
+					{
+						bestSupport = support;
+						bestModel = job.candidates[c];
+					}
+				}
+			}
+
+			//early termination: probability of drawing a hypothesis at least as good as the best one
+			//(the first sample must be an inlier, and we assume that half of its neighbours are inliers as well)
+			if (bestSupport != 0)
+			{
+				double inliersRatio = static_cast<double>(bestSupport) / job.remaining.size();
+				double p = inliersRatio * pow(0.5, PrimitiveSampleSize(bestModel.type) - 1.0) / job.types.size();
+				double neededCount = (p < 1.0 ? log(1.0 - params.confidence) / log(1.0 - p) : 1.0);
+				if (neededCount < requiredCount)
+				{
+					requiredCount = static_cast<unsigned>(std::ceil(neededCount));
+				}
+			}
+
+			if (progressCb && progressCb->isCancelRequested())
+			{
+				result = ProcessCancelledByUser;
+				break;
+			}
+		}
+
+		if (result != NoError || bestSupport < minSupport)
+		{
+			break;
+		}
+
+		//extract the best primitive
+		DetectedPrimitive primitive;
+		try
+		{
+			CollectPrimitiveInliers(job, bestModel, primitive.inliers);
+
+			PrimitiveModel refinedModel = bestModel;
+			if (refinedModel.type == PRIMITIVE_SPHERE)
+			{
+				ReferenceCloud inliersCloud(cloud);
+				if (inliersCloud.reserve(static_cast<unsigned>(primitive.inliers.size())))
+				{
+					for (unsigned index : primitive.inliers)
+						inliersCloud.addPointIndex(index);
+
+					CCVector3 center = CCVector3::fromArray(refinedModel.center.u);
+					PointCoordinateType radius = static_cast<PointCoordinateType>(refinedModel.radius);
+					if (RefineSphereLS(&inliersCloud, center, radius))
+					{
+						refinedModel.center = CCVector3d::fromArray(center.u);
+						refinedModel.radius = radius;
+					}
+				}
+			}
+			else
+			{
+				RefinePrimitive(cloud, primitive.inliers, refinedModel);
+			}
+			std::vector<unsigned> refinedInliers;
+			CollectPrimitiveInliers(job, refinedModel, refinedInliers);
+			if (refinedInliers.size() >= primitive.inliers.size())
+			{
+				bestModel = refinedModel;
+				primitive.inliers.swap(refinedInliers);
+			}
+		}
+		catch (const std::bad_alloc&)
+		{
+			result = NotEnoughMemory;
+			break;
+		}
+
+		primitive.type = bestModel.type;
+		primitive.center = CCVector3::fromArray(bestModel.center.u);
+		primitive.axis = CCVector3::fromArray(bestModel.axis.u);
+		primitive.radius = static_cast<PointCoordinateType>(bestModel.radius);
+		{
+			double sumSq = 0;
+			for (unsigned index : primitive.inliers)
+			{
+				double d = DistanceToPrimitive(bestModel, *cloud->getPoint(index));
+				sumSq += d * d;
+			}
+			primitive.rms = sqrt(sumSq / primitive.inliers.size());
+		}
+
+		//remove the inliers from the remaining points
+		for (unsigned index : primitive.inliers)
+		{
+			job.assigned[index] = 1;
+		}
+		job.remaining.erase(std::remove_if(job.remaining.begin(), job.remaining.end(), [&job](unsigned index) { return job.assigned[index] != 0; }), job.remaining.end());
+
+		try
+		{
+			primitives.push_back(std::move(primitive));
+		}
+		catch (const std::bad_alloc&)
+		{
+			result = NotEnoughMemory;
+			break;
+		}
+		++job.round;
+
+		if (progressCb)
+		{
+			progressCb->update(100.0f * static_cast<float>(n - job.remaining.size()) / n);
+		}
+	}
+
+	if (progressCb)
+	{
+		progressCb->stop();
+	}
+
+	if (!inputOctree)
+	{
+		delete octree;
+		octree = nullptr;
+	}
+
+	return result;
+}
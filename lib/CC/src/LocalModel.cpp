@@ -23,6 +23,7 @@
 #include "GenericIndexedMesh.h"
 #include "GenericMesh.h"
 #include "GenericTriangle.h"
+#include "SimpleTriangle.h"
 
 
 using namespace CCLib;
@@ -62,12 +63,15 @@ protected:
 };
 
 //! Delaunay 2D1/2 "local modelization"
+/** The triangles are accessed by index (and not with the mesh iterator) so
+	that the model can be shared by several threads (see LocalModelCache).
+**/
 class DelaunayLocalModel : public LocalModel
 {
 public:
 
 	//! Constructor
-	DelaunayLocalModel(GenericMesh* tri, const CCVector3 &center, PointCoordinateType squaredRadius)
+	DelaunayLocalModel(GenericIndexedMesh* tri, const CCVector3 &center, PointCoordinateType squaredRadius)
 		: LocalModel(center, squaredRadius)
 		, m_tri(tri)
 	{
@@ -86,13 +90,13 @@ public:
 		ScalarType minDist2 = NAN_VALUE;
 		if (m_tri)
 		{
-			m_tri->placeIteratorAtBeginning();
 			unsigned numberOfTriangles = m_tri->size();
 			CCVector3 triNearestPoint;
+			SimpleTriangle tri;
 			for (unsigned i = 0; i < numberOfTriangles; ++i)
 			{
-				GenericTriangle* tri = m_tri->_getNextTriangle();
-				ScalarType dist2 = DistanceComputationTools::computePoint2TriangleDistance(P, tri, false, nearestPoint ? &triNearestPoint : nullptr);
+				m_tri->getTriangleVertices(i, tri.A, tri.B, tri.C);
+				ScalarType dist2 = DistanceComputationTools::computePoint2TriangleDistance(P, &tri, false, nearestPoint ? &triNearestPoint : nullptr);
 				if (dist2 < minDist2 || i == 0)
 				{
 					//keep track of the smallest distance
@@ -112,7 +116,7 @@ public:
 protected:
 
 	//! Associated triangulation
-	GenericMesh* m_tri;
+	GenericIndexedMesh* m_tri;
 };
 
 //! Quadric "local modelization"
@@ -203,7 +207,7 @@ LocalModel* LocalModel::New(CC_LOCAL_MODEL_TYPES type,
 
 	case TRI:
 	{
-		GenericMesh* tri = subset.triangulateOnPlane(true); //'subset' is potentially associated to a volatile ReferenceCloud, so we must duplicate vertices!
+		GenericIndexedMesh* tri = subset.triangulateOnPlane(true); //'subset' is potentially associated to a volatile ReferenceCloud, so we must duplicate vertices!
 		if (tri)
 		{
 			return new DelaunayLocalModel(tri, center, squaredRadius);
@@ -19,53 +19,538 @@
 #include <ManualSegmentationTools.h>
 
 //local
+#include <DgmOctree.h>
 #include <GenericProgressCallback.h>
 #include <PointCloud.h>
 #include <Polyline.h>
 #include <SimpleMesh.h>
 
 //system
+#include <algorithm>
 #include <cstdint>
 #include <map>
 
+#ifdef USE_QT
+#ifndef CC_DEBUG
+//enables multi-threading handling
+#define ENABLE_MT_POLY_SEGMENTATION
+#endif
+#endif
+
+#ifdef ENABLE_MT_POLY_SEGMENTATION
+#include <QtConcurrentMap>
+#endif
 
 using namespace CCLib;
 
-ReferenceCloud* ManualSegmentationTools::segment(GenericIndexedCloudPersist* aCloud, const Polyline* poly, bool keepInside, const float* viewMat)
+//! Polygon prepared for fast (and repeated) 2D inclusion tests
+/** The edges are sorted in horizontal slabs (CSR layout) so that a point only
+	has to be tested against the edges overlapping its own slab. The crossing
+	test itself is the same as in ManualSegmentationTools::isPointInsidePoly.
+	Whole 2D boxes can also be classified (fully inside, fully outside or
+	straddling the polygon border).
+**/
+class PreparedPolygon
 {
-	assert(poly && aCloud);
+public:
+
+	//! Position of a 2D box relatively to the polygon
+	enum BoxPosition { BOX_OUTSIDE, BOX_INSIDE, BOX_STRADDLING };
+
+	//! Default constructor
+	PreparedPolygon()
+		: m_bbMin(0, 0)
+		, m_bbMax(0, 0)
+		, m_slabHeight(0)
+		, m_epsilon(0)
+	{}
+
+	//! Initializes the structure from the polygon vertices (considered as 2D)
+	/** \return false if the polygon is invalid or if there's not enough memory
+	**/
+	bool init(const GenericIndexedCloud* polyVertices)
+	{
+		unsigned vertCount = (polyVertices ? polyVertices->size() : 0);
+		if (vertCount < 2)
+			return false;
+
+		try
+		{
+			m_edges.resize(vertCount);
+
+			CCVector3 A;
+			polyVertices->getPoint(vertCount - 1, A);
+			m_bbMin = m_bbMax = CCVector2(A.x, A.y);
+			for (unsigned i = 0; i < vertCount; ++i)
+			{
+				CCVector3 B;
+				polyVertices->getPoint(i, B);
+
+				//same orientation as in isPointInsidePoly (A = previous vertex, B = current one)
+				m_edges[i].A = CCVector2(A.x, A.y);
+				m_edges[i].B = CCVector2(B.x, B.y);
+
+				m_bbMin.x = std::min(m_bbMin.x, B.x);
+				m_bbMin.y = std::min(m_bbMin.y, B.y);
+				m_bbMax.x = std::max(m_bbMax.x, B.x);
+				m_bbMax.y = std::max(m_bbMax.y, B.y);
+
+				A = B;
+			}
+
+			//tolerance used for box classification (to stay conservative)
+			m_epsilon = std::max(m_bbMax.x - m_bbMin.x, m_bbMax.y - m_bbMin.y) * static_cast<PointCoordinateType>(1.0e-6);
+
+			//one slab per edge (roughly), within reasonable limits
+			unsigned slabCount = std::max(1u, std::min(vertCount, 4096u));
+			m_slabHeight = (m_bbMax.y - m_bbMin.y) / slabCount;
+			if (m_slabHeight <= 0)
+			{
+				slabCount = 1;
+				m_slabHeight = 0;
+			}
+
+			//count the edges per slab
+			m_slabStart.clear();
+			m_slabStart.resize(slabCount + 1, 0);
+			for (const Edge& e : m_edges)
+			{
+				unsigned s0 = slabIndex(std::min(e.A.y, e.B.y));
+				unsigned s1 = slabIndex(std::max(e.A.y, e.B.y));
+				for (unsigned s = s0; s <= s1; ++s)
+					++m_slabStart[s + 1];
+			}
+			for (unsigned s = 0; s < slabCount; ++s)
+				m_slabStart[s + 1] += m_slabStart[s];
+
+			//fill the slabs (edges remain sorted in each slab)
+			m_slabEdges.resize(m_slabStart.back());
+			std::vector<unsigned> fillPos(m_slabStart.begin(), m_slabStart.end() - 1);
+			for (unsigned i = 0; i < vertCount; ++i)
+			{
+				const Edge& e = m_edges[i];
+				unsigned s0 = slabIndex(std::min(e.A.y, e.B.y));
+				unsigned s1 = slabIndex(std::max(e.A.y, e.B.y));
+				for (unsigned s = s0; s <= s1; ++s)
+					m_slabEdges[fillPos[s]++] = i;
+			}
+		}
+		catch (const std::bad_alloc&)
+		{
+			//not enough memory
+			m_edges.clear();
+			m_slabStart.clear();
+			m_slabEdges.clear();
+			return false;
+		}
+
+		return true;
+	}
+
+	//! Tests if a point is inside the polygon
+	inline bool isInside(const CCVector2& P) const
+	{
+		//points outside of the polygon bounding-box are necessarily outside
+		if (P.x < m_bbMin.x || P.x > m_bbMax.x || P.y < m_bbMin.y || P.y > m_bbMax.y)
+			return false;
+
+		bool inside = false;
+
+		unsigned s = slabIndex(P.y);
+		for (unsigned k = m_slabStart[s]; k < m_slabStart[s + 1]; ++k)
+		{
+			const Edge& e = m_edges[m_slabEdges[k]];
+			const CCVector2& A = e.A;
+			const CCVector2& B = e.B;
+
+			//Point Inclusion in Polygon Test (inspired from W. Randolph Franklin - WRF)
+			if ((B.y <= P.y && P.y < A.y) || (A.y <= P.y && P.y < B.y))
+			{
+				PointCoordinateType t = (P.x - B.x)*(A.y - B.y) - (A.x - B.x)*(P.y - B.y);
+				if (A.y < B.y)
+					t = -t;
+				if (t < 0)
+					inside = !inside;
+			}
+		}
+
+		return inside;
+	}
+
+	//! Classifies a 2D box relatively to the polygon
+	/** If no edge intersects the box, all the points of the box share the
+		same inclusion status (the one of its center).
+	**/
+	BoxPosition classify(CCVector2 boxMin, CCVector2 boxMax) const
+	{
+		if (boxMax.x < m_bbMin.x || boxMin.x > m_bbMax.x || boxMax.y < m_bbMin.y || boxMin.y > m_bbMax.y)
+			return BOX_OUTSIDE;
+
+		//we enlarge the box a little bit so as to be conservative
+		boxMin.x -= m_epsilon;
+		boxMin.y -= m_epsilon;
+		boxMax.x += m_epsilon;
+		boxMax.y += m_epsilon;
+
+		unsigned s0 = slabIndex(boxMin.y);
+		unsigned s1 = slabIndex(boxMax.y);
+		for (unsigned s = s0; s <= s1; ++s)
+		{
+			for (unsigned k = m_slabStart[s]; k < m_slabStart[s + 1]; ++k)
+			{
+				if (edgeIntersectsBox(m_edges[m_slabEdges[k]], boxMin, boxMax))
+					return BOX_STRADDLING;
+			}
+		}
+
+		CCVector2 C((boxMin.x + boxMax.x) / 2, (boxMin.y + boxMax.y) / 2);
+		return isInside(C) ? BOX_INSIDE : BOX_OUTSIDE;
+	}
+
+protected:
+
+	//! Polygon edge
+	struct Edge
+	{
+		CCVector2 A, B;
+	};
+
+	//! Returns the slab index of a given 'y' coordinate
+	inline unsigned slabIndex(PointCoordinateType y) const
+	{
+		if (m_slabHeight <= 0 || y <= m_bbMin.y)
+			return 0;
+		unsigned s = static_cast<unsigned>((y - m_bbMin.y) / m_slabHeight);
+		return std::min(s, static_cast<unsigned>(m_slabStart.size()) - 2);
+	}
+
+	//! Tests whether a segment intersects an axis-aligned 2D box
+	static bool edgeIntersectsBox(const Edge& e, const CCVector2& boxMin, const CCVector2& boxMax)
+	{
+		if (	std::max(e.A.x, e.B.x) < boxMin.x || std::min(e.A.x, e.B.x) > boxMax.x
+			||	std::max(e.A.y, e.B.y) < boxMin.y || std::min(e.A.y, e.B.y) > boxMax.y)
+		{
+			return false;
+		}
+
+		//the box corners must not all be on the same side of the edge line
+		CCVector2 u = e.B - e.A;
+		PointCoordinateType s1 = u.x * (boxMin.y - e.A.y) - u.y * (boxMin.x - e.A.x);
+		PointCoordinateType s2 = u.x * (boxMin.y - e.A.y) - u.y * (boxMax.x - e.A.x);
+		PointCoordinateType s3 = u.x * (boxMax.y - e.A.y) - u.y * (boxMin.x - e.A.x);
+		PointCoordinateType s4 = u.x * (boxMax.y - e.A.y) - u.y * (boxMax.x - e.A.x);
+
+		return !(	(s1 > 0 && s2 > 0 && s3 > 0 && s4 > 0)
+				||	(s1 < 0 && s2 < 0 && s3 < 0 && s4 < 0) );
+	}
+
+	//! Edges
+	std::vector<Edge> m_edges;
+	//! Slabs start (CSR layout)
+	std::vector<unsigned> m_slabStart;
+	//! Edges indexes per slab (CSR layout)
+	std::vector<unsigned> m_slabEdges;
+	//! Polygon bounding-box
+	CCVector2 m_bbMin, m_bbMax;
+	//! Slab height
+	PointCoordinateType m_slabHeight;
+	//! Tolerance for box classification
+	PointCoordinateType m_epsilon;
+};
+
+//! Affine projection of 3D points in the polygon plane (first two rows of an OpenGL-style 4x4 matrix)
+struct PolyProjection2D
+{
+	PolyProjection2D(const float* viewMat)
+	{
+		if (viewMat)
+		{
+			for (unsigned i = 0; i < 4; ++i)
+			{
+				row[0][i] = static_cast<PointCoordinateType>(viewMat[i * 4 + 0]);
+				row[1][i] = static_cast<PointCoordinateType>(viewMat[i * 4 + 1]);
+			}
+		}
+		else
+		{
+			row[0][0] = 1; row[0][1] = 0; row[0][2] = 0; row[0][3] = 0;
+			row[1][0] = 0; row[1][1] = 1; row[1][2] = 0; row[1][3] = 0;
+		}
+	}
+
+	inline CCVector2 operator () (const CCVector3& P) const
+	{
+		return CCVector2(	row[0][0] * P.x + row[0][1] * P.y + row[0][2] * P.z + row[0][3],
+							row[1][0] * P.x + row[1][1] * P.y + row[1][2] * P.z + row[1][3] );
+	}
+
+	PointCoordinateType row[2][4];
+};
+
+//! Polygon segmentation job (shared by all the tasks)
+struct PolySegmentationJob
+{
+	GenericIndexedCloudPersist* cloud = nullptr;
+	const PreparedPolygon* polygon = nullptr;
+	const PolyProjection2D* projection = nullptr;
+	bool keepInside = true;
+	//! Selection flag for each point (written in place by the tasks)
+	unsigned char* selected = nullptr;
+	//! Optional octree (tasks are then octree cells)
+	const DgmOctree* octree = nullptr;
+	unsigned char octreeLevel = 0;
+};
+
+//! Polygon segmentation task (a contiguous set of points, or a set of octree cells)
+struct PolySegmentationTask
+{
+	//! First index (point or octree container index)
+	unsigned first;
+	//! Last index (excluded)
+	unsigned last;
+};
 
-	CCLib::SquareMatrix* trans = (viewMat ? new CCLib::SquareMatrix(viewMat) : nullptr);
+//! Maximum number of points per task (when no octree is used)
+static const unsigned c_polySegmentationChunkSize = 4096;
+
+//! Processes a polygon segmentation task
+struct PolySegmentationFunctor
+{
+	PolySegmentationFunctor(const PolySegmentationJob& job) : m_job(job) {}
+
+	void operator () (const PolySegmentationTask& task) const
+	{
+		if (m_job.octree)
+			processOctreeCells(task);
+		else
+			processChunk(task);
+	}
+
+protected:
+
+	//! Whole box status (or -1 if the points must be tested one by one)
+	inline int boxStatus(const CCVector2& boxMin, const CCVector2& boxMax) const
+	{
+		switch (m_job.polygon->classify(boxMin, boxMax))
+		{
+		case PreparedPolygon::BOX_INSIDE:
+			return (m_job.keepInside ? 1 : 0);
+		case PreparedPolygon::BOX_OUTSIDE:
+			return (m_job.keepInside ? 0 : 1);
+		default:
+			return -1;
+		}
+	}
+
+	void processChunk(const PolySegmentationTask& task) const
+	{
+		//project the chunk points first (and compute their 2D bounding-box)
+		unsigned count = task.last - task.first;
+		std::vector<CCVector2> points2D(count);
+		CCVector2 bbMin, bbMax;
+		for (unsigned i = 0; i < count; ++i)
+		{
+			CCVector2 Q = (*m_job.projection)(*m_job.cloud->getPointPersistentPtr(task.first + i));
+			points2D[i] = Q;
+			if (i != 0)
+			{
+				bbMin.x = std::min(bbMin.x, Q.x);
+				bbMin.y = std::min(bbMin.y, Q.y);
+				bbMax.x = std::max(bbMax.x, Q.x);
+				bbMax.y = std::max(bbMax.y, Q.y);
+			}
+			else
+			{
+				bbMin = bbMax = Q;
+			}
+		}
+
+		unsigned char* selected = m_job.selected + task.first;
+
+		int status = boxStatus(bbMin, bbMax);
+		if (status >= 0)
+		{
+			//the whole chunk is on the same side of the polygon
+			std::fill(selected, selected + count, static_cast<unsigned char>(status));
+			return;
+		}
+
+		for (unsigned i = 0; i < count; ++i)
+		{
+			selected[i] = (m_job.polygon->isInside(points2D[i]) == m_job.keepInside ? 1 : 0);
+		}
+	}
+
+	void processOctreeCells(const PolySegmentationTask& task) const
+	{
+		const DgmOctree::cellsContainer& codes = m_job.octree->pointsAndTheirCellCodes();
+		const unsigned char bitDec = DgmOctree::GET_BIT_SHIFT(m_job.octreeLevel);
+
+		unsigned cellStart = task.first;
+		while (cellStart < task.last)
+		{
+			//look for the end of the current cell
+			DgmOctree::CellCode truncatedCode = (codes[cellStart].theCode >> bitDec);
+			unsigned cellEnd = cellStart + 1;
+			while (cellEnd < task.last && (codes[cellEnd].theCode >> bitDec) == truncatedCode)
+				++cellEnd;
+
+			//project the cell corners
+			CCVector3 cellMin, cellMax;
+			m_job.octree->computeCellLimits(truncatedCode, m_job.octreeLevel, cellMin, cellMax, true);
+			CCVector2 bbMin, bbMax;
+			for (unsigned j = 0; j < 8; ++j)
+			{
+				CCVector3 corner(	(j & 1) ? cellMax.x : cellMin.x,
+									(j & 2) ? cellMax.y : cellMin.y,
+									(j & 4) ? cellMax.z : cellMin.z );
+				CCVector2 Q = (*m_job.projection)(corner);
+				if (j != 0)
+				{
+					bbMin.x = std::min(bbMin.x, Q.x);
+					bbMin.y = std::min(bbMin.y, Q.y);
+					bbMax.x = std::max(bbMax.x, Q.x);
+					bbMax.y = std::max(bbMax.y, Q.y);
+				}
+				else
+				{
+					bbMin = bbMax = Q;
+				}
+			}
+
+			int status = boxStatus(bbMin, bbMax);
+			if (status >= 0)
+			{
+				//the whole cell is on the same side of the polygon
+				for (unsigned i = cellStart; i < cellEnd; ++i)
+					m_job.selected[codes[i].theIndex] = static_cast<unsigned char>(status);
+			}
+			else
+			{
+				for (unsigned i = cellStart; i < cellEnd; ++i)
+				{
+					unsigned index = codes[i].theIndex;
+					CCVector2 Q = (*m_job.projection)(*m_job.cloud->getPointPersistentPtr(index));
+					m_job.selected[index] = (m_job.polygon->isInside(Q) == m_job.keepInside ? 1 : 0);
+				}
+			}
+
+			cellStart = cellEnd;
+		}
+	}
+
+	const PolySegmentationJob& m_job;
+};
+
+ReferenceCloud* ManualSegmentationTools::segment(GenericIndexedCloudPersist* aCloud, const Polyline* poly, bool keepInside, const float* viewMat/*=nullptr*/, const DgmOctree* octree/*=nullptr*/)
+{
+	assert(poly && aCloud);
 
 	ReferenceCloud* Y = new ReferenceCloud(aCloud);
 
-	//we check for each point if it falls inside the polyline
 	unsigned count = aCloud->size();
-	for (unsigned i = 0; i < count; ++i)
-	{
-		CCVector3 P;
-		aCloud->getPoint(i, P);
+	if (count == 0)
+		return Y;
 
-		//we project the point in screen space first if necessary
-		if (trans)
+	PreparedPolygon polygon;
+	if (!polygon.init(poly))
+	{
+		//invalid polygon: no point can be inside
+		if (!keepInside && !Y->addPointIndex(0, count))
 		{
-			P = (*trans) * P;
+			//not enough memory
+			delete Y;
+			Y = nullptr;
 		}
+		return Y;
+	}
+
+	//we project the points in screen space first if necessary
+	//(only the first two rows of the - affine - view matrix are required)
+	PolyProjection2D projection(viewMat);
 
-		bool pointInside = isPointInsidePoly(CCVector2(P.x, P.y), poly);
-		if ((keepInside && pointInside) || (!keepInside && !pointInside))
+	//the octree is only usable if it corresponds to the current cloud
+	if (octree && (octree->getNumberOfProjectedPoints() != count || octree->associatedCloud() != aCloud))
+		octree = nullptr;
+
+	unsigned char octreeLevel = (octree ? octree->findBestLevelForAGivenPopulationPerCell(256) : 0);
+
+	std::vector<unsigned char> selected;
+	std::vector<PolySegmentationTask> tasks;
+	try
+	{
+		selected.resize(count, 0);
+
+		if (octree)
 		{
-			if (!Y->addPointIndex(i))
+			//tasks are sets of octree cells (never split a cell)
+			unsigned char bitDec = DgmOctree::GET_BIT_SHIFT(octreeLevel);
+			const DgmOctree::cellsContainer& codes = octree->pointsAndTheirCellCodes();
+
+			unsigned first = 0;
+			for (unsigned i = 1; i <= count; ++i)
 			{
-				//not enough memory
-				delete Y;
-				Y = nullptr;
-				break;
+				if (	i == count
+					||	(i - first >= c_polySegmentationChunkSize && (codes[i].theCode >> bitDec) != (codes[i - 1].theCode >> bitDec)))
+				{
+					tasks.push_back({ first, i });
+					first = i;
+				}
 			}
 		}
+		else
+		{
+			for (unsigned first = 0; first < count; first += c_polySegmentationChunkSize)
+			{
+				tasks.push_back({ first, std::min(first + c_polySegmentationChunkSize, count) });
+			}
+		}
+	}
+	catch (const std::bad_alloc&)
+	{
+		//not enough memory
+		delete Y;
+		return nullptr;
 	}
 
-	delete trans;
+	PolySegmentationJob job;
+	job.cloud = aCloud;
+	job.polygon = &polygon;
+	job.projection = &projection;
+	job.keepInside = keepInside;
+	job.selected = selected.data();
+	job.octree = octree;
+	job.octreeLevel = octreeLevel;
+
+	PolySegmentationFunctor functor(job);
+#ifdef ENABLE_MT_POLY_SEGMENTATION
+	QtConcurrent::blockingMap(tasks, functor);
+#else
+	for (const PolySegmentationTask& task : tasks)
+		functor(task);
+#endif
+
+	//eventually we merge the results (in the points order)
+	unsigned selectedCount = 0;
+	for (unsigned char s : selected)
+		selectedCount += s;
+
+	if (selectedCount != 0)
+	{
+		if (!Y->resize(selectedCount))
+		{
+			//not enough memory
+			delete Y;
+			return nullptr;
+		}
+
+		unsigned pos = 0;
+		for (unsigned i = 0; i < count; ++i)
+		{
+			if (selected[i])
+				Y->setPointIndex(pos++, i);
+		}
+	}
 
 	return Y;
 }
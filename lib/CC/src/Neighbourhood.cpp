@@ -889,11 +889,17 @@ double Neighbourhood::computeFeature(GeomFeature feature)
 
 	Jacobi<double>::SortEigenValuesAndVectors(eigVectors, eigValues); //sort the eigenvectors in decreasing order of their associated eigenvalues
 
-	//shortcuts
-	const double& l1 = eigValues[0];
-	const double& l2 = eigValues[1];
-	const double& l3 = eigValues[2];
+	CCVector3d e3(0, 0, 1);
+	if (feature == Verticality)
+	{
+		Jacobi<double>::GetEigenVector(eigVectors, 2, e3.u);
+	}
+
+	return ComputeFeature(feature, eigValues[0], eigValues[1], eigValues[2], e3);
+}
 
+double Neighbourhood::ComputeFeature(GeomFeature feature, double l1, double l2, double l3, const CCVector3d& e3)
+{
 	double value = std::numeric_limits<double>::quiet_NaN();
 
 	switch (feature)
@@ -947,9 +953,6 @@ double Neighbourhood::computeFeature(GeomFeature feature)
 	case Verticality:
 		{
 			CCVector3d Z(0, 0, 1);
-			CCVector3d e3(Z);
-			Jacobi<double>::GetEigenVector(eigVectors, 2, e3.u);
-
 			value = 1.0 - std::abs(Z.dot(e3));
 		}
 		break;
@@ -35,6 +35,19 @@ ScalarField::ScalarField(const ScalarField& sf)
 	setName(sf.m_name);
 }
 
+ScalarField& ScalarField::operator = (const ScalarField& sf)
+{
+	if (this != &sf)
+	{
+		std::vector<ScalarType>::operator = (sf);
+		setName(sf.m_name);
+		m_minVal = sf.m_minVal;
+		m_maxVal = sf.m_maxVal;
+		notifyValuesModified();
+	}
+	return *this;
+}
+
 void ScalarField::setName(const char* name)
 {
 	if (name)
@@ -109,5 +122,6 @@ bool ScalarField::resizeSafe(std::size_t count, bool initNewElements/*=false*/,
 		//not enough memory
 		return false;
 	}
+	notifyValuesModified();
 	return true;
 }
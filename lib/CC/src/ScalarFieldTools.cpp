@@ -24,7 +24,20 @@
 #include <ScalarField.h>
 
 //system
+#include <algorithm>
 #include <cstdio>
+#include <random>
+
+#ifdef USE_QT
+#ifndef CC_DEBUG
+//enables multi-threading handling
+#define ENABLE_MT_KMEANS
+#endif
+#endif
+
+#ifdef ENABLE_MT_KMEANS
+#include <QtConcurrentMap>
+#endif
 
 using namespace CCLib;
 
@@ -572,6 +585,266 @@ void ScalarFieldTools::computeScalarFieldHistogram(const GenericCloud* theCloud,
 	}
 }
 
+//! Max number of chunks processed by the K-means passes
+static const unsigned KMEANS_MAX_CHUNK_COUNT = 256;
+//! Min number of values per K-means chunk
+static const unsigned KMEANS_MIN_CHUNK_SIZE = 65536;
+//! Number of bins of the histogram used to pre-converge the 1D K-means
+static const unsigned KMEANS_HISTOGRAM_SIZE = 4096;
+//! Max number of iterations of the 1D K-means (on the histogram and on the values)
+static const int KMEANS_MAX_ITERATION_COUNT = 100;
+//! Max number of points used for the k-means++ seeding (multi-dimensional case)
+static const unsigned KMEANS_MAX_SEEDING_SAMPLES = 65536;
+//! Max number of classes for which the 1D class is found with a (vectorizable) linear scan
+static const unsigned KMEANS_LINEAR_SCAN_MAX_CLASSES = 32;
+
+//! Partial K-means statistics (computed on a contiguous range of points)
+struct KMeansChunk
+{
+	unsigned first = 0;
+	unsigned last = 0;
+	//! Sum of the values of each class (class by class)
+	std::vector<double> sums;
+	//! Number of values in each class
+	std::vector<unsigned> counts;
+	//! Min value of each class (1D only)
+	std::vector<ScalarType> mins;
+	//! Max value of each class (1D only)
+	std::vector<ScalarType> maxs;
+	//! Min value of the chunk (1D only - NaN if no valid value)
+	ScalarType minValue = NAN_VALUE;
+	//! Max value of the chunk (1D only - NaN if no valid value)
+	ScalarType maxValue = NAN_VALUE;
+	//! Histogram of the values (1D only)
+	std::vector<unsigned> histo;
+	//! Number of points that changed class (multi-dimensional only)
+	unsigned changedCount = 0;
+};
+
+//! Splits the points in a limited number of chunks
+static bool InitKMeansChunks(unsigned n, std::vector<KMeansChunk>& chunks)
+{
+	unsigned chunkSize = std::max(KMEANS_MIN_CHUNK_SIZE, n / KMEANS_MAX_CHUNK_COUNT + 1);
+	unsigned chunkCount = (n - 1) / chunkSize + 1;
+
+	try
+	{
+		chunks.resize(chunkCount);
+	}
+	catch (const std::bad_alloc&)
+	{
+		return false;
+	}
+
+	for (unsigned c = 0; c < chunkCount; ++c)
+	{
+		chunks[c].first = c * chunkSize;
+		chunks[c].last = std::min(n, chunks[c].first + chunkSize);
+	}
+
+	return true;
+}
+
+//! Returns the 1D class of a value (the classes boundaries must be sorted)
+static inline unsigned char KMeans1DClass(ScalarType V, const std::vector<ScalarType>& thresholds)
+{
+	if (thresholds.size() < KMEANS_LINEAR_SCAN_MAX_CLASSES)
+	{
+		//branchless count (the compiler can vectorize it)
+		unsigned char classIndex = 0;
+		for (ScalarType t : thresholds)
+			classIndex += static_cast<unsigned char>(t < V);
+		return classIndex;
+	}
+
+	return static_cast<unsigned char>(std::lower_bound(thresholds.begin(), thresholds.end(), V) - thresholds.begin());
+}
+
+//! Computes the (sorted) boundaries between sorted 1D classes centers
+static void KMeans1DThresholds(const std::vector<ScalarType>& centers, std::vector<ScalarType>& thresholds)
+{
+	thresholds.resize(centers.size() - 1);
+	for (std::size_t j = 0; j + 1 < centers.size(); ++j)
+		thresholds[j] = (centers[j] + centers[j + 1]) / 2;
+}
+
+//! 1D K-means job (shared by all the chunks)
+struct KMeans1DJob
+{
+	enum Pass { EXTREMAS, HISTOGRAM, CLASSES };
+
+	const GenericCloud* cloud = nullptr;
+	unsigned char K = 0;
+	Pass pass = EXTREMAS;
+	//! Histogram parameters
+	ScalarType minV = 0;
+	double binsPerUnit = 0;
+	//! Boundaries between the (sorted) classes
+	std::vector<ScalarType> thresholds;
+
+	//! Returns the histogram bin of a (valid) value
+	inline unsigned bin(ScalarType V) const
+	{
+		return std::min(KMEANS_HISTOGRAM_SIZE - 1, static_cast<unsigned>((V - minV) * binsPerUnit));
+	}
+};
+
+//! Processes one chunk of values for the current pass of the 1D K-means
+struct KMeans1DFunctor
+{
+	KMeans1DFunctor(const KMeans1DJob& job) : m_job(job) {}
+
+	void operator () (KMeansChunk& chunk) const
+	{
+		switch (m_job.pass)
+		{
+		case KMeans1DJob::EXTREMAS:
+		{
+			ScalarType minV = NAN_VALUE;
+			ScalarType maxV = NAN_VALUE;
+			for (unsigned i = chunk.first; i < chunk.last; ++i)
+			{
+				ScalarType V = m_job.cloud->getPointScalarValue(i);
+				if (ScalarField::ValidValue(V))
+				{
+					if (!ScalarField::ValidValue(minV))
+					{
+						minV = maxV = V;
+					}
+					else
+					{
+						minV = std::min(minV, V);
+						maxV = std::max(maxV, V);
+					}
+				}
+			}
+			chunk.minValue = minV;
+			chunk.maxValue = maxV;
+		}
+		break;
+
+		case KMeans1DJob::HISTOGRAM:
+		{
+			std::fill(chunk.histo.begin(), chunk.histo.end(), 0);
+			for (unsigned i = chunk.first; i < chunk.last; ++i)
+			{
+				ScalarType V = m_job.cloud->getPointScalarValue(i);
+				if (ScalarField::ValidValue(V))
+					++chunk.histo[m_job.bin(V)];
+			}
+		}
+		break;
+
+		case KMeans1DJob::CLASSES:
+		{
+			std::fill(chunk.sums.begin(), chunk.sums.end(), 0.0);
+			std::fill(chunk.counts.begin(), chunk.counts.end(), 0);
+			std::fill(chunk.mins.begin(), chunk.mins.end(), NAN_VALUE);
+			std::fill(chunk.maxs.begin(), chunk.maxs.end(), NAN_VALUE);
+			for (unsigned i = chunk.first; i < chunk.last; ++i)
+			{
+				ScalarType V = m_job.cloud->getPointScalarValue(i);
+				if (ScalarField::ValidValue(V))
+				{
+					unsigned char classIndex = KMeans1DClass(V, m_job.thresholds);
+					if (chunk.counts[classIndex]++ == 0)
+					{
+						chunk.mins[classIndex] = chunk.maxs[classIndex] = V;
+					}
+					else
+					{
+						chunk.mins[classIndex] = std::min(chunk.mins[classIndex], V);
+						chunk.maxs[classIndex] = std::max(chunk.maxs[classIndex], V);
+					}
+					chunk.sums[classIndex] += V;
+				}
+			}
+		}
+		break;
+		}
+	}
+
+protected:
+	const KMeans1DJob& m_job;
+};
+
+//! Runs the current pass of a K-means job on all the chunks
+template <class Functor> static void RunKMeansPass(std::vector<KMeansChunk>& chunks, const Functor& functor)
+{
+#ifdef ENABLE_MT_KMEANS
+	QtConcurrent::blockingMap(chunks, functor);
+#else
+	for (KMeansChunk& chunk : chunks)
+		functor(chunk);
+#endif
+}
+
+//! Picks K initial centers with the k-means++ heuristic
+/** \param samples sample values (point by point)
+	\param weights sample weights (or empty if all samples have the same weight)
+	\param dim dimension of the samples
+	\param K number of centers
+	\param centers output centers (K x dim values)
+**/
+static void KMeansPlusPlusSeeding(	const std::vector<ScalarType>& samples,
+									const std::vector<double>& weights,
+									unsigned dim,
+									unsigned char K,
+									std::vector<ScalarType>& centers)
+{
+	const std::size_t sampleCount = samples.size() / dim;
+	assert(sampleCount != 0);
+
+	std::mt19937 gen(0); //deterministic
+	centers.resize(static_cast<std::size_t>(K) * dim);
+
+	//squared distance of each sample to the nearest center (times its weight)
+	std::vector<double> minSquareDists(sampleCount);
+	std::size_t picked = 0;
+	if (weights.empty())
+	{
+		std::uniform_int_distribution<std::size_t> dist(0, sampleCount - 1);
+		picked = dist(gen);
+	}
+	else
+	{
+		std::discrete_distribution<std::size_t> dist(weights.begin(), weights.end());
+		picked = dist(gen);
+	}
+
+	for (unsigned char k = 0; k < K; ++k)
+	{
+		ScalarType* C = centers.data() + static_cast<std::size_t>(k) * dim;
+		std::copy(samples.begin() + picked * dim, samples.begin() + (picked + 1) * dim, C);
+		if (k + 1 == K)
+			break;
+
+		double totalSquareDist = 0.0;
+		for (std::size_t s = 0; s < sampleCount; ++s)
+		{
+			const ScalarType* P = samples.data() + s * dim;
+			double squareDist = 0.0;
+			for (unsigned d = 0; d < dim; ++d)
+			{
+				double delta = static_cast<double>(P[d]) - C[d];
+				squareDist += delta * delta;
+			}
+			if (!weights.empty())
+				squareDist *= weights[s];
+			if (k == 0 || squareDist < minSquareDists[s])
+				minSquareDists[s] = squareDist;
+			totalSquareDist += minSquareDists[s];
+		}
+
+		if (totalSquareDist > 0)
+		{
+			std::discrete_distribution<std::size_t> dist(minSquareDists.begin(), minSquareDists.end());
+			picked = dist(gen);
+		}
+		//else: less distinct values than classes, we keep the same center (the class will remain empty)
+	}
+}
+
 bool ScalarFieldTools::computeKmeans(	const GenericCloud* theCloud,
 										unsigned char K,
 										KMeanClass kmcc[],
@@ -588,22 +861,33 @@ bool ScalarFieldTools::computeKmeans(	const GenericCloud* theCloud,
 	if (n == 0)
 		return false;
 
-	//on a besoin de memoire ici !
-	std::vector<ScalarType> theKMeans;		//K clusters centers
-	std::vector<unsigned char> belongings;			//index of the cluster the point belongs to
-	std::vector<ScalarType> minDistsToMean;	//distance to the nearest cluster center
-	std::vector<ScalarType> theKSums;		//sum of distances to the clusters
-	std::vector<unsigned> theKNums;			//number of points per clusters
-	std::vector<unsigned> theOldKNums;		//number of points per clusters (prior to iteration)
-
+	//memory usage only depends on K (and on the number of chunks)
+	std::vector<KMeansChunk> chunks;
+	std::vector<ScalarType> theKMeans;	//K clusters centers
+	std::vector<double> theKSums;		//sum of the values of each cluster
+	std::vector<unsigned> theKNums;		//number of points per clusters
+	std::vector<unsigned> theOldKNums;	//number of points per clusters (prior to iteration)
+	std::vector<ScalarType> mins;		//min value of each cluster
+	std::vector<ScalarType> maxs;		//max value of each cluster
+	std::vector<unsigned> histo;		//histogram of all the values
 	try
 	{
-		theKMeans.resize(n);
-		belongings.resize(n);
-		minDistsToMean.resize(n);
+		if (!InitKMeansChunks(n, chunks))
+			return false;
+		for (KMeansChunk& chunk : chunks)
+		{
+			chunk.sums.resize(K);
+			chunk.counts.resize(K);
+			chunk.mins.resize(K);
+			chunk.maxs.resize(K);
+			chunk.histo.resize(KMEANS_HISTOGRAM_SIZE);
+		}
 		theKSums.resize(K);
-		theKNums.resize(K);
-		theOldKNums.resize(K);
+		theKNums.resize(K, 0);
+		theOldKNums.resize(K, 0);
+		mins.resize(K);
+		maxs.resize(K);
+		histo.resize(KMEANS_HISTOGRAM_SIZE, 0);
 	}
 	catch (const std::bad_alloc&)
 	{
@@ -611,12 +895,33 @@ bool ScalarFieldTools::computeKmeans(	const GenericCloud* theCloud,
 		return false;
 	}
 
+	KMeans1DJob job;
+	job.cloud = theCloud;
+	job.K = K;
+	KMeans1DFunctor functor(job);
+
 	//compute min and max SF values
-	ScalarType minV;
-	ScalarType maxV;
+	ScalarType minV = NAN_VALUE;
+	ScalarType maxV = NAN_VALUE;
 	{
-		computeScalarFieldExtremas(theCloud, minV, maxV);
-		
+		job.pass = KMeans1DJob::EXTREMAS;
+		RunKMeansPass(chunks, functor);
+		for (const KMeansChunk& chunk : chunks)
+		{
+			if (!ScalarField::ValidValue(chunk.minValue))
+				continue;
+			if (!ScalarField::ValidValue(minV))
+			{
+				minV = chunk.minValue;
+				maxV = chunk.maxValue;
+			}
+			else
+			{
+				minV = std::min(minV, chunk.minValue);
+				maxV = std::max(maxV, chunk.maxValue);
+			}
+		}
+
 		if (!ScalarField::ValidValue(minV))
 		{
 			//sf is only composed of NAN values?!
@@ -624,70 +929,113 @@ bool ScalarFieldTools::computeKmeans(	const GenericCloud* theCloud,
 		}
 	}
 
-	//init classes centers (regularly sampled)
+	//histogram of the values
+	{
+		job.minV = minV;
+		job.binsPerUnit = (maxV > minV ? KMEANS_HISTOGRAM_SIZE / (static_cast<double>(maxV) - minV) : 0.0);
+		job.pass = KMeans1DJob::HISTOGRAM;
+		RunKMeansPass(chunks, functor);
+		for (KMeansChunk& chunk : chunks)
+		{
+			for (unsigned b = 0; b < KMEANS_HISTOGRAM_SIZE; ++b)
+				histo[b] += chunk.histo[b];
+			//we won't need it anymore
+			chunk.histo.clear();
+			chunk.histo.shrink_to_fit();
+		}
+	}
+
+	//init classes centers (k-means++ on the histogram bins, then pre-converged on the histogram)
+	try
+	{
+		const double binWidth = (job.binsPerUnit > 0 ? 1.0 / job.binsPerUnit : 0.0);
+		std::vector<ScalarType> binValues;
+		std::vector<double> binWeights;
+		for (unsigned b = 0; b < KMEANS_HISTOGRAM_SIZE; ++b)
+		{
+			if (histo[b] != 0)
+			{
+				binValues.push_back(static_cast<ScalarType>(minV + (b + 0.5) * binWidth));
+				binWeights.push_back(histo[b]);
+			}
+		}
+
+		KMeansPlusPlusSeeding(binValues, binWeights, 1, K, theKMeans);
+		std::sort(theKMeans.begin(), theKMeans.end());
+
+		std::vector<double> binSums(K);
+		std::vector<double> binCounts(K);
+		std::vector<double> oldBinCounts(K, -1.0);
+		for (int iteration = 0; iteration < KMEANS_MAX_ITERATION_COUNT; ++iteration)
+		{
+			KMeans1DThresholds(theKMeans, job.thresholds);
+			std::fill(binSums.begin(), binSums.end(), 0.0);
+			std::fill(binCounts.begin(), binCounts.end(), 0.0);
+			for (std::size_t b = 0; b < binValues.size(); ++b)
+			{
+				unsigned char classIndex = KMeans1DClass(binValues[b], job.thresholds);
+				binSums[classIndex] += binValues[b] * binWeights[b];
+				binCounts[classIndex] += binWeights[b];
+			}
+			if (binCounts == oldBinCounts)
+				break;
+			oldBinCounts = binCounts;
+
+			for (unsigned char j = 0; j < K; ++j)
+				if (binCounts[j] > 0)
+					theKMeans[j] = static_cast<ScalarType>(binSums[j] / binCounts[j]);
+			std::sort(theKMeans.begin(), theKMeans.end());
+		}
+	}
+	catch (const std::bad_alloc&)
 	{
-		ScalarType step = (maxV - minV) / K;
-		for (unsigned char j=0; j<K; ++j)
-			theKMeans[j] = minV + step * j;
+		//not enough memory
+		return false;
 	}
 
 	//for progress notification
 	double initialCMD = 0;
 
-	//let's start
+	//let's start (on the real values this time)
+	job.pass = KMeans1DJob::CLASSES;
 	bool meansHaveMoved = false;
 	int iteration = 0;
 	do
 	{
 		meansHaveMoved = false;
 		++iteration;
-		{
-			for (unsigned i=0; i<n; ++i)
-			{
-				unsigned char minK = 0;
 
-				ScalarType V = theCloud->getPointScalarValue(i);
-				if (ScalarField::ValidValue(V))
-				{
-					minDistsToMean[i] = std::abs(theKMeans[minK]-V);
+		//classes boundaries (the means are kept sorted)
+		std::sort(theKMeans.begin(), theKMeans.end());
+		KMeans1DThresholds(theKMeans, job.thresholds);
 
-					//we look for the nearest cluster center
-					for (unsigned char j = 1; j < K; ++j)
-					{
-						ScalarType distToMean = std::abs(theKMeans[j] - V);
-						if (distToMean<minDistsToMean[i])
-						{
-							minDistsToMean[i] = distToMean;
-							minK = j;
-						}
-					}
-				}
-
-				belongings[i] = minK;
-				minDistsToMean[i] = V;
-			}
-		}
+		RunKMeansPass(chunks, functor);
 
-		//compute the clusters centers
+		//merge the partial results
 		theOldKNums = theKNums;
-		std::fill(theKSums.begin(), theKSums.end(), static_cast<ScalarType>(0));
+		std::fill(theKSums.begin(), theKSums.end(), 0.0);
 		std::fill(theKNums.begin(), theKNums.end(), static_cast<unsigned>(0));
+		std::fill(mins.begin(), mins.end(), maxV);
+		std::fill(maxs.begin(), maxs.end(), minV);
+		for (const KMeansChunk& chunk : chunks)
 		{
-			for (unsigned i = 0; i < n; ++i)
+			for (unsigned char j = 0; j < K; ++j)
 			{
-				if (minDistsToMean[i] >= 0) //must be a valid value!
-				{
-					theKSums[belongings[i]] += minDistsToMean[i];
-					++theKNums[belongings[i]];
-				}
+				if (chunk.counts[j] == 0)
+					continue;
+				theKSums[j] += chunk.sums[j];
+				theKNums[j] += chunk.counts[j];
+				mins[j] = std::min(mins[j], chunk.mins[j]);
+				maxs[j] = std::max(maxs[j], chunk.maxs[j]);
 			}
 		}
 
+		//compute the clusters centers
 		double classMovingDist = 0.0;
 		{
 			for (unsigned char j = 0; j < K; ++j)
 			{
-				ScalarType newMean = (theKNums[j] > 0 ? theKSums[j] / theKNums[j] : theKMeans[j]);
+				ScalarType newMean = (theKNums[j] > 0 ? static_cast<ScalarType>(theKSums[j] / theKNums[j]) : theKMeans[j]);
 
 				if (theOldKNums[j] != theKNums[j])
 					meansHaveMoved = true;
@@ -713,59 +1061,250 @@ bool ScalarFieldTools::computeKmeans(	const GenericCloud* theCloud,
 				progressCb->update(0);
 				initialCMD = classMovingDist;
 			}
-			else
+			else if (initialCMD > 0)
 			{
-				progressCb->update(static_cast<float>((1.0 - classMovingDist / initialCMD) * 100.0));
+				progressCb->update(static_cast<float>(std::max(0.0, 1.0 - classMovingDist / initialCMD) * 100.0));
 			}
 		}
-	} while (meansHaveMoved);
+	} while (meansHaveMoved && iteration < KMEANS_MAX_ITERATION_COUNT);
 
-	//update distances
-	std::vector<ScalarType> mins;
-	std::vector<ScalarType> maxs;
-	try
+	//last check
 	{
-		mins.resize(K, maxV);
-		maxs.resize(K, minV);
+		for (unsigned char j = 0; j < K; ++j)
+			if (theKNums[j] == 0)
+				mins[j] = maxs[j] = -1.0;
 	}
-	catch (const std::bad_alloc&)
+
+	//output
 	{
-		//not enough memory
+		for (unsigned char j = 0; j < K; ++j)
+		{
+			kmcc[j].mean = theKMeans[j];
+			kmcc[j].minValue = mins[j];
+			kmcc[j].maxValue = maxs[j];
+		}
+	}
+
+	if (progressCb)
+		progressCb->stop();
+
+	return true;
+}
+
+//! Multi-dimensional K-means job (shared by all the chunks)
+struct KMeansNDJob
+{
+	const std::vector<const ScalarField*>* features = nullptr;
+	unsigned char K = 0;
+	//! Current classes centers (class by class)
+	std::vector<ScalarType> centers;
+	//! Class of each point
+	std::vector<unsigned char>* belongings = nullptr;
+};
+
+//! Assigns the points of one chunk to the nearest class center (multi-dimensional K-means)
+struct KMeansNDFunctor
+{
+	KMeansNDFunctor(const KMeansNDJob& job) : m_job(job) {}
+
+	void operator () (KMeansChunk& chunk) const
+	{
+		const std::vector<const ScalarField*>& features = *m_job.features;
+		const unsigned dim = static_cast<unsigned>(features.size());
+		std::vector<unsigned char>& belongings = *m_job.belongings;
+
+		std::fill(chunk.sums.begin(), chunk.sums.end(), 0.0);
+		std::fill(chunk.counts.begin(), chunk.counts.end(), 0);
+		chunk.changedCount = 0;
+
+		std::vector<ScalarType> P(dim);
+		for (unsigned i = chunk.first; i < chunk.last; ++i)
+		{
+			bool validPoint = true;
+			for (unsigned d = 0; d < dim; ++d)
+			{
+				P[d] = features[d]->getValue(i);
+				if (!ScalarField::ValidValue(P[d]))
+				{
+					validPoint = false;
+					break;
+				}
+			}
+			if (!validPoint)
+			{
+				belongings[i] = ScalarFieldTools::INVALID_KMEAN_CLASS;
+				continue;
+			}
+
+			//we look for the nearest cluster center
+			unsigned char minK = 0;
+			ScalarType minSquareDist = 0;
+			const ScalarType* C = m_job.centers.data();
+			for (unsigned char k = 0; k < m_job.K; ++k, C += dim)
+			{
+				ScalarType squareDist = 0;
+				for (unsigned d = 0; d < dim; ++d)
+				{
+					ScalarType delta = P[d] - C[d];
+					squareDist += delta * delta;
+				}
+				if (k == 0 || squareDist < minSquareDist)
+				{
+					minSquareDist = squareDist;
+					minK = k;
+				}
+			}
+
+			if (belongings[i] != minK)
+			{
+				belongings[i] = minK;
+				++chunk.changedCount;
+			}
+
+			double* sums = chunk.sums.data() + static_cast<std::size_t>(minK) * dim;
+			for (unsigned d = 0; d < dim; ++d)
+				sums[d] += P[d];
+			++chunk.counts[minK];
+		}
+	}
+
+protected:
+	const KMeansNDJob& m_job;
+};
+
+bool ScalarFieldTools::computeKmeans(	const std::vector<const ScalarField*>& features,
+										unsigned char K,
+										std::vector<ScalarType>& centers,
+										std::vector<unsigned char>& belongings,
+										unsigned maxIterationCount,
+										GenericProgressCallback* progressCb)
+{
+	//valid parameters?
+	if (features.empty() || K == 0 || K == INVALID_KMEAN_CLASS)
+	{
+		assert(false);
 		return false;
 	}
 
-	//look for min and max values for each cluster
+	const unsigned dim = static_cast<unsigned>(features.size());
+	const unsigned n = features.front() ? features.front()->currentSize() : 0;
+	for (const ScalarField* sf : features)
 	{
-		for (unsigned i = 0; i < n; ++i)
+		if (!sf || sf->currentSize() != n)
 		{
-			ScalarType V = theCloud->getPointScalarValue(i);
-			if (ScalarField::ValidValue(V))
+			//all the scalar fields should have the same size
+			assert(false);
+			return false;
+		}
+	}
+	if (n == 0)
+		return false;
+
+	std::vector<KMeansChunk> chunks;
+	std::vector<ScalarType> samples;
+	try
+	{
+		if (!InitKMeansChunks(n, chunks))
+			return false;
+		for (KMeansChunk& chunk : chunks)
+		{
+			chunk.sums.resize(static_cast<std::size_t>(K) * dim);
+			chunk.counts.resize(K);
+		}
+		belongings.assign(n, static_cast<unsigned char>(INVALID_KMEAN_CLASS));
+
+		//subsample for the seeding (regular sampling first, all the points if not enough valid ones)
+		for (unsigned step = std::max(1u, n / KMEANS_MAX_SEEDING_SAMPLES); samples.size() < static_cast<std::size_t>(K) * dim; step = 1)
+		{
+			samples.clear();
+			for (unsigned i = 0; i < n && samples.size() < static_cast<std::size_t>(KMEANS_MAX_SEEDING_SAMPLES) * dim; i += step)
 			{
-				if (V < mins[belongings[i]])
-					mins[belongings[i]] = V;
-				else if (V > maxs[belongings[i]])
-					maxs[belongings[i]] = V;
+				bool validPoint = true;
+				for (const ScalarField* sf : features)
+					validPoint &= ScalarField::ValidValue(sf->getValue(i));
+				if (validPoint)
+					for (const ScalarField* sf : features)
+						samples.push_back(sf->getValue(i));
 			}
+			if (step == 1)
+				break;
 		}
 	}
+	catch (const std::bad_alloc&)
+	{
+		//not enough memory
+		return false;
+	}
 
-	//last check
+	if (samples.empty())
 	{
-		for (unsigned char j = 0; j < K; ++j)
-			if (theKNums[j] == 0)
-				mins[j] = maxs[j] = -1.0;
+		//only invalid values?!
+		return false;
 	}
 
-	//output
+	KMeansNDJob job;
+	job.features = &features;
+	job.K = K;
+	job.belongings = &belongings;
+	KMeansPlusPlusSeeding(samples, std::vector<double>(), dim, K, job.centers);
+	samples.clear();
+	samples.shrink_to_fit();
+
+	if (progressCb)
 	{
-		for (unsigned char j = 0; j < K; ++j)
+		if (progressCb->textCanBeEdited())
 		{
-			kmcc[j].mean = theKMeans[j];
-			kmcc[j].minValue = mins[j];
-			kmcc[j].maxValue = maxs[j];
+			progressCb->setMethodTitle("KMeans");
+			char buffer[256];
+			sprintf(buffer, "K=%i (%u dimensions)", K, dim);
+			progressCb->setInfo(buffer);
+			progressCb->start();
 		}
+		progressCb->update(0);
 	}
 
+	KMeansNDFunctor functor(job);
+	std::vector<double> sums(static_cast<std::size_t>(K) * dim);
+	std::vector<unsigned> counts(K);
+	for (unsigned iteration = 0; iteration < maxIterationCount; ++iteration)
+	{
+		RunKMeansPass(chunks, functor);
+
+		//merge the partial results
+		std::fill(sums.begin(), sums.end(), 0.0);
+		std::fill(counts.begin(), counts.end(), 0);
+		unsigned changedCount = 0;
+		for (const KMeansChunk& chunk : chunks)
+		{
+			for (std::size_t j = 0; j < sums.size(); ++j)
+				sums[j] += chunk.sums[j];
+			for (unsigned char k = 0; k < K; ++k)
+				counts[k] += chunk.counts[k];
+			changedCount += chunk.changedCount;
+		}
+
+		if (changedCount == 0)
+			break;
+
+		//compute the clusters centers (empty clusters keep their previous center)
+		for (unsigned char k = 0; k < K; ++k)
+			if (counts[k] != 0)
+				for (unsigned d = 0; d < dim; ++d)
+					job.centers[static_cast<std::size_t>(k) * dim + d] = static_cast<ScalarType>(sums[static_cast<std::size_t>(k) * dim + d] / counts[k]);
+
+		if (progressCb)
+		{
+			progressCb->update(static_cast<float>((iteration + 1) * 100.0 / maxIterationCount));
+			if (progressCb->isCancelRequested())
+			{
+				progressCb->stop();
+				return false;
+			}
+		}
+	}
+
+	centers = job.centers;
+
 	if (progressCb)
 		progressCb->stop();
 
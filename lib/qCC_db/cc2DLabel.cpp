@@ -1007,7 +1007,7 @@ void cc2DLabel::drawMeOnly3D(CC_DRAW_CONTEXT& context)
 		//not particularly fast
 		if (MACRO_DrawFastNamesOnly(context))
 			return;
-		glFunc->glPushName(getUniqueIDForDisplay());
+		context.pushName(getUniqueIDForDisplay());
 	}
 
 	//we always project the points in 2D (maybe useful later, even when displaying the label during the 2D pass!)
@@ -1128,7 +1128,7 @@ void cc2DLabel::drawMeOnly3D(CC_DRAW_CONTEXT& context)
 
 	if (pushName)
 	{
-		glFunc->glPopName();
+		context.popName();
 	}
 }
 
@@ -1225,7 +1225,7 @@ void cc2DLabel::drawMeOnly2D(CC_DRAW_CONTEXT& context)
 	bool pushName = MACRO_DrawEntityNames(context);
 	if (pushName)
 	{
-		glFunc->glPushName(getUniqueIDForDisplay());
+		context.pushName(getUniqueIDForDisplay());
 	}
 
 	float halfW = context.glW / 2.0f;
@@ -1312,7 +1312,7 @@ void cc2DLabel::drawMeOnly2D(CC_DRAW_CONTEXT& context)
 			//no need to draw anything (might be confusing)
 			if (pushName)
 			{
-				glFunc->glPopName();
+				context.popName();
 			}
 			return;
 		}
@@ -1323,7 +1323,7 @@ void cc2DLabel::drawMeOnly2D(CC_DRAW_CONTEXT& context)
 		//nothing to do
 		if (pushName)
 		{
-			glFunc->glPopName();
+			context.popName();
 		}
 		return;
 	}
@@ -1797,6 +1797,6 @@ void cc2DLabel::drawMeOnly2D(CC_DRAW_CONTEXT& context)
 
 	if (pushName)
 	{
-		glFunc->glPopName();
+		context.popName();
 	}
 }
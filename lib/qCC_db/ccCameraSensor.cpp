@@ -1342,7 +1342,7 @@ void ccCameraSensor::drawMeOnly(CC_DRAW_CONTEXT& context)
 		//not particularly fast
 		if (MACRO_DrawFastNamesOnly(context))
 			return;
-		glFunc->glPushName(getUniqueIDForDisplay());
+		context.pushName(getUniqueIDForDisplay());
 	}
 
 	glFunc->glMatrixMode(GL_MODELVIEW);
@@ -1354,7 +1354,7 @@ void ccCameraSensor::drawMeOnly(CC_DRAW_CONTEXT& context)
 			//no visible position for this index!
 			glFunc->glPopMatrix();
 			if (pushName)
-				glFunc->glPopName();
+				context.popName();
 			return;
 		}
 
@@ -1530,7 +1530,7 @@ void ccCameraSensor::drawMeOnly(CC_DRAW_CONTEXT& context)
 	}
 
 	if (pushName)
-		glFunc->glPopName();
+		context.popName();
 
 	glFunc->glPopMatrix();
 }
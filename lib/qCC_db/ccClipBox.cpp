@@ -22,6 +22,7 @@
 //#include "ccReservedIDs.h"
 
 //Local
+#include "ccChunk.h"
 #include "ccCone.h"
 #include "ccCylinder.h"
 #include "ccHObjectCaster.h"
@@ -29,6 +30,7 @@
 #include "ccTorus.h"
 
 //system
+#include <algorithm>
 #include <cassert>
 
 //Components geometry
@@ -48,7 +50,7 @@ void DrawUnitArrow(int ID, const CCVector3& start, const CCVector3& direction, P
 
 	if (ID > 0)
 	{
-		glFunc->glLoadName(ID);
+		context.loadName(ID);
 	}
 
 	glFunc->glMatrixMode(GL_MODELVIEW);
@@ -103,7 +105,7 @@ static void DrawUnitTorus(int ID, const CCVector3& center, const CCVector3& dire
 		return;
 
 	if (ID > 0)
-		glFunc->glLoadName(ID);
+		context.loadName(ID);
 
 	glFunc->glMatrixMode(GL_MODELVIEW);
 	glFunc->glPushMatrix();
@@ -180,7 +182,7 @@ static void DrawUnitCross(int ID, const CCVector3& center, PointCoordinateType s
 		return;
 
 	if (ID > 0)
-		glFunc->glLoadName(ID);
+		context.loadName(ID);
 
 	scale /= 2;
 	DrawUnitArrow(0, center, CCVector3(-1, 0, 0), scale, col, context);
@@ -620,39 +622,140 @@ void ccClipBox::flagPointsInside(	ccGenericPointCloud* cloud,
 		return;
 	}
 
-	int count = static_cast<int>(cloud->size());
+	unsigned pointCount = cloud->size();
+	int chunkCount = static_cast<int>(ccChunk::Count(pointCount));
 
+	//the points are expressed in the box frame with the inverse transformation
+	ccGLMatrix transMat;
 	if (m_glTransEnabled)
 	{
-		ccGLMatrix transMat = m_glTrans.inverse();
+		transMat = m_glTrans.inverse();
+	}
+
+	//whole chunks can be accepted or rejected thanks to their bounding-boxes
+	const std::vector<ccBBox>& chunkBBoxes = cloud->getChunkBBoxes();
+	bool useChunkBoxes = (chunkBBoxes.size() == static_cast<size_t>(chunkCount));
+
+	//per-chunk visibility summary (only if we fill the cloud's own visibility table)
+	std::vector<unsigned char> chunkVisibility;
+	bool ownTable = (visTable == &static_cast<const ccGenericPointCloud*>(cloud)->getTheVisibilityArray());
+	if (ownTable)
+	{
+		try
+		{
+			chunkVisibility.resize(chunkCount, ccGenericPointCloud::CHUNK_MIXED);
+		}
+		catch (const std::bad_alloc&)
+		{
+			//not a big deal
+			ownTable = false;
+		}
+	}
+
+	const CCVector3& boxMin = m_box.minCorner();
+	const CCVector3& boxMax = m_box.maxCorner();
 
 #if defined(_OPENMP)
-#pragma omp parallel for
+#pragma omp parallel for schedule(dynamic)
 #endif
-		for (int i = 0; i < count; ++i)
+	for (int i = 0; i < chunkCount; ++i)
+	{
+		unsigned start = static_cast<unsigned>(ccChunk::StartPos(i));
+		unsigned stop = start + static_cast<unsigned>(ccChunk::Size(i, pointCount));
+
+		//can we accept or reject the whole chunk?
+		if (useChunkBoxes && chunkBBoxes[i].isValid())
 		{
-			if (!shrink || visTable->at(i) == POINT_VISIBLE)
+			const ccBBox& chunkBox = chunkBBoxes[i];
+			bool allInside = true;
+			ccBBox transformedBox;
+			for (unsigned c = 0; c < 8; ++c)
 			{
-				CCVector3 P = *cloud->getPoint(static_cast<unsigned>(i));
-				transMat.apply(P);
-				visTable->at(i) = (m_box.contains(P) ? POINT_VISIBLE : POINT_HIDDEN);
+				CCVector3 corner(	(c & 1) ? chunkBox.maxCorner().x : chunkBox.minCorner().x,
+									(c & 2) ? chunkBox.maxCorner().y : chunkBox.minCorner().y,
+									(c & 4) ? chunkBox.maxCorner().z : chunkBox.minCorner().z );
+				if (m_glTransEnabled)
+				{
+					transMat.apply(corner);
+				}
+				allInside &= m_box.contains(corner);
+				transformedBox.add(corner);
+			}
+
+			if (allInside)
+			{
+				//the box is convex: all the points are inside
+				if (!shrink)
+				{
+					std::fill(visTable->begin() + start, visTable->begin() + stop, POINT_VISIBLE);
+				}
+				//(in 'shrink' mode, the points keep their current state)
+				if (ownTable)
+				{
+					chunkVisibility[i] = (shrink ? ccGenericPointCloud::CHUNK_MIXED : ccGenericPointCloud::CHUNK_ALL_VISIBLE);
+				}
+				continue;
+			}
+
+			const CCVector3& tMin = transformedBox.minCorner();
+			const CCVector3& tMax = transformedBox.maxCorner();
+			if (	tMin.x > boxMax.x || tMax.x < boxMin.x
+				||	tMin.y > boxMax.y || tMax.y < boxMin.y
+				||	tMin.z > boxMax.z || tMax.z < boxMin.z )
+			{
+				//no point can be inside
+				if (shrink)
+				{
+					std::replace(visTable->begin() + start, visTable->begin() + stop, static_cast<unsigned char>(POINT_VISIBLE), static_cast<unsigned char>(POINT_HIDDEN));
+				}
+				else
+				{
+					std::fill(visTable->begin() + start, visTable->begin() + stop, POINT_HIDDEN);
+				}
+				if (ownTable)
+				{
+					chunkVisibility[i] = ccGenericPointCloud::CHUNK_ALL_HIDDEN;
+				}
+				continue;
 			}
 		}
-	}
-	else
-	{
-#if defined(_OPENMP)
-#pragma omp parallel for
-#endif
-		for (int i = 0; i < count; ++i)
+
+		//otherwise we test the points one by one
+		unsigned visibleCount = 0;
+		for (unsigned j = start; j < stop; ++j)
 		{
-			if (!shrink || visTable->at(i) == POINT_VISIBLE)
+			unsigned char& vis = (*visTable)[j];
+			if (shrink && vis != POINT_VISIBLE)
 			{
-				const CCVector3* P = cloud->getPoint(static_cast<unsigned>(i));
-				visTable->at(i) = (m_box.contains(*P) ? POINT_VISIBLE : POINT_HIDDEN);
+				continue;
 			}
+
+			CCVector3 P = *cloud->getPoint(j);
+			if (m_glTransEnabled)
+			{
+				transMat.apply(P);
+			}
+			//branchless test
+			bool inside = (P.x >= boxMin.x) & (P.x <= boxMax.x)
+						& (P.y >= boxMin.y) & (P.y <= boxMax.y)
+						& (P.z >= boxMin.z) & (P.z <= boxMax.z);
+			vis = (inside ? POINT_VISIBLE : POINT_HIDDEN);
+			visibleCount += inside;
+		}
+
+		if (ownTable)
+		{
+			if (visibleCount == 0)
+				chunkVisibility[i] = ccGenericPointCloud::CHUNK_ALL_HIDDEN;
+			else if (visibleCount == stop - start)
+				chunkVisibility[i] = ccGenericPointCloud::CHUNK_ALL_VISIBLE;
 		}
 	}
+
+	if (ownTable)
+	{
+		cloud->setChunkVisibility(std::move(chunkVisibility));
+	}
 }
 
 ccBBox ccClipBox::getOwnBB(bool withGLFeatures/*=false*/)
@@ -718,7 +821,7 @@ void ccClipBox::drawMeOnly(CC_DRAW_CONTEXT& context)
 	bool pushName = MACRO_DrawEntityNames(context);
 	if (pushName)
 	{
-		glFunc->glPushName(getUniqueIDForDisplay());
+		context.pushName(getUniqueIDForDisplay());
 	}
 
 	//draw the interactors
@@ -736,7 +839,7 @@ void ccClipBox::drawMeOnly(CC_DRAW_CONTEXT& context)
 
 		if (pushName) //2nd level = sub-item
 		{
-			glFunc->glPushName(0); //fake ID, will be replaced by the arrows one if any
+			context.pushName(0); //fake ID, will be replaced by the arrows one if any
 		}
 
 		//force the light on
@@ -762,12 +865,12 @@ void ccClipBox::drawMeOnly(CC_DRAW_CONTEXT& context)
 
 		if (pushName)
 		{
-			glFunc->glPopName();
+			context.popName();
 		}
 	}
 
 	if (pushName)
 	{
-		glFunc->glPopName();
+		context.popName();
 	}
 }
@@ -102,7 +102,10 @@ public:
 	void shift(const CCVector3& v);
 
 	//! Flags the points of a given cloud depending on whether they are inside or outside of this clipping box
-	/** \param cloud point cloud
+	/** Whole chunks of points (see ccChunk) are accepted or rejected with their
+		bounding-boxes. If 'visTable' is the cloud's own visibility table, the
+		per-chunk summary is updated as well (see ccGenericPointCloud::setChunkVisibility).
+		\param cloud point cloud
 		\param visTable visibility flags
 		\param shrink Whether the box is shrinking (faster) or not
 	**/
@@ -801,7 +801,7 @@ void ccGBLSensor::drawMeOnly(CC_DRAW_CONTEXT& context)
 		//not particularly fast
 		if (MACRO_DrawFastNamesOnly(context))
 			return;
-		glFunc->glPushName(getUniqueIDForDisplay());
+		context.pushName(getUniqueIDForDisplay());
 	}
 
 	//DGM FIXME: this display routine is crap!
@@ -816,7 +816,7 @@ void ccGBLSensor::drawMeOnly(CC_DRAW_CONTEXT& context)
 			//no visible position for this index!
 			glFunc->glPopMatrix();
 			if (pushName)
-				glFunc->glPopName();
+				context.popName();
 			return;
 		}
 
@@ -892,7 +892,7 @@ void ccGBLSensor::drawMeOnly(CC_DRAW_CONTEXT& context)
 	glFunc->glPopAttrib(); //GL_LINE_BIT
 
 	if (pushName)
-		glFunc->glPopName();
+		context.popName();
 
 	glFunc->glPopMatrix();
 }
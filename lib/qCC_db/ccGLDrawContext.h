@@ -23,6 +23,9 @@
 //Local
 #include "ccMaterial.h"
 
+//System
+#include <vector>
+
 class ccGenericGLDisplay;
 class ccScalarField;
 class ccColorRampShader;
@@ -55,7 +58,8 @@ enum CC_DRAWING_FLAGS
 	CC_DRAW_FAST_NAMES_ONLY					= 0x0200,
 	//CC_FREE_FLAG							= 0x03C0,		// UNUSED (formerly CC_DRAW_ANY_NAMES = CC_DRAW_ENTITY_NAMES | CC_DRAW_POINT_NAMES | CC_DRAW_TRI_NAMES)
 	CC_LOD_ACTIVATED						= 0x0400,
-	CC_VIRTUAL_TRANS_ENABLED				= 0x0800
+	CC_VIRTUAL_TRANS_ENABLED				= 0x0800,
+	CC_DRAW_ID_BUFFER						= 0x1000		// names are rendered as flat colors instead of being pushed on the GL selection stack
 };
 
 // Drawing flags testing macros (see ccDrawableObject)
@@ -70,6 +74,76 @@ enum CC_DRAWING_FLAGS
 #define MACRO_LODActivated(context)        (context.drawingFlags & CC_LOD_ACTIVATED)
 #define MACRO_VirtualTransEnabled(context) (context.drawingFlags & CC_VIRTUAL_TRANS_ENABLED)
 
+//! Name table for ID buffer picking (see CC_DRAW_ID_BUFFER)
+/** In this mode the (deprecated) OpenGL selection stack is not used. Each
+	(entity, sub-item) pair is registered in this table instead, and the
+	corresponding primitives are rendered with a flat color encoding the
+	table index + 1 (0 being reserved for the background).
+**/
+struct ccGLPickingNameTable
+{
+	//! Registered name
+	struct Name
+	{
+		//! Entity unique ID (for display)
+		unsigned entityID;
+		//! Sub-item index (or -1 if none)
+		int itemIndex;
+	};
+
+	//! Registered names
+	std::vector<Name> names;
+	//! Current name stack (same semantic as the OpenGL one)
+	std::vector<unsigned> stack;
+	//! Location of the 'flat color' uniform of the ID shader
+	int colorUniformLocation;
+	//! Whether some names couldn't be registered (see MaxNameCount)
+	/** The corresponding primitives have been rendered as background.
+	**/
+	bool overflow;
+
+	//! Default constructor
+	ccGLPickingNameTable() : colorUniformLocation(-1), overflow(false) {}
+
+	//! Clears the table
+	void clear() { names.clear(); stack.clear(); overflow = false; }
+
+	//! Converts a name index to a RGB color (24 bits)
+	static inline void IndexToColor(size_t index, float rgba[4])
+	{
+		size_t code = index + 1;
+		rgba[0] = static_cast<float>( code        & 0xFF) / 255.0f;
+		rgba[1] = static_cast<float>((code >> 8)  & 0xFF) / 255.0f;
+		rgba[2] = static_cast<float>((code >> 16) & 0xFF) / 255.0f;
+		rgba[3] = 1.0f;
+	}
+
+	//! Converts a color read back from the ID buffer to a name index (or -1 for the background)
+	static inline int ColorToIndex(const unsigned char* rgb)
+	{
+		int code = static_cast<int>(rgb[0]) | (static_cast<int>(rgb[1]) << 8) | (static_cast<int>(rgb[2]) << 16);
+		return code - 1;
+	}
+
+	//! Maximum number of names that can be encoded
+	static inline size_t MaxNameCount() { return (1 << 24) - 1; }
+};
+
+//! Rendering statistics (see ccGLDrawContext::renderingStats)
+struct ccGLRenderingStats
+{
+	//! Number of points sent to the GPU
+	size_t pointsDrawn;
+	//! Number of bytes uploaded to VBOs
+	size_t vboBytesUploaded;
+
+	//! Default constructor
+	ccGLRenderingStats() : pointsDrawn(0), vboBytesUploaded(0) {}
+
+	//! Resets the counters
+	void reset() { pointsDrawn = 0; vboBytesUploaded = 0; }
+};
+
 //! Display context
 struct ccGLDrawContext
 {
@@ -156,6 +230,12 @@ struct ccGLDrawContext
 	//! Whether to draw rounded points (instead of sqaures)
 	bool drawRoundedPoints;
 
+	//! Name table (ID buffer picking mode only)
+	ccGLPickingNameTable* pickingNames;
+
+	//! Rendering statistics (only collected if set, e.g. in benchmark mode)
+	ccGLRenderingStats* renderingStats;
+
 	//Default constructor
 	ccGLDrawContext()
 		: drawingFlags(0)
@@ -192,13 +272,138 @@ struct ccGLDrawContext
 		, destBlend(GL_ONE_MINUS_SRC_ALPHA)
 		, stereoPassIndex(0)
 		, drawRoundedPoints(false)
+		, pickingNames(nullptr)
+		, renderingStats(nullptr)
+		, nameStackGLFunc(nullptr)
+		, nameStackGLContext(nullptr)
 	{}
    
 	template<class TYPE>
 	TYPE *glFunctions() const
 	{				
 		return qGLContext ? qGLContext->versionFunctions<TYPE>() : 0;
-	}   
+	}
+
+	//! Pushes a picking name
+	/** Either on the OpenGL selection stack or in the ID buffer name table
+		(see CC_DRAW_ID_BUFFER).
+	**/
+	void pushName(unsigned name) const
+	{
+		QOpenGLFunctions_2_1* glFunc = nameStackFunctions();
+		if (!glFunc)
+			return;
+
+		if (pickingNames)
+		{
+			pickingNames->stack.push_back(name);
+			applyPickingName(glFunc);
+		}
+		else
+		{
+			glFunc->glPushName(name);
+		}
+	}
+
+	//! Pops the last picking name
+	void popName() const
+	{
+		QOpenGLFunctions_2_1* glFunc = nameStackFunctions();
+		if (!glFunc)
+			return;
+
+		if (pickingNames)
+		{
+			if (!pickingNames->stack.empty())
+			{
+				pickingNames->stack.pop_back();
+				applyPickingName(glFunc);
+			}
+		}
+		else
+		{
+			glFunc->glPopName();
+		}
+	}
+
+	//! Replaces the last picking name
+	void loadName(unsigned name) const
+	{
+		QOpenGLFunctions_2_1* glFunc = nameStackFunctions();
+		if (!glFunc)
+			return;
+
+		if (pickingNames)
+		{
+			if (!pickingNames->stack.empty())
+			{
+				pickingNames->stack.back() = name;
+				applyPickingName(glFunc);
+			}
+		}
+		else
+		{
+			glFunc->glLoadName(name);
+		}
+	}
+
+protected:
+
+	//! Returns the OpenGL functions used by the name stack methods
+	/** They are only queried once per OpenGL context (these methods
+		may be called for each entity and each sub-item).
+	**/
+	QOpenGLFunctions_2_1* nameStackFunctions() const
+	{
+		if (nameStackGLContext != qGLContext)
+		{
+			nameStackGLFunc = glFunctions<QOpenGLFunctions_2_1>();
+			nameStackGLContext = qGLContext;
+		}
+		return nameStackGLFunc;
+	}
+
+	//! Registers the current name stack in the ID buffer name table and updates the ID color
+	void applyPickingName(QOpenGLFunctions_2_1* glFunc) const
+	{
+		float rgba[4] = { 0.0f, 0.0f, 0.0f, 1.0f }; //background
+		const std::vector<unsigned>& stack = pickingNames->stack;
+		if (!stack.empty())
+		{
+			ccGLPickingNameTable::Name name;
+			name.entityID = stack.front();
+			name.itemIndex = (stack.size() > 1 ? static_cast<int>(stack[1]) : -1);
+			//no need to register the same name twice in a row
+			bool newName = (	pickingNames->names.empty()
+							||	pickingNames->names.back().entityID != name.entityID
+							||	pickingNames->names.back().itemIndex != name.itemIndex);
+			if (newName && pickingNames->names.size() >= ccGLPickingNameTable::MaxNameCount())
+			{
+				//this name can't be encoded: it will be drawn as background
+				pickingNames->overflow = true;
+			}
+			else
+			{
+				if (newName)
+				{
+					pickingNames->names.push_back(name);
+				}
+				ccGLPickingNameTable::IndexToColor(pickingNames->names.size() - 1, rgba);
+			}
+		}
+
+		if (pickingNames->colorUniformLocation >= 0)
+		{
+			glFunc->glUniform4fv(pickingNames->colorUniformLocation, 1, rgba);
+		}
+		//also set as the current color in case an entity temporarily releases the ID shader
+		glFunc->glColor4fv(rgba);
+	}
+
+	//! Cached OpenGL functions (see nameStackFunctions)
+	mutable QOpenGLFunctions_2_1* nameStackGLFunc;
+	//! OpenGL context of the cached functions
+	mutable QOpenGLContext* nameStackGLContext;
 };
 
 using CC_DRAW_CONTEXT = ccGLDrawContext;
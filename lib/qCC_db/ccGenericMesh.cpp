@@ -244,7 +244,7 @@ void ccGenericMesh::drawMeOnly(CC_DRAW_CONTEXT& context)
 			//not fast at all!
 			if (MACRO_DrawFastNamesOnly(context))
 				return;
-			glFunc->glPushName(getUniqueIDForDisplay());
+			context.pushName(getUniqueIDForDisplay());
 			//minimal display for picking mode!
 			glParams.showNorms = false;
 			glParams.showColors = false;
@@ -665,7 +665,7 @@ void ccGenericMesh::drawMeOnly(CC_DRAW_CONTEXT& context)
 
 		if (pushName)
 		{
-			glFunc->glPopName();
+			context.popName();
 		}
 	}
 }
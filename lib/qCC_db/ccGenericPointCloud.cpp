@@ -15,10 +15,6 @@
 //#                                                                        #
 //##########################################################################
 
-#ifdef USE_TBB
-#include <tbb/parallel_for.h>
-#endif
-
 #include "ccGenericPointCloud.h"
 
 //CCLib
@@ -28,17 +24,23 @@
 #include <ReferenceCloud.h>
 
 //Local
+#include "ccChunk.h"
 #include "ccGenericGLDisplay.h"
 #include "ccOctreeProxy.h"
 #include "ccPointCloud.h"
+#include "ccPointCloudLOD.h"
 #include "ccProgressDialog.h"
 #include "ccScalarField.h"
 #include "ccSensor.h"
 
+//System
+#include <algorithm>
+
 
 ccGenericPointCloud::ccGenericPointCloud(QString name, unsigned uniqueID)
 	: ccShiftedObject(name, uniqueID)
 	, m_pointSize(0)
+	, m_chunkBBoxesPointCount(0)
 {
 	setVisible(true);
 	lockVisibility(false);
@@ -48,6 +50,7 @@ ccGenericPointCloud::ccGenericPointCloud(const ccGenericPointCloud& cloud)
 	: ccShiftedObject(cloud)
 	, m_pointsVisibility(cloud.m_pointsVisibility)
 	, m_pointSize(cloud.m_pointSize)
+	, m_chunkBBoxesPointCount(0)
 {
 }
 
@@ -61,10 +64,13 @@ void ccGenericPointCloud::clear()
 	unallocateVisibilityArray();
 	deleteOctree();
 	enableTempColor(false);
+	invalidateChunkBBoxes();
 }
 
 bool ccGenericPointCloud::resetVisibilityArray()
 {
+	m_chunkVisibility.clear();
+
 	try
 	{
 		m_pointsVisibility.resize(size());
@@ -92,11 +98,19 @@ void ccGenericPointCloud::invertVisibilityArray()
 	{
 		vis = (vis == POINT_HIDDEN ? POINT_VISIBLE : POINT_HIDDEN);
 	}
+
+	//update the chunks summary (a chunk without visible points
+	//may contain other states than POINT_HIDDEN)
+	for (unsigned char& state : m_chunkVisibility)
+	{
+		state = (state == CHUNK_ALL_VISIBLE ? CHUNK_ALL_HIDDEN : CHUNK_MIXED);
+	}
 }
 
 void ccGenericPointCloud::unallocateVisibilityArray()
 {
 	m_pointsVisibility.resize(0);
+	m_chunkVisibility.clear();
 }
 
 bool ccGenericPointCloud::isVisibilityTableInstantiated() const
@@ -360,98 +374,401 @@ bool ccGenericPointCloud::pointPicking(	const CCVector2d& clickPos,
 	}
 
 	//otherwise we go 'brute force' (works quite well in fact?!)
-	nearestPointIndex = -1;
-	nearestSquareDist = -1.0;
+	std::vector<PointPickingCandidate> candidates;
+	if (!pointPicking(clickPos, camera, candidates, 1, pickWidth, pickHeight))
+	{
+		nearestPointIndex = -1;
+		nearestSquareDist = -1.0;
+		return false;
+	}
+
+	nearestPointIndex = static_cast<int>(candidates.front().pointIndex);
+	nearestSquareDist = candidates.front().squareDist;
+	return true;
+}
+
+const std::vector<ccBBox>& ccGenericPointCloud::getChunkBBoxes()
+{
+	unsigned pointCount = size();
+	if (!m_chunkBBoxes.empty() && m_chunkBBoxesPointCount == pointCount)
+	{
+		return m_chunkBBoxes;
+	}
+
+	size_t chunkCount = ccChunk::Count(pointCount);
+	try
+	{
+		m_chunkBBoxes.resize(chunkCount);
+	}
+	catch (const std::bad_alloc&)
+	{
+		m_chunkBBoxes.clear();
+		return m_chunkBBoxes;
+	}
+
+#if defined(_OPENMP)
+#pragma omp parallel for
+#endif
+	for (int i = 0; i < static_cast<int>(chunkCount); ++i)
 	{
-		//back project the clicked point in 3D
-		CCVector3d clickPosd(clickPos.x, clickPos.y, 0);
-		CCVector3d X(0, 0, 0);
-		if (!camera.unproject(clickPosd, X))
+		ccBBox& box = m_chunkBBoxes[i];
+		box.clear();
+
+		unsigned start = static_cast<unsigned>(ccChunk::StartPos(i));
+		unsigned stop = start + static_cast<unsigned>(ccChunk::Size(i, pointCount));
+		for (unsigned j = start; j < stop; ++j)
 		{
-			return false;
+			box.add(*getPoint(j));
+		}
+	}
+
+	m_chunkBBoxesPointCount = pointCount;
+
+	return m_chunkBBoxes;
+}
+
+//! Multiplies two (column major) OpenGL matrices
+static void MultGLMatrices(const double* A, const double* B, double* out)
+{
+	for (unsigned c = 0; c < 4; ++c)
+	{
+		for (unsigned r = 0; r < 4; ++r)
+		{
+			out[c * 4 + r] = A[r] * B[c * 4] + A[4 + r] * B[c * 4 + 1] + A[8 + r] * B[c * 4 + 2] + A[12 + r] * B[c * 4 + 3];
+		}
+	}
+}
+
+//! Inserts a candidate in a sorted list of (at most) k candidates
+static void InsertPickingCandidate(std::vector<ccGenericPointCloud::PointPickingCandidate>& candidates, unsigned k, const ccGenericPointCloud::PointPickingCandidate& candidate)
+{
+	if (candidates.size() == k)
+	{
+		if (candidate.squareDist >= candidates.back().squareDist)
+		{
+			return;
+		}
+		candidates.pop_back();
+	}
+
+	auto it = std::upper_bound(	candidates.begin(),
+								candidates.end(),
+								candidate,
+								[](const ccGenericPointCloud::PointPickingCandidate& a, const ccGenericPointCloud::PointPickingCandidate& b) { return a.squareDist < b.squareDist; });
+	candidates.insert(it, candidate);
+}
+
+//! Number of planes of the picking 'frustum'
+static const unsigned PICKING_PLANE_COUNT = 6;
+
+//! Computes the max signed distance of contiguous points to the picking planes
+/** The loop is branch-free so that the compiler can vectorize it.
+	A point is inside the picking 'frustum' if its distance is <= 0.
+**/
+static void ComputePickingDistances(const CCVector3* points, unsigned count, const float planes[PICKING_PLANE_COUNT][4], float* distances)
+{
+	for (unsigned j = 0; j < count; ++j)
+	{
+		const CCVector3& P = points[j];
+		float maxDist = planes[0][0] * P.x + planes[0][1] * P.y + planes[0][2] * P.z + planes[0][3];
+		for (unsigned p = 1; p < PICKING_PLANE_COUNT; ++p)
+		{
+			float dist = planes[p][0] * P.x + planes[p][1] * P.y + planes[p][2] * P.z + planes[p][3];
+			maxDist = (dist > maxDist ? dist : maxDist);
+		}
+		distances[j] = maxDist;
+	}
+}
+
+//! Collects the LOD leaf cells that may intersect the picking 'frustum'
+/** The cells are returned as ranges of the LOD octree codes.
+**/
+static void CollectPickingLODCells(	const ccPointCloudLOD& lod,
+									const ccPointCloudLOD::Node& node,
+									const float planes[PICKING_PLANE_COUNT][4],
+									const float planeNorms[PICKING_PLANE_COUNT],
+									std::vector<LODLevelDesc>& cells)
+{
+	//we discard the whole subtree if its bounding sphere lies outside of one of the planes
+	for (unsigned p = 0; p < PICKING_PLANE_COUNT; ++p)
+	{
+		const float* plane = planes[p];
+		float dist = plane[0] * node.center.x + plane[1] * node.center.y + plane[2] * node.center.z + plane[3];
+		if (dist > node.radius * planeNorms[p])
+		{
+			return;
+		}
+	}
+
+	if (node.childCount == 0)
+	{
+		cells.emplace_back(node.firstCodeIndex, node.pointCount);
+		return;
+	}
+
+	for (int32_t childIndex : node.childIndexes)
+	{
+		if (childIndex >= 0)
+		{
+			CollectPickingLODCells(lod, lod.node(childIndex, node.level + 1), planes, planeNorms, cells);
 		}
+	}
+}
+
+bool ccGenericPointCloud::pointPicking(	const CCVector2d& clickPos,
+										const ccGLCameraParameters& camera,
+										std::vector<PointPickingCandidate>& candidates,
+										unsigned k,
+										double pickWidth/*=2.0*/,
+										double pickHeight/*=2.0*/)
+{
+	candidates.clear();
+	if (k == 0 || size() == 0 || camera.viewport[2] <= 0 || camera.viewport[3] <= 0)
+	{
+		return false;
+	}
+
+	//back project the clicked point in 3D
+	CCVector3d clickPosd(clickPos.x, clickPos.y, 0);
+	CCVector3d X(0, 0, 0);
+	if (!camera.unproject(clickPosd, X))
+	{
+		return false;
+	}
+
+	//warning: we have to handle the relative GL transformation!
+	double MVP[16];
+	{
+		MultGLMatrices(camera.projectionMat.data(), camera.modelViewMat.data(), MVP);
 
-		//warning: we have to handle the relative GL transformation!
 		ccGLMatrix trans;
-		bool noGLTrans = !getAbsoluteGLTransformation(trans);
+		if (getAbsoluteGLTransformation(trans))
+		{
+			double T[16];
+			for (unsigned i = 0; i < 16; ++i)
+			{
+				T[i] = trans.data()[i];
+			}
+			double MV[16];
+			std::copy(MVP, MVP + 16, MV);
+			MultGLMatrices(MV, T, MVP);
+		}
+	}
+
+	//the picking window in normalized device coordinates (clipped to the frustum)
+	double ndcMinX = std::max(-1.0, 2.0 * (clickPos.x - pickWidth  - camera.viewport[0]) / camera.viewport[2] - 1.0);
+	double ndcMaxX = std::min( 1.0, 2.0 * (clickPos.x + pickWidth  - camera.viewport[0]) / camera.viewport[2] - 1.0);
+	double ndcMinY = std::max(-1.0, 2.0 * (clickPos.y - pickHeight - camera.viewport[1]) / camera.viewport[3] - 1.0);
+	double ndcMaxY = std::min( 1.0, 2.0 * (clickPos.y + pickHeight - camera.viewport[1]) / camera.viewport[3] - 1.0);
+	if (ndcMinX > ndcMaxX || ndcMinY > ndcMaxY)
+	{
+		//the picking window is outside of the viewport
+		return false;
+	}
+
+	//the picking 'frustum' as 6 planes (a point P is inside if a.P + d <= 0 for each plane)
+	//expressed in the cloud local coordinate system (i.e. before the GL transformation)
+	float planes[PICKING_PLANE_COUNT][4];
+	{
+		//rows of the MVP matrix (clip = MVP * [P,1])
+		double rowX[4] = { MVP[0], MVP[4], MVP[8],  MVP[12] };
+		double rowY[4] = { MVP[1], MVP[5], MVP[9],  MVP[13] };
+		double rowZ[4] = { MVP[2], MVP[6], MVP[10], MVP[14] };
+		double rowW[4] = { MVP[3], MVP[7], MVP[11], MVP[15] };
+		for (unsigned j = 0; j < 4; ++j)
+		{
+			planes[0][j] = static_cast<float>(rowX[j] - ndcMaxX * rowW[j]);	//x/w <= ndcMaxX
+			planes[1][j] = static_cast<float>(ndcMinX * rowW[j] - rowX[j]);	//x/w >= ndcMinX
+			planes[2][j] = static_cast<float>(rowY[j] - ndcMaxY * rowW[j]);	//y/w <= ndcMaxY
+			planes[3][j] = static_cast<float>(ndcMinY * rowW[j] - rowY[j]);	//y/w >= ndcMinY
+			planes[4][j] = static_cast<float>(rowZ[j] - rowW[j]);			//z <= w (far)
+			planes[5][j] = static_cast<float>(-rowZ[j] - rowW[j]);			//z >= -w (near)
+		}
+	}
+
+	//visibility table (if any)
+	const VisibilityTableType* visTable = isVisibilityTableInstantiated() ? &getTheVisibilityArray() : nullptr;
+
+	//scalar field with hidden values (if any)
+	ccScalarField* activeSF = nullptr;
+	if (	sfShown()
+		&&	isA(CC_TYPES::POINT_CLOUD)
+		&&	!visTable //if the visibility table is instantiated, we always display ALL points
+		)
+	{
+		ccPointCloud* pc = static_cast<ccPointCloud*>(this);
+		ccScalarField* sf = pc->getCurrentDisplayedScalarField();
+		if (sf && sf->mayHaveHiddenValues() && sf->getColorScale())
+		{
+			//we must take this SF display parameters into account as some points may be hidden!
+			activeSF = sf;
+		}
+	}
+
+	unsigned pointCount = size();
 
-		//visibility table (if any)
-		const ccGenericPointCloud::VisibilityTableType* visTable = isVisibilityTableInstantiated() ? &getTheVisibilityArray() : nullptr;
+	//the points of a ccPointCloud are stored contiguously
+	const CCVector3* cloudPoints = (isA(CC_TYPES::POINT_CLOUD) ? static_cast<ccPointCloud*>(this)->getPoint(0) : nullptr);
 
-		//scalar field with hidden values (if any)
-		ccScalarField* activeSF = nullptr;
-		if (	sfShown()
-			&&	isA(CC_TYPES::POINT_CLOUD)
-			&&	!visTable //if the visibility table is instantiated, we always display ALL points
-			)
+	//if the LOD structure is available, we only test the points of the LOD cells intersecting the picking 'frustum'
+	const ccOctree::cellsContainer* lodCodes = nullptr;
+	std::vector<LODLevelDesc> lodCells;
+	if (isA(CC_TYPES::POINT_CLOUD))
+	{
+		ccPointCloudLOD* lod = static_cast<ccPointCloud*>(this)->getLOD();
+		if (	lod
+			&&	lod->isInitialized()
+			&&	lod->octree()
+			&&	lod->octree()->getNumberOfProjectedPoints() == pointCount )
 		{
-			ccPointCloud* pc = static_cast<ccPointCloud*>(this);
-			ccScalarField* sf = pc->getCurrentDisplayedScalarField();
-			if (sf && sf->mayHaveHiddenValues() && sf->getColorScale())
+			float planeNorms[PICKING_PLANE_COUNT];
+			for (unsigned p = 0; p < PICKING_PLANE_COUNT; ++p)
+			{
+				planeNorms[p] = CCVector3f(planes[p][0], planes[p][1], planes[p][2]).norm();
+			}
+
+			try
+			{
+				CollectPickingLODCells(*lod, lod->root(), planes, planeNorms, lodCells);
+				lodCodes = &lod->octree()->pointsAndTheirCellCodes();
+			}
+			catch (const std::bad_alloc&)
+			{
+				//not enough memory: we'll test the chunks instead
+				lodCells.clear();
+			}
+
+			if (lodCodes && lodCells.empty())
 			{
-				//we must take this SF display parameters into account as some points may be hidden!
-				activeSF = sf;
+				//no cell intersects the picking 'frustum'
+				return false;
 			}
 		}
+	}
+
+	static const std::vector<ccBBox> s_noBBoxes;
+	const std::vector<ccBBox>& chunkBBoxes = (lodCodes ? s_noBBoxes : getChunkBBoxes());
+	int cellCount = static_cast<int>(lodCodes ? lodCells.size() : ccChunk::Count(pointCount));
 
-		int pointCount = static_cast<int>(size());
-#ifdef USE_TBB
-		tbb::parallel_for( 0, pointCount, [&](int i)
-#else
 #if defined(_OPENMP)
-#pragma omp parallel for
-#endif
-		for (int i = 0; i < pointCount; ++i)
+#pragma omp parallel
 #endif
+	{
+		std::vector<PointPickingCandidate> threadCandidates;
+		threadCandidates.reserve(k + 1);
+
+		//per-thread buffers
+		std::vector<float> distances(ccChunk::SIZE);
+		std::vector<CCVector3> gatheredPoints;
+		std::vector<unsigned> gatheredIndexes;
+
+		//tests a set of (at most ccChunk::SIZE) contiguous points
+		auto testPoints = [&](const CCVector3* points, const unsigned* indexes, unsigned firstIndex, unsigned count)
 		{
-			//we shouldn't test points that are actually hidden!
-			if (	(!visTable || visTable->at(i) == POINT_VISIBLE)
-				&&	(!activeSF || activeSF->getColor(activeSF->getValue(i)))
-				)
+			ComputePickingDistances(points, count, planes, distances.data());
+
+			for (unsigned j = 0; j < count; ++j)
 			{
-				const CCVector3* P = getPoint(i);
+				if (!(distances[j] <= 0))
+				{
+					continue;
+				}
 
-				CCVector3d Q2D;
-				bool insideFrustum = false;
-				if (noGLTrans)
+				unsigned pointIndex = (indexes ? indexes[j] : firstIndex + j);
+
+				//we shouldn't test points that are actually hidden!
+				if (	(visTable && visTable->at(pointIndex) != POINT_VISIBLE)
+					||	(activeSF && !activeSF->getColor(activeSF->getValue(pointIndex)))
+					)
 				{
-					camera.project(*P, Q2D, &insideFrustum);
+					continue;
 				}
-				else
+
+				const CCVector3& P = points[j];
+				PointPickingCandidate candidate;
+				candidate.pointIndex = pointIndex;
+				candidate.squareDist = CCVector3d(X.x - P.x, X.y - P.y, X.z - P.z).norm2d();
+				InsertPickingCandidate(threadCandidates, k, candidate);
+			}
+		};
+
+#if defined(_OPENMP)
+#pragma omp for schedule(dynamic)
+#endif
+		for (int i = 0; i < cellCount; ++i)
+		{
+			if (lodCodes)
+			{
+				//LOD cell
+				const LODLevelDesc& cell = lodCells[i];
+				for (unsigned blockStart = 0; blockStart < cell.count; blockStart += static_cast<unsigned>(ccChunk::SIZE))
 				{
-					CCVector3 P3D = *P;
-					trans.apply(P3D);
-					camera.project(P3D, Q2D, &insideFrustum);
+					unsigned count = std::min(static_cast<unsigned>(ccChunk::SIZE), cell.count - blockStart);
+					gatheredPoints.resize(count);
+					gatheredIndexes.resize(count);
+					for (unsigned j = 0; j < count; ++j)
+					{
+						unsigned pointIndex = (*lodCodes)[cell.startIndex + blockStart + j].theIndex;
+						gatheredIndexes[j] = pointIndex;
+						gatheredPoints[j] = *getPoint(pointIndex);
+					}
+					testPoints(gatheredPoints.data(), gatheredIndexes.data(), 0, count);
 				}
+				continue;
+			}
 
-				if (!insideFrustum)
+			//can we discard the whole chunk?
+			if (static_cast<size_t>(i) < chunkBBoxes.size() && chunkBBoxes[i].isValid())
+			{
+				const CCVector3& bbMin = chunkBBoxes[i].minCorner();
+				const CCVector3& bbMax = chunkBBoxes[i].maxCorner();
+				bool outside = false;
+				for (unsigned p = 0; p < PICKING_PLANE_COUNT && !outside; ++p)
+				{
+					const float* plane = planes[p];
+					//nearest corner of the box relatively to the plane
+					float minDist = plane[3]
+						+ plane[0] * (plane[0] > 0 ? bbMin.x : bbMax.x)
+						+ plane[1] * (plane[1] > 0 ? bbMin.y : bbMax.y)
+						+ plane[2] * (plane[2] > 0 ? bbMin.z : bbMax.z);
+					outside = (minDist > 0);
+				}
+				if (outside)
 				{
-					// Point is not inside the frustum
-#ifdef USE_TBB
-					return;
-#else
 					continue;
-#endif
 				}
+			}
 
-				if (	fabs(Q2D.x - clickPos.x) <= pickWidth
-					&&	fabs(Q2D.y - clickPos.y) <= pickHeight)
+			unsigned start = static_cast<unsigned>(ccChunk::StartPos(i));
+			unsigned count = static_cast<unsigned>(ccChunk::Size(i, pointCount));
+			if (cloudPoints)
+			{
+				testPoints(cloudPoints + start, nullptr, start, count);
+			}
+			else
+			{
+				gatheredPoints.resize(count);
+				for (unsigned j = 0; j < count; ++j)
 				{
-					const double squareDist = CCVector3d(X.x - P->x, X.y - P->y, X.z - P->z).norm2d();
-					if (nearestPointIndex < 0 || squareDist < nearestSquareDist)
-					{
-						nearestSquareDist = squareDist;
-						nearestPointIndex = i;
-					}
+					gatheredPoints[j] = *getPoint(start + j);
 				}
+				testPoints(gatheredPoints.data(), nullptr, start, count);
 			}
 		}
-#ifdef USE_TBB
-		);
+
+		//merge the per-thread candidates
+#if defined(_OPENMP)
+#pragma omp critical
 #endif
+		{
+			for (const PointPickingCandidate& candidate : threadCandidates)
+			{
+				InsertPickingCandidate(candidates, k, candidate);
+			}
+		}
 	}
-	
-	return (nearestPointIndex >= 0);
+
+	return !candidates.empty();
 }
 
 CCLib::ReferenceCloud* ccGenericPointCloud::getTheVisiblePoints(const VisibilityTableType* visTable/*=nullptr*/, bool silent/*=false*/) const
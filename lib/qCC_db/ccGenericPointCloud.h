@@ -171,7 +171,9 @@ public:
 	using VisibilityTableType = std::vector<unsigned char>;
 	
 	//! Returns associated visiblity array
-	virtual inline VisibilityTableType& getTheVisibilityArray() { return m_pointsVisibility; }
+	/** \warning Discards the per-chunk visibility summary (see setChunkVisibility)
+	**/
+	virtual inline VisibilityTableType& getTheVisibilityArray() { m_chunkVisibility.clear(); return m_pointsVisibility; }
 
 	//! Returns associated visiblity array (const version)
 	virtual inline const VisibilityTableType& getTheVisibilityArray() const { return m_pointsVisibility; }
@@ -197,6 +199,28 @@ public:
 	//! Erases the points visibility information
 	virtual void unallocateVisibilityArray();
 
+	//! Per-chunk visibility state (see ccChunk)
+	enum ChunkVisibility : unsigned char
+	{
+		CHUNK_MIXED = 0,		//!< visible and hidden points (or unknown)
+		CHUNK_ALL_VISIBLE = 1,	//!< all the points of the chunk are visible
+		CHUNK_ALL_HIDDEN = 2,	//!< none of the points of the chunk is visible
+	};
+
+	//! Sets the per-chunk summary of the visibility array
+	/** Optional: lets the display skip the chunks without any visible point.
+		Must be consistent with the current visibility array (one ChunkVisibility
+		value per chunk). It is discarded as soon as the visibility array is reset,
+		released or accessed for modification (see getTheVisibilityArray).
+	**/
+	inline void setChunkVisibility(std::vector<unsigned char>&& chunkVisibility) { m_chunkVisibility = std::move(chunkVisibility); }
+
+	//! Returns the per-chunk summary of the visibility array (empty if not available)
+	inline const std::vector<unsigned char>& getChunkVisibility() const { return m_chunkVisibility; }
+
+	//! Returns the (cached) bounding-box of each chunk of points (see ccChunk)
+	const std::vector<ccBBox>& getChunkBBoxes();
+
 
 	/***************************************************
 					Other methods
@@ -267,7 +291,38 @@ public:
 						double pickHeight = 2.0,
 						bool autoComputeOctree = false);
 
+	//! Point picking candidate
+	struct PointPickingCandidate
+	{
+		unsigned pointIndex;	//!< point index
+		double squareDist;		//!< square distance to the (unprojected) clicked position
+	};
+
+	//! Brute force point picking returning the k nearest candidates
+	/** If the LOD structure of the cloud is available, only the points of the LOD cells
+		whose bounding sphere intersects the picking frustum are tested. Otherwise points
+		are tested chunk by chunk (see ccChunk) and the chunks whose bounding box lies
+		outside of the picking frustum are discarded without testing their points.
+		\param clickPos clicked position (in pixels)
+		\param camera camera parameters
+		\param candidates the k nearest candidates (sorted by increasing distance)
+		\param k max number of candidates
+		\param pickWidth picking window half width (in pixels)
+		\param pickHeight picking window half height (in pixels)
+		\return whether at least one candidate was found
+	**/
+	bool pointPicking(	const CCVector2d& clickPos,
+						const ccGLCameraParameters& camera,
+						std::vector<PointPickingCandidate>& candidates,
+						unsigned k,
+						double pickWidth = 2.0,
+						double pickHeight = 2.0);
+
 protected:
+
+	//! Invalidates the cached chunk bounding-boxes
+	inline void invalidateChunkBBoxes() { m_chunkBBoxes.clear(); }
+
 	//inherited from ccHObject
 	bool toFile_MeOnly(QFile& out) const override;
 	bool fromFile_MeOnly(QFile& in, short dataVersion, int flags, LoadedIDMap& oldToNewIDMap) override;
@@ -278,9 +333,17 @@ protected:
 	**/
 	VisibilityTableType m_pointsVisibility;
 
+	//! Per-chunk visibility summary (see setChunkVisibility)
+	std::vector<unsigned char> m_chunkVisibility;
+
 	//! Point size (won't be applied if 0)
 	unsigned char m_pointSize;
 
+	//! Cached chunk bounding-boxes (see getChunkBBoxes)
+	std::vector<ccBBox> m_chunkBBoxes;
+	//! Number of points when the chunk bounding-boxes were computed
+	unsigned m_chunkBBoxesPointCount;
+
 };
 
 #endif //CC_GENERIC_POINT_CLOUD_HEADER
@@ -46,12 +46,89 @@
 //Qt
 #include <QIcon>
 
+//system
+#include <atomic>
+#include <unordered_map>
+
+//! Unique ID index (see ccHObject::find)
+struct ccHObject::UniqueIDIndex
+{
+	//! Entities of the hierarchy (by unique ID)
+	std::unordered_map<unsigned, ccHObject*> entities;
+	//! Hierarchies revision at the last update (see s_hierarchiesRevision)
+	unsigned revision = 0;
+	//! Whether all the entities of the hierarchy are indexed
+	/** An entity may still be part of the hierarchy after being removed
+		from one of its parents (i.e. if it has several parents).
+	**/
+	bool complete = true;
+};
+
+//! Hierarchies revision
+/** Incremented each time the children of any entity change. An index that
+	missed a revision (e.g. an entity shared by several hierarchies has been
+	modified) is rebuilt the next time it is used.
+**/
+static std::atomic<unsigned> s_hierarchiesRevision(0);
+//! Number of unique ID indexes
+static std::atomic<int> s_uniqueIDIndexCount(0);
+
+//! Adds an entity and all its children (recursively) to a unique ID index
+static void AddToUniqueIDIndex(std::unordered_map<unsigned, ccHObject*>& entities, const ccHObject* object)
+{
+	//DGM: the first occurrence is kept, as with a linear search
+	entities.emplace(object->getUniqueID(), const_cast<ccHObject*>(object));
+
+	for (unsigned i = 0; i < object->getChildrenNumber(); ++i)
+	{
+		AddToUniqueIDIndex(entities, object->getChild(i));
+	}
+}
+
+//! Removes an entity and all its children (recursively) from a unique ID index
+static void RemoveFromUniqueIDIndex(std::unordered_map<unsigned, ccHObject*>& entities, const ccHObject* object)
+{
+	std::unordered_map<unsigned, ccHObject*>::iterator it = entities.find(object->getUniqueID());
+	if (it != entities.end() && it->second == object)
+	{
+		entities.erase(it);
+	}
+
+	for (unsigned i = 0; i < object->getChildrenNumber(); ++i)
+	{
+		RemoveFromUniqueIDIndex(entities, object->getChild(i));
+	}
+}
+
+//! Linear (recursive) search of an entity by its unique ID
+static ccHObject* FindRecursive(const ccHObject* object, unsigned uniqueID)
+{
+	//found the right item?
+	if (object->getUniqueID() == uniqueID)
+	{
+		return const_cast<ccHObject *>(object);
+	}
+	
+	//otherwise we are going to test all children recursively
+	for (unsigned i = 0; i < object->getChildrenNumber(); ++i)
+	{
+		ccHObject* match = FindRecursive(object->getChild(i), uniqueID);
+		if (match)
+		{
+			return match;
+		}
+	}
+
+	return nullptr;
+}
+
 ccHObject::ccHObject(const QString& name, unsigned uniqueID/*=ccUniqueIDGenerator::InvalidUniqueID*/)
 	: ccObject(name, uniqueID)
 	, ccDrawableObject()
 	, m_parent(nullptr)
 	, m_selectionBehavior(SELECTION_AA_BBOX)
 	, m_isDeleting(false)
+	, m_uniqueIDIndex(nullptr)
 {
 	setVisible(false);
 	lockVisibility(true);
@@ -65,6 +142,7 @@ ccHObject::ccHObject(const ccHObject& object)
 	, m_parent(nullptr)
 	, m_selectionBehavior(object.m_selectionBehavior)
 	, m_isDeleting(false)
+	, m_uniqueIDIndex(nullptr)
 {
 	m_glTransHistory.toIdentity();
 }
@@ -97,6 +175,65 @@ ccHObject::~ccHObject()
 	m_dependencies.clear();
 
 	removeAllChildren();
+
+	if (m_uniqueIDIndex)
+	{
+		delete m_uniqueIDIndex;
+		m_uniqueIDIndex = nullptr;
+		--s_uniqueIDIndexCount;
+	}
+}
+
+void ccHObject::setUniqueID(unsigned ID)
+{
+	ccObject::setUniqueID(ID);
+
+	//all the unique ID indexes are outdated
+	++s_hierarchiesRevision;
+}
+
+void ccHObject::updateUniqueIDIndex(const ccHObject* child, bool added)
+{
+	assert(child);
+	unsigned revision = s_hierarchiesRevision++;
+
+	if (s_uniqueIDIndexCount == 0)
+	{
+		//no index at all
+		return;
+	}
+
+	//only the top-level entities have an index
+	ccHObject* topLevelObject = this;
+	while (topLevelObject->getParent())
+	{
+		topLevelObject = topLevelObject->getParent();
+	}
+
+	UniqueIDIndex* index = topLevelObject->m_uniqueIDIndex;
+	if (!index || index->revision != revision || topLevelObject->m_isDeleting)
+	{
+		//no index or already outdated index (will be rebuilt if necessary)
+		return;
+	}
+
+	try
+	{
+		if (added)
+		{
+			AddToUniqueIDIndex(index->entities, child);
+		}
+		else
+		{
+			RemoveFromUniqueIDIndex(index->entities, child);
+			index->complete = false;
+		}
+		index->revision = revision + 1;
+	}
+	catch (const std::bad_alloc&)
+	{
+		//not enough memory: the index is left outdated
+	}
 }
 
 void ccHObject::notifyGeometryUpdate()
@@ -316,6 +453,7 @@ void ccHObject::onDeletionOf(const ccHObject* obj)
 	{
 		//we can't swap children as we want to keep the order!
 		m_children.erase(m_children.begin() + pos);
+		updateUniqueIDIndex(obj, false);
 	}
 }
 
@@ -370,6 +508,8 @@ bool ccHObject::addChild(ccHObject* child, int dependencyFlags/*=DP_PARENT_OF_OT
 			child->setDisplay(getDisplay());
 	}
 
+	updateUniqueIDIndex(child, true);
+
 	return true;
 }
 
@@ -387,23 +527,51 @@ unsigned int ccHObject::getChildCountRecursive() const
 
 ccHObject* ccHObject::find(unsigned uniqueID) const
 {
-	//found the right item?
-	if (getUniqueID() == uniqueID)
-	{
-		return const_cast<ccHObject *>(this);
-	}
-	
-	//otherwise we are going to test all children recursively
-	for (unsigned i=0; i<getChildrenNumber(); ++i)
+	//top-level entities use an index of their whole hierarchy
+	if (!m_parent)
 	{
-		ccHObject* match = getChild(i)->find(uniqueID);
-		if (match)
+		try
 		{
-			return match;
+			if (!m_uniqueIDIndex)
+			{
+				m_uniqueIDIndex = new UniqueIDIndex;
+				m_uniqueIDIndex->revision = s_hierarchiesRevision + 1; //to force the first build
+				++s_uniqueIDIndexCount;
+			}
+
+			for (int attempt = 0; attempt < 2; ++attempt)
+			{
+				unsigned revision = s_hierarchiesRevision;
+				if (m_uniqueIDIndex->revision != revision || (attempt != 0 && !m_uniqueIDIndex->complete))
+				{
+					//(re)build the index
+					m_uniqueIDIndex->entities.clear();
+					AddToUniqueIDIndex(m_uniqueIDIndex->entities, this);
+					m_uniqueIDIndex->revision = revision;
+					m_uniqueIDIndex->complete = true;
+				}
+
+				std::unordered_map<unsigned, ccHObject*>::const_iterator it = m_uniqueIDIndex->entities.find(uniqueID);
+				if (it != m_uniqueIDIndex->entities.end())
+				{
+					return it->second;
+				}
+				if (m_uniqueIDIndex->complete)
+				{
+					return nullptr;
+				}
+			}
+		}
+		catch (const std::bad_alloc&)
+		{
+			//not enough memory: we fall back to the linear search
+			delete m_uniqueIDIndex;
+			m_uniqueIDIndex = nullptr;
+			--s_uniqueIDIndexCount;
 		}
 	}
 
-	return nullptr;
+	return FindRecursive(this, uniqueID);
 }
 
 unsigned ccHObject::filterChildren(	Container& filteredChildren,
@@ -473,6 +641,7 @@ void ccHObject::transferChildren(ccHObject& newParent, bool forceFatherDependent
 		//we must explicitely remove any dependency with the child as we don't call 'detachChild'
 		removeDependencyWith(child);
 		child->removeDependencyWith(this);
+		updateUniqueIDIndex(child, false);
 
 		newParent.addChild(child,fatherDependencyFlags);
 		child->addDependency(&newParent,childDependencyFlags);
@@ -855,6 +1024,7 @@ void ccHObject::detachChild(ccHObject* child)
 	{
 		//we can't swap children as we want to keep the order!
 		m_children.erase(m_children.begin()+pos);
+		updateUniqueIDIndex(child, false);
 	}
 }
 
@@ -870,6 +1040,8 @@ void ccHObject::detatchAllChildren()
 		{
 			child->setParent(nullptr);
 		}
+
+		updateUniqueIDIndex(child, false);
 	}
 	m_children.clear();
 }
@@ -897,6 +1069,7 @@ void ccHObject::removeChild(int pos)
 	//(DGM: do this BEFORE deleting the object (otherwise
 	//the dependency mechanism can 'backfire' ;)
 	m_children.erase(m_children.begin() + pos);
+	updateUniqueIDIndex(child, false);
 
 	//backup dependency flags
 	int flags = getDependencyFlagsWith(child);
@@ -925,6 +1098,7 @@ void ccHObject::removeAllChildren()
 	{
 		ccHObject* child = m_children.back();
 		m_children.pop_back();
+		updateUniqueIDIndex(child, false);
 
 		int flags = getDependencyFlagsWith(child);
 		if ((flags & DP_DELETE_OTHER) == DP_DELETE_OTHER)
@@ -934,6 +1108,10 @@ void ccHObject::removeAllChildren()
 			else
 				delete child;
 		}
+		else if (child->getParent() == this)
+		{
+			child->setParent(nullptr);
+		}
 	}
 }
 
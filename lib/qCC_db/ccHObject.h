@@ -142,7 +142,12 @@ public: //children management
 	inline ccHObject* getChild(unsigned childPos) const { return (childPos < getChildrenNumber() ? m_children[childPos] : nullptr); }
 
 	//! Finds an entity in this object hierarchy
-	/** \param uniqueID child unique ID
+	/** Top-level entities (i.e. without parent) use an index of their whole
+		hierarchy (built on the first call, then kept in sync by addChild,
+		detachChild, removeChild, etc.) so that the lookup is done in constant
+		time. The other entities perform a (recursive) linear search.
+		\warning The index is lazily built: not thread-safe.
+		\param uniqueID child unique ID
 		\return child (or nullptr if not found)
 	**/
 	ccHObject* find(unsigned uniqueID) const;
@@ -386,6 +391,9 @@ public: //display
 	//! Returns object unqiue ID used for display
 	virtual inline unsigned getUniqueIDForDisplay() const { return getUniqueID(); }
 
+	//inherited from ccObject
+	void setUniqueID(unsigned ID) override;
+
 	//! Returns the transformation 'history' matrix
 	virtual inline const ccGLMatrix& getGLTransformationHistory() const { return m_glTransHistory; }
 	//! Sets the transformation 'history' matrix (handle with care!)
@@ -437,6 +445,15 @@ protected:
 	**/
 	virtual void onUpdateOf(ccHObject* obj) { /*does nothing by default*/ }
 
+	//! Unique ID index (see find)
+	struct UniqueIDIndex;
+
+	//! Updates the unique ID index of the top-level entity (if any) after a change of the children
+	/** \param child child (and its own hierarchy) that has been added or removed
+		\param added whether the child has been added or removed
+	**/
+	void updateUniqueIDIndex(const ccHObject* child, bool added);
+
 	//! Parent
 	ccHObject* m_parent;
 
@@ -460,6 +477,9 @@ protected:
 
 	//! Flag to safely handle dependencies when the object is being deleted
 	bool m_isDeleting;
+
+	//! Unique ID index (top-level entities only, see find)
+	mutable UniqueIDIndex* m_uniqueIDIndex;
 };
 
 /*** Helpers ***/
@@ -156,13 +156,13 @@ void ccKdTree::drawMeOnly(CC_DRAW_CONTEXT& context)
 		//not fast at all!
 		if (MACRO_DrawFastNamesOnly(context))
 			return;
-		glFunc->glPushName(getUniqueIDForDisplay());
+		context.pushName(getUniqueIDForDisplay());
 	}
 
 	DrawMeOnlyVisitor(m_associatedGenericCloud->getOwnBB()).visit(context, m_root);
 
 	if (pushName)
-		glFunc->glPopName();
+		context.popName();
 }
 
 bool ccKdTree::convertCellIndexToSF()
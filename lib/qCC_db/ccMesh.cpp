@@ -44,10 +44,127 @@
 //System
 #include <string.h>
 #include <assert.h>
+#include <algorithm>
 #include <cmath> //for std::modf
+#include <limits>
 
 static CCVector3 s_blankNorm(0, 0, 0);
 
+//! Computes the vertex/triangles adjacency of a mesh
+/** CSR layout: the triangles incident to vertex i are vertTris[vertTriStart[i]..vertTriStart[i+1]]
+	(in ascending order).
+**/
+static bool ComputeVertexTriangleAdjacency(	const ccMesh& mesh,
+											unsigned vertCount,
+											std::vector<unsigned>& vertTriStart,
+											std::vector<unsigned>& vertTris)
+{
+	unsigned faceCount = mesh.size();
+	try
+	{
+		vertTriStart.clear();
+		vertTriStart.resize(static_cast<std::size_t>(vertCount) + 1, 0);
+		vertTris.resize(static_cast<std::size_t>(faceCount) * 3);
+	}
+	catch (const std::bad_alloc&)
+	{
+		//not enough memory
+		return false;
+	}
+
+	//compute the number of triangles to which belong each vertex
+	for (unsigned j = 0; j < faceCount; j++)
+	{
+		const CCLib::VerticesIndexes* tri = mesh.getTriangleVertIndexes(j);
+		assert(tri->i1 < vertCount && tri->i2 < vertCount && tri->i3 < vertCount);
+		++vertTriStart[tri->i1];
+		++vertTriStart[tri->i2];
+		++vertTriStart[tri->i3];
+	}
+	//inclusive prefix sum: vertTriStart[i] is the end of the range of vertex i for now
+	for (unsigned i = 1; i < vertCount; i++)
+	{
+		vertTriStart[i] += vertTriStart[i - 1];
+	}
+	vertTriStart[vertCount] = 3 * faceCount;
+
+	//we fill the ranges backwards so that 'vertTriStart[i]' ends up at the start of the range of vertex i
+	for (unsigned j = faceCount; j-- > 0; )
+	{
+		const CCLib::VerticesIndexes* tri = mesh.getTriangleVertIndexes(j);
+		vertTris[--vertTriStart[tri->i1]] = j;
+		vertTris[--vertTriStart[tri->i2]] = j;
+		vertTris[--vertTriStart[tri->i3]] = j;
+	}
+
+	return true;
+}
+
+//! Computes the (normalized) normal of each vertex of a mesh based on its vertex/triangles adjacency
+/** Each vertex gathers the normals of its incident triangles (no write conflict).
+	\param angleWeighted whether the triangle normals are weighted by the angle at the vertex (or by the triangle area)
+**/
+static void ComputeVertexNormals(	const ccMesh& mesh,
+									const ccGenericPointCloud& vertices,
+									const std::vector<unsigned>& vertTriStart,
+									const std::vector<unsigned>& vertTris,
+									bool angleWeighted,
+									std::vector<CCVector3>& normals)
+{
+	const unsigned vertCount = vertices.size();
+	assert(normals.size() == vertCount && vertTriStart.size() == static_cast<std::size_t>(vertCount) + 1);
+
+#if defined(_OPENMP)
+	#pragma omp parallel for
+#endif
+	for (int i = 0; i < static_cast<int>(vertCount); ++i)
+	{
+		const unsigned vertIndex = static_cast<unsigned>(i);
+		const CCVector3& P = *vertices.getPoint(vertIndex);
+
+		CCVector3 N(0, 0, 0);
+		for (unsigned t = vertTriStart[i]; t < vertTriStart[i + 1]; ++t)
+		{
+			const CCLib::VerticesIndexes* tri = mesh.getTriangleVertIndexes(vertTris[t]);
+			//other vertices (j, k) in the triangle order
+			unsigned j = tri->i2;
+			unsigned k = tri->i3;
+			if (tri->i2 == vertIndex)
+			{
+				j = tri->i3;
+				k = tri->i1;
+			}
+			else if (tri->i3 == vertIndex)
+			{
+				j = tri->i1;
+				k = tri->i2;
+			}
+
+			CCVector3 u = *vertices.getPoint(j) - P;
+			CCVector3 v = *vertices.getPoint(k) - P;
+			//face normal (right hand rule)
+			CCVector3 faceN = u.cross(v);
+			if (angleWeighted)
+			{
+				PointCoordinateType doubleArea = faceN.norm();
+				if (doubleArea > std::numeric_limits<PointCoordinateType>::epsilon())
+				{
+					PointCoordinateType angle = std::atan2(doubleArea, u.dot(v));
+					N += faceN * (angle / doubleArea);
+				}
+			}
+			else
+			{
+				N += faceN; //no normalization = weighting by surface!
+			}
+		}
+
+		//normalize the 'mean' normal
+		N.normalize();
+		normals[i] = N;
+	}
+}
+
 ccMesh::ccMesh(ccGenericPointCloud* vertices, unsigned uniqueID/*=ccUniqueIDGenerator::InvalidUniqueID*/)
 	: ccGenericMesh("Mesh", uniqueID)
 	, m_associatedCloud(nullptr)
@@ -170,12 +287,12 @@ bool ccMesh::hasScalarFields() const
 	return (m_associatedCloud ? m_associatedCloud->hasScalarFields() : false);
 }
 
-bool ccMesh::computeNormals(bool perVertex)
+bool ccMesh::computeNormals(bool perVertex, bool angleWeighted/*=false*/)
 {
-	return perVertex ? computePerVertexNormals() : computePerTriangleNormals();
+	return perVertex ? computePerVertexNormals(angleWeighted) : computePerTriangleNormals();
 }
 
-bool ccMesh::computePerVertexNormals()
+bool ccMesh::computePerVertexNormals(bool angleWeighted/*=false*/)
 {
 	if (!m_associatedCloud || !m_associatedCloud->isA(CC_TYPES::POINT_CLOUD)) //TODO
 	{
@@ -200,6 +317,9 @@ bool ccMesh::computePerVertexNormals()
 
 	//we instantiate a temporary structure to store each vertex normal (uncompressed)
 	std::vector<CCVector3> theNorms;
+	//and the vertex/triangles adjacency
+	std::vector<unsigned> vertTriStart;
+	std::vector<unsigned> vertTris;
 	try
 	{
 		theNorms.resize(vertCount, s_blankNorm);
@@ -209,6 +329,11 @@ bool ccMesh::computePerVertexNormals()
 		ccLog::Warning("[ccMesh::computePerVertexNormals] Not enough memory!");
 		return false;
 	}
+	if (!ComputeVertexTriangleAdjacency(*this, vertCount, vertTriStart, vertTris))
+	{
+		ccLog::Warning("[ccMesh::computePerVertexNormals] Not enough memory!");
+		return false;
+	}
 
 	//allocate compressed normals array on vertices cloud
 	bool normalsWereAllocated = cloud->hasNormals();
@@ -218,39 +343,12 @@ bool ccMesh::computePerVertexNormals()
 		return false;
 	}
 
-	//for each triangle
-	placeIteratorAtBeginning();
-	{
-		for (unsigned i = 0; i < triCount; ++i)
-		{
-			CCLib::VerticesIndexes* tsi = getNextTriangleVertIndexes();
-
-			assert(tsi->i1 < vertCount && tsi->i2 < vertCount && tsi->i3 < vertCount);
-			const CCVector3 *A = cloud->getPoint(tsi->i1);
-			const CCVector3 *B = cloud->getPoint(tsi->i2);
-			const CCVector3 *C = cloud->getPoint(tsi->i3);
-
-			//compute face normal (right hand rule)
-			CCVector3 N = (*B-*A).cross(*C-*A);
-			//N.normalize(); //DGM: no normalization = weighting by surface!
-
-			//we add this normal to all triangle vertices
-			theNorms[tsi->i1] += N;
-			theNorms[tsi->i2] += N;
-			theNorms[tsi->i3] += N;
-		}
-	}
-
 	//for each vertex
-	{
-		for (unsigned i = 0; i < vertCount; i++)
-		{
-			CCVector3& N = theNorms[i];
-			//normalize the 'mean' normal
-			N.normalize();
-			cloud->setPointNormal(i, N);
-		}
-	}
+	ComputeVertexNormals(*this, *cloud, vertTriStart, vertTris, angleWeighted, theNorms);
+
+	//compress all the normals at once
+	ccNormalVectors::GetNormIndexes(theNorms.data(), vertCount, cloud->normals()->data());
+	cloud->normalsHaveChanged();
 
 	//apply it also to sub-meshes!
 	showNormals_extended(true);
@@ -276,7 +374,7 @@ bool ccMesh::computePerTriangleNormals()
 	setTriNormsTable(nullptr);
 
 	NormsIndexesTableType* normIndexes = new NormsIndexesTableType();
-	if (!normIndexes->reserveSafe(triCount))
+	if (!normIndexes->resizeSafe(triCount))
 	{
 		normIndexes->release();
 		ccLog::Warning("[ccMesh::computePerTriangleNormals] Not enough memory!");
@@ -284,25 +382,25 @@ bool ccMesh::computePerTriangleNormals()
 	}
 
 	//for each triangle
+#if defined(_OPENMP)
+	#pragma omp parallel for
+#endif
+	for (int i = 0; i < static_cast<int>(triCount); ++i)
 	{
-		for (unsigned i = 0; i < triCount; ++i)
-		{
-			const CCLib::VerticesIndexes& tri = m_triVertIndexes->getValue(i);
-			const CCVector3* A = m_associatedCloud->getPoint(tri.i1);
-			const CCVector3* B = m_associatedCloud->getPoint(tri.i2);
-			const CCVector3* C = m_associatedCloud->getPoint(tri.i3);
+		const CCLib::VerticesIndexes& tri = m_triVertIndexes->getValue(i);
+		const CCVector3* A = m_associatedCloud->getPoint(tri.i1);
+		const CCVector3* B = m_associatedCloud->getPoint(tri.i2);
+		const CCVector3* C = m_associatedCloud->getPoint(tri.i3);
 
-			//compute face normal (right hand rule)
-			CCVector3 N = (*B-*A).cross(*C-*A);
+		//compute face normal (right hand rule)
+		CCVector3 N = (*B-*A).cross(*C-*A);
 
-			CompressedNormType nIndex = ccNormalVectors::GetNormIndex(N.u);
-			normIndexes->emplace_back(nIndex);
-		}
+		normIndexes->setValue(i, ccNormalVectors::GetNormIndex(N.u));
 	}
 
 	//set the per-triangle normal indexes
 	{
-		if (!reservePerTriangleNormalIndexes())
+		if (!reservePerTriangleNormalIndexes() || !m_triNormalIndexes->resizeSafe(triCount))
 		{
 			normIndexes->release();
 			ccLog::Warning("[ccMesh::computePerTriangleNormals] Not enough memory!");
@@ -311,8 +409,11 @@ bool ccMesh::computePerTriangleNormals()
 
 		setTriNormsTable(normIndexes);
 
+#if defined(_OPENMP)
+		#pragma omp parallel for
+#endif
 		for (int i = 0; i < static_cast<int>(triCount); ++i)
-			addTriangleNormalIndexes(i, i, i);
+			setTriangleNormalIndexes(i, i, i, i);
 	}
 
 	//apply it also to sub-meshes!
@@ -540,9 +641,82 @@ void ccMesh::transformTriNormals(const ccGLMatrix& trans)
 	}
 }
 
+//! Pass-band frequency of the Taubin smoothing
+static const PointCoordinateType s_taubinPassBand = static_cast<PointCoordinateType>(0.1);
+
+//! Computes the Laplacian of a vertex (weighted mean of its neighbours, relative to the vertex)
+/** \param vertIndex vertex index
+	\param triBegin first incident triangle (in the vertex/triangles adjacency)
+	\param triEnd end of the incident triangles
+**/
+static CCVector3 ComputeVertexLaplacian(const ccMesh& mesh,
+										const ccGenericPointCloud& vertices,
+										unsigned vertIndex,
+										const unsigned* triBegin,
+										const unsigned* triEnd,
+										bool cotangentWeights)
+{
+	const CCVector3& P = *vertices.getPoint(vertIndex);
+
+	//uniform weights: each incident triangle contributes its 2 other vertices (as before)
+	CCVector3d uniformSum(0, 0, 0);
+	CCVector3d weightedSum(0, 0, 0);
+	double weightSum = 0.0;
+	for (const unsigned* t = triBegin; t != triEnd; ++t)
+	{
+		const CCLib::VerticesIndexes* tri = mesh.getTriangleVertIndexes(*t);
+		//other vertices (j, k) in the triangle order
+		unsigned j = tri->i2;
+		unsigned k = tri->i3;
+		if (tri->i2 == vertIndex)
+		{
+			j = tri->i3;
+			k = tri->i1;
+		}
+		else if (tri->i3 == vertIndex)
+		{
+			j = tri->i1;
+			k = tri->i2;
+		}
+
+		const CCVector3& Pj = *vertices.getPoint(j);
+		const CCVector3& Pk = *vertices.getPoint(k);
+		CCVector3 dPj = Pj - P;
+		CCVector3 dPk = Pk - P;
+		uniformSum += CCVector3d::fromArray((dPj + dPk).u);
+
+		if (cotangentWeights)
+		{
+			//cotangent of the angles opposite to the edges (P,Pj) and (P,Pk)
+			CCVector3 kP = P - Pk;
+			CCVector3 kj = Pj - Pk;
+			CCVector3 jP = P - Pj;
+			CCVector3 jk = Pk - Pj;
+			double doubleArea = dPj.cross(dPk).normd();
+			if (doubleArea > std::numeric_limits<double>::epsilon())
+			{
+				//negative weights (obtuse angles) would make the process unstable
+				double cotK = std::max(0.0, static_cast<double>(kP.dot(kj)) / doubleArea);
+				double cotJ = std::max(0.0, static_cast<double>(jP.dot(jk)) / doubleArea);
+				weightedSum += CCVector3d::fromArray(dPj.u) * cotK + CCVector3d::fromArray(dPk.u) * cotJ;
+				weightSum += cotK + cotJ;
+			}
+		}
+	}
+
+	if (cotangentWeights && weightSum > std::numeric_limits<double>::epsilon())
+	{
+		return CCVector3::fromArray((weightedSum / weightSum).u);
+	}
+
+	std::size_t count = static_cast<std::size_t>(triEnd - triBegin);
+	return (count ? CCVector3::fromArray((uniformSum / (2.0 * count)).u) : CCVector3(0, 0, 0));
+}
+
 bool ccMesh::laplacianSmooth(	unsigned nbIteration,
 								PointCoordinateType factor,
-								ccProgressDialog* progressCb/*=0*/)
+								ccProgressDialog* progressCb/*=0*/,
+								LAPLACIAN_SMOOTHING_MODE mode/*=LAPLACIAN_UNIFORM*/)
 {
 	if (!m_associatedCloud)
 		return false;
@@ -554,22 +728,19 @@ bool ccMesh::laplacianSmooth(	unsigned nbIteration,
 	if (!vertCount || !faceCount)
 		return false;
 
-	std::vector<CCVector3> verticesDisplacement;
-	try
-	{
-		verticesDisplacement.resize(vertCount);
-	}
-	catch (const std::bad_alloc&)
+	//vertex/triangles adjacency (computed once)
+	std::vector<unsigned> vertTriStart;
+	std::vector<unsigned> vertTris;
+	if (!ComputeVertexTriangleAdjacency(*this, vertCount, vertTriStart, vertTris))
 	{
 		//not enough memory
 		return false;
 	}
 
-	//compute the number of edges to which belong each vertex
-	std::vector<unsigned> edgesCount;
+	std::vector<CCVector3> verticesDisplacement;
 	try
 	{
-		edgesCount.resize(vertCount, 0);
+		verticesDisplacement.resize(vertCount);
 	}
 	catch (const std::bad_alloc&)
 	{
@@ -577,15 +748,6 @@ bool ccMesh::laplacianSmooth(	unsigned nbIteration,
 		return false;
 	}
 
-	placeIteratorAtBeginning();
-	for(unsigned j=0; j<faceCount; j++)
-	{
-		const CCLib::VerticesIndexes* tri = getNextTriangleVertIndexes();
-		edgesCount[tri->i1] += 2;
-		edgesCount[tri->i2] += 2;
-		edgesCount[tri->i3] += 2;
-	}
-
 	//progress dialog
 	CCLib::NormalizedProgress nProgress(progressCb, nbIteration);
 	if (progressCb)
@@ -595,28 +757,45 @@ bool ccMesh::laplacianSmooth(	unsigned nbIteration,
 		progressCb->start();
 	}
 
+	//Taubin: each iteration is a shrinking step (lambda = factor) followed by an inflating one (mu < -lambda)
+	std::vector<PointCoordinateType> stepFactors(1, factor);
+	if (mode == LAPLACIAN_TAUBIN)
+	{
+		PointCoordinateType denom = s_taubinPassBand * factor - 1;
+		stepFactors.push_back(denom < 0 ? factor / denom : -factor);
+	}
+	const bool cotangentWeights = (mode == LAPLACIAN_COTANGENT);
+	const unsigned* adjacency = vertTris.data();
+
 	//repeat Laplacian smoothing iterations
 	for (unsigned iter = 0; iter < nbIteration; iter++)
 	{
-		std::fill(verticesDisplacement.begin(), verticesDisplacement.end(), CCVector3(0, 0, 0));
-
-		//for each triangle
-		placeIteratorAtBeginning();
-		for (unsigned j = 0; j < faceCount; j++)
+		for (PointCoordinateType stepFactor : stepFactors)
 		{
-			const CCLib::VerticesIndexes* tri = getNextTriangleVertIndexes();
-
-			const CCVector3* A = m_associatedCloud->getPoint(tri->i1);
-			const CCVector3* B = m_associatedCloud->getPoint(tri->i2);
-			const CCVector3* C = m_associatedCloud->getPoint(tri->i3);
-
-			CCVector3 dAB = (*B-*A);
-			CCVector3 dAC = (*C-*A);
-			CCVector3 dBC = (*C-*B);
+			//each vertex gathers its own displacement (no write conflict)
+#if defined(_OPENMP)
+			#pragma omp parallel for
+#endif
+			for (int i = 0; i < static_cast<int>(vertCount); ++i)
+			{
+				verticesDisplacement[i] = ComputeVertexLaplacian(	*this,
+																	*m_associatedCloud,
+																	static_cast<unsigned>(i),
+																	adjacency + vertTriStart[i],
+																	adjacency + vertTriStart[i + 1],
+																	cotangentWeights);
+			}
 
-			verticesDisplacement[tri->i1] += dAB + dAC;
-			verticesDisplacement[tri->i2] += dBC - dAB;
-			verticesDisplacement[tri->i3] -= dAC + dBC;
+			//apply displacement (Jacobi: all the vertices move at once)
+#if defined(_OPENMP)
+			#pragma omp parallel for
+#endif
+			for (int i = 0; i < static_cast<int>(vertCount); ++i)
+			{
+				//this is a "persistent" pointer and we know what type of cloud is behind ;)
+				CCVector3* P = const_cast<CCVector3*>(m_associatedCloud->getPointPersistentPtr(static_cast<unsigned>(i)));
+				(*P) += verticesDisplacement[i] * stepFactor;
+			}
 		}
 
 		if (!nProgress.oneStep())
@@ -624,23 +803,25 @@ bool ccMesh::laplacianSmooth(	unsigned nbIteration,
 			//cancelled by user
 			break;
 		}
-
-		//apply displacement
-		for (unsigned i = 0; i < vertCount; i++)
-		{
-			if (edgesCount[i])
-			{
-				//this is a "persistent" pointer and we know what type of cloud is behind ;)
-				CCVector3* P = const_cast<CCVector3*>(m_associatedCloud->getPointPersistentPtr(i));
-				(*P) += verticesDisplacement[i] * (factor / edgesCount[i]);
-			}
-		}
 	}
 
 	m_associatedCloud->notifyGeometryUpdate();
 
 	if (hasNormals())
-		computeNormals(!hasTriNormals());
+	{
+		if (!hasTriNormals() && m_associatedCloud->isA(CC_TYPES::POINT_CLOUD) && m_associatedCloud->hasNormals())
+		{
+			//we can update the per-vertex normals with the same adjacency (we reuse the displacement buffer)
+			ccPointCloud* cloud = static_cast<ccPointCloud*>(m_associatedCloud);
+			ComputeVertexNormals(*this, *cloud, vertTriStart, vertTris, false, verticesDisplacement);
+			ccNormalVectors::GetNormIndexes(verticesDisplacement.data(), vertCount, cloud->normals()->data());
+			cloud->normalsHaveChanged();
+		}
+		else
+		{
+			computeNormals(!hasTriNormals());
+		}
+	}
 
 	return true;
 }
@@ -1725,7 +1906,7 @@ void ccMesh::drawMeOnly(CC_DRAW_CONTEXT& context)
 			//not fast at all!
 			if (MACRO_DrawFastNamesOnly(context))
 				return;
-			glFunc->glPushName(getUniqueIDForDisplay());
+			context.pushName(getUniqueIDForDisplay());
 			//minimal display for picking mode!
 			glParams.showNorms = false;
 			glParams.showColors = false;
@@ -2156,7 +2337,7 @@ void ccMesh::drawMeOnly(CC_DRAW_CONTEXT& context)
 
 		if (pushName)
 		{
-			glFunc->glPopName();
+			context.popName();
 		}
 	}
 }
@@ -328,24 +328,37 @@ public:
 
 	//! Computes normals
 	/** \param perVertex whether normals should be computed per-vertex or per-triangle
+		\param angleWeighted whether per-vertex normals are weighted by the incident angles (or by the triangles area)
 		\return success
 	**/
-	bool computeNormals(bool perVertex);
+	bool computeNormals(bool perVertex, bool angleWeighted = false);
 
 	//! Computes per-vertex normals
-	bool computePerVertexNormals();
+	/** \param angleWeighted whether the normals of the incident triangles are weighted by their angle at the vertex (or by their area)
+	**/
+	bool computePerVertexNormals(bool angleWeighted = false);
 
 	//! Computes per-triangle normals
 	bool computePerTriangleNormals();
 
+	//! Laplacian smoothing modes
+	enum LAPLACIAN_SMOOTHING_MODE {	LAPLACIAN_UNIFORM,		/**< Uniform weights (mean of the neighbours) **/
+									LAPLACIAN_TAUBIN,		/**< Taubin lambda/mu scheme (uniform weights, no shrinkage) **/
+									LAPLACIAN_COTANGENT,	/**< Cotangent weights **/
+	};
+
 	//! Laplacian smoothing
-	/** \param nbIteration smoothing iterations
+	/** The vertices/triangles adjacency is computed once, then each
+		iteration moves all the vertices at once (multi-threaded).
+		\param nbIteration smoothing iterations
 		\param factor smoothing 'force'
 		\param progressCb progress dialog callback
+		\param mode smoothing mode
 	**/
 	bool laplacianSmooth(	unsigned nbIteration = 100,
 							PointCoordinateType factor = static_cast<PointCoordinateType>(0.01),
-							ccProgressDialog* progressCb = nullptr);
+							ccProgressDialog* progressCb = nullptr,
+							LAPLACIAN_SMOOTHING_MODE mode = LAPLACIAN_UNIFORM);
 
 	//! Mesh scalar field processes
 	enum MESH_SCALAR_FIELD_PROCESS {	SMOOTH_MESH_SF,		/**< Smooth **/
@@ -25,378 +25,351 @@
 #include "ccOctree.h"
 #include "ccPointCloud.h"
 #include "ccProgressDialog.h"
-#include "ccScalarField.h"
 
 //system
-#include <map>
-#include <queue>
-#include <set>
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <limits>
 #include <vector>
 
 namespace 
 {
-	//! Weighted graph edge
-	class Edge
-	{
-	public:
-		
-		//! Unique edge key type
-		using Key = std::pair<unsigned, unsigned>;
-		
-		//! Returns the unique key of an edge (no vertex order)
-		inline static Key ConstructKey(unsigned v1, unsigned v2)
-		{
-			return v1 > v2 ? std::make_pair(v2, v1) : std::make_pair(v1, v2);
-		}
-		
-		//! Default constructor
-		Edge(unsigned v1, unsigned v2, float weight)
-			: m_key(ConstructKey(v1, v2))
-			, m_weight(weight)
-		{
-			assert(m_weight >= 0);
-		}
-		
-		//! Strict weak ordering operator (required by std::priority_queue)
-		inline bool operator < (const Edge& other) const
-		{
-			return m_weight > other.m_weight;
-		}
-		
-		//! Returns first vertex (index)
-		const unsigned& v1() const { return m_key.first; }
-		//! Returns second vertex (index)
-		const unsigned& v2() const { return m_key.second; }
-		
-	protected:
-		
-		//! Unique key
-		Key m_key;
-		
-		//! Associated weight
-		float m_weight;
-	};
-	
-	//! Generic graph structure
-	class Graph
+	//! Invalid vertex index
+	static const unsigned c_noVertex = std::numeric_limits<unsigned>::max();
+
+	//! k-NN graph (each vertex stores its k nearest neighbors: fixed-width CSR layout)
+	/** Each vertex only writes its own slots, so the graph can be filled concurrently.
+	**/
+	class KnnGraph
 	{
 	public:
-		
+
 		//! Default constructor
-		Graph() = default;
-		
-		//! Set of indexes
-		using IndexSet = std::set<unsigned int>;
-		
+		KnnGraph() : m_k(0) {}
+
 		//! Reserves memory for graph
 		/** Must be called before using the structure!
-		Clears the structure as well.
-	**/
-		bool reserve(unsigned vertexCount)
+			Clears the structure as well.
+		**/
+		bool reserve(unsigned vertexCount, unsigned k)
 		{
-			m_edges.clear();
-			
+			m_k = k;
+			m_neighbors.clear();
+			m_weights.clear();
+
 			try
 			{
-				m_vertexNeighbors.resize(vertexCount, IndexSet());
+				m_neighbors.resize(static_cast<size_t>(vertexCount) * k, c_noVertex);
+				m_weights.resize(static_cast<size_t>(vertexCount) * k, 0.0f);
 			}
 			catch (const std::bad_alloc&)
 			{
 				//not enough memory
+				m_neighbors.clear();
+				m_weights.clear();
 				return false;
 			}
-			
+
 			return true;
 		}
-		
+
 		//! Returns the number of vertices
-		unsigned vertexCount() const { return static_cast<unsigned>(m_vertexNeighbors.size()); } //the m_vertexNeighbors vector size shouldn't be bigger than a 32 bits integer (see 'reserve')
-		
-		//! Returns the number of edges
-		size_t edgeCount() const { return m_edges.size(); }
-		
-		//! Returns the weight associated to an edge (if it exists - returns -1 otherwise)
-		float weight(unsigned v1, unsigned v2) const
+		unsigned vertexCount() const { return m_k != 0 ? static_cast<unsigned>(m_neighbors.size() / m_k) : 0; }
+
+		//! Returns the number of neighbors (slots) per vertex
+		unsigned k() const { return m_k; }
+
+		//! Sets the j-th neighbor of a vertex
+		inline void setNeighbor(unsigned v, unsigned j, unsigned neighbor, float weight)
 		{
-			assert(v1 < m_vertexNeighbors.size() && v2 < m_vertexNeighbors.size());
-			
-			// try to find the corresponding edge (otherwise return -1)
-			std::map<Edge::Key, float>::const_iterator it = m_edges.find(Edge::ConstructKey(v1, v2));
-			
-			return (it == m_edges.end() ? -1 : it->second);
+			size_t slot = static_cast<size_t>(v) * m_k + j;
+			m_neighbors[slot] = neighbor;
+			m_weights[slot] = weight;
 		}
-		
-		//! Adds or updates the edge (v1,v2)
-		void addEdge(unsigned v1, unsigned v2, float weight = 0.0f)
+
+		//! Returns the neighbor stored in a given slot (or c_noVertex)
+		inline unsigned neighbor(size_t slot) const { return m_neighbors[slot]; }
+		//! Returns the weight of the edge stored in a given slot
+		inline float weight(size_t slot) const { return m_weights[slot]; }
+		//! Returns the total number of slots
+		inline size_t slotCount() const { return m_neighbors.size(); }
+
+	protected:
+
+		//! Number of slots per vertex
+		unsigned m_k;
+		//! Neighbors (k slots per vertex)
+		std::vector<unsigned> m_neighbors;
+		//! Edges weights (k slots per vertex)
+		std::vector<float> m_weights;
+	};
+
+	//! Tree (or forest) stored in CSR layout
+	struct Tree
+	{
+		//! Start of the neighbors of each vertex (vertexCount + 1)
+		std::vector<unsigned> offsets;
+		//! Neighbors
+		std::vector<unsigned> neighbors;
+	};
+
+	//! Returns the root of a vertex (union-find structure)
+	inline unsigned FindRoot(std::vector<unsigned>& parents, unsigned v)
+	{
+		unsigned root = v;
+		while (parents[root] != root)
+			root = parents[root];
+		//path compression
+		while (parents[v] != root)
 		{
-			assert(v1 < m_vertexNeighbors.size() && v2 < m_vertexNeighbors.size());
-			
-			m_edges.insert(std::make_pair(Edge::ConstructKey(v1, v2), weight));
-			m_vertexNeighbors[v1].insert(v2);
-			m_vertexNeighbors[v2].insert(v1);
+			unsigned next = parents[v];
+			parents[v] = root;
+			v = next;
 		}
-		
-		//! Returns the set of edges connected to a given vertex
-		inline const IndexSet& getVertexNeighbors(unsigned index) const
+		return root;
+	}
+
+	//! Edge key: weight (most significant bits) and edge index (for deterministic tie-breaking)
+	inline uint64_t EdgeKey(float weight, uint32_t edgeIndex)
+	{
+		//weights are positive floats: their binary representation has the same order
+		uint32_t weightBits = 0;
+		memcpy(&weightBits, &weight, sizeof(float));
+		return (static_cast<uint64_t>(weightBits) << 32) | edgeIndex;
+	}
+
+	//! Atomic 'min' operation
+	inline void AtomicMin(std::atomic<uint64_t>& value, uint64_t candidate)
+	{
+		uint64_t current = value.load(std::memory_order_relaxed);
+		while (candidate < current && !value.compare_exchange_weak(current, candidate, std::memory_order_relaxed))
 		{
-			return m_vertexNeighbors[index];
 		}
-		
-	protected:
-		
-		//! Graph edges
-		std::map<Edge::Key, float> m_edges;
-		
-		//! Set of neighbors for each vertex
-		std::vector<IndexSet> m_vertexNeighbors;
-	};
+	}
 }
 
-static bool ResolveNormalsWithMST(	ccPointCloud* cloud,
-#ifdef WITH_GRAPH
-									const Graph& graph,
-#else
-									ccOctree::Shared& octree,
-									unsigned char level,
-									unsigned kNN,
-#endif
-									ccProgressDialog* progressCb = nullptr)
+//! Computes the minimum spanning forest of the k-NN graph (parallel Borůvka algorithm)
+static bool ComputeMinimumSpanningForest(const KnnGraph& graph, Tree& tree, CCLib::GenericProgressCallback* progressCb)
 {
-	assert(cloud && cloud->hasNormals());
-
-//#define COLOR_PATCHES
-#ifdef COLOR_PATCHES
-	//Test: color patches
-	cloud->setColor(ccColor::white);
-	cloud->showColors(true);
-
-	//Test: arrival time
-	int sfIdx = cloud->getScalarFieldIndexByName("MST arrival time");
-	if (sfIdx < 0)
-		sfIdx = cloud->addScalarField("MST arrival time");
-	ccScalarField* sf = static_cast<ccScalarField*>(cloud->getScalarField(sfIdx));
-	sf->fill(NAN_VALUE);
-	cloud->setCurrentDisplayedScalarField(sfIdx);
-#endif
-
-	//reset
-	std::priority_queue<Edge> priorityQueue;
-	std::vector<bool> visited;
-	unsigned visitedCount = 0;
-#ifdef WITH_GRAPH
 	unsigned vertexCount = graph.vertexCount();
-#else
-	unsigned vertexCount = cloud->size();
-#endif
 
-	//instantiate the 'visited' table
+	//edges (only the valid k-NN graph slots)
+	std::vector<uint32_t> edges;
+	std::vector<unsigned> parents;
+	std::vector<unsigned> components;
+	std::vector< std::atomic<uint64_t> > bestEdges;
+	std::vector<unsigned> treeEdges; //pairs of vertices
 	try
 	{
-		visited.resize(vertexCount, false);
-
-		//progress notification
-		CCLib::NormalizedProgress nProgress(progressCb, vertexCount);
-		if (progressCb)
+		if (graph.slotCount() >= std::numeric_limits<uint32_t>::max())
 		{
-			progressCb->update(0);
-			progressCb->setMethodTitle(QObject::tr("Orient normals (MST)"));
-#ifdef WITH_GRAPH
-			progressCb->setInfo(QObject::tr("Compute Minimum spanning tree\nPoints: %1\nEdges: %2").arg(vertexCount).arg(graph.edgeCount()));
-#else
-			progressCb->setInfo(QObject::tr("Compute Minimum spanning tree\nPoints: %1").arg(vertexCount));
-#endif
-			progressCb->start();
+			ccLog::Warning("[MST] Too many edges");
+			return false;
+		}
+		edges.reserve(graph.slotCount());
+		for (size_t slot = 0; slot < graph.slotCount(); ++slot)
+		{
+			if (graph.neighbor(slot) != c_noVertex)
+				edges.push_back(static_cast<uint32_t>(slot));
 		}
 
-#ifndef WITH_GRAPH
-		CCLib::DgmOctree::NearestNeighboursSearchStruct nNSS;
-		nNSS.level = level;
-		nNSS.minNumberOfNeighbors = kNN + 1; //+1 because we'll get the query point itself!
+		parents.resize(vertexCount);
+		for (unsigned i = 0; i < vertexCount; ++i)
+			parents[i] = i;
+		components.resize(vertexCount);
+		bestEdges = std::vector< std::atomic<uint64_t> >(vertexCount);
+		treeEdges.reserve(2 * static_cast<size_t>(vertexCount));
+	}
+	catch (const std::bad_alloc&)
+	{
+		//not enough memory
+		return false;
+	}
+
+	const uint64_t noEdge = std::numeric_limits<uint64_t>::max();
+	const unsigned k = graph.k();
+
+	//each round at least halves the number of components (in each connected part of the graph)
+	unsigned round = 0;
+	while (!edges.empty())
+	{
+		//current component of each vertex
+#if defined(_OPENMP)
+#pragma omp parallel for
 #endif
+		for (int i = 0; i < static_cast<int>(vertexCount); ++i)
+		{
+			unsigned root = static_cast<unsigned>(i);
+			while (parents[root] != root)
+				root = parents[root];
+			components[i] = root;
+			bestEdges[i].store(noEdge, std::memory_order_relaxed);
+		}
 
-		//while unvisited vertices remain...
-		unsigned firstUnvisitedIndex = 0;
-		size_t patchCount = 0;
-		size_t inversionCount = 0;
-		while (visitedCount < vertexCount)
+		//lightest edge leaving each component
+#if defined(_OPENMP)
+#pragma omp parallel for
+#endif
+		for (int e = 0; e < static_cast<int>(edges.size()); ++e)
 		{
-			//find the first not-yet-visited vertex
-			while (visited[firstUnvisitedIndex])
+			uint32_t slot = edges[e];
+			unsigned c1 = components[slot / k];
+			unsigned c2 = components[graph.neighbor(slot)];
+			if (c1 != c2)
 			{
-				++firstUnvisitedIndex;
+				uint64_t key = EdgeKey(graph.weight(slot), slot);
+				AtomicMin(bestEdges[c1], key);
+				AtomicMin(bestEdges[c2], key);
 			}
+		}
 
-			//set it as "visited"
+		//merge the components
+		size_t mergeCount = 0;
+		for (unsigned c = 0; c < vertexCount; ++c)
+		{
+			uint64_t key = bestEdges[c].load(std::memory_order_relaxed);
+			if (key == noEdge)
+				continue;
+
+			uint32_t slot = static_cast<uint32_t>(key & 0xFFFFFFFF);
+			unsigned v1 = slot / k;
+			unsigned v2 = graph.neighbor(slot);
+			unsigned r1 = FindRoot(parents, v1);
+			unsigned r2 = FindRoot(parents, v2);
+			if (r1 != r2) //the same edge may have been chosen by both components
 			{
-				visited[firstUnvisitedIndex] = true;
-				++visitedCount;
-				//add its neighbors to the priority queue
-#ifdef WITH_GRAPH
-				const Graph::IndexSet& neighbors = graph.getVertexNeighbors(firstUnvisitedIndex);
-				for (Graph::IndexSet::const_iterator it = neighbors.begin(); it != neighbors.end(); ++it)
-				{
-					priorityQueue.push(Edge(firstUnvisitedIndex, *it, graph.weight(firstUnvisitedIndex, *it)));
-				}
-#else
-				const CCVector3* P = cloud->getPoint(firstUnvisitedIndex);
-				nNSS.queryPoint = *P;
-				octree->getTheCellPosWhichIncludesThePoint(P, nNSS.cellPos, level);
-				octree->computeCellCenter(nNSS.cellPos, level, nNSS.cellCenter);
-				nNSS.pointsInNeighbourhood.clear();
-				nNSS.alreadyVisitedNeighbourhoodSize = 0;
-
-				//look for neighbors in a sphere
-				unsigned neighborCount = octree->findNearestNeighborsStartingFromCell(nNSS, false);
-				neighborCount = std::min(neighborCount, kNN + 1);
-
-				//current point index
-				const CCVector3& N1 = cloud->getPointNormal(firstUnvisitedIndex);
-				for (unsigned j = 0; j < neighborCount; ++j)
-				{
-					//current neighbor index
-					unsigned neighborIndex = nNSS.pointsInNeighbourhood[j].pointIndex;
-					if (	firstUnvisitedIndex != neighborIndex
-						&&	!visited[neighborIndex])
-					{
-						const CCVector3& N2 = cloud->getPointNormal(neighborIndex);
-						//dot product
-						float weight = std::max(0.0f, 1.0f - static_cast<float>(fabs(N1.dot(N2))));
+				parents[r2] = r1;
+				treeEdges.push_back(v1);
+				treeEdges.push_back(v2);
+				++mergeCount;
+			}
+		}
 
-						//distance
-						//float weight = sqrt(nNSS.pointsInNeighbourhood[j].squareDistd);
+		if (mergeCount == 0)
+		{
+			break;
+		}
 
-						//mutual dot product
-						//const CCVector3* P2 = cloud->getPoint(static_cast<unsigned>(neighborIndex));
-						//CCVector3 uAB = *P2 - *P1;
-						//uAB.normalize();
-						//float weight = (fabs(CCVector3::vdot(uAB.u, N1) + fabs(CCVector3::vdot(uAB.u, N2)))) / 2;
+		//remove the edges inside components
+		for (unsigned i = 0; i < vertexCount; ++i)
+		{
+			FindRoot(parents, i);
+		}
+		edges.erase(std::remove_if(edges.begin(), edges.end(), [&](uint32_t slot) { return parents[slot / k] == parents[graph.neighbor(slot)]; }), edges.end());
 
-						priorityQueue.emplace( firstUnvisitedIndex, neighborIndex, weight );
-					}
-				}
-#endif
+		if (progressCb)
+		{
+			progressCb->update(std::min(90.0f, 10.0f * (++round)));
+			if (progressCb->isCancelRequested())
+				return false;
+		}
+	}
 
-				if (progressCb && !nProgress.oneStep())
-				{
-					break;
-				}
-			}
+	//convert the tree edges to CSR
+	try
+	{
+		tree.offsets.clear();
+		tree.offsets.resize(vertexCount + 1, 0);
+		for (size_t i = 0; i < treeEdges.size(); ++i)
+			++tree.offsets[treeEdges[i] + 1];
+		for (unsigned i = 0; i < vertexCount; ++i)
+			tree.offsets[i + 1] += tree.offsets[i];
+
+		tree.neighbors.resize(treeEdges.size());
+		std::vector<unsigned> fillPos(tree.offsets.begin(), tree.offsets.end() - 1);
+		for (size_t i = 0; i < treeEdges.size(); i += 2)
+		{
+			tree.neighbors[fillPos[treeEdges[i]]++] = treeEdges[i + 1];
+			tree.neighbors[fillPos[treeEdges[i + 1]]++] = treeEdges[i];
+		}
+	}
+	catch (const std::bad_alloc&)
+	{
+		//not enough memory
+		return false;
+	}
+
+	return true;
+}
+
+//! Propagates the normals orientation along the minimum spanning forest (level-synchronous BFS)
+static bool ResolveNormalsWithMST(ccPointCloud* cloud, const Tree& tree, CCLib::GenericProgressCallback* progressCb)
+{
+	assert(cloud && cloud->hasNormals());
+
+	unsigned vertexCount = cloud->size();
+	assert(tree.offsets.size() == vertexCount + 1);
+
+	size_t patchCount = 0;
+	size_t inversionCount = 0;
+	try
+	{
+		std::vector<unsigned> parent(vertexCount, c_noVertex);
+		std::vector<char> invert(vertexCount, 0);
+		std::vector<unsigned> frontier;
+		std::vector<unsigned> nextFrontier;
+
+		for (unsigned root = 0; root < vertexCount; ++root)
+		{
+			if (parent[root] != c_noVertex)
+				continue;
 
-	#ifdef COLOR_PATCHES
-			ccColor::Rgb patchCol = ccColor::Generator::Random();
-			cloud->setPointColor(static_cast<unsigned>(firstUnvisitedIndex), patchCol.rgb);
-			sf->setValue(static_cast<unsigned>(firstUnvisitedIndex),static_cast<ScalarType>(visitedCount));
-	#endif
+			//new patch (its root keeps its orientation)
+			parent[root] = root;
+			++patchCount;
+			frontier.assign(1, root);
 
-			while (!priorityQueue.empty() && (visitedCount < vertexCount))
+			while (!frontier.empty())
 			{
-				//process next edge (with the lowest 'weight')
-				Edge element = priorityQueue.top();
-				priorityQueue.pop();
-
-				//shall the normal be inverted?
-				const CCVector3& N1 = cloud->getPointNormal(static_cast<unsigned>(element.v1()));
-				const CCVector3& N2 = cloud->getPointNormal(static_cast<unsigned>(element.v2()));
-				bool inverNormal = (N1.dot(N2) < 0);
-				unsigned v = 0;
-				//we should change the vertex that has not been visited yet
-				if (!visited[element.v1()])
-				{
-					v = element.v1();
-					if (inverNormal)
-					{
-						cloud->setPointNormal(static_cast<unsigned>(v), -N1);
-						++inversionCount;
-					}
-				}
-				else if (!visited[element.v2()])
-				{
-					v = element.v2();
-					if (inverNormal)
-					{
-						cloud->setPointNormal(static_cast<unsigned>(v), -N2);
-						++inversionCount;
-					}
-				}
-				else
-				{
-					continue;
-				}
+				nextFrontier.clear();
 
-				//set it as "visited"
+#if defined(_OPENMP)
+#pragma omp parallel
+#endif
 				{
-					visited[v] = true;
-					++visitedCount;
-					//add its neighbors to the priority queue
-#ifdef WITH_GRAPH
-					const Graph::IndexSet& neighbors = graph.getVertexNeighbors(v);
-					for (Graph::IndexSet::const_iterator it = neighbors.begin(); it != neighbors.end(); ++it)
-						priorityQueue.push(Edge(v, *it, graph.weight(v,*it)));
-#else
-					const CCVector3* P = cloud->getPoint(v);
-					nNSS.queryPoint = *P;
-					octree->getTheCellPosWhichIncludesThePoint(P, nNSS.cellPos, level);
-					octree->computeCellCenter(nNSS.cellPos, level, nNSS.cellCenter);
-					nNSS.pointsInNeighbourhood.clear();
-					nNSS.alreadyVisitedNeighbourhoodSize = 0;
-
-					//look for neighbors in a sphere
-					unsigned neighborCount = octree->findNearestNeighborsStartingFromCell(nNSS, false);
-					neighborCount = std::min(neighborCount, kNN + 1);
-					//current point index
-					const CCVector3& N1 = cloud->getPointNormal(v);
-					for (unsigned j = 0; j < neighborCount; ++j)
+					std::vector<unsigned> threadFrontier;
+#if defined(_OPENMP)
+#pragma omp for nowait
+#endif
+					for (int f = 0; f < static_cast<int>(frontier.size()); ++f)
 					{
-						//current neighbor index
-						unsigned neighborIndex = nNSS.pointsInNeighbourhood[j].pointIndex;
-						if (	v != neighborIndex
-							&&	!visited[neighborIndex])
+						unsigned v = frontier[f];
+						const CCVector3& N1 = cloud->getPointNormal(v);
+						for (unsigned j = tree.offsets[v]; j < tree.offsets[v + 1]; ++j)
 						{
-							const CCVector3& N2 = cloud->getPointNormal(neighborIndex);
-							//dot product
-							float weight = std::max(0.0f, 1.0f - static_cast<float>(fabs(N1.dot(N2))));
-
-							//distance
-							//float weight = sqrt(nNSS.pointsInNeighbourhood[j].squareDistd);
-
-							//mutual dot product
-							//const CCVector3* P2 = cloud->getPoint(static_cast<unsigned>(neighborIndex));
-							//CCVector3 uAB = *P2 - *P1;
-							//uAB.normalize();
-							//float weight = (fabs(CCVector3::vdot(uAB.u, N1) + fabs(CCVector3::vdot(uAB.u, N2)))) / 2;
-
-							priorityQueue.emplace( v, neighborIndex, weight );
+							//in a tree, each vertex is only reached by its parent
+							unsigned w = tree.neighbors[j];
+							if (w == parent[v])
+								continue;
+
+							parent[w] = v;
+							//shall the normal be inverted?
+							const CCVector3& N2 = cloud->getPointNormal(w);
+							invert[w] = ((N1.dot(N2) < 0) != (invert[v] != 0)) ? 1 : 0;
+							threadFrontier.push_back(w);
 						}
 					}
+#if defined(_OPENMP)
+#pragma omp critical
 #endif
+					nextFrontier.insert(nextFrontier.end(), threadFrontier.begin(), threadFrontier.end());
 				}
 
-	#ifdef COLOR_PATCHES
-				cloud->setPointColor(static_cast<unsigned>(v), patchCol);
-				sf->setValue(static_cast<unsigned>(v),static_cast<ScalarType>(visitedCount));
-	#endif
-				if (progressCb && !nProgress.oneStep())
-				{
-					visitedCount = static_cast<unsigned>(vertexCount); //early stop
-					break;
-				}
+				std::swap(frontier, nextFrontier);
 			}
-
-			//new patch
-			++patchCount;
 		}
 
-	#ifdef COLOR_PATCHES
-		sf->computeMinAndMax();
-		cloud->showSF(true);
-	#endif
-
-		if (progressCb)
+		//eventually invert the normals
+		for (unsigned i = 0; i < vertexCount; ++i)
 		{
-			progressCb->stop();
+			if (invert[i])
+			{
+				cloud->setPointNormal(i, -cloud->getPointNormal(i));
+				++inversionCount;
+			}
 		}
-
-		ccLog::Print(QString("[ResolveNormalsWithMST] Patches = %1 / Inversions: %2").arg(patchCount).arg(inversionCount));
 	}
 	catch (const std::bad_alloc&)
 	{
@@ -404,16 +377,22 @@ static bool ResolveNormalsWithMST(	ccPointCloud* cloud,
 		return false;
 	}
 
+	if (progressCb)
+	{
+		progressCb->update(100.0f);
+	}
+
+	ccLog::Print(QString("[ResolveNormalsWithMST] Patches = %1 / Inversions: %2").arg(patchCount).arg(inversionCount));
+
 	return true;
 }
 
-#ifdef WITH_GRAPH
-static bool ComputeMSTGraphAtLevel(	const CCLib::DgmOctree::octreeCell& cell,
+static bool ComputeKnnGraphAtLevel(	const CCLib::DgmOctree::octreeCell& cell,
 									void** additionalParameters,
 									CCLib::NormalizedProgress* nProgress/*=0*/)
 {
 	//parameters
-	Graph* graph = static_cast<Graph*>(additionalParameters[0]);
+	KnnGraph* graph = static_cast<KnnGraph*>(additionalParameters[0]);
 	ccPointCloud* cloud = static_cast<ccPointCloud*>(additionalParameters[1]);
 
 	//structure for the nearest neighbor search
@@ -452,15 +431,15 @@ static bool ComputeMSTGraphAtLevel(	const CCLib::DgmOctree::octreeCell& cell,
 	{
 		cell.points->getPoint(i, nNSS.queryPoint);
 
-		//look for neighbors in a sphere
+		//look for the nearest neighbors
 		unsigned neighborCount = cell.parentOctree->findNearestNeighborsStartingFromCell(nNSS, false);
 		neighborCount = std::min(neighborCount, kNN + 1);
 
 		//current point index
 		unsigned index = cell.points->getPointGlobalIndex(i);
 		const CCVector3& N1 = cloud->getPointNormal(index);
-		//const CCVector3* P1 = cloud->getPoint(static_cast<unsigned>(index));
-		for (unsigned j = 0; j < neighborCount; ++j)
+		unsigned slot = 0;
+		for (unsigned j = 0; j < neighborCount && slot < kNN; ++j)
 		{
 			//current neighbor index
 			unsigned neighborIndex = nNSS.pointsInNeighbourhood[j].pointIndex;
@@ -470,16 +449,7 @@ static bool ComputeMSTGraphAtLevel(	const CCLib::DgmOctree::octreeCell& cell,
 				//dot product
 				float weight = std::max(0.0f, 1.0f - static_cast<float>(fabs(N1.dot(N2))));
 
-				//distance
-				//float weight = sqrt(nNSS.pointsInNeighbourhood[j].squareDistd);
-
-				//mutual dot product
-				//const CCVector3* P2 = cloud->getPoint(static_cast<unsigned>(neighborIndex));
-				//CCVector3 uAB = *P2 - *P1;
-				//uAB.normalize();
-				//float weight = (fabs(CCVector3::vdot(uAB.u, N1) + fabs(CCVector3::vdot(uAB.u, N2)))) / 2;
-
-				graph->addEdge(index, neighborIndex, weight);
+				graph->setNeighbor(index, slot++, neighborIndex, weight);
 			}
 		}
 
@@ -489,7 +459,6 @@ static bool ComputeMSTGraphAtLevel(	const CCLib::DgmOctree::octreeCell& cell,
 
 	return true;
 }
-#endif
 
 bool ccMinimumSpanningTreeForNormsDirection::OrientNormals(	ccPointCloud* cloud,
 															unsigned kNN/*=6*/,
@@ -501,6 +470,11 @@ bool ccMinimumSpanningTreeForNormsDirection::OrientNormals(	ccPointCloud* cloud,
 		ccLog::Warning(QString("Cloud '%1' has no normals!").arg(cloud->getName()));
 		return false;
 	}
+	if (kNN == 0)
+	{
+		ccLog::Warning("[orientNormalsWithMST] Invalid number of neighbors");
+		return false;
+	}
 
 	//we need the octree
 	if (!cloud->getOctree())
@@ -519,12 +493,13 @@ bool ccMinimumSpanningTreeForNormsDirection::OrientNormals(	ccPointCloud* cloud,
 	bool result = true;
 	try
 	{
-#ifdef WITH_GRAPH
-		Graph graph;
-		if (!graph.reserve(cloud->size()))
+		//1st step: k-NN graph (each point only writes its own neighbors: compatible with parallel strategies)
+		KnnGraph graph;
+		if (!graph.reserve(cloud->size(), kNN))
 		{
 			//not enough memory!
-			result = false;
+			ccLog::Warning(QString("[orientNormalsWithMST] Not enough memory to compute the graph of cloud '%1'").arg(cloud->getName()));
+			return false;
 		}
 
 		//parameters
@@ -534,33 +509,48 @@ bool ccMinimumSpanningTreeForNormsDirection::OrientNormals(	ccPointCloud* cloud,
 										};
 
 		if (octree->executeFunctionForAllCellsAtLevel(	level,
-														&ComputeMSTGraphAtLevel,
+														&ComputeKnnGraphAtLevel,
 														additionalParameters,
-														false, //not compatible with parallel strategies!
+														true,
 														progressDlg,
 														"Build Spanning Tree") == 0)
 		{
 			//something went wrong
 			ccLog::Warning(QString("Failed to compute Spanning Tree on cloud '%1'").arg(cloud->getName()));
+			return false;
+		}
+
+		//2nd step: minimum spanning forest
+		if (progressDlg)
+		{
+			progressDlg->setMethodTitle(QObject::tr("Orient normals (MST)"));
+			progressDlg->setInfo(QObject::tr("Compute Minimum spanning tree\nPoints: %1\nEdges: %2").arg(cloud->size()).arg(graph.slotCount()));
+			progressDlg->update(0);
+			progressDlg->start();
+		}
+
+		Tree tree;
+		if (!ComputeMinimumSpanningForest(graph, tree, progressDlg))
+		{
+			//something went wrong
+			ccLog::Warning(QString("Failed to compute Minimum Spanning Tree on cloud '%1'").arg(cloud->getName()));
 			result = false;
 		}
 		else
 		{
-			if (!ResolveNormalsWithMST(cloud, graph, progressDlg))
+			//3rd step: propagate the orientation along the tree
+			if (!ResolveNormalsWithMST(cloud, tree, progressDlg))
 			{
 				//something went wrong
-				ccLog::Warning(QString("Failed to compute Minimum Spanning Tree on cloud '%1'").arg(cloud->getName()));
+				ccLog::Warning(QString("Failed to resolve normals orientation with Minimum Spanning Tree on cloud '%1'").arg(cloud->getName()));
 				result = false;
 			}
 		}
-#else
-		if (!ResolveNormalsWithMST(cloud, octree, level, kNN, progressDlg))
+
+		if (progressDlg)
 		{
-			//something went wrong
-			ccLog::Warning(QString("Failed to resolve normals orientation with Minimum Spanning Tree on cloud '%1'").arg(cloud->getName()));
-			result = false;
+			progressDlg->stop();
 		}
-#endif
 	}
 	catch (...)
 	{
@@ -22,6 +22,7 @@
 
 //System
 #include <assert.h>
+#include <cmath>
 
 void ccNormalCompressor::InvertNormal(CompressedNormType &code)
 {
@@ -187,3 +188,88 @@ void ccNormalCompressor::Decompress(unsigned index, PointCoordinateType n[3], un
 	n[1] = ((sector & 2) != 0 ? -(box[4] + box[1]) : box[4] + box[1]);
 	n[2] = ((sector & 1) != 0 ? -(box[5] + box[2]) : box[5] + box[2]);
 }
+
+void ccNormalCompressor::Compress(const PointCoordinateType* normals, size_t count, CompressedNormType* codes)
+{
+	assert(normals && codes);
+
+#if defined(_OPENMP)
+#pragma omp parallel for
+#endif
+	for (int i = 0; i < static_cast<int>(count); ++i)
+	{
+		codes[i] = static_cast<CompressedNormType>(Compress(normals + 3 * static_cast<size_t>(i)));
+	}
+}
+
+void ccNormalCompressor::Decompress(const CompressedNormType* codes, size_t count, PointCoordinateType* normals, unsigned char level/*=QUANTIZE_LEVEL*/)
+{
+	assert(normals && codes);
+
+#if defined(_OPENMP)
+#pragma omp parallel for
+#endif
+	for (int i = 0; i < static_cast<int>(count); ++i)
+	{
+		Decompress(codes[i], normals + 3 * static_cast<size_t>(i), level);
+	}
+}
+
+//! Octahedral encoding quantization (even, so that 0 is exactly represented at q = c_octahedralMaxQ / 2)
+static const uint32_t c_octahedralMaxQ = 65534;
+
+uint32_t ccNormalCompressor::CompressOctahedral(const PointCoordinateType n[3])
+{
+	PointCoordinateType l1 = std::abs(n[0]) + std::abs(n[1]) + std::abs(n[2]);
+	if (l1 == 0)
+	{
+		return OCTAHEDRAL_NULL_CODE;
+	}
+
+	//project on the octahedron
+	PointCoordinateType u = n[0] / l1;
+	PointCoordinateType v = n[1] / l1;
+	if (n[2] < 0)
+	{
+		//fold the lower hemisphere
+		PointCoordinateType fu = (1 - std::abs(v)) * (u >= 0 ? 1 : -1);
+		PointCoordinateType fv = (1 - std::abs(u)) * (v >= 0 ? 1 : -1);
+		u = fu;
+		v = fv;
+	}
+
+	//quantize ([-1;1] --> [0;c_octahedralMaxQ])
+	uint32_t qu = static_cast<uint32_t>(std::lround((u + 1) * (c_octahedralMaxQ / 2)));
+	uint32_t qv = static_cast<uint32_t>(std::lround((v + 1) * (c_octahedralMaxQ / 2)));
+	if (qu > c_octahedralMaxQ) qu = c_octahedralMaxQ;
+	if (qv > c_octahedralMaxQ) qv = c_octahedralMaxQ;
+
+	return (qu << 16) | qv;
+}
+
+void ccNormalCompressor::DecompressOctahedral(uint32_t code, PointCoordinateType n[3])
+{
+	if (code == OCTAHEDRAL_NULL_CODE)
+	{
+		n[0] = n[1] = n[2] = 0;
+		return;
+	}
+
+	static const PointCoordinateType c_halfQ = static_cast<PointCoordinateType>(c_octahedralMaxQ / 2);
+	PointCoordinateType u = static_cast<PointCoordinateType>(code >> 16) / c_halfQ - 1;
+	PointCoordinateType v = static_cast<PointCoordinateType>(code & 0xFFFF) / c_halfQ - 1;
+	PointCoordinateType z = 1 - std::abs(u) - std::abs(v);
+	if (z < 0)
+	{
+		//unfold the lower hemisphere
+		PointCoordinateType fu = (1 - std::abs(v)) * (u >= 0 ? 1 : -1);
+		PointCoordinateType fv = (1 - std::abs(u)) * (v >= 0 ? 1 : -1);
+		u = fu;
+		v = fv;
+	}
+
+	PointCoordinateType norm = std::sqrt(u * u + v * v + z * z);
+	n[0] = u / norm;
+	n[1] = v / norm;
+	n[2] = z / norm;
+}
@@ -22,6 +22,10 @@
 #include "qCC_db.h"
 #include "ccBasicTypes.h"
 
+//System
+#include <cstddef>
+#include <cstdint>
+
 //! Normal compressor
 class QCC_DB_LIB_API ccNormalCompressor
 {
@@ -46,6 +50,35 @@ public:
 	//! Inverts a (compressed) normal
 	static void InvertNormal(CompressedNormType &code);
 
+	//! Batch compression algorithm (parallel)
+	/** \param normals normals (packed X,Y,Z coordinates)
+		\param count number of normals
+		\param codes output codes (must be at least 'count' long)
+	**/
+	static void Compress(const PointCoordinateType* normals, size_t count, CompressedNormType* codes);
+
+	//! Batch decompression algorithm (parallel)
+	/** \warning Prefer the ccNormalVectors lookup table for the default quantization level.
+		\param codes compressed normals
+		\param count number of codes
+		\param normals output normals (packed X,Y,Z coordinates - must be at least '3*count' long)
+		\param level quantization level
+	**/
+	static void Decompress(const CompressedNormType* codes, size_t count, PointCoordinateType* normals, unsigned char level = QUANTIZE_LEVEL);
+
+	//! Null normal code (octahedral encoding)
+	static const uint32_t OCTAHEDRAL_NULL_CODE = 0xFFFFFFFF;
+
+	//! Octahedral encoding of a normal (32 bits: 16 bits per coordinate)
+	/** Alternative (finer) encoding with a constant time compression.
+		\warning Not compatible with the quantized codes stored by the clouds and meshes
+		(see Compress). Meant for transient buffers and data exchange.
+	**/
+	static uint32_t CompressOctahedral(const PointCoordinateType N[3]);
+
+	//! Octahedral decoding of a normal (see CompressOctahedral)
+	static void DecompressOctahedral(uint32_t code, PointCoordinateType N[3]);
+
 };
 
  #endif //CC_NORMAL_COMPRESSOR_HEADER
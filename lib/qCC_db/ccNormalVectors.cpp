@@ -18,6 +18,7 @@
 #include "ccNormalVectors.h"
 
 //Local
+#include "ccChunk.h"
 #include "ccSingleton.h"
 #include "ccNormalCompressor.h"
 
@@ -66,6 +67,29 @@ CompressedNormType ccNormalVectors::GetNormIndex(const PointCoordinateType N[])
 	return static_cast<CompressedNormType>(index);
 }
 
+void ccNormalVectors::GetNormIndexes(const CCVector3* N, size_t count, CompressedNormType* codes)
+{
+	assert(N && codes);
+
+	//CCVector3 is a plain array of 3 coordinates
+	ccNormalCompressor::Compress(N->u, count, codes);
+}
+
+void ccNormalVectors::GetNormals(const CompressedNormType* codes, size_t count, CCVector3* N)
+{
+	assert(N && codes);
+
+	const std::vector<CCVector3>& normalVectors = GetUniqueInstance()->m_theNormalVectors;
+
+#if defined(_OPENMP)
+#pragma omp parallel for
+#endif
+	for (int i = 0; i < static_cast<int>(count); ++i)
+	{
+		N[i] = normalVectors[codes[i]];
+	}
+}
+
 bool ccNormalVectors::enableNormalHSVColorsArray()
 {
 	if (!m_theNormalHSVColors.empty())
@@ -508,13 +532,10 @@ bool ccNormalVectors::ComputeCloudNormals(	ccGenericPointCloud* theCloud,
 		return false;
 	}
 
-	//we 'compress' each normal
-	std::fill(theNormsCodes.begin(), theNormsCodes.end(), 0);
-	for (unsigned i = 0; i < pointCount; i++)
+	//we 'compress' each normal (in parallel, chunk by chunk)
+	for (size_t i = 0; i < ccChunk::Count(pointCount); ++i)
 	{
-		const CCVector3& N = theNorms->at(i);
-		CompressedNormType nCode = GetNormIndex(N);
-		theNormsCodes.setValue(i, nCode);
+		GetNormIndexes(ccChunk::Start(*theNorms, i), ccChunk::Size(i, pointCount), ccChunk::Start(theNormsCodes, i));
 	}
 
 	theNorms->release();
@@ -54,6 +54,20 @@ public:
 	//! Returns the compressed index corresponding to a normal vector (shortcut)
 	static inline CompressedNormType GetNormIndex(const CCVector3& N) { return GetNormIndex(N.u); }
 
+	//! Returns the compressed indexes corresponding to several normal vectors (parallel)
+	/** \param N normal vectors
+		\param count number of normal vectors
+		\param codes output compressed indexes (must be at least 'count' long)
+	**/
+	static void GetNormIndexes(const CCVector3* N, size_t count, CompressedNormType* codes);
+
+	//! Returns the precomputed normals corresponding to several compressed indexes (parallel)
+	/** \param codes compressed indexes
+		\param count number of compressed indexes
+		\param N output normal vectors (must be at least 'count' long)
+	**/
+	static void GetNormals(const CompressedNormType* codes, size_t count, CCVector3* N);
+
 	//! 'Default' orientations
 	enum Orientation {
 
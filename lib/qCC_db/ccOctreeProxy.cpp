@@ -74,13 +74,13 @@ void ccOctreeProxy::drawMeOnly(CC_DRAW_CONTEXT& context)
 		//not fast at all!
 		if (MACRO_DrawFastNamesOnly(context))
 			return;
-		glFunc->glPushName(getUniqueIDForDisplay());
+		context.pushName(getUniqueIDForDisplay());
 	}
 
 	m_octree->draw(context);
 
 	if (pushName)
 	{
-		glFunc->glPopName();
+		context.popName();
 	}
 }
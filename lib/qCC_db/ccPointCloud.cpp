@@ -43,6 +43,7 @@
 #include "ccNormalVectors.h"
 #include "ccOctree.h"
 #include "ccPointCloudLOD.h"
+#include "ccPointCloudSFFilter.h"
 #include "ccPolyline.h"
 #include "ccProgressDialog.h"
 #include "ccScalarField.h"
@@ -53,11 +54,96 @@
 #include <QSharedPointer>
 
 //system
+#include <algorithm>
 #include <cassert>
 #include <queue>
 
 static const char s_deviationSFName[] = "Deviation";
 
+//! Extracts the global indexes of a selection
+/** \return whether the indexes form a single contiguous (and ordered) range
+**/
+static bool GetGlobalIndexes(const CCLib::ReferenceCloud& selection, std::vector<unsigned>& indexes)
+{
+	int count = static_cast<int>(indexes.size());
+	if (count == 0)
+	{
+		return true;
+	}
+
+	unsigned firstIndex = selection.getPointGlobalIndex(0);
+	bool contiguous = true;
+#if defined(_OPENMP)
+#pragma omp parallel for reduction(&&:contiguous)
+#endif
+	for (int i = 0; i < count; ++i)
+	{
+		indexes[i] = selection.getPointGlobalIndex(static_cast<unsigned>(i));
+		contiguous = contiguous && (indexes[i] == firstIndex + static_cast<unsigned>(i));
+	}
+
+	return contiguous;
+}
+
+//! Copies the values of a source array at the given (global) indexes
+/** A contiguous range is copied at once, otherwise the values are gathered in parallel.
+	The destination array must already have the right size.
+**/
+template <class T> static void CopyValues(const T* source, const std::vector<unsigned>& indexes, bool contiguous, T* dest)
+{
+	if (indexes.empty())
+	{
+		return;
+	}
+
+	if (contiguous)
+	{
+		std::copy(source + indexes.front(), source + indexes.front() + indexes.size(), dest);
+		return;
+	}
+
+	int count = static_cast<int>(indexes.size());
+#if defined(_OPENMP)
+#pragma omp parallel for
+#endif
+	for (int i = 0; i < count; ++i)
+	{
+		dest[i] = source[indexes[i]];
+	}
+}
+
+//! Appends the first 'count' values of a source array at the end of a container
+/** The container must have been reserved first (so that the source pointer remains
+	valid, even if it points to the container itself).
+**/
+template <class Container, class T> static void AppendValues(Container& dest, const T* source, size_t count)
+{
+	size_t countBefore = dest.size();
+	assert(dest.capacity() >= countBefore + count);
+	dest.resize(countBefore + count);
+	std::copy(source, source + count, dest.data() + countBefore);
+}
+
+//! Removes the values of the visible points (the order of the other values is preserved)
+template <class Container> static void RemoveVisibleValues(Container& values, const ccGenericPointCloud::VisibilityTableType& visTable)
+{
+	assert(values.size() == visTable.size());
+
+	size_t lastIndex = 0;
+	for (size_t i = 0; i < visTable.size(); ++i)
+	{
+		if (visTable[i] != POINT_VISIBLE)
+		{
+			if (i != lastIndex)
+			{
+				values[lastIndex] = values[i];
+			}
+			++lastIndex;
+		}
+	}
+	values.resize(lastIndex);
+}
+
 ccPointCloud::ccPointCloud(QString name/*=QString()*/, unsigned uniqueID/*=ccUniqueIDGenerator::InvalidUniqueID*/) throw()
 	: BaseClass(name, uniqueID)
 	, m_rgbaColors(nullptr)
@@ -211,23 +297,32 @@ ccPointCloud* ccPointCloud::partialClone(const CCLib::ReferenceCloud* selection,
 			return nullptr;
 		}
 
-		//import points
+		//global indexes of the selected points (extracted once for all attributes)
+		std::vector<unsigned> indexes;
+		try
 		{
-			for (unsigned i = 0; i < n; i++)
-			{
-				result->addPoint(*getPointPersistentPtr(selection->getPointGlobalIndex(i)));
-			}
+			indexes.resize(n);
 		}
+		catch (const std::bad_alloc&)
+		{
+			ccLog::Error("[ccPointCloud::partialClone] Not enough memory to duplicate cloud!");
+			delete result;
+			return nullptr;
+		}
+		bool contiguous = GetGlobalIndexes(*selection, indexes);
+
+		//import points
+		result->m_points.resize(n); //already reserved
+		CopyValues(m_points.data(), indexes, contiguous, result->m_points.data());
+		result->invalidateBoundingBox();
 
 		//RGB colors
 		if (hasColors())
 		{
 			if (result->reserveTheRGBTable())
 			{
-				for (unsigned i = 0; i < n; i++)
-				{
-					result->addColor(getPointColor(selection->getPointGlobalIndex(i)));
-				}
+				result->m_rgbaColors->resize(n); //already reserved
+				CopyValues(m_rgbaColors->data(), indexes, contiguous, result->m_rgbaColors->data());
 				result->showColors(colorsShown());
 			}
 			else
@@ -243,10 +338,8 @@ ccPointCloud* ccPointCloud::partialClone(const CCLib::ReferenceCloud* selection,
 		{
 			if (result->reserveTheNormsTable())
 			{
-				for (unsigned i = 0; i < n; i++)
-				{
-					result->addNormIndex(getPointNormalIndex(selection->getPointGlobalIndex(i)));
-				}
+				result->m_normals->resize(n); //already reserved
+				CopyValues(m_normals->data(), indexes, contiguous, result->m_normals->data());
 				result->showNormals(normalsShown());
 			}
 			else
@@ -264,15 +357,21 @@ ccPointCloud* ccPointCloud::partialClone(const CCLib::ReferenceCloud* selection,
 			{
 				try
 				{
-					for (unsigned i = 0; i < n; i++)
+					result->waveforms().resize(n);
+					CopyValues(m_fwfWaveforms.data(), indexes, contiguous, result->waveforms().data());
+
+					//copy only the necessary descriptors
+					bool usedDescriptors[256] = { false };
+					for (const ccWaveform& w : result->waveforms())
 					{
-						const ccWaveform& w = m_fwfWaveforms[selection->getPointGlobalIndex(i)];
-						if (!result->fwfDescriptors().contains(w.descriptorID()))
+						usedDescriptors[w.descriptorID()] = true;
+					}
+					for (int id = 0; id < 256; ++id)
+					{
+						if (usedDescriptors[id])
 						{
-							//copy only the necessary descriptors
-							result->fwfDescriptors().insert(w.descriptorID(), m_fwfDescriptors[w.descriptorID()]);
+							result->fwfDescriptors().insert(static_cast<uint8_t>(id), m_fwfDescriptors[static_cast<uint8_t>(id)]);
 						}
-						result->waveforms().push_back(w);
 					}
 					//we will use the same FWF data container
 					result->fwfData() = fwfData();
@@ -314,8 +413,7 @@ ccPointCloud* ccPointCloud::partialClone(const CCLib::ReferenceCloud* selection,
 							currentScalarField->setGlobalShift(sf->getGlobalShift());
 
 							//we copy data to new SF
-							for (unsigned i = 0; i < n; i++)
-								currentScalarField->setValue(i, sf->getValue(selection->getPointGlobalIndex(i)));
+							CopyValues(sf->data(), indexes, contiguous, currentScalarField->data());
 
 							currentScalarField->computeMinAndMax();
 							//copy display parameters
@@ -360,7 +458,7 @@ ccPointCloud* ccPointCloud::partialClone(const CCLib::ReferenceCloud* selection,
 				{
 					for (unsigned i = 0; i < n; i++)
 					{
-						newIndexMap[selection->getPointGlobalIndex(i)] = i;
+						newIndexMap[indexes[i]] = i;
 					}
 				}
 
@@ -545,10 +643,8 @@ const ccPointCloud& ccPointCloud::append(ccPointCloud* addedCloud, unsigned poin
 		deleteOctree();
 		unallocateVisibilityArray();
 
-		for (unsigned i = 0; i < addedPoints; i++)
-		{
-			addPoint(*addedCloud->getPoint(i));
-		}
+		AppendValues(m_points, addedCloud->m_points.data(), addedPoints);
+		invalidateBoundingBox();
 	}
 
 	//deprecate internal structures
@@ -564,10 +660,7 @@ const ccPointCloud& ccPointCloud::append(ccPointCloud* addedCloud, unsigned poin
 		if (!addedCloud->hasColors())
 		{
 			//we set a white color to new points
-			for (unsigned i = 0; i < addedPoints; i++)
-			{
-				addColor(ccColor::white);
-			}
+			m_rgbaColors->resize(m_rgbaColors->size() + addedPoints, ccColor::white);
 		}
 		else //otherwise
 		{
@@ -577,10 +670,7 @@ const ccPointCloud& ccPointCloud::append(ccPointCloud* addedCloud, unsigned poin
 				//we try to reserve a new array
 				if (reserveTheRGBTable())
 				{
-					for (unsigned i = 0; i < pointCountBefore; i++)
-					{
-						addColor(ccColor::white);
-					}
+					m_rgbaColors->resize(pointCountBefore, ccColor::white);
 				}
 				else
 				{
@@ -592,10 +682,7 @@ const ccPointCloud& ccPointCloud::append(ccPointCloud* addedCloud, unsigned poin
 			//we import colors (if necessary)
 			if (hasColors() && m_rgbaColors->currentSize() == pointCountBefore)
 			{
-				for (unsigned i = 0; i < addedPoints; i++)
-				{
-					addColor(addedCloud->m_rgbaColors->getValue(i));
-				}
+				AppendValues(*m_rgbaColors, addedCloud->m_rgbaColors->data(), addedPoints);
 			}
 		}
 	}
@@ -610,10 +697,7 @@ const ccPointCloud& ccPointCloud::append(ccPointCloud* addedCloud, unsigned poin
 		if (!addedCloud->hasNormals())
 		{
 			//we associate imported points with '0' normals
-			for (unsigned i = 0; i < addedPoints; i++)
-			{
-				addNormIndex(0);
-			}
+			m_normals->resize(m_normals->size() + addedPoints, 0);
 		}
 		else //otherwise
 		{
@@ -623,10 +707,7 @@ const ccPointCloud& ccPointCloud::append(ccPointCloud* addedCloud, unsigned poin
 				//we try to reserve a new array
 				if (reserveTheNormsTable())
 				{
-					for (unsigned i = 0; i < pointCountBefore; i++)
-					{
-						addNormIndex(0);
-					}
+					m_normals->resize(pointCountBefore, 0);
 				}
 				else
 				{
@@ -638,10 +719,7 @@ const ccPointCloud& ccPointCloud::append(ccPointCloud* addedCloud, unsigned poin
 			//we import normals (if necessary)
 			if (hasNormals() && m_normals->currentSize() == pointCountBefore)
 			{
-				for (unsigned i = 0; i < addedPoints; i++)
-				{
-					addNormIndex(addedCloud->m_normals->getValue(i));
-				}
+				AppendValues(*m_normals, addedCloud->m_normals->data(), addedPoints);
 			}
 		}
 	}
@@ -653,10 +731,7 @@ const ccPointCloud& ccPointCloud::append(ccPointCloud* addedCloud, unsigned poin
 		if (!addedCloud->hasFWF())
 		{
 			//we associate imported points with empty waveform
-			for (unsigned i = 0; i < addedPoints; i++)
-			{
-				m_fwfWaveforms.emplace_back(0);
-			}
+			m_fwfWaveforms.resize(m_fwfWaveforms.size() + addedPoints, ccWaveform(0));
 		}
 		else //otherwise
 		{
@@ -668,10 +743,7 @@ const ccPointCloud& ccPointCloud::append(ccPointCloud* addedCloud, unsigned poin
 				//we try to reserve a new array
 				if (reserveTheFWFTable())
 				{
-					for (unsigned i = 0; i < pointCountBefore; i++)
-					{
-						m_fwfWaveforms.emplace_back(0);
-					}
+					m_fwfWaveforms.resize(pointCountBefore, ccWaveform(0));
 					//we will simply use the other cloud FWF data container
 					fwfData() = addedCloud->fwfData();
 				}
@@ -769,24 +841,38 @@ const ccPointCloud& ccPointCloud::append(ccPointCloud* addedCloud, unsigned poin
 				//and now import waveforms
 				if (success && m_fwfWaveforms.size() == pointCountBefore)
 				{
-					for (unsigned i = 0; i < addedPoints; i++)
+					//flat version of the descriptor ID map (for parallel access)
+					int newDescriptorIDs[256];
+					for (int id = 0; id < 256; ++id)
+					{
+						newDescriptorIDs[id] = descriptorIDMap.contains(static_cast<uint8_t>(id)) ? descriptorIDMap[static_cast<uint8_t>(id)] : -1;
+					}
+
+					AppendValues(m_fwfWaveforms, addedCloud->waveforms().data(), addedPoints);
+					ccWaveform* newWaveforms = m_fwfWaveforms.data() + pointCountBefore;
+
+					int lostCount = 0;
+#if defined(_OPENMP)
+#pragma omp parallel for reduction(+:lostCount)
+#endif
+					for (int i = 0; i < static_cast<int>(addedPoints); ++i)
 					{
-						ccWaveform w = addedCloud->waveforms()[i];
-						if (descriptorIDMap.contains(w.descriptorID())) //the waveform can be imported :)
+						ccWaveform& w = newWaveforms[i];
+						int newID = newDescriptorIDs[w.descriptorID()];
+						if (newID >= 0) //the waveform can be imported :)
 						{
 							//update the byte offset
 							w.setDataDescription(w.dataOffset() + fwfDataOffset, w.byteCount());
 							//and the (potentially new) descriptor ID
-							w.setDescriptorID(descriptorIDMap[w.descriptorID()]);
-
-							m_fwfWaveforms.push_back(w);
+							w.setDescriptorID(static_cast<uint8_t>(newID));
 						}
 						else //the waveform is associated to a descriptor that couldn't be imported :(
 						{
-							m_fwfWaveforms.emplace_back(0);
-							++lostWaveformCount;
+							w = ccWaveform(0);
+							++lostCount;
 						}
 					}
+					lostWaveformCount = static_cast<size_t>(lostCount);
 				}
 
 				if (lostWaveformCount)
@@ -819,10 +905,19 @@ const ccPointCloud& ccPointCloud::append(ccPointCloud* addedCloud, unsigned poin
 					//we fill it with new values (it should have been already 'reserved' (if necessary)
 					if (sameSF->currentSize() == pointCountBefore)
 					{
+						AppendValues(*sameSF, sf->data(), addedPoints);
+
 						double shift = sf->getGlobalShift() - sameSF->getGlobalShift();
-						for (unsigned i = 0; i < addedPoints; i++)
+						if (shift != 0)
 						{
-							sameSF->addElement(static_cast<ScalarType>(shift + sf->getValue(i))); //FIXME: we could have accuracy issues here
+							ScalarType* newValues = sameSF->data() + pointCountBefore;
+#if defined(_OPENMP)
+#pragma omp parallel for
+#endif
+							for (int i = 0; i < static_cast<int>(addedPoints); ++i)
+							{
+								newValues[i] = static_cast<ScalarType>(shift + newValues[i]); //FIXME: we could have accuracy issues here
+							}
 						}
 					}
 					sameSF->computeMinAndMax();
@@ -839,10 +934,7 @@ const ccPointCloud& ccPointCloud::append(ccPointCloud* addedCloud, unsigned poin
 					if (newSF->resizeSafe(pointCountBefore + addedPoints, true, NAN_VALUE))
 					{
 						//we copy the new values
-						for (unsigned i = 0; i < addedPoints; i++)
-						{
-							newSF->setValue(pointCountBefore + i, sf->getValue(i));
-						}
+						std::copy(sf->data(), sf->data() + addedPoints, newSF->data() + pointCountBefore);
 						newSF->computeMinAndMax();
 						//copy display parameters
 						newSF->importParametersFrom(sf);
@@ -872,11 +964,7 @@ const ccPointCloud& ccPointCloud::append(ccPointCloud* addedCloud, unsigned poin
 				if (sf->currentSize() == pointCountBefore)
 				{
 					//we fill the end with NaN (as there is no equivalent in the added cloud)
-					ScalarType NaN = sf->NaN();
-					for (unsigned i = 0; i < addedPoints; i++)
-					{
-						sf->addElement(NaN);
-					}
+					sf->resize(pointCountBefore + addedPoints, sf->NaN());
 				}
 			}
 		}
@@ -1490,6 +1578,34 @@ const CCVector3& ccPointCloud::getPointNormal(unsigned pointIndex) const
 	return ccNormalVectors::GetNormal(m_normals->getValue(pointIndex));
 }
 
+void ccPointCloud::colorsHaveChanged(unsigned firstIndex, unsigned lastIndex)
+{
+	assert(firstIndex <= lastIndex);
+
+	if (m_vboManager.state != vboSet::INITIALIZED || (m_vboManager.updateFlags & vboSet::UPDATE_COLORS))
+	{
+		//the colors of all the chunks will be (re)loaded anyway
+		return;
+	}
+
+	size_t firstChunk = (firstIndex >> ccChunk::SIZE_POWER);
+	size_t lastChunk = (lastIndex >> ccChunk::SIZE_POWER);
+	std::vector<bool>& chunksToUpdate = m_vboManager.colorChunksToUpdate;
+	if (chunksToUpdate.size() <= lastChunk)
+	{
+		try
+		{
+			chunksToUpdate.resize(std::max(lastChunk + 1, ccChunk::Count(m_points)), false);
+		}
+		catch (const std::bad_alloc&)
+		{
+			colorsHaveChanged();
+			return;
+		}
+	}
+	std::fill(chunksToUpdate.begin() + firstChunk, chunksToUpdate.begin() + (lastChunk + 1), true);
+}
+
 void ccPointCloud::setPointColor(unsigned pointIndex, const ccColor::Rgba& col)
 {
 	assert(m_rgbaColors && pointIndex < m_rgbaColors->currentSize());
@@ -1497,7 +1613,7 @@ void ccPointCloud::setPointColor(unsigned pointIndex, const ccColor::Rgba& col)
 	m_rgbaColors->setValue(pointIndex, col);
 
 	//We must update the VBOs
-	colorsHaveChanged();
+	colorsHaveChanged(pointIndex, pointIndex);
 }
 
 void ccPointCloud::setPointNormalIndex(unsigned pointIndex, CompressedNormType norm)
@@ -1539,6 +1655,8 @@ void ccPointCloud::invalidateBoundingBox()
 {
 	BaseClass::invalidateBoundingBox();
 
+	invalidateChunkBBoxes();
+
 	notifyGeometryUpdate();	//calls releaseVBOs()
 }
 
@@ -1556,6 +1674,16 @@ void ccPointCloud::addNorm(const CCVector3& N)
 	addNormIndex(ccNormalVectors::GetNormIndex(N));
 }
 
+void ccPointCloud::addNorms(const CCVector3* N, unsigned count)
+{
+	assert(m_normals && m_normals->isAllocated());
+	assert(m_normals->size() + count <= m_normals->capacity());
+
+	size_t pos = m_normals->size();
+	m_normals->resize(pos + count);
+	ccNormalVectors::GetNormIndexes(N, count, m_normals->data() + pos);
+}
+
 void ccPointCloud::addNormIndex(CompressedNormType index)
 {
 	assert(m_normals && m_normals->isAllocated());
@@ -2544,7 +2672,7 @@ void ccPointCloud::drawMeOnly(CC_DRAW_CONTEXT& context)
 				return;
 			}
 
-			glFunc->glPushName(getUniqueIDForDisplay());
+			context.pushName(getUniqueIDForDisplay());
 			//minimal display for picking mode!
 			glParams.showNorms = false;
 			glParams.showColors = false;
@@ -2655,6 +2783,11 @@ void ccPointCloud::drawMeOnly(CC_DRAW_CONTEXT& context)
 
 		//ccLog::Print(QString("Rendering %1 points starting from index %2 (LoD = %3 / PN = %4)").arg(toDisplay.count).arg(toDisplay.startIndex).arg(toDisplay.indexMap ? "yes" : "no").arg(pushName ? "yes" : "no"));
 
+		if (context.renderingStats)
+		{
+			context.renderingStats->pointsDrawn += (toDisplay.count + toDisplay.decimStep - 1) / toDisplay.decimStep;
+		}
+
 		glFunc->glPushAttrib(GL_LIGHTING_BIT | GL_COLOR_BUFFER_BIT | GL_TRANSFORM_BIT | GL_POINT_BIT);
 
 		if (glParams.showSF || glParams.showColors)
@@ -2723,12 +2856,26 @@ void ccPointCloud::drawMeOnly(CC_DRAW_CONTEXT& context)
 				const ccNormalVectors* compressedNormals = ccNormalVectors::GetUniqueInstance();
 				assert(compressedNormals);
 
+				//we can skip the chunks without any visible point (if the summary is available)
+				bool useChunkVisibility = (m_chunkVisibility.size() == ccChunk::Count(m_points));
+
 				glFunc->glBegin(GL_POINTS);
 
 				for (unsigned j = toDisplay.startIndex; j < toDisplay.endIndex; j += toDisplay.decimStep)
 				{
-					//we must test each point visibility
 					unsigned pointIndex = toDisplay.indexMap ? toDisplay.indexMap->at(j) : j;
+					if (useChunkVisibility && m_chunkVisibility[pointIndex >> ccChunk::SIZE_POWER] == CHUNK_ALL_HIDDEN)
+					{
+						if (!toDisplay.indexMap)
+						{
+							//jump to the last index of this chunk (on the decimation grid)
+							unsigned chunkEnd = static_cast<unsigned>(ccChunk::StartPos((pointIndex >> ccChunk::SIZE_POWER) + 1));
+							j += ((chunkEnd - 1 - j) / toDisplay.decimStep) * toDisplay.decimStep;
+						}
+						continue;
+					}
+
+					//we must test each point visibility
 					if (m_pointsVisibility.empty() || m_pointsVisibility[pointIndex] == POINT_VISIBLE)
 					{
 						if (glParams.showSF)
@@ -3166,7 +3313,7 @@ void ccPointCloud::drawMeOnly(CC_DRAW_CONTEXT& context)
 
 		if (pushName)
 		{
-			glFunc->glPopName();
+			context.popName();
 		}
 	}
 	else if (MACRO_Draw2D(context))
@@ -3198,9 +3345,11 @@ ccPointCloud* ccPointCloud::filterPointsByScalarValue(ScalarType minVal, ScalarT
 		return nullptr;
 	}
 
-	QSharedPointer<CCLib::ReferenceCloud> c(CCLib::ManualSegmentationTools::segment(this, minVal, maxVal, outside));
+	//whole chunks are accepted or rejected thanks to the SF per-chunk ranges
+	ccPointCloudSFFilter filter(this);
+	filter.setInterval(minVal, maxVal, outside);
 
-	return (c ? partialClone(c.data()) : nullptr);
+	return filter.materialize();
 }
 
 void ccPointCloud::hidePointsByScalarValue(ScalarType minVal, ScalarType maxVal)
@@ -3219,15 +3368,10 @@ void ccPointCloud::hidePointsByScalarValue(ScalarType minVal, ScalarType maxVal)
 	}
 
 	//we use the visibility table to tag the points to filter out
-	unsigned count = size();
-	for (unsigned i = 0; i < count; ++i)
-	{
-		const ScalarType& val = sf->getValue(i);
-		if (val < minVal || val > maxVal || val != val) //handle NaN values!
-		{
-			m_pointsVisibility[i] = POINT_HIDDEN;
-		}
-	}
+	//(NaN values are hidden as well)
+	ccPointCloudSFFilter filter(this, static_cast<ccScalarField*>(sf));
+	filter.setInterval(minVal, maxVal);
+	filter.hideUnselectedPoints(m_pointsVisibility);
 }
 
 ccGenericPointCloud* ccPointCloud::createNewCloudFromVisibilitySelection(bool removeSelectedPoints/*=false*/, VisibilityTableType* visTable/*=nullptr*/, bool silent/*=false*/)
@@ -3316,19 +3460,26 @@ ccGenericPointCloud* ccPointCloud::createNewCloudFromVisibilitySelection(bool re
 			}
 		}
 
-		//we remove all visible points
-		unsigned lastPoint = 0;
-		for (unsigned i = 0; i < count; ++i)
+		//we remove all visible points (attribute by attribute)
+		RemoveVisibleValues(m_points, m_pointsVisibility);
+		unsigned lastPoint = size();
+		for (unsigned k = 0; k < getNumberOfScalarFields(); ++k)
 		{
-			if (m_pointsVisibility[i] != POINT_VISIBLE)
-			{
-				if (i != lastPoint)
-				{
-					swapPoints(lastPoint, i);
-				}
-				++lastPoint;
-			}
+			RemoveVisibleValues(*getScalarField(static_cast<int>(k)), m_pointsVisibility);
+		}
+		if (hasColors())
+		{
+			RemoveVisibleValues(*m_rgbaColors, m_pointsVisibility);
+		}
+		if (hasNormals())
+		{
+			RemoveVisibleValues(*m_normals, m_pointsVisibility);
+		}
+		if (hasFWF() && m_fwfWaveforms.size() == count)
+		{
+			RemoveVisibleValues(m_fwfWaveforms, m_pointsVisibility);
 		}
+		releaseVBOs();
 
 		unallocateVisibilityArray();
 
@@ -3407,7 +3558,7 @@ bool ccPointCloud::convertCurrentScalarFieldToColors(bool mixWithExistingColor/*
 		for (unsigned i = 0; i < count; i++)
 		{
 			const ccColor::Rgb* col = getPointScalarValueColor(i);
-			setPointColor(i, col ? *col : ccColor::blackRGB);
+			m_rgbaColors->setValue(i, ccColor::Rgba(col ? *col : ccColor::blackRGB, ccColor::MAX));
 		}
 	}
 	else //mix with existing colors
@@ -3521,7 +3672,7 @@ bool ccPointCloud::interpolateColorsFrom(	ccGenericPointCloud* otherCloud,
 	for (unsigned i = 0; i < CPSetSize; ++i)
 	{
 		unsigned index = CPSet->getPointGlobalIndex(i);
-		setPointColor(i, otherCloud->getPointColor(index));
+		m_rgbaColors->setValue(i, otherCloud->getPointColor(index));
 	}
 
 	//We must update the VBOs
@@ -4693,27 +4844,23 @@ CCLib::ReferenceCloud* ccPointCloud::crop2D(const ccPolyline* poly, unsigned cha
 		return nullptr;
 	}
 
-	CCLib::ReferenceCloud* ref = new CCLib::ReferenceCloud(this);
-	if (!ref->reserve(count))
-	{
-		ccLog::Warning("[ccPointCloud::crop] Not enough memory!");
-		delete ref;
-		return nullptr;
-	}
-
 	unsigned char X = ((orthoDim+1) % 3);
 	unsigned char Y = ((X+1) % 3);
 
-	for (unsigned i=0; i<count; ++i)
-	{
-		const CCVector3* P = point(i);
+	//projection matrix (OpenGL style): (X,Y) --> (x,y)
+	float projMat[16] = { 0 };
+	projMat[X * 4 + 0] = 1.0f;
+	projMat[Y * 4 + 1] = 1.0f;
+	projMat[15] = 1.0f;
 
-		CCVector2 P2D( P->u[X], P->u[Y] );
-		bool pointIsInside = CCLib::ManualSegmentationTools::isPointInsidePoly(P2D, poly);
-		if (inside == pointIsInside)
-		{
-			ref->addPointIndex(i);
-		}
+	//the octree (if any) lets the segmentation process whole cells at once
+	ccOctree::Shared octree = getOctree();
+
+	CCLib::ReferenceCloud* ref = CCLib::ManualSegmentationTools::segment(this, poly, inside, projMat, octree.data());
+	if (!ref)
+	{
+		ccLog::Warning("[ccPointCloud::crop] Not enough memory!");
+		return nullptr;
 	}
 
 	if (ref->size() == 0)
@@ -4721,10 +4868,6 @@ CCLib::ReferenceCloud* ccPointCloud::crop2D(const ccPolyline* poly, unsigned cha
 		//no points inside selection!
 		ref->clear(true);
 	}
-	else
-	{
-		ref->resize(ref->size());
-	}
 
 	return ref;
 }
@@ -4805,6 +4948,21 @@ bool ccPointCloud::updateVBOs(const CC_DRAW_CONTEXT& context, const glDrawParams
 		{
 			m_vboManager.updateFlags |= vboSet::UPDATE_COLORS;
 		}
+		else if (glParams.showSF && !m_currentDisplayedScalarField->getModifiedChunks().empty())
+		{
+			//only some values of the displayed SF have changed
+			const std::vector<bool>& modifiedChunks = m_currentDisplayedScalarField->getModifiedChunks();
+			const size_t chunksCount = std::min(modifiedChunks.size(), ccChunk::Count(m_points));
+			for (size_t i = 0; i < chunksCount; ++i)
+			{
+				if (modifiedChunks[i])
+				{
+					unsigned firstIndex = static_cast<unsigned>(ccChunk::StartPos(i));
+					colorsHaveChanged(firstIndex, firstIndex + static_cast<unsigned>(ccChunk::Size(i, m_points)) - 1);
+				}
+			}
+			m_currentDisplayedScalarField->setModificationFlag(false);
+		}
 
 #ifndef DONT_LOAD_NORMALS_IN_VBOS
 		if ( glParams.showNorms && !m_vboManager.hasNormals )
@@ -4815,7 +4973,19 @@ bool ccPointCloud::updateVBOs(const CC_DRAW_CONTEXT& context, const glDrawParams
 		//nothing to do?
 		if (m_vboManager.updateFlags == 0)
 		{
-			return true;
+			if (m_vboManager.colorChunksToUpdate.empty())
+			{
+				return true;
+			}
+
+			//only the colors of some chunks have changed
+			if (	(glParams.showSF || glParams.showColors)
+				&&	m_vboManager.vbos.size() == ccChunk::Count(m_points) )
+			{
+				return updateVBOColorChunks(context, glParams);
+			}
+
+			m_vboManager.updateFlags |= vboSet::UPDATE_COLORS;
 		}
 	}
 	else
@@ -4853,6 +5023,7 @@ bool ccPointCloud::updateVBOs(const CC_DRAW_CONTEXT& context, const glDrawParams
 
 	//init VBOs
 	unsigned pointsInVBOs = 0;
+	size_t uploadedBytes = 0;
 	int totalSizeBytesBefore = m_vboManager.totalMemSizeBytes;
 	m_vboManager.totalMemSizeBytes = 0;
 	{
@@ -4909,37 +5080,20 @@ bool ccPointCloud::updateVBOs(const CC_DRAW_CONTEXT& context, const glDrawParams
 				if (chunkUpdateFlags & vboSet::UPDATE_POINTS)
 				{
 					m_vboManager.vbos[chunkIndex]->write(0, ccChunk::Start(m_points, chunkIndex), sizeof(PointCoordinateType)*chunkSize * 3);
+					uploadedBytes += sizeof(PointCoordinateType)*chunkSize * 3;
 				}
 				//load colors
 				if (chunkUpdateFlags & vboSet::UPDATE_COLORS)
 				{
 					if (glParams.showSF)
 					{
-						//copy SF colors in static array
-						{
-							assert(m_vboManager.sourceSF);
-							ColorCompType* _sfColors = s_rgbBuffer4ub;
-							ScalarType* _sf = ccChunk::Start(*m_vboManager.sourceSF, chunkIndex);
-							for (int j = 0; j < chunkSize; j++, _sf++)
-							{
-								//we need to convert scalar value to color into a temporary structure
-								const ccColor::Rgb* col = _sf ? m_vboManager.sourceSF->getColor(*_sf) : nullptr;
-								if (!col)
-									col = &ccColor::lightGreyRGB;
-								*_sfColors++ = col->r;
-								*_sfColors++ = col->g;
-								*_sfColors++ = col->b;
-								*_sfColors++ = ccColor::MAX;
-							}
-						}
-						//then send them in VRAM
-						m_vboManager.vbos[chunkIndex]->write(m_vboManager.vbos[chunkIndex]->rgbShift, s_rgbBuffer4ub, sizeof(ColorCompType) * chunkSize * 4);
+						uploadedBytes += writeVBOColors(chunkIndex, true);
 						//upadte 'modification' flag for current displayed SF
 						m_vboManager.sourceSF->setModificationFlag(false);
 					}
 					else if (glParams.showColors)
 					{
-						m_vboManager.vbos[chunkIndex]->write(m_vboManager.vbos[chunkIndex]->rgbShift, ccChunk::Start(*m_rgbaColors, chunkIndex), sizeof(ColorCompType) * chunkSize * 4);
+						uploadedBytes += writeVBOColors(chunkIndex, false);
 					}
 				}
 #ifndef DONT_LOAD_NORMALS_IN_VBOS
@@ -4957,6 +5111,7 @@ bool ccPointCloud::updateVBOs(const CC_DRAW_CONTEXT& context, const glDrawParams
 						*(outNorms)++ = N.z;
 					}
 					m_vboManager.vbos[chunkIndex]->write(m_vboManager.vbos[chunkIndex]->normalShift, s_normalBuffer, sizeof(PointCoordinateType)*chunkSize * 3);
+					uploadedBytes += sizeof(PointCoordinateType)*chunkSize * 3;
 				}
 #endif
 				m_vboManager.vbos[chunkIndex]->release();
@@ -5015,12 +5170,100 @@ bool ccPointCloud::updateVBOs(const CC_DRAW_CONTEXT& context, const glDrawParams
 			.arg(static_cast<double>(pointsInVBOs) / size() * 100.0, 0, 'f', 2));
 #endif
 
+	if (context.renderingStats)
+	{
+		context.renderingStats->vboBytesUploaded += uploadedBytes;
+	}
+
 	m_vboManager.state = vboSet::INITIALIZED;
 	m_vboManager.updateFlags = 0;
+	m_vboManager.colorChunksToUpdate.clear();
 
 	return true;
 }
 
+bool ccPointCloud::updateVBOColorChunks(const CC_DRAW_CONTEXT& context, const glDrawParams& glParams)
+{
+	assert(m_vboManager.state == vboSet::INITIALIZED && m_vboManager.hasColors);
+	assert(glParams.showSF == m_vboManager.colorIsSF);
+
+	size_t uploadedBytes = 0;
+	const std::vector<bool>& chunksToUpdate = m_vboManager.colorChunksToUpdate;
+	size_t chunksCount = std::min(chunksToUpdate.size(), m_vboManager.vbos.size());
+	for (size_t chunkIndex = 0; chunkIndex < chunksCount; ++chunkIndex)
+	{
+		VBO* vbo = m_vboManager.vbos[chunkIndex];
+		if (!chunksToUpdate[chunkIndex] || !vbo || !vbo->isCreated())
+		{
+			continue;
+		}
+
+		if (!vbo->bind())
+		{
+			ccLog::Warning(QString("[ccPointCloud::updateVBOColorChunks] Failed to bind VBO to active context! (cloud '%1')").arg(getName()));
+			m_vboManager.state = vboSet::FAILED;
+			return false;
+		}
+		//only this chunk's color block is replaced (glBufferSubData)
+		uploadedBytes += writeVBOColors(chunkIndex, glParams.showSF);
+		vbo->release();
+	}
+	m_vboManager.colorChunksToUpdate.clear();
+
+	QOpenGLFunctions_2_1* glFunc = context.glFunctions<QOpenGLFunctions_2_1>();
+	assert(glFunc != nullptr);
+	if (glFunc && CatchGLErrors(glFunc->glGetError(), "ccPointCloud::updateVBOColorChunks"))
+	{
+		//the VBOs will be re-initialized next time
+		releaseVBOs();
+		return false;
+	}
+
+	if (context.renderingStats)
+	{
+		context.renderingStats->vboBytesUploaded += uploadedBytes;
+	}
+
+	return true;
+}
+
+size_t ccPointCloud::writeVBOColors(size_t chunkIndex, bool colorsFromSF)
+{
+	VBO* vbo = m_vboManager.vbos[chunkIndex];
+	assert(vbo);
+	int chunkSize = static_cast<int>(ccChunk::Size(chunkIndex, m_points));
+
+	if (colorsFromSF)
+	{
+		//copy SF colors in static array
+		{
+			assert(m_vboManager.sourceSF);
+			ColorCompType* _sfColors = s_rgbBuffer4ub;
+			ScalarType* _sf = ccChunk::Start(*m_vboManager.sourceSF, chunkIndex);
+			for (int j = 0; j < chunkSize; j++, _sf++)
+			{
+				//we need to convert scalar value to color into a temporary structure
+				const ccColor::Rgb* col = _sf ? m_vboManager.sourceSF->getColor(*_sf) : nullptr;
+				if (!col)
+					col = &ccColor::lightGreyRGB;
+				*_sfColors++ = col->r;
+				*_sfColors++ = col->g;
+				*_sfColors++ = col->b;
+				*_sfColors++ = ccColor::MAX;
+			}
+		}
+		//then send them in VRAM
+		vbo->write(vbo->rgbShift, s_rgbBuffer4ub, sizeof(ColorCompType) * chunkSize * 4);
+	}
+	else
+	{
+		assert(m_rgbaColors);
+		vbo->write(vbo->rgbShift, ccChunk::Start(*m_rgbaColors, chunkIndex), sizeof(ColorCompType) * chunkSize * 4);
+	}
+
+	return sizeof(ColorCompType) * chunkSize * 4;
+}
+
 int ccPointCloud::VBO::init(int count, bool withColors, bool withNormals, bool* reallocated/*=0*/)
 {
 	//required memory
@@ -5103,6 +5346,7 @@ void ccPointCloud::releaseVBOs()
 	}
 
 	m_vboManager.vbos.resize(0);
+	m_vboManager.colorChunksToUpdate.clear();
 	m_vboManager.hasColors = false;
 	m_vboManager.hasNormals = false;
 	m_vboManager.colorIsSF = false;
@@ -162,6 +162,12 @@ public: //features deletion/clearing
 
 	//! Notify a modification of color / scalar field display parameters or contents
 	inline void colorsHaveChanged() { m_vboManager.updateFlags |= vboSet::UPDATE_COLORS; }
+	//! Notify a modification of the colors / displayed scalar values of a range of points
+	/** Only the VBO chunks containing these points will be updated (see ccChunk).
+		\param firstIndex index of the first modified point
+		\param lastIndex index of the last modified point (included)
+	**/
+	void colorsHaveChanged(unsigned firstIndex, unsigned lastIndex);
 	//! Notify a modification of normals display parameters or contents
 	inline void normalsHaveChanged() { m_vboManager.updateFlags |= vboSet::UPDATE_NORMALS; }
 	//! Notify a modification of points display parameters or contents
@@ -519,6 +525,14 @@ public: //other methods
 	**/
 	void addNorm(const CCVector3& N);
 
+	//! Pushes several normal vectors on stack
+	/** Normals are compressed in parallel (faster than multiple calls to addNorm).
+		WARNING: memory must be reserved first (see reserveTheNormsTable).
+		\param N normal vectors
+		\param count number of normal vectors
+	**/
+	void addNorms(const CCVector3* N, unsigned count);
+
 	//! Adds a normal vector to the one at a specific index
 	/** The resulting sum is automatically normalized and compressed.
 		\param N normal vector to add (size: 3)
@@ -773,6 +787,14 @@ protected: // VBO
 	//! Init/updates VBOs
 	bool updateVBOs(const CC_DRAW_CONTEXT& context, const glDrawParams& glParams);
 
+	//! Updates the colors of the VBO chunks flagged by colorsHaveChanged(firstIndex, lastIndex)
+	bool updateVBOColorChunks(const CC_DRAW_CONTEXT& context, const glDrawParams& glParams);
+
+	//! Writes the colors (or the SF colors) of a chunk in its (bound) VBO
+	/** \return the number of uploaded bytes
+	**/
+	size_t writeVBOColors(size_t chunkIndex, bool colorsFromSF);
+
 	//! Release VBOs
 	void releaseVBOs();
 
@@ -819,6 +841,8 @@ protected: // VBO
 		{}
 
 		std::vector<VBO*> vbos;
+		//! Chunks with modified colors (if UPDATE_COLORS is not set)
+		std::vector<bool> colorChunksToUpdate;
 		bool hasColors;
 		bool colorIsSF;
 		ccScalarField* sourceSF;
@@ -849,6 +873,9 @@ public: //Level of Detail (LOD)
 	//! Clears the LOD structure
 	void clearLOD();
 
+	//! Returns the LOD structure (if any)
+	inline ccPointCloudLOD* getLOD() const { return m_lod; }
+
 protected: //Level of Detail (LOD)
 
 	//! L.O.D. structure
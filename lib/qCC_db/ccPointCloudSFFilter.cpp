@@ -0,0 +1,239 @@
+//##########################################################################
+//#                                                                        #
+//#                              CLOUDCOMPARE                              #
+//#                                                                        #
+//#  This program is free software; you can redistribute it and/or modify  #
+//#  it under the terms of the GNU General Public License as published by  #
+//#  the Free Software Foundation; version 2 or later of the License.      #
+//#                                                                        #
+//#  This program is distributed in the hope that it will be useful,       #
+//#  but WITHOUT ANY WARRANTY; without even the implied warranty of        #
+//#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the          #
+//#  GNU General Public License for more details.                          #
+//#                                                                        #
+//#                  COPYRIGHT: Daniel Girardeau-Montaut                   #
+//#                                                                        #
+//##########################################################################
+
+#include "ccPointCloudSFFilter.h"
+
+//Local
+#include "ccPointCloud.h"
+
+//CCLib
+#include <ReferenceCloud.h>
+
+//System
+#include <algorithm>
+
+ccPointCloudSFFilter::ccPointCloudSFFilter(ccPointCloud* cloud, ccScalarField* sf/*=nullptr*/)
+	: m_cloud(cloud)
+	, m_sf(sf)
+	, m_minVal(0)
+	, m_maxVal(0)
+	, m_outside(false)
+	, m_selectedCount(0)
+	, m_selectedCountIsValid(false)
+{
+	if (m_cloud && !m_sf)
+	{
+		m_sf = static_cast<ccScalarField*>(m_cloud->getCurrentOutScalarField());
+	}
+	if (m_cloud && m_sf && m_sf->size() < m_cloud->size())
+	{
+		//inconsistent scalar field
+		assert(false);
+		m_sf = nullptr;
+	}
+}
+
+void ccPointCloudSFFilter::setInterval(ScalarType minVal, ScalarType maxVal, bool outside/*=false*/)
+{
+	m_minVal = minVal;
+	m_maxVal = maxVal;
+	m_outside = outside;
+	m_selectedCountIsValid = false;
+
+	if (!isValid())
+	{
+		m_chunkStates.clear();
+		return;
+	}
+
+	size_t pointCount = m_cloud->size();
+	size_t chunkCount = ccChunk::Count(pointCount);
+	m_chunkStates.resize(chunkCount);
+
+	const std::vector<ccScalarField::ChunkRange>& ranges = m_sf->getChunkRanges();
+	if (ranges.size() < chunkCount)
+	{
+		//no (valid) chunk ranges: we'll have to test all the points
+		std::fill(m_chunkStates.begin(), m_chunkStates.end(), PARTIALLY_SELECTED);
+		return;
+	}
+
+	const ChunkState inside = (outside ? NONE_SELECTED : ALL_SELECTED);
+	const ChunkState notInside = (outside ? ALL_SELECTED : NONE_SELECTED);
+
+	for (size_t i = 0; i < chunkCount; ++i)
+	{
+		const ccScalarField::ChunkRange& range = ranges[i];
+		if (range.validCount == 0 || range.maxVal < minVal || range.minVal > maxVal)
+		{
+			//NaN values are never inside the interval
+			m_chunkStates[i] = notInside;
+		}
+		else if (range.validCount == ccChunk::Size(i, pointCount) && range.minVal >= minVal && range.maxVal <= maxVal)
+		{
+			m_chunkStates[i] = inside;
+		}
+		else
+		{
+			m_chunkStates[i] = PARTIALLY_SELECTED;
+		}
+	}
+}
+
+unsigned ccPointCloudSFFilter::size() const
+{
+	if (m_selectedCountIsValid)
+	{
+		return m_selectedCount;
+	}
+
+	size_t pointCount = (isValid() ? m_cloud->size() : 0);
+	size_t count = 0;
+
+#if defined(_OPENMP)
+#pragma omp parallel for reduction(+:count)
+#endif
+	for (int i = 0; i < static_cast<int>(m_chunkStates.size()); ++i)
+	{
+		switch (m_chunkStates[i])
+		{
+		case ALL_SELECTED:
+			count += ccChunk::Size(i, pointCount);
+			break;
+		case PARTIALLY_SELECTED:
+		{
+			unsigned start = static_cast<unsigned>(ccChunk::StartPos(i));
+			unsigned stop = start + static_cast<unsigned>(ccChunk::Size(i, pointCount));
+			for (unsigned j = start; j < stop; ++j)
+			{
+				if (testValue(j))
+					++count;
+			}
+		}
+		break;
+		default:
+			break;
+		}
+	}
+
+	m_selectedCount = static_cast<unsigned>(count);
+	m_selectedCountIsValid = true;
+
+	return m_selectedCount;
+}
+
+bool ccPointCloudSFFilter::hideUnselectedPoints(ccGenericPointCloud::VisibilityTableType& visTable) const
+{
+	if (!isValid() || visTable.size() != m_cloud->size())
+	{
+		assert(false);
+		return false;
+	}
+
+	size_t pointCount = visTable.size();
+
+#if defined(_OPENMP)
+#pragma omp parallel for
+#endif
+	for (int i = 0; i < static_cast<int>(m_chunkStates.size()); ++i)
+	{
+		unsigned char* vis = ccChunk::Start(visTable, i);
+		size_t chunkSize = ccChunk::Size(i, pointCount);
+
+		switch (m_chunkStates[i])
+		{
+		case NONE_SELECTED:
+			std::fill(vis, vis + chunkSize, POINT_HIDDEN);
+			break;
+		case PARTIALLY_SELECTED:
+		{
+			unsigned start = static_cast<unsigned>(ccChunk::StartPos(i));
+			for (unsigned j = 0; j < chunkSize; ++j)
+			{
+				if (!testValue(start + j))
+					vis[j] = POINT_HIDDEN;
+			}
+		}
+		break;
+		default:
+			break;
+		}
+	}
+
+	return true;
+}
+
+CCLib::ReferenceCloud* ccPointCloudSFFilter::toReferenceCloud() const
+{
+	if (!isValid())
+	{
+		return nullptr;
+	}
+
+	CCLib::ReferenceCloud* selection = new CCLib::ReferenceCloud(m_cloud);
+	unsigned count = size();
+	if (count == 0)
+	{
+		return selection;
+	}
+	if (!selection->reserve(count))
+	{
+		delete selection;
+		return nullptr;
+	}
+
+	size_t pointCount = m_cloud->size();
+	for (size_t i = 0; i < m_chunkStates.size(); ++i)
+	{
+		unsigned start = static_cast<unsigned>(ccChunk::StartPos(i));
+		unsigned stop = start + static_cast<unsigned>(ccChunk::Size(i, pointCount));
+
+		switch (m_chunkStates[i])
+		{
+		case ALL_SELECTED:
+			selection->addPointIndex(start, stop);
+			break;
+		case PARTIALLY_SELECTED:
+			for (unsigned j = start; j < stop; ++j)
+			{
+				if (testValue(j))
+					selection->addPointIndex(j);
+			}
+			break;
+		default:
+			break;
+		}
+	}
+
+	return selection;
+}
+
+ccPointCloud* ccPointCloudSFFilter::materialize() const
+{
+	CCLib::ReferenceCloud* selection = toReferenceCloud();
+	if (!selection)
+	{
+		return nullptr;
+	}
+
+	ccPointCloud* result = m_cloud->partialClone(selection);
+
+	delete selection;
+	selection = nullptr;
+
+	return result;
+}
@@ -0,0 +1,139 @@
+//##########################################################################
+//#                                                                        #
+//#                              CLOUDCOMPARE                              #
+//#                                                                        #
+//#  This program is free software; you can redistribute it and/or modify  #
+//#  it under the terms of the GNU General Public License as published by  #
+//#  the Free Software Foundation; version 2 or later of the License.      #
+//#                                                                        #
+//#  This program is distributed in the hope that it will be useful,       #
+//#  but WITHOUT ANY WARRANTY; without even the implied warranty of        #
+//#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the          #
+//#  GNU General Public License for more details.                          #
+//#                                                                        #
+//#                  COPYRIGHT: Daniel Girardeau-Montaut                   #
+//#                                                                        #
+//##########################################################################
+
+#ifndef CC_POINT_CLOUD_SF_FILTER_HEADER
+#define CC_POINT_CLOUD_SF_FILTER_HEADER
+
+//Local
+#include "ccChunk.h"
+#include "ccGenericPointCloud.h"
+#include "ccScalarField.h"
+
+//System
+#include <vector>
+
+class ccPointCloud;
+
+namespace CCLib
+{
+	class ReferenceCloud;
+}
+
+//! Lazily evaluated view on the points of a cloud whose scalar values fall into an interval
+/** The view relies on the per-chunk value ranges of the scalar field (see
+	ccScalarField::getChunkRanges): changing the interval only classifies the
+	chunks (fully selected, not selected at all or partially selected). The
+	points themselves are only tested when the view is counted, applied to a
+	visibility table or materialized (and only for the partially selected chunks).
+	If the ranges are not up to date (values modified since the last call to
+	computeMinAndMax), all the chunks are considered as partially selected.
+	\warning The chunks are classified by setInterval: call it again if the
+	scalar values are modified in the meantime.
+**/
+class QCC_DB_LIB_API ccPointCloudSFFilter
+{
+public:
+
+	//! Default constructor
+	/** \param cloud point cloud
+		\param sf scalar field (the current output scalar field of the cloud if none)
+	**/
+	explicit ccPointCloudSFFilter(ccPointCloud* cloud, ccScalarField* sf = nullptr);
+
+	//! Chunk selection state
+	enum ChunkState : unsigned char { NONE_SELECTED = 0, ALL_SELECTED = 1, PARTIALLY_SELECTED = 2 };
+
+	//! Returns whether the view is valid (i.e. the cloud has a scalar field)
+	inline bool isValid() const { return m_cloud && m_sf; }
+
+	//! Sets the filtering interval
+	/** Only the chunks are classified here (no point is tested).
+		\param minVal minimum value
+		\param maxVal maximum value
+		\param outside whether to select the points inside or outside of the specified interval
+	**/
+	void setInterval(ScalarType minVal, ScalarType maxVal, bool outside = false);
+
+	//! Returns the per-chunk selection states
+	inline const std::vector<ChunkState>& chunkStates() const { return m_chunkStates; }
+
+	//! Returns whether a given point is selected or not
+	inline bool isSelected(unsigned index) const
+	{
+		switch (m_chunkStates[index >> ccChunk::SIZE_POWER])
+		{
+		case ALL_SELECTED:
+			return true;
+		case NONE_SELECTED:
+			return false;
+		default:
+			return testValue(index);
+		}
+	}
+
+	//! Returns the number of selected points
+	/** Only the partially selected chunks are actually parsed (once per interval).
+	**/
+	unsigned size() const;
+
+	//! Flags the points that are not selected as hidden in a visibility table
+	/** \param visTable visibility table (must have the same size as the cloud)
+		\return success
+	**/
+	bool hideUnselectedPoints(ccGenericPointCloud::VisibilityTableType& visTable) const;
+
+	//! Converts the view to a reference cloud
+	/** \return the selected points (or nullptr if not enough memory)
+	**/
+	CCLib::ReferenceCloud* toReferenceCloud() const;
+
+	//! Materializes the view as a new cloud
+	/** \return the selected points as a new cloud (see ccPointCloud::partialClone)
+	**/
+	ccPointCloud* materialize() const;
+
+protected:
+
+	//! Tests the value of a single point
+	inline bool testValue(unsigned index) const
+	{
+		const ScalarType val = (*m_sf)[index];
+		return (val >= m_minVal && val <= m_maxVal) ^ m_outside; //NaN values are never inside
+	}
+
+	//! Associated cloud
+	ccPointCloud* m_cloud;
+	//! Associated scalar field
+	ccScalarField* m_sf;
+
+	//! Interval min value
+	ScalarType m_minVal;
+	//! Interval max value
+	ScalarType m_maxVal;
+	//! Whether points inside or outside of the interval are selected
+	bool m_outside;
+
+	//! Per-chunk selection state
+	std::vector<ChunkState> m_chunkStates;
+
+	//! Number of selected points (lazily computed)
+	mutable unsigned m_selectedCount;
+	//! Whether the number of selected points is up-to-date
+	mutable bool m_selectedCountIsValid;
+};
+
+#endif //CC_POINT_CLOUD_SF_FILTER_HEADER
@@ -193,7 +193,7 @@ void ccPolyline::drawMeOnly(CC_DRAW_CONTEXT& context)
 	//standard case: list names pushing
 	bool pushName = MACRO_DrawEntityNames(context);
 	if (pushName)
-		glFunc->glPushName(getUniqueIDForDisplay());
+		context.pushName(getUniqueIDForDisplay());
 
 	if (isColorOverriden())
 		ccGL::Color4v(glFunc, getTempColor().rgba);
@@ -297,7 +297,7 @@ void ccPolyline::drawMeOnly(CC_DRAW_CONTEXT& context)
 	}
 
 	if (pushName)
-		glFunc->glPopName();
+		context.popName();
 }
 
 void ccPolyline::setWidth(PointCoordinateType width)
@@ -18,6 +18,7 @@
 #include "ccScalarField.h"
 
 //Local
+#include "ccChunk.h"
 #include "ccColorScalesManager.h"
 
 //CCLib
@@ -58,6 +59,7 @@ ccScalarField::ccScalarField(const ccScalarField& sf)
 	, m_colorScale(sf.m_colorScale)
 	, m_colorRampSteps(sf.m_colorRampSteps)
 	, m_histogram(sf.m_histogram)
+	, m_chunkRanges(sf.m_chunkRanges)
 	, m_modified(sf.m_modified)
 	, m_globalShift(sf.m_globalShift)
 {
@@ -160,6 +162,31 @@ void ccScalarField::setLogScale(bool state)
 	}
 }
 
+//! Computes the value range of a chunk of scalar values
+static ccScalarField::ChunkRange ComputeChunkRange(const ScalarType* values, size_t count)
+{
+	ccScalarField::ChunkRange range;
+	for (size_t j = 0; j < count; ++j)
+	{
+		const ScalarType& val = values[j];
+		if (!ScalarField::ValidValue(val))
+			continue;
+		if (range.validCount++ == 0)
+		{
+			range.minVal = range.maxVal = val;
+		}
+		else if (val < range.minVal)
+		{
+			range.minVal = val;
+		}
+		else if (val > range.maxVal)
+		{
+			range.maxVal = val;
+		}
+	}
+	return range;
+}
+
 void ccScalarField::computeMinAndMax()
 {
 	ScalarField::computeMinAndMax();
@@ -214,11 +241,125 @@ void ccScalarField::computeMinAndMax()
 		}
 	}
 
+	//update per-chunk ranges
+	{
+		size_t chunkCount = ccChunk::Count(size());
+		try
+		{
+			m_chunkRanges.resize(chunkCount);
+		}
+		catch (const std::bad_alloc&)
+		{
+			ccLog::Warning("[ccScalarField::computeMinAndMax] Failed to update per-chunk ranges!");
+			m_chunkRanges.clear();
+			chunkCount = 0;
+		}
+
+#if defined(_OPENMP)
+#pragma omp parallel for
+#endif
+		for (int i = 0; i < static_cast<int>(chunkCount); ++i)
+		{
+			m_chunkRanges[i] = ComputeChunkRange(data() + ccChunk::StartPos(i), ccChunk::Size(i, size()));
+		}
+	}
+
 	m_modified = true;
 
 	updateSaturationBounds();
 }
 
+void ccScalarField::setValues(unsigned firstIndex, const ScalarType* values, unsigned count)
+{
+	if (count == 0)
+	{
+		return;
+	}
+	assert(values && static_cast<size_t>(firstIndex) + count <= size());
+
+	//we can only keep the display parameters if the [min;max] range can't change
+	bool sameRange = !valuesModified() && m_minVal < m_maxVal;
+	for (unsigned i = 0; i < count && sameRange; ++i)
+	{
+		ScalarType oldVal = getValue(firstIndex + i);
+		ScalarType newVal = values[i];
+		//the current extrema must remain, and the new values must be (valid and) inside the range
+		sameRange = (oldVal > m_minVal && oldVal < m_maxVal && newVal >= m_minVal && newVal <= m_maxVal);
+	}
+
+	if (!sameRange)
+	{
+		std::copy(values, values + count, begin() + firstIndex);
+		notifyValuesModified();
+		computeMinAndMax();
+		return;
+	}
+
+	//update histogram (same bins as computeMinAndMax)
+	if (!m_histogram.empty())
+	{
+		unsigned numberOfClasses = static_cast<unsigned>(m_histogram.size());
+		ScalarType step = static_cast<ScalarType>(numberOfClasses) / m_displayRange.maxRange();
+		for (unsigned i = 0; i < count; ++i)
+		{
+			unsigned oldBin = static_cast<unsigned>(floor((getValue(firstIndex + i) - m_displayRange.min())*step));
+			unsigned newBin = static_cast<unsigned>(floor((values[i] - m_displayRange.min())*step));
+			--m_histogram[std::min(oldBin, numberOfClasses - 1)];
+			++m_histogram[std::min(newBin, numberOfClasses - 1)];
+		}
+		m_histogram.maxValue = *std::max_element(m_histogram.begin(), m_histogram.end());
+	}
+
+	//the values are only set now (the min and max values remain valid)
+	std::copy(values, values + count, begin() + firstIndex);
+
+	//update the ranges of the modified chunks
+	unsigned lastIndex = firstIndex + count - 1;
+	if (m_chunkRanges.size() == ccChunk::Count(size()))
+	{
+		for (size_t i = (firstIndex >> ccChunk::SIZE_POWER); i <= (lastIndex >> ccChunk::SIZE_POWER); ++i)
+		{
+			m_chunkRanges[i] = ComputeChunkRange(data() + ccChunk::StartPos(i), ccChunk::Size(i, size()));
+		}
+	}
+
+	valuesHaveChanged(firstIndex, lastIndex);
+}
+
+const std::vector<ccScalarField::ChunkRange>& ccScalarField::getChunkRanges() const
+{
+	static const std::vector<ChunkRange> s_noRanges;
+	//the SF may have been modified or resized since the last call to computeMinAndMax
+	return (!valuesModified() && m_chunkRanges.size() == ccChunk::Count(size()) ? m_chunkRanges : s_noRanges);
+}
+
+void ccScalarField::valuesHaveChanged(unsigned firstIndex, unsigned lastIndex)
+{
+	assert(firstIndex <= lastIndex);
+
+	if (m_modified)
+	{
+		//all the colors will be updated anyway
+		return;
+	}
+
+	size_t firstChunk = (firstIndex >> ccChunk::SIZE_POWER);
+	size_t lastChunk = (lastIndex >> ccChunk::SIZE_POWER);
+	if (m_modifiedChunks.size() <= lastChunk)
+	{
+		try
+		{
+			m_modifiedChunks.resize(std::max(lastChunk + 1, ccChunk::Count(size())), false);
+		}
+		catch (const std::bad_alloc&)
+		{
+			m_modified = true;
+			return;
+		}
+	}
+	std::fill(m_modifiedChunks.begin() + firstChunk, m_modifiedChunks.begin() + (lastChunk + 1), true);
+}
+
 void ccScalarField::updateSaturationBounds()
 {
 	if (!m_colorScale || m_colorScale->isRelative()) //Relative scale (default)
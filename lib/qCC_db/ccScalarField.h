@@ -170,6 +170,16 @@ public:
 	//inherited
 	void computeMinAndMax() override;
 
+	//! Sets the values of a range of points
+	/** As long as the current [min;max] range is unchanged, only the histogram,
+		the ranges and the displayed colors of the chunks containing these points
+		are updated (see valuesHaveChanged). Otherwise computeMinAndMax is called.
+		\param firstIndex index of the first value to set
+		\param values new values
+		\param count number of values
+	**/
+	void setValues(unsigned firstIndex, const ScalarType* values, unsigned count);
+
 	//! Returns associated color scale
 	inline const ccColorScale::Shared& getColorScale() const { return m_colorScale; }
 
@@ -192,6 +202,22 @@ public:
 	//! Returns associated histogram values (for display)
 	inline const Histogram& getHistogram() const { return m_histogram; }
 
+	//! Value range of a chunk of scalar values (see ccChunk)
+	struct ChunkRange
+	{
+		ScalarType minVal = 0;	//!< min valid value
+		ScalarType maxVal = 0;	//!< max valid value
+		unsigned validCount = 0;//!< number of valid (i.e. non NaN) values
+	};
+
+	//! Returns the per-chunk value ranges
+	/** As the histogram, they are only updated by computeMinAndMax. They are
+		discarded as soon as the values are modified (see CCLib::ScalarField::valuesModified)
+		or the scalar field is resized.
+		\return the chunk ranges (or an empty vector if they are not valid anymore)
+	**/
+	const std::vector<ChunkRange>& getChunkRanges() const;
+
 	//! Returns whether the scalar field in its current configuration MAY have 'hidden' values or not
 	/** 'Hidden' values are typically NaN values or values outside of the 'displayed' intervale
 		while those values are not displayed in grey (see ccScalarField::showNaNValuesInGrey).
@@ -199,10 +225,24 @@ public:
 	bool mayHaveHiddenValues() const;
 
 	//! Sets modification flag state
-	inline void setModificationFlag(bool state) { m_modified = state; }
+	/** Clearing the flag also clears the modified chunks (see valuesHaveChanged).
+	**/
+	inline void setModificationFlag(bool state) { m_modified = state; if (!state) m_modifiedChunks.clear(); }
 	//! Returns modification flag state
 	inline bool getModificationFlag() const { return m_modified; }
 
+	//! Notifies a modification of the values of a range of points
+	/** Contrary to the modification flag, only the displayed colors of the
+		chunks containing these points will be updated (see ccPointCloud::updateVBOs).
+		The display parameters shouldn't have changed (call computeMinAndMax if the
+		values range may have changed, in which case all the colors are updated).
+		\param firstIndex index of the first modified value
+		\param lastIndex index of the last modified value (included)
+	**/
+	void valuesHaveChanged(unsigned firstIndex, unsigned lastIndex);
+	//! Returns the chunks modified since the last display update (see valuesHaveChanged)
+	inline const std::vector<bool>& getModifiedChunks() const { return m_modifiedChunks; }
+
 	//! Imports the parameters from another scalar field
 	void importParametersFrom(const ccScalarField* sf);
 
@@ -270,12 +310,18 @@ protected: //members
 	//! Associated histogram values (for display)
 	Histogram m_histogram;
 
+	//! Per-chunk value ranges
+	std::vector<ChunkRange> m_chunkRanges;
+
 	//! Modification flag
 	/** Any modification to the scalar field values or parameters
 		will turn this flag on.
 	**/
 	bool m_modified;
 
+	//! Chunks whose values have been modified (see valuesHaveChanged)
+	std::vector<bool> m_modifiedChunks;
+
 	//! Global shift
 	double m_globalShift;
 };
@@ -17,6 +17,9 @@
 
 #include "AsciiFilter.h"
 
+//Local
+#include "ccParallelBlockWriter.h"
+
 //Qt
 #include <QFile>
 #include <QFileInfo>
@@ -29,6 +32,7 @@
 
 //qCC_db
 #include <cc2DLabel.h>
+#include <ccChunk.h>
 #include <ccHObjectCaster.h>
 #include <ccLog.h>
 #include <ccPointCloud.h>
@@ -37,11 +41,42 @@
 
 //System
 #include <cassert>
+#include <charconv>
 #include <cstring>
+#include <string>
 
 //Qt
 #include <QScopedPointer>
 
+//! Appends a number with a fixed number of decimals (same output as QString::number(value, 'f', precision))
+static inline void AppendFixed(std::string& buffer, double value, int precision)
+{
+	char digits[512];
+	std::to_chars_result res = std::to_chars(digits, digits + sizeof(digits), value, std::chars_format::fixed, precision);
+	if (res.ec == std::errc())
+		buffer.append(digits, res.ptr);
+	else //too many digits
+		buffer.append(QString::number(value, 'f', precision).toStdString());
+}
+
+//! Appends a number with 6 significant digits (same output as QString::number(value))
+static inline void AppendGeneral(std::string& buffer, double value)
+{
+	char digits[32];
+	std::to_chars_result res = std::to_chars(digits, digits + sizeof(digits), value, std::chars_format::general, 6);
+	assert(res.ec == std::errc());
+	buffer.append(digits, res.ptr);
+}
+
+//! Appends an integer number
+static inline void AppendInteger(std::string& buffer, unsigned value)
+{
+	char digits[16];
+	std::to_chars_result res = std::to_chars(digits, digits + sizeof(digits), value);
+	assert(res.ec == std::errc());
+	buffer.append(digits, res.ptr);
+}
+
 Garbage<QDialog> s_dialogGarbage;
 AsciiSaveDlg* s_saveDialog(nullptr);
 AsciiOpenDlg* s_openDialog(nullptr);
@@ -295,97 +330,99 @@ CC_FILE_ERROR AsciiFilter::saveToFile(ccHObject* entity, const QString& filename
 		stream << QString::number(numberOfPoints) << "\n";
 	}
 
-	CC_FILE_ERROR result = CC_FERR_NO_ERROR;
-	for (unsigned i = 0; i < numberOfPoints; ++i)
+	//the points are written in blocks (formatted in parallel)
+	stream.flush();
+
+	const char separatorChar = separator.toLatin1();
+
+	auto appendColor = [&](std::string& buffer, const ccColor::Rgba& col)
 	{
-		//line for the current point
-		QString line;
-
-		//write current point coordinates
-		const CCVector3* P = cloud->getPoint(i);
-		CCVector3d Pglobal = cloud->toGlobal3d<PointCoordinateType>(*P);
-		line.append(QString::number(Pglobal.x, 'f', s_coordPrecision));
-		line.append(separator);
-		line.append(QString::number(Pglobal.y, 'f', s_coordPrecision));
-		line.append(separator);
-		line.append(QString::number(Pglobal.z, 'f', s_coordPrecision));
-
-		QString colorLine;
-		if (writeColors)
+		if (saveFloatColors)
 		{
-			//add rgb color
-			const ccColor::Rgba& col = cloud->getPointColor(i);
-			if (saveFloatColors)
+			buffer.push_back(separatorChar);
+			AppendGeneral(buffer, static_cast<double>(col.r) / ccColor::MAX);
+			buffer.push_back(separatorChar);
+			AppendGeneral(buffer, static_cast<double>(col.g) / ccColor::MAX);
+			buffer.push_back(separatorChar);
+			AppendGeneral(buffer, static_cast<double>(col.b) / ccColor::MAX);
+			if (saveAlphaChannel)
 			{
-				colorLine.append(separator);
-				colorLine.append(QString::number(static_cast<double>(col.r) / ccColor::MAX));
-				colorLine.append(separator);
-				colorLine.append(QString::number(static_cast<double>(col.g) / ccColor::MAX));
-				colorLine.append(separator);
-				colorLine.append(QString::number(static_cast<double>(col.b) / ccColor::MAX));
-				if (saveAlphaChannel)
-				{
-					colorLine.append(separator);
-					colorLine.append(QString::number(static_cast<double>(col.a) / ccColor::MAX));
-				}
+				buffer.push_back(separatorChar);
+				AppendGeneral(buffer, static_cast<double>(col.a) / ccColor::MAX);
 			}
-			else
+		}
+		else
+		{
+			buffer.push_back(separatorChar);
+			AppendInteger(buffer, col.r);
+			buffer.push_back(separatorChar);
+			AppendInteger(buffer, col.g);
+			buffer.push_back(separatorChar);
+			AppendInteger(buffer, col.b);
+			if (saveAlphaChannel)
 			{
-				colorLine.append(separator);
-				colorLine.append(QString::number(col.r));
-				colorLine.append(separator);
-				colorLine.append(QString::number(col.g));
-				colorLine.append(separator);
-				colorLine.append(QString::number(col.b));
-				if (saveAlphaChannel)
+				buffer.push_back(separatorChar);
+				AppendInteger(buffer, col.a);
+			}
+		}
+	};
+
+	auto formatPoints = [&](unsigned firstIndex, unsigned count, std::string& buffer)
+	{
+		for (unsigned i = firstIndex; i < firstIndex + count; ++i)
+		{
+			//write current point coordinates
+			const CCVector3* P = cloud->getPoint(i);
+			CCVector3d Pglobal = cloud->toGlobal3d<PointCoordinateType>(*P);
+			AppendFixed(buffer, Pglobal.x, s_coordPrecision);
+			buffer.push_back(separatorChar);
+			AppendFixed(buffer, Pglobal.y, s_coordPrecision);
+			buffer.push_back(separatorChar);
+			AppendFixed(buffer, Pglobal.z, s_coordPrecision);
+
+			if (writeColors && !swapColorAndSFs)
+			{
+				appendColor(buffer, cloud->getPointColor(i));
+			}
+
+			if (writeSF)
+			{
+				//add each associated SF values
+				for (const ccScalarField* sf : theScalarFields)
 				{
-					colorLine.append(separator);
-					colorLine.append(QString::number(col.a));
+					buffer.push_back(separatorChar);
+					double sfVal = sf->getGlobalShift() + sf->getValue(i);
+					AppendFixed(buffer, sfVal, s_sfPrecision);
 				}
 			}
 
-			if (!swapColorAndSFs)
+			if (writeColors && swapColorAndSFs)
 			{
-				line.append(colorLine);
+				appendColor(buffer, cloud->getPointColor(i));
 			}
-		}
 
-		if (writeSF)
-		{
-			//add each associated SF values
-			for (std::vector<ccScalarField*>::const_iterator it = theScalarFields.begin(); it != theScalarFields.end(); ++it)
+			if (writeNorms)
 			{
-				line.append(separator);
-				double sfVal = (*it)->getGlobalShift() + (*it)->getValue(i);
-				line.append(QString::number(sfVal, 'f', s_sfPrecision));
+				//add normal vector
+				const CCVector3& N = cloud->getPointNormal(i);
+				buffer.push_back(separatorChar);
+				AppendFixed(buffer, N.x, s_nPrecision);
+				buffer.push_back(separatorChar);
+				AppendFixed(buffer, N.y, s_nPrecision);
+				buffer.push_back(separatorChar);
+				AppendFixed(buffer, N.z, s_nPrecision);
 			}
-		}
-
-		if (writeColors && swapColorAndSFs)
-			line.append(colorLine);
 
-		if (writeNorms)
-		{
-			//add normal vector
-			const CCVector3& N = cloud->getPointNormal(i);
-			line.append(separator);
-			line.append(QString::number(N.x, 'f', s_nPrecision));
-			line.append(separator);
-			line.append(QString::number(N.y, 'f', s_nPrecision));
-			line.append(separator);
-			line.append(QString::number(N.z, 'f', s_nPrecision));
+			buffer.push_back('\n');
 		}
+	};
 
-		stream << line << "\n";
-
-		if (pDlg && !nprogress.oneStep())
-		{
-			result = CC_FERR_CANCELED_BY_USER;
-			break;
-		}
-	}
+	auto writeBlock = [&file](const std::string& buffer, unsigned)
+	{
+		return file.write(buffer.data(), static_cast<qint64>(buffer.size())) == static_cast<qint64>(buffer.size());
+	};
 
-	return result;
+	return ccParallelBlockWriter::Process(numberOfPoints, formatPoints, writeBlock, &nprogress);
 }
 
 CC_FILE_ERROR AsciiFilter::loadFile(const QString& filename,
@@ -823,6 +860,17 @@ CC_FILE_ERROR AsciiFilter::loadCloudFromFormatedAsciiFile(	const QString& filena
 	ccColor::Rgba col(0, 0, 0, 255);
 	bool preserveCoordinateShift = true;
 
+	//normals are compressed in parallel, one chunk at a time
+	std::vector<CCVector3> normalBuffer;
+	auto flushNormalBuffer = [&]()
+	{
+		if (!normalBuffer.empty())
+		{
+			cloudDesc.cloud->addNorms(normalBuffer.data(), static_cast<unsigned>(normalBuffer.size()));
+			normalBuffer.clear();
+		}
+	};
+
 	//other useful variables
 	unsigned linesRead = 0;
 	unsigned pointsRead = 0;
@@ -887,6 +935,7 @@ CC_FILE_ERROR AsciiFilter::loadCloudFromFormatedAsciiFile(	const QString& filena
 				ccLog::PrintDebug("[ASCII] We choose to instantiate new clouds");
 
 				//we store (and resize) actual cloud
+				flushNormalBuffer();
 				if (!cloudDesc.cloud->resize(cloudChunkSize))
 					ccLog::Warning("Memory reallocation failed ... some memory may have been wasted ...");
 				if (!cloudDesc.scalarFields.empty())
@@ -995,7 +1044,11 @@ CC_FILE_ERROR AsciiFilter::loadCloudFromFormatedAsciiFile(	const QString& filena
 					N.y = static_cast<PointCoordinateType>(locale.toDouble(parts[cloudDesc.yNormIndex]));
 				if (cloudDesc.zNormIndex >= 0)
 					N.z = static_cast<PointCoordinateType>(locale.toDouble(parts[cloudDesc.zNormIndex]));
-				cloudDesc.cloud->addNorm(N);
+				normalBuffer.push_back(N);
+				if (normalBuffer.size() == ccChunk::SIZE)
+				{
+					flushNormalBuffer();
+				}
 			}
 
 			//Colors
@@ -1092,6 +1145,8 @@ CC_FILE_ERROR AsciiFilter::loadCloudFromFormatedAsciiFile(	const QString& filena
 
 	if (cloudDesc.cloud)
 	{
+		flushNormalBuffer();
+
 		if (cloudDesc.cloud->size() < cloudDesc.cloud->capacity())
 			cloudDesc.cloud->resize(cloudDesc.cloud->size());
 
@@ -19,6 +19,7 @@
 #include "FileIO.h"
 
 //Local
+#include "ccParallelBlockWriter.h"
 #include "PlyOpenDlg.h"
 
 //Qt
@@ -26,8 +27,10 @@
 #include <QImage>
 #include <QMessageBox>
 #include <QPushButton>
+#include <QSysInfo>
 
 //qCC_db
+#include <ccChunk.h>
 #include <ccHObjectCaster.h>
 #include <ccLog.h>
 #include <ccMaterial.h>
@@ -40,6 +43,7 @@
 //System
 #include <cassert>
 #include <cstring>
+#include <string>
 #if defined(CC_WINDOWS)
 #include <windows.h>
 #else
@@ -81,6 +85,13 @@ static void errorCallback(p_ply _ply, const char *message) {
 	ccLog::Error("[PLY] '%s'", message);
 }
 
+//! Encodes a value (native byte order) and moves the output pointer
+template <typename T> static inline void EncodeValue(char*& out, T value)
+{
+	memcpy(out, &value, sizeof(T));
+	out += sizeof(T);
+}
+
 void PlyFilter::SetDefaultOutputFormat(e_ply_storage_mode format)
 {
 	s_defaultOutputFormat = format;
@@ -392,71 +403,194 @@ CC_FILE_ERROR PlyFilter::saveToFile(ccHObject* entity, QString filename, e_ply_s
 		return CC_FERR_THIRD_PARTY_LIB_FAILURE;
 	}
 
-	//save the point cloud (=vertices)
-	for (unsigned i=0; i<vertCount; ++i)
+	//binary file with the native byte order: the vertices and faces are
+	//encoded in memory (in parallel) and written by blocks
+	e_ply_storage_mode fileStorageType = PLY_ASCII;
+	get_plystorage_mode(ply, &fileStorageType);
+	const e_ply_storage_mode nativeStorageType = (QSysInfo::ByteOrder == QSysInfo::LittleEndian ? PLY_LITTLE_ENDIAN : PLY_BIG_ENDIAN);
+	if (fileStorageType == nativeStorageType)
 	{
-		const CCVector3* P = vertices->getPoint(i);
-		CCVector3d Pglobal = vertices->toGlobal3d<PointCoordinateType>(*P);
-		ply_write(ply, Pglobal.x);
-		ply_write(ply, Pglobal.y);
-		ply_write(ply, Pglobal.z);
-
-		if (hasColors)
+		auto writeBlock = [ply](const std::string& buffer, unsigned count)
 		{
-			const ccColor::Rgb& col = vertices->getPointColor(i);
-			ply_write(ply, static_cast<double>(col.r));
-			ply_write(ply, static_cast<double>(col.g));
-			ply_write(ply, static_cast<double>(col.b));
-		}
-		else if (hasUniqueColor)
+			return ply_write_instances(ply, buffer.data(), buffer.size(), static_cast<long>(count)) != 0;
+		};
+
+		//vertex records
+		const bool coordsAsDouble = (coordType == PLY_DOUBLE);
+		const size_t vertexSize =	3 * (coordsAsDouble ? sizeof(double) : sizeof(float))
+								+	(hasColors || hasUniqueColor ? 3 * sizeof(ColorCompType) : 0)
+								+	(hasNormals ? 3 * sizeof(PointCoordinateType) : 0)
+								+	scalarFields.size() * sizeof(ScalarType);
+
+		auto encodeVertices = [&](unsigned firstIndex, unsigned count, std::string& buffer)
 		{
-			ply_write(ply, static_cast<double>(uniqueColor[0]));
-			ply_write(ply, static_cast<double>(uniqueColor[1]));
-			ply_write(ply, static_cast<double>(uniqueColor[2]));
-		}
+			buffer.resize(count * vertexSize);
+			char* out = &buffer[0];
+			for (unsigned i = firstIndex; i < firstIndex + count; ++i)
+			{
+				const CCVector3* P = vertices->getPoint(i);
+				CCVector3d Pglobal = vertices->toGlobal3d<PointCoordinateType>(*P);
+				if (coordsAsDouble)
+				{
+					EncodeValue<double>(out, Pglobal.x);
+					EncodeValue<double>(out, Pglobal.y);
+					EncodeValue<double>(out, Pglobal.z);
+				}
+				else
+				{
+					EncodeValue<float>(out, static_cast<float>(Pglobal.x));
+					EncodeValue<float>(out, static_cast<float>(Pglobal.y));
+					EncodeValue<float>(out, static_cast<float>(Pglobal.z));
+				}
 
-		if (hasNormals)
+				if (hasColors)
+				{
+					const ccColor::Rgb& col = vertices->getPointColor(i);
+					EncodeValue<ColorCompType>(out, col.r);
+					EncodeValue<ColorCompType>(out, col.g);
+					EncodeValue<ColorCompType>(out, col.b);
+				}
+				else if (hasUniqueColor)
+				{
+					EncodeValue<ColorCompType>(out, uniqueColor[0]);
+					EncodeValue<ColorCompType>(out, uniqueColor[1]);
+					EncodeValue<ColorCompType>(out, uniqueColor[2]);
+				}
+
+				if (hasNormals)
+				{
+					const CCVector3& N = vertices->getPointNormal(i);
+					EncodeValue<PointCoordinateType>(out, N.x);
+					EncodeValue<PointCoordinateType>(out, N.y);
+					EncodeValue<PointCoordinateType>(out, N.z);
+				}
+
+				for (const ccScalarField* sf : scalarFields)
+				{
+					EncodeValue<ScalarType>(out, static_cast<ScalarType>(sf->getGlobalShift() + sf->getValue(i)));
+				}
+			}
+			assert(out == buffer.data() + buffer.size());
+		};
+
+		CC_FILE_ERROR error = ccParallelBlockWriter::Process(vertCount, encodeVertices, writeBlock);
+
+		//face records
+		if (error == CC_FERR_NO_ERROR && mesh)
 		{
-			const CCVector3& N = vertices->getPointNormal(i);
-			ply_write(ply, static_cast<double>(N.x));
-			ply_write(ply, static_cast<double>(N.y));
-			ply_write(ply, static_cast<double>(N.z));
+			const size_t faceSize =	sizeof(unsigned char) + 3 * sizeof(int)
+								+	(material ? sizeof(unsigned char) + 6 * sizeof(float) : 0);
+
+			auto encodeFaces = [&](unsigned firstIndex, unsigned count, std::string& buffer)
+			{
+				buffer.resize(count * faceSize);
+				char* out = &buffer[0];
+				for (unsigned i = firstIndex; i < firstIndex + count; ++i)
+				{
+					const CCLib::VerticesIndexes* tsi = mesh->getTriangleVertIndexes(i);
+					assert(tsi->i1 < vertCount);
+					assert(tsi->i2 < vertCount);
+					assert(tsi->i3 < vertCount);
+					EncodeValue<unsigned char>(out, 3);
+					EncodeValue<int>(out, static_cast<int>(tsi->i1));
+					EncodeValue<int>(out, static_cast<int>(tsi->i2));
+					EncodeValue<int>(out, static_cast<int>(tsi->i3));
+
+					if (material) //texture coordinates
+					{
+						TexCoords2D *tx1 = nullptr;
+						TexCoords2D *tx2 = nullptr;
+						TexCoords2D *tx3 = nullptr;
+						mesh->getTriangleTexCoordinates(i, tx1, tx2, tx3);
+						EncodeValue<unsigned char>(out, 6);
+						EncodeValue<float>(out, tx1 ? tx1->tx : -1.0f);
+						EncodeValue<float>(out, tx1 ? tx1->ty : -1.0f);
+						EncodeValue<float>(out, tx2 ? tx2->tx : -1.0f);
+						EncodeValue<float>(out, tx2 ? tx2->ty : -1.0f);
+						EncodeValue<float>(out, tx3 ? tx3->tx : -1.0f);
+						EncodeValue<float>(out, tx3 ? tx3->ty : -1.0f);
+					}
+				}
+				assert(out == buffer.data() + buffer.size());
+			};
+
+			error = ccParallelBlockWriter::Process(triNum, encodeFaces, writeBlock);
 		}
 
-		for (std::vector<ccScalarField*>::const_iterator sf = scalarFields.begin(); sf != scalarFields.end(); ++sf)
+		if (error != CC_FERR_NO_ERROR)
 		{
-			ply_write(ply, (*sf)->getGlobalShift() + (*sf)->getValue(i));
+			ply_close(ply);
+			return error;
 		}
 	}
-
-	//and the mesh structure
-	if (mesh)
+	else
 	{
-		mesh->placeIteratorAtBeginning();
-		for (unsigned i = 0; i < triNum; ++i)
+		//save the point cloud (=vertices)
+		for (unsigned i=0; i<vertCount; ++i)
+		{
+			const CCVector3* P = vertices->getPoint(i);
+			CCVector3d Pglobal = vertices->toGlobal3d<PointCoordinateType>(*P);
+			ply_write(ply, Pglobal.x);
+			ply_write(ply, Pglobal.y);
+			ply_write(ply, Pglobal.z);
+
+			if (hasColors)
+			{
+				const ccColor::Rgb& col = vertices->getPointColor(i);
+				ply_write(ply, static_cast<double>(col.r));
+				ply_write(ply, static_cast<double>(col.g));
+				ply_write(ply, static_cast<double>(col.b));
+			}
+			else if (hasUniqueColor)
+			{
+				ply_write(ply, static_cast<double>(uniqueColor[0]));
+				ply_write(ply, static_cast<double>(uniqueColor[1]));
+				ply_write(ply, static_cast<double>(uniqueColor[2]));
+			}
+
+			if (hasNormals)
+			{
+				const CCVector3& N = vertices->getPointNormal(i);
+				ply_write(ply, static_cast<double>(N.x));
+				ply_write(ply, static_cast<double>(N.y));
+				ply_write(ply, static_cast<double>(N.z));
+			}
+
+			for (std::vector<ccScalarField*>::const_iterator sf = scalarFields.begin(); sf != scalarFields.end(); ++sf)
+			{
+				ply_write(ply, (*sf)->getGlobalShift() + (*sf)->getValue(i));
+			}
+		}
+
+		//and the mesh structure
+		if (mesh)
 		{
-			const CCLib::VerticesIndexes* tsi = mesh->getNextTriangleVertIndexes(); //DGM: getNextTriangleVertIndexes is faster for mesh groups!
-			ply_write(ply, double(3));
-			assert(tsi->i1 < vertCount);
-			assert(tsi->i2 < vertCount);
-			assert(tsi->i3 < vertCount);
-			ply_write(ply, double(tsi->i1));
-			ply_write(ply, double(tsi->i2));
-			ply_write(ply, double(tsi->i3));
-
-			if (material) //texture coordinates
+			mesh->placeIteratorAtBeginning();
+			for (unsigned i = 0; i < triNum; ++i)
 			{
-				ply_write(ply, 6.0);
-				TexCoords2D *tx1 = nullptr;
-				TexCoords2D *tx2 = nullptr;
-				TexCoords2D *tx3 = nullptr;
-				mesh->getTriangleTexCoordinates(i, tx1, tx2, tx3);
-				ply_write(ply, tx1 ? tx1->tx : -1.0);
-				ply_write(ply, tx1 ? tx1->ty : -1.0);
-				ply_write(ply, tx2 ? tx2->tx : -1.0);
-				ply_write(ply, tx2 ? tx2->ty : -1.0);
-				ply_write(ply, tx3 ? tx3->tx : -1.0);
-				ply_write(ply, tx3 ? tx3->ty : -1.0);
+				const CCLib::VerticesIndexes* tsi = mesh->getNextTriangleVertIndexes(); //DGM: getNextTriangleVertIndexes is faster for mesh groups!
+				ply_write(ply, double(3));
+				assert(tsi->i1 < vertCount);
+				assert(tsi->i2 < vertCount);
+				assert(tsi->i3 < vertCount);
+				ply_write(ply, double(tsi->i1));
+				ply_write(ply, double(tsi->i2));
+				ply_write(ply, double(tsi->i3));
+
+				if (material) //texture coordinates
+				{
+					ply_write(ply, 6.0);
+					TexCoords2D *tx1 = nullptr;
+					TexCoords2D *tx2 = nullptr;
+					TexCoords2D *tx3 = nullptr;
+					mesh->getTriangleTexCoordinates(i, tx1, tx2, tx3);
+					ply_write(ply, tx1 ? tx1->tx : -1.0);
+					ply_write(ply, tx1 ? tx1->ty : -1.0);
+					ply_write(ply, tx2 ? tx2->tx : -1.0);
+					ply_write(ply, tx2 ? tx2->ty : -1.0);
+					ply_write(ply, tx3 ? tx3->tx : -1.0);
+					ply_write(ply, tx3 ? tx3->ty : -1.0);
+				}
 			}
 		}
 	}
@@ -489,6 +623,17 @@ static CCVector3d s_Pshift(0, 0, 0);
 bool s_hasQuads = false;
 bool s_hasMaterials = false;
 std::vector<bool> s_triIsQuad;
+//! Normals buffer (compressed in parallel, one chunk at a time)
+static std::vector<CCVector3> s_NormalBuffer;
+
+static void FlushNormalBuffer(ccPointCloud* cloud)
+{
+	if (!s_NormalBuffer.empty())
+	{
+		cloud->addNorms(s_NormalBuffer.data(), static_cast<unsigned>(s_NormalBuffer.size()));
+		s_NormalBuffer.clear();
+	}
+}
 
 static int vertex_cb(p_ply_argument argument)
 {
@@ -562,7 +707,11 @@ static int normal_cb(p_ply_argument argument)
 
 	if (flags & ELEM_EOL)
 	{
-		cloud->addNorm(s_Normal);
+		s_NormalBuffer.push_back(s_Normal);
+		if (s_NormalBuffer.size() == ccChunk::SIZE)
+		{
+			FlushNormalBuffer(cloud);
+		}
 		++s_NormalCount;
 
 		if ((s_NormalCount % PROCESS_EVENTS_FREQ) == 0)
@@ -875,6 +1024,8 @@ CC_FILE_ERROR PlyFilter::loadFile(const QString& filename, const QString& inputT
 	s_IntensityCount = 0;
 	s_ColorCount = 0;
 	s_NormalCount = 0;
+	s_NormalBuffer.clear();
+	s_NormalBuffer.reserve(ccChunk::SIZE);
 	s_PointCount = 0;
 	s_PointDataCorrupted = false;
 	s_NotEnoughMemory = false;
@@ -1696,6 +1847,14 @@ CC_FILE_ERROR PlyFilter::loadFile(const QString& filename, const QString& inputT
 
 	ply_close(ply);
 
+	//compress the remaining normals
+	if (cloud->hasNormals())
+	{
+		FlushNormalBuffer(cloud);
+	}
+	s_NormalBuffer.clear();
+	s_NormalBuffer.shrink_to_fit();
+
 	if (pDlg)
 	{
 		pDlg.reset();
@@ -0,0 +1,129 @@
+//##########################################################################
+//#                                                                        #
+//#                              CLOUDCOMPARE                              #
+//#                                                                        #
+//#  This program is free software; you can redistribute it and/or modify  #
+//#  it under the terms of the GNU General Public License as published by  #
+//#  the Free Software Foundation; version 2 or later of the License.      #
+//#                                                                        #
+//#  This program is distributed in the hope that it will be useful,       #
+//#  but WITHOUT ANY WARRANTY; without even the implied warranty of        #
+//#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the          #
+//#  GNU General Public License for more details.                          #
+//#                                                                        #
+//#          COPYRIGHT: CloudCompare project                               #
+//#                                                                        #
+//##########################################################################
+
+#include "ccParallelBlockWriter.h"
+
+//CCLib
+#include <GenericProgressCallback.h>
+
+//Qt
+#include <QFuture>
+#include <QThread>
+#include <QtConcurrentMap>
+#include <QtConcurrentRun>
+
+//system
+#include <algorithm>
+#include <cassert>
+#include <vector>
+
+namespace
+{
+	//! Block of encoded elements
+	struct Block
+	{
+		unsigned firstIndex = 0;
+		unsigned count = 0;
+		std::string buffer;
+	};
+
+	//! Batch of blocks (encoded together, written together)
+	using Batch = std::vector<Block>;
+}
+
+CC_FILE_ERROR ccParallelBlockWriter::Process(	unsigned elementCount,
+												EncodeFunction encode,
+												WriteFunction write,
+												CCLib::NormalizedProgress* nprogress/*=nullptr*/,
+												unsigned blockSize/*=DEFAULT_BLOCK_SIZE*/)
+{
+	assert(encode && write);
+	if (elementCount == 0)
+	{
+		return CC_FERR_NO_ERROR;
+	}
+	blockSize = std::max(1u, blockSize);
+
+	//a few blocks per thread so that the threads are kept busy
+	const unsigned blocksPerBatch = static_cast<unsigned>(std::max(1, QThread::idealThreadCount()) * 2);
+
+	//two batches: one being encoded while the other one is being written
+	Batch batches[2];
+	QFuture<bool> pendingWrite;
+	bool pending = false;
+
+	auto writeBatch = [&write](const Batch* batch) -> bool
+	{
+		for (const Block& block : *batch)
+		{
+			if (!write(block.buffer, block.count))
+			{
+				return false;
+			}
+		}
+		return true;
+	};
+
+	CC_FILE_ERROR result = CC_FERR_NO_ERROR;
+	unsigned batchIndex = 0;
+	for (unsigned firstIndex = 0; firstIndex < elementCount; ++batchIndex)
+	{
+		//prepare the next batch (the buffers are reused)
+		Batch& batch = batches[batchIndex & 1];
+		batch.resize(blocksPerBatch);
+		unsigned batchCount = 0;
+		size_t blockCount = 0;
+		for (; blockCount < blocksPerBatch && firstIndex < elementCount; ++blockCount)
+		{
+			Block& block = batch[blockCount];
+			block.firstIndex = firstIndex;
+			block.count = std::min(blockSize, elementCount - firstIndex);
+			block.buffer.clear();
+			firstIndex += block.count;
+			batchCount += block.count;
+		}
+		batch.resize(blockCount);
+
+		QtConcurrent::blockingMap(batch, [&encode](Block& block) { encode(block.firstIndex, block.count, block.buffer); });
+
+		//wait for the previous batch to be written before writing this one
+		if (pending)
+		{
+			pending = false;
+			if (!pendingWrite.result())
+			{
+				result = CC_FERR_WRITING;
+				break;
+			}
+		}
+		pendingWrite = QtConcurrent::run(writeBatch, &batch);
+		pending = true;
+
+		if (nprogress && !nprogress->steps(batchCount))
+		{
+			result = CC_FERR_CANCELED_BY_USER;
+			break;
+		}
+	}
+
+	if (pending && !pendingWrite.result() && result == CC_FERR_NO_ERROR)
+	{
+		result = CC_FERR_WRITING;
+	}
+
+	return result;
+}
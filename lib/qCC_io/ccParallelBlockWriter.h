@@ -0,0 +1,69 @@
+//##########################################################################
+//#                                                                        #
+//#                              CLOUDCOMPARE                              #
+//#                                                                        #
+//#  This program is free software; you can redistribute it and/or modify  #
+//#  it under the terms of the GNU General Public License as published by  #
+//#  the Free Software Foundation; version 2 or later of the License.      #
+//#                                                                        #
+//#  This program is distributed in the hope that it will be useful,       #
+//#  but WITHOUT ANY WARRANTY; without even the implied warranty of        #
+//#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the          #
+//#  GNU General Public License for more details.                          #
+//#                                                                        #
+//#          COPYRIGHT: CloudCompare project                               #
+//#                                                                        #
+//##########################################################################
+
+#ifndef CC_PARALLEL_BLOCK_WRITER_HEADER
+#define CC_PARALLEL_BLOCK_WRITER_HEADER
+
+//Local
+#include "FileIOFilter.h"
+
+//system
+#include <functional>
+#include <string>
+
+namespace CCLib
+{
+	class NormalizedProgress;
+}
+
+//! Encodes consecutive blocks of elements (points, faces, etc.) in parallel and writes them in order
+/** The blocks of a batch are encoded concurrently (each in its own buffer)
+	while the previous batch is being written by another thread. The writing
+	function is therefore never called concurrently, and always in the
+	elements order.
+**/
+class ccParallelBlockWriter
+{
+public:
+
+	//! Encoding function: appends the encoded elements [firstIndex, firstIndex + count[ to a buffer
+	/** \warning Called concurrently (with distinct buffers)
+	**/
+	using EncodeFunction = std::function<void(unsigned firstIndex, unsigned count, std::string& buffer)>;
+
+	//! Writing function: writes a buffer (holding 'count' encoded elements)
+	using WriteFunction = std::function<bool(const std::string& buffer, unsigned count)>;
+
+	//! Default number of elements per block
+	static const unsigned DEFAULT_BLOCK_SIZE = 16384;
+
+	//! Encodes and writes 'elementCount' elements
+	/** \param elementCount number of elements
+		\param encode encoding function
+		\param write writing function
+		\param nprogress optional progress (updated once per batch, from the calling thread)
+		\param blockSize number of elements per block
+		\return CC_FERR_NO_ERROR, CC_FERR_WRITING or CC_FERR_CANCELED_BY_USER
+	**/
+	static CC_FILE_ERROR Process(	unsigned elementCount,
+									EncodeFunction encode,
+									WriteFunction write,
+									CCLib::NormalizedProgress* nprogress = nullptr,
+									unsigned blockSize = DEFAULT_BLOCK_SIZE);
+};
+
+#endif //CC_PARALLEL_BLOCK_WRITER_HEADER
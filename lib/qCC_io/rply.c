@@ -686,6 +686,40 @@ int ply_write(p_ply ply, double value) {
     return !breakafter || putc('\n', ply->fp) > 0;
 }
 
+int ply_write_instances(p_ply ply, const void *data, size_t size, 
+        long ninstances) {
+    p_ply_element element = NULL;
+    assert(ply && ply->fp && ply->io_mode == PLY_WRITE);
+    if (ply->storage_mode == PLY_ASCII || ply->welement >= ply->nelements) {
+        ply_ferror(ply, "Invalid block of instances");
+        return 0;
+    }
+    element = &ply->element[ply->welement];
+    if (ply->wproperty != 0 || ply->wvalue_index != 0 || ninstances < 0 ||
+        ply->winstance_index + ninstances > element->ninstances) {
+        ply_ferror(ply, "Invalid block of instances");
+        return 0;
+    }
+    /* flush the values written with ply_write first */
+    if (ply->buffer_last > 0) {
+        if (fwrite(ply->buffer, 1, ply->buffer_last, ply->fp) < ply->buffer_last) {
+            ply_ferror(ply, "Error writing to file");
+            return 0;
+        }
+        ply->buffer_last = 0;
+    }
+    if (size > 0 && fwrite(data, 1, size, ply->fp) < size) {
+        ply_ferror(ply, "Error writing to file");
+        return 0;
+    }
+    ply->winstance_index += ninstances;
+    if (ply->winstance_index >= element->ninstances) {
+        ply->winstance_index = 0;
+        ply->welement++;
+    }
+    return 1;
+}
+
 int ply_close(p_ply ply) {
     long i;
     assert(ply && ply->fp);
@@ -10,9 +10,12 @@
  *
  * Modifications:
  *	- DGM (25/01/06) - get_plystorage_mode method added
+ *	- ply_write_instances method added (bulk binary writes)
  *
  * ---------------------------------------------------------------------- */
 
+#include <stddef.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -359,6 +362,20 @@ int ply_close(p_ply ply);
  * ---------------------------------------------------------------------- */
 int get_plystorage_mode(p_ply ply, e_ply_storage_mode *storage_mode);
 
+/* ----------------------------------------------------------------------
+ * Writes a block of already encoded instances of the current element
+ * (binary files only). The values must be stored in the file byte order
+ * and the block must start at the first property of an instance.
+ *
+ * ply: handle returned by ply_create
+ * data: encoded instances
+ * size: size of the encoded data (in bytes)
+ * ninstances: number of instances in the block
+ *
+ * Returns 1 if successful, 0 otherwise
+ * ---------------------------------------------------------------------- */
+int ply_write_instances(p_ply ply, const void *data, size_t size, long ninstances);
+
 #ifdef __cplusplus
 }
 #endif
@@ -1,9 +1,27 @@
 ﻿#include "mainwindow.h"
+#include "ccCommandLineParser.h"
 
 #include <QApplication>
 
 int main(int argc, char *argv[])
 {
+	//command line mode (no GUI)
+	bool commandLine = (argc > 1 && argv[1][0] == '-');
+	if (commandLine)
+	{
+#if defined(Q_OS_LINUX)
+		//no display available (e.g. on a server): no need for one anyway
+		if (qEnvironmentVariableIsEmpty("DISPLAY") && qEnvironmentVariableIsEmpty("WAYLAND_DISPLAY") && qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+		{
+			qputenv("QT_QPA_PLATFORM", "offscreen");
+		}
+#endif
+		QApplication a(argc, argv);
+		int result = ccCommandLineParser::Parse(argc, argv);
+		FileIOFilter::UnregisterAll();
+		return result;
+	}
+
     QApplication a(argc, argv);
     MainWindow w;
     w.show();
@@ -5,6 +5,7 @@
 #include <QMessageBox>
 #include <QSettings>
 #include <QFileDialog>
+#include <QInputDialog>
 #include <QGroupBox>
 #include <QHBoxLayout>
 #include <QVBoxLayout>
@@ -46,6 +47,7 @@ MainWindow::MainWindow(QWidget *parent)
     ui->setupUi(this);
 
     initUi();
+    initConsole();
     initConnections();
     initCC();
     loadPlugins();
@@ -83,6 +85,22 @@ void MainWindow::initUi()
     m_glWindow->setShaderPath("shaders");
 }
 
+void MainWindow::initConsole()
+{
+    //restore the console settings
+    QSettings settings;
+    settings.beginGroup(ccPS::Console());
+
+    CGConsoleView* console = CGConsoleView::getInstance();
+    console->SetMaxHistory(settings.value(ccPS::ConsoleMaxHistory(), console->MaxHistory()).toInt());
+
+    QString logFilename = settings.value(ccPS::ConsoleLogFile()).toString();
+    if (settings.value(ccPS::ConsoleLogFileEnabled(), false).toBool() && !logFilename.isEmpty())
+    {
+        ui->action_ConsoleLogFile->setChecked(console->EnableLogFile(logFilename));
+    }
+}
+
 void MainWindow::initConnections()
 {
     connect(m_glWindow,	&ccGLWindow::filesDropped, this, static_cast<void (MainWindow::*)(QStringList)>(&MainWindow::addToDB), Qt::QueuedConnection);
@@ -1071,6 +1089,95 @@ void MainWindow::on_action_Console_triggered(bool checked)
         CGConsoleView::getInstance()->setVisible(false);
 }
 
+void MainWindow::on_action_ConsoleLogFile_triggered(bool checked)
+{
+    QSettings settings;
+    settings.beginGroup(ccPS::Console());
+
+    CGConsoleView* console = CGConsoleView::getInstance();
+    if (!checked)
+    {
+        console->DisableLogFile();
+        settings.setValue(ccPS::ConsoleLogFileEnabled(), false);
+        return;
+    }
+
+    QString logFilename = settings.value(ccPS::ConsoleLogFile(), ccFileUtils::defaultDocPath() + "/console.log").toString();
+    logFilename = QFileDialog::getSaveFileName(this,
+                                               tr(u8"控制台日志文件"),
+                                               logFilename,
+                                               "Log file (*.log *.txt)",
+                                               nullptr,
+                                               CCFileDialogOptions() | QFileDialog::DontConfirmOverwrite); //the messages are appended
+    if (logFilename.isEmpty() || !console->EnableLogFile(logFilename))
+    {
+        //process cancelled by the user (or failed)
+        ui->action_ConsoleLogFile->setChecked(false);
+        return;
+    }
+
+    settings.setValue(ccPS::ConsoleLogFile(), logFilename);
+    settings.setValue(ccPS::ConsoleLogFileEnabled(), true);
+}
+
+void MainWindow::on_action_ConsoleMaxHistory_triggered()
+{
+    CGConsoleView* console = CGConsoleView::getInstance();
+
+    bool ok = false;
+    int maxHistory = QInputDialog::getInt(this, tr(u8"控制台历史记录长度"), tr(u8"最大消息数"), console->MaxHistory(), 1, 1000000, 100, &ok);
+    if (!ok)
+        return;
+
+    console->SetMaxHistory(maxHistory);
+
+    QSettings settings;
+    settings.beginGroup(ccPS::Console());
+    settings.setValue(ccPS::ConsoleMaxHistory(), maxHistory);
+}
+
+void MainWindow::on_action_RecordCameraPath_triggered(bool checked)
+{
+    if (!m_glWindow)
+        return;
+
+    if (checked)
+    {
+        m_glWindow->startCameraPathRecording();
+        ccLog::Print("[Camera path] Recording started (uncheck the action to stop and save the path)");
+        return;
+    }
+
+    m_glWindow->stopCameraPathRecording();
+    const ccGLWindow::CameraPath& path = m_glWindow->recordedCameraPath();
+    if (path.empty())
+    {
+        ccLog::Warning("[Camera path] No viewport recorded");
+        return;
+    }
+
+    QSettings settings;
+    settings.beginGroup(ccPS::SaveFile());
+    QString currentPath = settings.value(ccPS::CurrentPath(), ccFileUtils::defaultDocPath()).toString();
+
+    QString filename = QFileDialog::getSaveFileName(this,
+                                                    tr(u8"保存相机路径"),
+                                                    currentPath,
+                                                    "Camera path (*.ccpath)",
+                                                    nullptr,
+                                                    CCFileDialogOptions());
+    if (filename.isEmpty())
+    {
+        //process cancelled by the user
+        return;
+    }
+
+    if (ccGLWindow::SaveCameraPath(filename, path))
+    {
+        ccLog::Print(QString("[Camera path] %1 viewport(s) saved to '%2' (see the -RENDER_BENCHMARK and -RENDER_TILED commands)").arg(path.size()).arg(filename));
+    }
+}
+
 void MainWindow::on_action_PointPicking_triggered()
 {
     initPointPicking();
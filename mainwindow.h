@@ -33,6 +33,7 @@ public:
     void initConnections();
     void initCC();
     void initPointPicking();
+    void initConsole();
 
 public:
     void addToDB(ccHObject* entity);
@@ -88,7 +89,10 @@ private slots:
     void on_action_SetPivotOff_triggered();
     void on_action_SetPivotRotationOnly_triggered();
     void on_action_Console_triggered(bool checked);
+    void on_action_ConsoleLogFile_triggered(bool checked);
+    void on_action_ConsoleMaxHistory_triggered();
     void on_action_PointPicking_triggered();
+    void on_action_RecordCameraPath_triggered(bool checked);
 
     void on_action_Elevation_triggered();
     void on_action_Depth_triggered();
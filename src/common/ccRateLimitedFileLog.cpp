@@ -0,0 +1,115 @@
+//##########################################################################
+//#                                                                        #
+//#                              CLOUDCOMPARE                              #
+//#                                                                        #
+//#  This program is free software; you can redistribute it and/or modify  #
+//#  it under the terms of the GNU General Public License as published by  #
+//#  the Free Software Foundation; version 2 or later of the License.      #
+//#                                                                        #
+//#  This program is distributed in the hope that it will be useful,       #
+//#  but WITHOUT ANY WARRANTY; without even the implied warranty of        #
+//#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the          #
+//#  GNU General Public License for more details.                          #
+//#                                                                        #
+//#                 COPYRIGHT: Daniel Girardeau-Montaut                    #
+//#                                                                        #
+//##########################################################################
+
+#include "ccRateLimitedFileLog.h"
+
+ccRateLimitedFileLog::ccRateLimitedFileLog()
+	: m_maxMessagesPerSecond(100)
+	, m_currentSecond(0)
+	, m_writtenCount(0)
+	, m_suppressedCount(0)
+{
+}
+
+ccRateLimitedFileLog::~ccRateLimitedFileLog()
+{
+	close();
+}
+
+bool ccRateLimitedFileLog::open(const QString& filename, unsigned maxMessagesPerSecond/*=100*/)
+{
+	close();
+
+	m_file.setFileName(filename);
+	if (!m_file.open(QFile::WriteOnly | QFile::Append | QFile::Text))
+	{
+		return false;
+	}
+	m_stream.setDevice(&m_file);
+
+	m_maxMessagesPerSecond = maxMessagesPerSecond;
+	m_currentSecond = 0;
+	m_writtenCount = 0;
+	m_suppressedCount = 0;
+
+	return true;
+}
+
+void ccRateLimitedFileLog::close()
+{
+	if (!m_file.isOpen())
+	{
+		return;
+	}
+
+	reportSuppressedMessages();
+	m_stream.flush();
+	m_stream.setDevice(nullptr);
+	m_file.close();
+}
+
+void ccRateLimitedFileLog::reportSuppressedMessages()
+{
+	if (m_suppressedCount != 0)
+	{
+		m_stream << QString("(%1 message(s) suppressed by the rate limit)").arg(m_suppressedCount) << '\n';
+		m_suppressedCount = 0;
+	}
+}
+
+void ccRateLimitedFileLog::write(const ccRingBufferLog::Entry& entry)
+{
+	if (!m_file.isOpen())
+	{
+		return;
+	}
+
+	qint64 second = entry.timestamp_ms / 1000;
+	if (second != m_currentSecond)
+	{
+		reportSuppressedMessages();
+		m_currentSecond = second;
+		m_writtenCount = 0;
+	}
+
+	bool important = ((entry.level & (ccLog::LOG_WARNING | ccLog::LOG_ERROR)) != 0);
+	if (!important && m_maxMessagesPerSecond != 0 && m_writtenCount >= m_maxMessagesPerSecond)
+	{
+		++m_suppressedCount;
+		return;
+	}
+	++m_writtenCount;
+
+	QString line = ccRingBufferLog::Format(entry);
+	if (entry.level & ccLog::LOG_ERROR)
+	{
+		line.insert(line.indexOf(" : ") + 3, "[ERROR] ");
+	}
+	else if (entry.level & ccLog::LOG_WARNING)
+	{
+		line.insert(line.indexOf(" : ") + 3, "[WARNING] ");
+	}
+	m_stream << line << '\n';
+}
+
+void ccRateLimitedFileLog::flush()
+{
+	if (m_file.isOpen())
+	{
+		m_stream.flush();
+	}
+}
@@ -0,0 +1,83 @@
+//##########################################################################
+//#                                                                        #
+//#                              CLOUDCOMPARE                              #
+//#                                                                        #
+//#  This program is free software; you can redistribute it and/or modify  #
+//#  it under the terms of the GNU General Public License as published by  #
+//#  the Free Software Foundation; version 2 or later of the License.      #
+//#                                                                        #
+//#  This program is distributed in the hope that it will be useful,       #
+//#  but WITHOUT ANY WARRANTY; without even the implied warranty of        #
+//#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the          #
+//#  GNU General Public License for more details.                          #
+//#                                                                        #
+//#                 COPYRIGHT: Daniel Girardeau-Montaut                    #
+//#                                                                        #
+//##########################################################################
+
+#ifndef CC_RATE_LIMITED_FILE_LOG_HEADER
+#define CC_RATE_LIMITED_FILE_LOG_HEADER
+
+//Local
+#include "ccRingBufferLog.h"
+
+//Qt
+#include <QFile>
+#include <QTextStream>
+
+//! Log file with rate limiting
+/** At most 'maxMessagesPerSecond' messages are written per second (based on
+	the messages timestamps). The other ones are only counted, and their number
+	is reported once the next second starts. Warnings and errors are not limited.
+	\warning Not thread safe: meant to be fed with the entries drained from a
+	ccRingBufferLog instance.
+**/
+class ccRateLimitedFileLog
+{
+public:
+
+	//! Default constructor
+	ccRateLimitedFileLog();
+
+	//! Destructor
+	~ccRateLimitedFileLog();
+
+	//! Opens (or creates) the log file (messages are appended)
+	/** \param filename log filename
+		\param maxMessagesPerSecond max number of (standard) messages written per second (0 = no limit)
+		\return success
+	**/
+	bool open(const QString& filename, unsigned maxMessagesPerSecond = 100);
+
+	//! Closes the file
+	void close();
+
+	//! Returns whether the file is opened
+	bool isOpen() const { return m_file.isOpen(); }
+
+	//! Writes an entry (if the rate limit allows it)
+	void write(const ccRingBufferLog::Entry& entry);
+
+	//! Flushes the pending data to the file
+	void flush();
+
+protected:
+
+	//! Reports the number of suppressed messages (if any)
+	void reportSuppressedMessages();
+
+	//! Log file
+	QFile m_file;
+	//! Text stream
+	QTextStream m_stream;
+	//! Max number of messages per second
+	unsigned m_maxMessagesPerSecond;
+	//! Current time window (in seconds since epoch)
+	qint64 m_currentSecond;
+	//! Number of messages written in the current time window
+	unsigned m_writtenCount;
+	//! Number of messages suppressed in the current time window
+	size_t m_suppressedCount;
+};
+
+#endif //CC_RATE_LIMITED_FILE_LOG_HEADER
@@ -0,0 +1,112 @@
+//##########################################################################
+//#                                                                        #
+//#                              CLOUDCOMPARE                              #
+//#                                                                        #
+//#  This program is free software; you can redistribute it and/or modify  #
+//#  it under the terms of the GNU General Public License as published by  #
+//#  the Free Software Foundation; version 2 or later of the License.      #
+//#                                                                        #
+//#  This program is distributed in the hope that it will be useful,       #
+//#  but WITHOUT ANY WARRANTY; without even the implied warranty of        #
+//#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the          #
+//#  GNU General Public License for more details.                          #
+//#                                                                        #
+//#                 COPYRIGHT: Daniel Girardeau-Montaut                    #
+//#                                                                        #
+//##########################################################################
+
+#include "ccRingBufferLog.h"
+
+//Qt
+#include <QDateTime>
+
+//system
+#include <cstdint>
+
+ccRingBufferLog::ccRingBufferLog(size_t capacity/*=4096*/)
+	: m_mask(0)
+	, m_writePos(0)
+	, m_readPos(0)
+	, m_dropped(0)
+{
+	size_t size = 2;
+	while (size < capacity)
+	{
+		size <<= 1;
+	}
+	m_mask = size - 1;
+
+	m_slots.reset(new Slot[size]);
+	for (size_t i = 0; i < size; ++i)
+	{
+		m_slots[i].sequence.store(i, std::memory_order_relaxed);
+	}
+}
+
+void ccRingBufferLog::logMessage(const QString& message, int level)
+{
+	//reserve a slot
+	size_t pos = m_writePos.load(std::memory_order_relaxed);
+	Slot* slot = nullptr;
+	while (true)
+	{
+		slot = &m_slots[pos & m_mask];
+		size_t sequence = slot->sequence.load(std::memory_order_acquire);
+		intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+		if (diff == 0)
+		{
+			if (m_writePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+			{
+				break;
+			}
+		}
+		else if (diff < 0)
+		{
+			//the buffer is full: we don't wait for the consumer
+			m_dropped.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+		else
+		{
+			pos = m_writePos.load(std::memory_order_relaxed);
+		}
+	}
+
+	//QString is implicitly shared (with an atomic reference counter)
+	slot->entry.text = message;
+	slot->entry.level = level;
+	slot->entry.timestamp_ms = QDateTime::currentMSecsSinceEpoch();
+
+	//publish the entry
+	slot->sequence.store(pos + 1, std::memory_order_release);
+}
+
+size_t ccRingBufferLog::drain(std::vector<Entry>& entries, size_t maxCount/*=-1*/)
+{
+	size_t count = 0;
+	while (count < maxCount)
+	{
+		Slot& slot = m_slots[m_readPos & m_mask];
+		size_t sequence = slot.sequence.load(std::memory_order_acquire);
+		if (sequence != m_readPos + 1)
+		{
+			//empty (or the next entry is still being written)
+			break;
+		}
+
+		entries.emplace_back(std::move(slot.entry));
+		slot.entry.text = QString();
+
+		//release the slot for the next lap
+		slot.sequence.store(m_readPos + m_mask + 1, std::memory_order_release);
+		++m_readPos;
+		++count;
+	}
+
+	return count;
+}
+
+QString ccRingBufferLog::Format(const Entry& entry)
+{
+	return QString("[%1] : %2").arg(QDateTime::fromMSecsSinceEpoch(entry.timestamp_ms).toString("yyyy/MM/dd hh:mm:ss:zzz"), entry.text);
+}
@@ -0,0 +1,99 @@
+//##########################################################################
+//#                                                                        #
+//#                              CLOUDCOMPARE                              #
+//#                                                                        #
+//#  This program is free software; you can redistribute it and/or modify  #
+//#  it under the terms of the GNU General Public License as published by  #
+//#  the Free Software Foundation; version 2 or later of the License.      #
+//#                                                                        #
+//#  This program is distributed in the hope that it will be useful,       #
+//#  but WITHOUT ANY WARRANTY; without even the implied warranty of        #
+//#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the          #
+//#  GNU General Public License for more details.                          #
+//#                                                                        #
+//#                 COPYRIGHT: Daniel Girardeau-Montaut                    #
+//#                                                                        #
+//##########################################################################
+
+#ifndef CC_RING_BUFFER_LOG_HEADER
+#define CC_RING_BUFFER_LOG_HEADER
+
+//qCC_db
+#include <ccLog.h>
+
+//Qt
+#include <QString>
+
+//system
+#include <atomic>
+#include <memory>
+#include <vector>
+
+//! Bounded, lock-free log sink
+/** Any thread can push messages without blocking (multiple producers).
+	The messages are retrieved by a single consumer (typically a GUI timer)
+	with drain. When the buffer is full, the new messages are dropped (and
+	counted) instead of blocking the calling thread.
+**/
+class ccRingBufferLog : public ccLog
+{
+public:
+
+	//! Log entry
+	struct Entry
+	{
+		QString text;
+		int level = LOG_STANDARD;
+		qint64 timestamp_ms = 0; //!< since epoch
+	};
+
+	//! Default constructor
+	/** \param capacity buffer capacity (rounded up to the next power of 2)
+	**/
+	explicit ccRingBufferLog(size_t capacity = 4096);
+
+	//inherited from ccLog
+	void logMessage(const QString& message, int level) override;
+
+	//! Moves the pending messages (in chronological order) at the end of a vector
+	/** \warning Single consumer: must always be called by the same thread.
+		\param entries output entries
+		\param maxCount maximum number of retrieved entries
+		\return number of retrieved entries
+	**/
+	size_t drain(std::vector<Entry>& entries, size_t maxCount = static_cast<size_t>(-1));
+
+	//! Returns the number of messages dropped since the last call (and resets it)
+	size_t takeDroppedCount() { return m_dropped.exchange(0); }
+
+	//! Returns the buffer capacity
+	size_t capacity() const { return m_mask + 1; }
+
+	//! Formats an entry as "[yyyy/MM/dd hh:mm:ss:zzz] : text"
+	static QString Format(const Entry& entry);
+
+protected:
+
+	//! Buffer slot
+	struct Slot
+	{
+		//! Sequence number (see D. Vyukov's bounded MPMC queue)
+		std::atomic<size_t> sequence;
+		//! Entry
+		Entry entry;
+	};
+
+	//! Slots
+	std::unique_ptr<Slot[]> m_slots;
+	//! Capacity - 1 (the capacity is a power of 2)
+	size_t m_mask;
+
+	//! Next write position (shared by the producers)
+	alignas(64) std::atomic<size_t> m_writePos;
+	//! Next read position (consumer only)
+	alignas(64) size_t m_readPos;
+	//! Number of dropped messages
+	std::atomic<size_t> m_dropped;
+};
+
+#endif //CC_RING_BUFFER_LOG_HEADER
@@ -0,0 +1,737 @@
+//##########################################################################
+//#                                                                        #
+//#                              CLOUDCOMPARE                              #
+//#                                                                        #
+//#  This program is free software; you can redistribute it and/or modify  #
+//#  it under the terms of the GNU General Public License as published by  #
+//#  the Free Software Foundation; version 2 or later of the License.      #
+//#                                                                        #
+//#  This program is distributed in the hope that it will be useful,       #
+//#  but WITHOUT ANY WARRANTY; without even the implied warranty of        #
+//#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the          #
+//#  GNU General Public License for more details.                          #
+//#                                                                        #
+//#                  COPYRIGHT: Daniel Girardeau-Montaut                   #
+//#                                                                        #
+//##########################################################################
+
+#include "ccCommandLineCommands.h"
+
+//Local
+#include "ccCommandLineParser.h"
+#include "ccGLWindow.h"
+
+//CCLib
+#include <Cloud2CloudReferenceIndex.h>
+#include <CloudSamplingTools.h>
+#include <DgmOctree.h>
+#include <DistanceComputationTools.h>
+
+//qCC_db
+#include <ccProgressDialog.h>
+#include <ccScalarField.h>
+
+//qCC_io
+#include <FileIOFilter.h>
+
+//Qt
+#include <QCoreApplication>
+
+//system
+#include <functional>
+
+constexpr char COMMAND_OPEN[]						= "O";
+constexpr char COMMAND_CLOUD_EXPORT_FORMAT[]		= "C_EXPORT_FMT";
+constexpr char COMMAND_SUBSAMPLE[]					= "SS";
+constexpr char COMMAND_SOR_FILTER[]					= "SOR";
+constexpr char COMMAND_C2C_DIST[]					= "C2C_DIST";
+constexpr char COMMAND_C2C_REFERENCE[]				= "REF";
+constexpr char COMMAND_C2C_MAX_DISTANCE[]			= "MAX_DIST";
+constexpr char COMMAND_OCTREE_LEVEL[]				= "OCTREE_LEVEL";
+constexpr char COMMAND_SAVE_CLOUDS[]				= "SAVE_CLOUDS";
+constexpr char COMMAND_SAVE_ALL_AT_ONCE[]			= "ALL_AT_ONCE";
+constexpr char COMMAND_AUTO_SAVE[]					= "AUTO_SAVE";
+constexpr char COMMAND_NO_TIMESTAMP[]				= "NO_TIMESTAMP";
+constexpr char COMMAND_RENDER_BENCHMARK[]			= "RENDER_BENCHMARK";
+constexpr char COMMAND_BENCHMARK_JSON[]				= "JSON";
+constexpr char COMMAND_BENCHMARK_SIZE[]				= "SIZE";
+constexpr char COMMAND_BENCHMARK_WARM_UP[]			= "WARM_UP";
+constexpr char COMMAND_RENDER_TILED[]				= "RENDER_TILED";
+constexpr char COMMAND_RENDER_ZOOM[]				= "ZOOM";
+constexpr char COMMAND_RENDER_TILE_SIZE[]			= "TILE";
+constexpr char COMMAND_RENDER_VIEWPORT[]			= "VIEWPORT";
+
+constexpr char OPTION_ON[]							= "ON";
+constexpr char OPTION_OFF[]							= "OFF";
+
+constexpr char C2C_DISTANCES_SF_NAME[]				= "C2C absolute distances";
+
+//! Returns the (headless) command line parser
+/** The built-in commands are only registered by ccCommandLineParser.
+**/
+static ccCommandLineParser& Parser(ccCommandLineInterface& cmd)
+{
+	return static_cast<ccCommandLineParser&>(cmd);
+}
+
+//! Replaces a cloud by its subset (and saves it if necessary)
+static bool ReplaceBySubset(ccCommandLineInterface& cmd, CLCloudDesc& desc, CCLib::ReferenceCloud* subset, const QString& suffix)
+{
+	if (!subset)
+	{
+		return cmd.error("Process failed (not enough memory?)");
+	}
+
+	ccPointCloud* result = desc.pc->partialClone(subset);
+	delete subset;
+	subset = nullptr;
+
+	if (!result)
+	{
+		return cmd.error("Not enough memory!");
+	}
+
+	cmd.print(QString("\tResult: %1 points (out of %2)").arg(result->size()).arg(desc.pc->size()));
+
+	//the original cloud is released as soon as possible
+	result->setName(desc.pc->getName() + QString(".") + suffix.toLower());
+	delete desc.pc;
+	desc.pc = result;
+	desc.basename += QString("_") + suffix;
+
+	if (cmd.autoSaveMode())
+	{
+		QString errorStr = cmd.exportEntity(desc);
+		if (!errorStr.isEmpty())
+		{
+			return cmd.error(errorStr);
+		}
+	}
+
+	return true;
+}
+
+//! Renders the loaded clouds and meshes in a temporary (offscreen) 3D view
+/** The OpenGL rendering is done by the main thread.
+	\return the value returned by the rendering task
+**/
+static bool RenderLoadedEntities(ccCommandLineInterface& cmd, int width, int height, std::function<bool(ccGLWindow*)> task)
+{
+	//the entities are only temporarily attached to the scene
+	ccHObject scene("Rendered scene");
+	for (CLCloudDesc& desc : cmd.clouds())
+	{
+		scene.addChild(desc.pc, ccHObject::DP_NONE);
+	}
+	for (CLMeshDesc& desc : cmd.meshes())
+	{
+		scene.addChild(desc.mesh, ccHObject::DP_NONE);
+	}
+
+	bool success = false;
+	Parser(cmd).runIOTask([&]()
+	{
+		ccGLWindow* glWindow = new ccGLWindow(nullptr, nullptr, true);
+		glWindow->resize(width, height);
+		glWindow->show();
+		//the OpenGL context is initialized once the window is exposed
+		QCoreApplication::processEvents();
+
+		scene.setDisplay_recursive(glWindow);
+		glWindow->setSceneDB(&scene);
+
+		success = task(glWindow);
+
+		glWindow->setSceneDB(nullptr);
+		scene.setDisplay_recursive(nullptr);
+		delete glWindow;
+	});
+
+	scene.detatchAllChildren();
+
+	return success;
+}
+
+CommandLoad::CommandLoad()
+	: ccCommandLineInterface::Command("Load", COMMAND_OPEN)
+{}
+
+bool CommandLoad::process(ccCommandLineInterface& cmd)
+{
+	cmd.print("[LOADING]");
+
+	//optional parameters
+	while (!cmd.arguments().empty() && ccCommandLineInterface::IsCommand(cmd.arguments().front(), ccCommandLineInterface::COMMAND_OPEN_SHIFT_ON_LOAD()))
+	{
+		cmd.arguments().pop_front();
+		if (!cmd.processGlobalShiftCommand())
+		{
+			return false;
+		}
+	}
+
+	if (cmd.arguments().empty())
+	{
+		return cmd.error(QString("Missing parameter: filename after \"-%1\"").arg(COMMAND_OPEN));
+	}
+
+	QString filename = cmd.arguments().takeFirst();
+	if (!cmd.importFile(filename))
+	{
+		return false;
+	}
+
+	cmd.storeCoordinatesShiftParams();
+
+	return true;
+}
+
+CommandChangeCloudOutputFormat::CommandChangeCloudOutputFormat()
+	: ccCommandLineInterface::Command("Change cloud output format", COMMAND_CLOUD_EXPORT_FORMAT)
+{}
+
+bool CommandChangeCloudOutputFormat::process(ccCommandLineInterface& cmd)
+{
+	if (cmd.arguments().empty())
+	{
+		return cmd.error(QString("Missing parameter: format (e.g. BIN, ASC, PLY) after \"-%1\"").arg(COMMAND_CLOUD_EXPORT_FORMAT));
+	}
+
+	QString extension = cmd.arguments().takeFirst().toLower();
+
+	FileIOFilter::Shared filter = FileIOFilter::FindBestFilterForExtension(extension);
+	if (!filter || !filter->exportSupported() || filter->getFileFilters(false).empty())
+	{
+		return cmd.error(QString("Unhandled output format: '%1'").arg(extension));
+	}
+
+	cmd.setCloudExportFormat(filter->getFileFilters(false).front(), extension);
+	cmd.print(QString("Output export format (clouds) set to: %1").arg(extension.toUpper()));
+
+	return true;
+}
+
+CommandSubsample::CommandSubsample()
+	: ccCommandLineInterface::Command("Subsample", COMMAND_SUBSAMPLE)
+{}
+
+bool CommandSubsample::process(ccCommandLineInterface& cmd)
+{
+	cmd.print("[SUBSAMPLING]");
+
+	if (cmd.arguments().size() < 2)
+	{
+		return cmd.error(QString("Missing parameters: method (RANDOM, SPATIAL or OCTREE) and value after \"-%1\"").arg(COMMAND_SUBSAMPLE));
+	}
+	if (cmd.clouds().empty())
+	{
+		return cmd.error(QString("No point cloud to resample (be sure to open one with \"-%1 [cloud filename]\" before \"-%2\")").arg(COMMAND_OPEN, COMMAND_SUBSAMPLE));
+	}
+
+	QString method = cmd.arguments().takeFirst().toUpper();
+	QString value = cmd.arguments().takeFirst();
+	cmd.print(QString("\tMethod: %1 (%2)").arg(method, value));
+
+	bool ok = false;
+	if (method == "RANDOM")
+	{
+		unsigned count = value.toUInt(&ok);
+		if (!ok)
+		{
+			return cmd.error("Invalid number of points for random resampling!");
+		}
+
+		for (CLCloudDesc& desc : cmd.clouds())
+		{
+			CCLib::ReferenceCloud* subset = CCLib::CloudSamplingTools::subsampleCloudRandomly(desc.pc, count);
+			if (!ReplaceBySubset(cmd, desc, subset, "RANDOM_SUBSAMPLED"))
+			{
+				return false;
+			}
+		}
+	}
+	else if (method == "SPATIAL")
+	{
+		double step = value.toDouble(&ok);
+		if (!ok || step <= 0)
+		{
+			return cmd.error("Invalid step value for spatial resampling!");
+		}
+
+		for (CLCloudDesc& desc : cmd.clouds())
+		{
+			CCLib::ReferenceCloud* subset = nullptr;
+			{
+				ccCommandLineParser::OctreeLocker locker(Parser(cmd));
+				CCLib::CloudSamplingTools::SFModulationParams modParams(false);
+				subset = CCLib::CloudSamplingTools::resampleCloudSpatially(desc.pc, static_cast<PointCoordinateType>(step), modParams);
+			}
+			if (!ReplaceBySubset(cmd, desc, subset, "SPATIAL_SUBSAMPLED"))
+			{
+				return false;
+			}
+		}
+	}
+	else if (method == "OCTREE")
+	{
+		int octreeLevel = value.toInt(&ok);
+		if (!ok || octreeLevel < 1 || octreeLevel > CCLib::DgmOctree::MAX_OCTREE_LEVEL)
+		{
+			return cmd.error("Invalid octree level!");
+		}
+
+		for (CLCloudDesc& desc : cmd.clouds())
+		{
+			CCLib::ReferenceCloud* subset = nullptr;
+			{
+				ccCommandLineParser::OctreeLocker locker(Parser(cmd));
+				subset = CCLib::CloudSamplingTools::subsampleCloudWithOctreeAtLevel(desc.pc,
+																					static_cast<unsigned char>(octreeLevel),
+																					CCLib::CloudSamplingTools::NEAREST_POINT_TO_CELL_CENTER);
+			}
+			if (!ReplaceBySubset(cmd, desc, subset, QString("OCTREE_LEVEL_%1_SUBSAMPLED").arg(octreeLevel)))
+			{
+				return false;
+			}
+		}
+	}
+	else
+	{
+		return cmd.error(QString("Unknown resampling method: '%1'").arg(method));
+	}
+
+	return true;
+}
+
+CommandSOR::CommandSOR()
+	: ccCommandLineInterface::Command("S.O.R. filter", COMMAND_SOR_FILTER)
+{}
+
+bool CommandSOR::process(ccCommandLineInterface& cmd)
+{
+	cmd.print("[SOR FILTER]");
+
+	if (cmd.arguments().size() < 2)
+	{
+		return cmd.error(QString("Missing parameters: number of neighbors and sigma multiplier after \"-%1\"").arg(COMMAND_SOR_FILTER));
+	}
+	if (cmd.clouds().empty())
+	{
+		return cmd.error(QString("No point cloud to filter (be sure to open one with \"-%1 [cloud filename]\" before \"-%2\")").arg(COMMAND_OPEN, COMMAND_SOR_FILTER));
+	}
+
+	bool ok = false;
+	int knn = cmd.arguments().takeFirst().toInt(&ok);
+	if (!ok || knn <= 0)
+	{
+		return cmd.error("Invalid number of neighbors!");
+	}
+	double nSigma = cmd.arguments().takeFirst().toDouble(&ok);
+	if (!ok || nSigma < 0)
+	{
+		return cmd.error("Invalid sigma multiplier!");
+	}
+	cmd.print(QString("\tNeighbors: %1 / sigma multiplier: %2").arg(knn).arg(nSigma));
+
+	for (CLCloudDesc& desc : cmd.clouds())
+	{
+		CCLib::ReferenceCloud* subset = nullptr;
+		{
+			ccCommandLineParser::OctreeLocker locker(Parser(cmd));
+			subset = CCLib::CloudSamplingTools::sorFilterTiled(desc.pc, knn, nSigma);
+		}
+		if (!ReplaceBySubset(cmd, desc, subset, "SOR"))
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+CommandC2CDist::CommandC2CDist()
+	: ccCommandLineInterface::Command("C2C distance", COMMAND_C2C_DIST)
+{}
+
+bool CommandC2CDist::process(ccCommandLineInterface& cmd)
+{
+	cmd.print("[C2C DISTANCE]");
+
+	//optional parameters
+	QString referenceFilename;
+	ScalarType maxDist = -1;
+	int octreeLevel = 0;
+	while (!cmd.arguments().empty())
+	{
+		QString argument = cmd.arguments().front();
+		bool ok = true;
+		if (ccCommandLineInterface::IsCommand(argument, COMMAND_C2C_REFERENCE))
+		{
+			cmd.arguments().pop_front();
+			if (cmd.arguments().empty())
+			{
+				return cmd.error(QString("Missing parameter: filename after \"-%1\"").arg(COMMAND_C2C_REFERENCE));
+			}
+			referenceFilename = cmd.arguments().takeFirst();
+		}
+		else if (ccCommandLineInterface::IsCommand(argument, COMMAND_C2C_MAX_DISTANCE))
+		{
+			cmd.arguments().pop_front();
+			maxDist = static_cast<ScalarType>(cmd.arguments().empty() ? -1.0 : cmd.arguments().takeFirst().toDouble(&ok));
+			if (!ok || maxDist <= 0)
+			{
+				return cmd.error(QString("Invalid or missing value after \"-%1\"").arg(COMMAND_C2C_MAX_DISTANCE));
+			}
+		}
+		else if (ccCommandLineInterface::IsCommand(argument, COMMAND_OCTREE_LEVEL))
+		{
+			cmd.arguments().pop_front();
+			octreeLevel = (cmd.arguments().empty() ? 0 : cmd.arguments().takeFirst().toInt(&ok));
+			if (!ok || octreeLevel < 1 || octreeLevel > CCLib::DgmOctree::MAX_OCTREE_LEVEL)
+			{
+				return cmd.error(QString("Invalid or missing value after \"-%1\"").arg(COMMAND_OCTREE_LEVEL));
+			}
+		}
+		else
+		{
+			break;
+		}
+	}
+
+	//compared clouds: all the loaded clouds (if a reference file is given) or the first one
+	size_t comparedCount = 0;
+	//a reference file is loaded only once (and shared by all the jobs in batch mode)
+	const CCLib::Cloud2CloudReferenceIndex* referenceIndex = nullptr;
+	if (!referenceFilename.isEmpty())
+	{
+		comparedCount = cmd.clouds().size();
+		if (comparedCount == 0)
+		{
+			return cmd.error(QString("No point cloud to compare (be sure to open one with \"-%1 [cloud filename]\" before \"-%2\")").arg(COMMAND_OPEN, COMMAND_C2C_DIST));
+		}
+		referenceIndex = Parser(cmd).sharedReferenceIndex(referenceFilename);
+		if (!referenceIndex)
+		{
+			return cmd.error(QString("Failed to load the reference file '%1'").arg(referenceFilename));
+		}
+	}
+	else
+	{
+		if (cmd.clouds().size() < 2)
+		{
+			return cmd.error(QString("Only one point cloud available. Be sure to open or generate a second one before performing C2C distance (or use \"-%1 [filename]\")!").arg(COMMAND_C2C_REFERENCE));
+		}
+		comparedCount = 1;
+	}
+
+	bool success = true;
+	for (size_t i = 0; i < comparedCount; ++i)
+	{
+		CLCloudDesc& desc = cmd.clouds()[i];
+		ccPointCloud* compCloud = desc.pc;
+
+		int sfIdx = compCloud->getScalarFieldIndexByName(C2C_DISTANCES_SF_NAME);
+		if (sfIdx < 0)
+		{
+			sfIdx = compCloud->addScalarField(C2C_DISTANCES_SF_NAME);
+		}
+		if (sfIdx < 0)
+		{
+			success = cmd.error("Not enough memory!");
+			break;
+		}
+		compCloud->setCurrentScalarField(sfIdx);
+
+		CCLib::DistanceComputationTools::Cloud2CloudDistanceComputationParams params;
+		params.octreeLevel = static_cast<unsigned char>(octreeLevel);
+		params.maxSearchDist = maxDist;
+		params.multiThread = true;
+
+		int result = 0;
+		if (referenceIndex)
+		{
+			//no octree traversal (see OctreeLocker): the jobs can share the reference concurrently
+			result = referenceIndex->computeDistances(compCloud, params);
+		}
+		else
+		{
+			ccCommandLineParser::OctreeLocker locker(Parser(cmd));
+			result = CCLib::DistanceComputationTools::computeCloud2CloudDistance(compCloud, cmd.clouds()[1].pc, params);
+		}
+		if (result < 0)
+		{
+			success = cmd.error(QString("An error occurred during C2C distance computation! (error code: %1)").arg(result));
+			break;
+		}
+
+		compCloud->getScalarField(sfIdx)->computeMinAndMax();
+		compCloud->setCurrentDisplayedScalarField(sfIdx);
+		compCloud->showSF(true);
+
+		desc.basename += QString("_C2C_DIST");
+		if (maxDist > 0)
+		{
+			desc.basename += QString("_MAX_DIST_%1").arg(maxDist);
+		}
+
+		if (cmd.autoSaveMode())
+		{
+			QString errorStr = cmd.exportEntity(desc);
+			if (!errorStr.isEmpty())
+			{
+				success = cmd.error(errorStr);
+				break;
+			}
+		}
+	}
+
+	return success;
+}
+
+CommandSaveClouds::CommandSaveClouds()
+	: ccCommandLineInterface::Command("Save clouds", COMMAND_SAVE_CLOUDS)
+{}
+
+bool CommandSaveClouds::process(ccCommandLineInterface& cmd)
+{
+	bool allAtOnce = false;
+	if (!cmd.arguments().empty() && cmd.arguments().front().toUpper() == COMMAND_SAVE_ALL_AT_ONCE)
+	{
+		cmd.arguments().pop_front();
+		allAtOnce = true;
+	}
+
+	return cmd.saveClouds(QString(), allAtOnce);
+}
+
+CommandAutoSave::CommandAutoSave()
+	: ccCommandLineInterface::Command("Auto save state", COMMAND_AUTO_SAVE)
+{}
+
+bool CommandAutoSave::process(ccCommandLineInterface& cmd)
+{
+	if (cmd.arguments().empty())
+	{
+		return cmd.error(QString("Missing parameter: option after \"-%1\" (%2/%3)").arg(COMMAND_AUTO_SAVE, OPTION_ON, OPTION_OFF));
+	}
+
+	QString option = cmd.arguments().takeFirst().toUpper();
+	if (option == OPTION_ON)
+	{
+		cmd.print("Auto-save is enabled");
+		cmd.toggleAutoSaveMode(true);
+	}
+	else if (option == OPTION_OFF)
+	{
+		cmd.print("Auto-save is disabled");
+		cmd.toggleAutoSaveMode(false);
+	}
+	else
+	{
+		return cmd.error(QString("Unrecognized option after \"-%1\" (%2 or %3 expected)").arg(COMMAND_AUTO_SAVE, OPTION_ON, OPTION_OFF));
+	}
+
+	return true;
+}
+
+CommandNoTimestamp::CommandNoTimestamp()
+	: ccCommandLineInterface::Command("No timestamp", COMMAND_NO_TIMESTAMP)
+{}
+
+bool CommandNoTimestamp::process(ccCommandLineInterface& cmd)
+{
+	cmd.toggleAddTimestamp(false);
+	return true;
+}
+
+CommandRenderBenchmark::CommandRenderBenchmark()
+	: ccCommandLineInterface::Command("Rendering benchmark", COMMAND_RENDER_BENCHMARK)
+{}
+
+bool CommandRenderBenchmark::process(ccCommandLineInterface& cmd)
+{
+	cmd.print("[RENDERING BENCHMARK]");
+
+	//optional parameters
+	QString jsonFilename;
+	int width = 1280;
+	int height = 720;
+	int warmUpFrames = 3;
+	while (!cmd.arguments().empty())
+	{
+		QString argument = cmd.arguments().front();
+		bool ok = true;
+		if (ccCommandLineInterface::IsCommand(argument, COMMAND_BENCHMARK_JSON))
+		{
+			cmd.arguments().pop_front();
+			if (cmd.arguments().empty())
+			{
+				return cmd.error(QString("Missing parameter: filename after \"-%1\"").arg(COMMAND_BENCHMARK_JSON));
+			}
+			jsonFilename = cmd.arguments().takeFirst();
+		}
+		else if (ccCommandLineInterface::IsCommand(argument, COMMAND_BENCHMARK_SIZE))
+		{
+			cmd.arguments().pop_front();
+			bool okH = false;
+			width = (cmd.arguments().empty() ? 0 : cmd.arguments().takeFirst().toInt(&ok));
+			height = (cmd.arguments().empty() ? 0 : cmd.arguments().takeFirst().toInt(&okH));
+			if (!ok || !okH || width <= 0 || height <= 0)
+			{
+				return cmd.error(QString("Invalid or missing values after \"-%1\" (width and height expected)").arg(COMMAND_BENCHMARK_SIZE));
+			}
+		}
+		else if (ccCommandLineInterface::IsCommand(argument, COMMAND_BENCHMARK_WARM_UP))
+		{
+			cmd.arguments().pop_front();
+			warmUpFrames = (cmd.arguments().empty() ? -1 : cmd.arguments().takeFirst().toInt(&ok));
+			if (!ok || warmUpFrames < 0)
+			{
+				return cmd.error(QString("Invalid or missing value after \"-%1\"").arg(COMMAND_BENCHMARK_WARM_UP));
+			}
+		}
+		else
+		{
+			break;
+		}
+	}
+
+	if (cmd.arguments().empty())
+	{
+		return cmd.error(QString("Missing parameter: camera path filename after \"-%1\"").arg(COMMAND_RENDER_BENCHMARK));
+	}
+	QString cameraPathFilename = cmd.arguments().takeFirst();
+
+	if (cmd.clouds().empty() && cmd.meshes().empty())
+	{
+		return cmd.error(QString("No entity to render (be sure to open one with \"-%1 [filename]\" before \"-%2\")").arg(COMMAND_OPEN, COMMAND_RENDER_BENCHMARK));
+	}
+
+	ccGLWindow::CameraPath cameraPath;
+	if (!ccGLWindow::LoadCameraPath(cameraPathFilename, cameraPath))
+	{
+		return cmd.error(QString("Failed to load the camera path '%1'").arg(cameraPathFilename));
+	}
+	cmd.print(QString("\tCamera path: %1 viewports").arg(cameraPath.size()));
+
+	bool success = RenderLoadedEntities(cmd, width, height, [&](ccGLWindow* glWindow)
+	{
+		return glWindow->runRenderingBenchmark(cameraPath, jsonFilename, static_cast<unsigned>(warmUpFrames));
+	});
+
+	if (!success)
+	{
+		return cmd.error("Rendering benchmark failed (see above)");
+	}
+	if (!jsonFilename.isEmpty())
+	{
+		cmd.print(QString("\tResults saved in '%1'").arg(jsonFilename));
+	}
+
+	return true;
+}
+
+CommandRenderTiled::CommandRenderTiled()
+	: ccCommandLineInterface::Command("Tiled rendering", COMMAND_RENDER_TILED)
+{}
+
+bool CommandRenderTiled::process(ccCommandLineInterface& cmd)
+{
+	cmd.print("[TILED RENDERING]");
+
+	//optional parameters
+	int width = 1280;
+	int height = 720;
+	float zoomFactor = 1.0f;
+	int tileSize = 1024;
+	QString viewportFilename;
+	while (!cmd.arguments().empty())
+	{
+		QString argument = cmd.arguments().front();
+		bool ok = true;
+		if (ccCommandLineInterface::IsCommand(argument, COMMAND_BENCHMARK_SIZE))
+		{
+			cmd.arguments().pop_front();
+			bool okH = false;
+			width = (cmd.arguments().empty() ? 0 : cmd.arguments().takeFirst().toInt(&ok));
+			height = (cmd.arguments().empty() ? 0 : cmd.arguments().takeFirst().toInt(&okH));
+			if (!ok || !okH || width <= 0 || height <= 0)
+			{
+				return cmd.error(QString("Invalid or missing values after \"-%1\" (width and height expected)").arg(COMMAND_BENCHMARK_SIZE));
+			}
+		}
+		else if (ccCommandLineInterface::IsCommand(argument, COMMAND_RENDER_ZOOM))
+		{
+			cmd.arguments().pop_front();
+			zoomFactor = (cmd.arguments().empty() ? 0.0f : cmd.arguments().takeFirst().toFloat(&ok));
+			if (!ok || zoomFactor < 1.0e-2f)
+			{
+				return cmd.error(QString("Invalid or missing value after \"-%1\"").arg(COMMAND_RENDER_ZOOM));
+			}
+		}
+		else if (ccCommandLineInterface::IsCommand(argument, COMMAND_RENDER_TILE_SIZE))
+		{
+			cmd.arguments().pop_front();
+			tileSize = (cmd.arguments().empty() ? 0 : cmd.arguments().takeFirst().toInt(&ok));
+			if (!ok || tileSize < 16)
+			{
+				return cmd.error(QString("Invalid or missing value after \"-%1\" (16 pixels at least)").arg(COMMAND_RENDER_TILE_SIZE));
+			}
+		}
+		else if (ccCommandLineInterface::IsCommand(argument, COMMAND_RENDER_VIEWPORT))
+		{
+			cmd.arguments().pop_front();
+			if (cmd.arguments().empty())
+			{
+				return cmd.error(QString("Missing parameter: camera path filename after \"-%1\"").arg(COMMAND_RENDER_VIEWPORT));
+			}
+			viewportFilename = cmd.arguments().takeFirst();
+		}
+		else
+		{
+			break;
+		}
+	}
+
+	if (cmd.arguments().empty())
+	{
+		return cmd.error(QString("Missing parameter: output filename after \"-%1\"").arg(COMMAND_RENDER_TILED));
+	}
+	QString outputFilename = cmd.arguments().takeFirst();
+
+	if (cmd.clouds().empty() && cmd.meshes().empty())
+	{
+		return cmd.error(QString("No entity to render (be sure to open one with \"-%1 [filename]\" before \"-%2\")").arg(COMMAND_OPEN, COMMAND_RENDER_TILED));
+	}
+
+	//the viewport is the first one of a camera path (if any)
+	ccGLWindow::CameraPath cameraPath;
+	if (!viewportFilename.isEmpty())
+	{
+		if (!ccGLWindow::LoadCameraPath(viewportFilename, cameraPath) || cameraPath.empty())
+		{
+			return cmd.error(QString("Failed to load the camera path '%1'").arg(viewportFilename));
+		}
+	}
+
+	bool success = RenderLoadedEntities(cmd, width, height, [&](ccGLWindow* glWindow)
+	{
+		if (cameraPath.empty())
+		{
+			glWindow->zoomGlobal();
+		}
+		else
+		{
+			glWindow->setViewportParameters(cameraPath.front());
+		}
+		return glWindow->renderToFileTiled(outputFilename, zoomFactor, false, false, tileSize, cmd.progressDialog());
+	});
+
+	if (!success)
+	{
+		return cmd.error("Tiled rendering failed (see above)");
+	}
+	cmd.print(QString("\tImage saved in '%1'").arg(outputFilename));
+
+	return true;
+}
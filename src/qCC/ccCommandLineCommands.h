@@ -0,0 +1,94 @@
+//##########################################################################
+//#                                                                        #
+//#                              CLOUDCOMPARE                              #
+//#                                                                        #
+//#  This program is free software; you can redistribute it and/or modify  #
+//#  it under the terms of the GNU General Public License as published by  #
+//#  the Free Software Foundation; version 2 or later of the License.      #
+//#                                                                        #
+//#  This program is distributed in the hope that it will be useful,       #
+//#  but WITHOUT ANY WARRANTY; without even the implied warranty of        #
+//#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the          #
+//#  GNU General Public License for more details.                          #
+//#                                                                        #
+//#                  COPYRIGHT: Daniel Girardeau-Montaut                   #
+//#                                                                        #
+//##########################################################################
+
+#ifndef CC_COMMAND_LINE_COMMANDS_HEADER
+#define CC_COMMAND_LINE_COMMANDS_HEADER
+
+//interface
+#include "ccCommandLineInterface.h"
+
+//! Loads one file
+struct CommandLoad : public ccCommandLineInterface::Command
+{
+	CommandLoad();
+	bool process(ccCommandLineInterface& cmd) override;
+};
+
+//! Changes the clouds output format
+struct CommandChangeCloudOutputFormat : public ccCommandLineInterface::Command
+{
+	CommandChangeCloudOutputFormat();
+	bool process(ccCommandLineInterface& cmd) override;
+};
+
+//! Subsamples the loaded clouds (random, spatial or octree based)
+struct CommandSubsample : public ccCommandLineInterface::Command
+{
+	CommandSubsample();
+	bool process(ccCommandLineInterface& cmd) override;
+};
+
+//! Statistical Outliers Removal (SOR) filter
+struct CommandSOR : public ccCommandLineInterface::Command
+{
+	CommandSOR();
+	bool process(ccCommandLineInterface& cmd) override;
+};
+
+//! Cloud-to-cloud distances
+struct CommandC2CDist : public ccCommandLineInterface::Command
+{
+	CommandC2CDist();
+	bool process(ccCommandLineInterface& cmd) override;
+};
+
+//! Saves all the loaded clouds
+struct CommandSaveClouds : public ccCommandLineInterface::Command
+{
+	CommandSaveClouds();
+	bool process(ccCommandLineInterface& cmd) override;
+};
+
+//! Enables or disables the automatic saving of the clouds (after each process)
+struct CommandAutoSave : public ccCommandLineInterface::Command
+{
+	CommandAutoSave();
+	bool process(ccCommandLineInterface& cmd) override;
+};
+
+//! Disables the timestamp in the output filenames
+struct CommandNoTimestamp : public ccCommandLineInterface::Command
+{
+	CommandNoTimestamp();
+	bool process(ccCommandLineInterface& cmd) override;
+};
+
+//! Rendering benchmark (replays a camera path on the loaded entities)
+struct CommandRenderBenchmark : public ccCommandLineInterface::Command
+{
+	CommandRenderBenchmark();
+	bool process(ccCommandLineInterface& cmd) override;
+};
+
+//! Tiled rendering of the loaded entities (streamed to a BigTIFF or PNG file)
+struct CommandRenderTiled : public ccCommandLineInterface::Command
+{
+	CommandRenderTiled();
+	bool process(ccCommandLineInterface& cmd) override;
+};
+
+#endif //CC_COMMAND_LINE_COMMANDS_HEADER
@@ -0,0 +1,971 @@
+//##########################################################################
+//#                                                                        #
+//#                              CLOUDCOMPARE                              #
+//#                                                                        #
+//#  This program is free software; you can redistribute it and/or modify  #
+//#  it under the terms of the GNU General Public License as published by  #
+//#  the Free Software Foundation; version 2 or later of the License.      #
+//#                                                                        #
+//#  This program is distributed in the hope that it will be useful,       #
+//#  but WITHOUT ANY WARRANTY; without even the implied warranty of        #
+//#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the          #
+//#  GNU General Public License for more details.                          #
+//#                                                                        #
+//#                  COPYRIGHT: Daniel Girardeau-Montaut                   #
+//#                                                                        #
+//##########################################################################
+
+#include "ccCommandLineParser.h"
+
+//Local
+#include "ccCommandLineCommands.h"
+
+//CCLib
+#include <Cloud2CloudReferenceIndex.h>
+
+//qCC_db
+#include <ccHObjectCaster.h>
+#include <ccLog.h>
+#include <ccPointCloud.h>
+
+//qCC_io
+#include <AsciiFilter.h>
+#include <BinFilter.h>
+
+//Qt
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMutexLocker>
+#include <QThread>
+#include <QThreadPool>
+#include <QtConcurrentRun>
+
+//System
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstdio>
+
+//global options (must be placed before the commands)
+constexpr char COMMAND_SILENT_MODE[]	= "SILENT";
+constexpr char COMMAND_MAX_JOBS[]		= "MAX_JOBS";
+constexpr char COMMAND_MEMORY_BUDGET[]	= "MEMORY_BUDGET";
+constexpr char COMMAND_TIMINGS[]		= "TIMINGS_JSON";
+//load command keyword (for splitting the input files in batch mode)
+constexpr char COMMAND_OPEN[]			= "O";
+//C2C distance keywords (without a reference file, the loaded clouds are compared with each other)
+constexpr char COMMAND_C2C_DIST[]		= "C2C_DIST";
+constexpr char COMMAND_C2C_REFERENCE[]	= "REF";
+
+QSemaphore* ccCommandLineParser::s_memoryBudget = nullptr;
+int ccCommandLineParser::s_memoryBudgetMB = 0;
+QMutex ccCommandLineParser::s_octreeMutex;
+QMap<QString, ccCommandLineParser::SharedReference> ccCommandLineParser::s_sharedReferences;
+QMutex ccCommandLineParser::s_sharedReferencesMutex;
+
+//! Console logger (headless mode)
+class ccConsoleLog : public ccLog
+{
+public:
+
+	explicit ccConsoleLog(bool silent) : m_silent(silent) {}
+
+	void logMessage(const QString& message, int level) override
+	{
+#ifndef QT_DEBUG
+		if (level & LOG_DEBUG)
+		{
+			return;
+		}
+#endif
+		if (m_silent && !(level & (LOG_WARNING | LOG_ERROR)))
+		{
+			return;
+		}
+
+		QMutexLocker locker(&m_mutex);
+		if (level & LOG_ERROR)
+		{
+			fprintf(stderr, "[ERROR] %s\n", qPrintable(message));
+		}
+		else if (level & LOG_WARNING)
+		{
+			fprintf(stderr, "[WARNING] %s\n", qPrintable(message));
+		}
+		else
+		{
+			fprintf(stdout, "%s\n", qPrintable(message));
+			fflush(stdout);
+		}
+	}
+
+protected:
+
+	bool m_silent;
+	QMutex m_mutex;
+};
+
+//! Batch job (= one command sequence)
+struct ccCommandLineJob
+{
+	//! Job name
+	QString name;
+	//! Arguments
+	QStringList arguments;
+	//! Whether the job succeeded
+	bool success = false;
+	//! Total duration (in ms)
+	double total_ms = 0.0;
+	//! Time spent waiting for the memory budget (in ms)
+	double memoryWait_ms = 0.0;
+	//! Reserved memory (in MB)
+	int reservedMemoryMB = 0;
+	//! Stage timings
+	std::vector<ccCommandLineParser::StageTiming> timings;
+};
+
+static void RunJob(ccCommandLineJob& job)
+{
+	QElapsedTimer timer;
+	timer.start();
+
+	{
+		ccCommandLineParser parser(job.name);
+		parser.arguments() = job.arguments;
+
+		//reserve the whole job memory at once (so that jobs can't deadlock)
+		int memoryMB = 0;
+		for (const QString& argument : job.arguments)
+		{
+			if (QFileInfo(argument).isFile())
+			{
+				memoryMB += ccCommandLineParser::EstimateMemoryForFile(argument);
+			}
+		}
+		parser.reserveMemory(memoryMB);
+		job.memoryWait_ms = timer.nsecsElapsed() / 1.0e6;
+
+		job.success = parser.start();
+		job.timings = parser.timings();
+		job.reservedMemoryMB = memoryMB;
+
+		//the parser releases the entities and the reserved memory
+	}
+
+	job.total_ms = timer.nsecsElapsed() / 1.0e6;
+}
+
+static bool SaveTimings(const QString& filename, const std::vector<ccCommandLineJob>& jobs, int maxJobs, double total_ms)
+{
+	QJsonArray jobArray;
+	for (const ccCommandLineJob& job : jobs)
+	{
+		QJsonArray stageArray;
+		for (const ccCommandLineParser::StageTiming& timing : job.timings)
+		{
+			QJsonObject stage;
+			stage["command"] = timing.keyword;
+			stage["ms"] = timing.elapsed_ms;
+			stage["wait_ms"] = timing.wait_ms;
+			stageArray.append(stage);
+		}
+
+		QJsonObject jobObject;
+		jobObject["name"] = job.name;
+		jobObject["success"] = job.success;
+		jobObject["total_ms"] = job.total_ms;
+		jobObject["memory_wait_ms"] = job.memoryWait_ms;
+		jobObject["memory_mb"] = job.reservedMemoryMB;
+		jobObject["stages"] = stageArray;
+		jobArray.append(jobObject);
+	}
+
+	QJsonObject root;
+	root["max_jobs"] = maxJobs;
+	root["memory_budget_mb"] = ccCommandLineParser::MemoryBudgetMB();
+	root["total_ms"] = total_ms;
+	root["jobs"] = jobArray;
+
+	QFile file(filename);
+	if (!file.open(QFile::WriteOnly | QFile::Text))
+	{
+		return ccLog::Error(QString("Failed to write timings in file '%1'").arg(filename));
+	}
+	file.write(QJsonDocument(root).toJson());
+
+	return true;
+}
+
+//! Returns whether a command sequence compares the loaded clouds with each other
+/** I.e. '-C2C_DIST' without a reference file ('-REF filename').
+**/
+static bool ComparesLoadedClouds(const QStringList& commands)
+{
+	for (int i = 0; i < commands.size(); ++i)
+	{
+		if (!ccCommandLineInterface::IsCommand(commands[i], COMMAND_C2C_DIST))
+		{
+			continue;
+		}
+
+		//look for the reference file in the command options (before the next command)
+		bool hasReference = false;
+		for (int j = i + 1; j < commands.size() && !hasReference; ++j)
+		{
+			if (ccCommandLineInterface::IsCommand(commands[j], COMMAND_C2C_DIST) || ccCommandLineInterface::IsCommand(commands[j], COMMAND_OPEN))
+			{
+				break;
+			}
+			hasReference = ccCommandLineInterface::IsCommand(commands[j], COMMAND_C2C_REFERENCE);
+		}
+		if (!hasReference)
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+//! Splits the commands by input file (batch mode)
+/** Each '-O [-GLOBAL_SHIFT ...] filename' sequence becomes a job. The other
+	commands are applied to each job (in the same order). If the commands
+	compare the loaded clouds with each other, all the input files go in a
+	single job.
+**/
+static std::vector<ccCommandLineJob> SplitByInputFile(const QStringList& commands)
+{
+	if (ComparesLoadedClouds(commands))
+	{
+		ccLog::Warning(QString("[Batch] \"-%1\" without \"-%2\" compares the loaded clouds with each other: the input files are processed by a single job").arg(COMMAND_C2C_DIST, COMMAND_C2C_REFERENCE));
+		std::vector<ccCommandLineJob> jobs(1);
+		jobs.front().arguments = commands;
+		return jobs;
+	}
+
+	std::vector<QStringList> inputs;
+	QStringList script;
+
+	for (int i = 0; i < commands.size(); ++i)
+	{
+		if (!ccCommandLineInterface::IsCommand(commands[i], COMMAND_OPEN))
+		{
+			script << commands[i];
+			continue;
+		}
+
+		QStringList input;
+		input << commands[i];
+		if (i + 1 < commands.size() && ccCommandLineInterface::IsCommand(commands[i + 1], ccCommandLineInterface::COMMAND_OPEN_SHIFT_ON_LOAD()))
+		{
+			input << commands[++i];
+			if (i + 1 < commands.size())
+			{
+				QString shiftParam = commands[++i];
+				input << shiftParam;
+				if (	shiftParam.toUpper() != ccCommandLineInterface::COMMAND_OPEN_SHIFT_ON_LOAD_AUTO()
+					&&	shiftParam.toUpper() != ccCommandLineInterface::COMMAND_OPEN_SHIFT_ON_LOAD_FIRST())
+				{
+					//X Y Z
+					for (int j = 0; j < 2 && i + 1 < commands.size(); ++j)
+					{
+						input << commands[++i];
+					}
+				}
+			}
+		}
+		if (i + 1 < commands.size())
+		{
+			input << commands[++i]; //filename
+		}
+		inputs.push_back(input);
+	}
+
+	std::vector<ccCommandLineJob> jobs;
+	jobs.resize(inputs.size());
+	for (size_t i = 0; i < inputs.size(); ++i)
+	{
+		jobs[i].name = QFileInfo(inputs[i].back()).fileName();
+		jobs[i].arguments = inputs[i] + script;
+	}
+
+	return jobs;
+}
+
+int ccCommandLineParser::Parse(int nargs, char** args)
+{
+	if (!args || nargs < 2)
+	{
+		assert(false);
+		return EXIT_SUCCESS;
+	}
+
+	QStringList arguments;
+	for (int i = 1; i < nargs; ++i)
+	{
+		arguments << QString::fromLocal8Bit(args[i]);
+	}
+
+	//global options
+	bool silent = false;
+	int maxJobs = 1;
+	int memoryBudgetMB = 0;
+	QString timingsFilename;
+	QStringList commands;
+	while (!arguments.empty())
+	{
+		QString argument = arguments.takeFirst();
+
+		if (IsCommand(argument, COMMAND_SILENT_MODE))
+		{
+			silent = true;
+		}
+		else if (IsCommand(argument, COMMAND_MAX_JOBS) || IsCommand(argument, COMMAND_MEMORY_BUDGET))
+		{
+			bool ok = false;
+			int value = (arguments.empty() ? 0 : arguments.takeFirst().toInt(&ok));
+			if (!ok || value <= 0)
+			{
+				fprintf(stderr, "[ERROR] Invalid or missing value after '%s' (strictly positive integer expected)\n", qPrintable(argument));
+				return EXIT_FAILURE;
+			}
+			if (IsCommand(argument, COMMAND_MAX_JOBS))
+				maxJobs = value;
+			else
+				memoryBudgetMB = value;
+		}
+		else if (IsCommand(argument, COMMAND_TIMINGS))
+		{
+			if (arguments.empty())
+			{
+				fprintf(stderr, "[ERROR] Missing filename after '%s'\n", qPrintable(argument));
+				return EXIT_FAILURE;
+			}
+			timingsFilename = arguments.takeFirst();
+		}
+		else
+		{
+			commands << argument;
+		}
+	}
+
+	//console output
+	static ccConsoleLog s_consoleLog(silent);
+	ccLog::RegisterInstance(&s_consoleLog);
+
+	//I/O filters
+	FileIOFilter::InitInternalFilters();
+	//the semi-persistent dialogs must be created by the main thread
+	AsciiFilter::GetOpenDialog();
+	AsciiFilter::GetSaveDialog();
+
+	//global memory budget
+	if (memoryBudgetMB > 0)
+	{
+		s_memoryBudgetMB = memoryBudgetMB;
+		s_memoryBudget = new QSemaphore(memoryBudgetMB);
+	}
+
+	std::vector<ccCommandLineJob> jobs;
+	if (maxJobs > 1)
+	{
+		//batch mode: the input files are processed independently
+		jobs = SplitByInputFile(commands);
+	}
+	else
+	{
+		//standard mode: all the commands are processed in a row
+		jobs.resize(1);
+		jobs.front().arguments = commands;
+	}
+
+	QElapsedTimer timer;
+	timer.start();
+
+	if (jobs.size() < 2)
+	{
+		for (ccCommandLineJob& job : jobs)
+		{
+			RunJob(job);
+		}
+	}
+	else
+	{
+		ccLog::Print(QString("[Batch] %1 files, %2 concurrent jobs%3").arg(jobs.size()).arg(maxJobs).arg(memoryBudgetMB > 0 ? QString(", memory budget: %1 MB").arg(memoryBudgetMB) : QString()));
+
+		QThreadPool pool;
+		pool.setMaxThreadCount(maxJobs);
+
+		std::atomic<size_t> remainingJobs(jobs.size());
+		for (ccCommandLineJob& job : jobs)
+		{
+			QtConcurrent::run(&pool, [&job, &remainingJobs]()
+			{
+				RunJob(job);
+				--remainingJobs;
+				//wake up the main thread
+				QMetaObject::invokeMethod(QCoreApplication::instance(), []() {}, Qt::QueuedConnection);
+			});
+		}
+
+		//the main thread processes the I/O tasks (see runIOTask)
+		while (remainingJobs != 0)
+		{
+			QCoreApplication::processEvents(QEventLoop::WaitForMoreEvents);
+		}
+		pool.waitForDone();
+	}
+
+	double total_ms = timer.nsecsElapsed() / 1.0e6;
+
+	bool success = true;
+	for (const ccCommandLineJob& job : jobs)
+	{
+		if (!job.success)
+		{
+			success = false;
+			if (jobs.size() > 1)
+			{
+				ccLog::Warning(QString("[Batch] Job '%1' failed").arg(job.name));
+			}
+		}
+	}
+
+	if (!timingsFilename.isEmpty())
+	{
+		SaveTimings(timingsFilename, jobs, maxJobs, total_ms);
+	}
+
+	ReleaseSharedReferences();
+
+	delete s_memoryBudget;
+	s_memoryBudget = nullptr;
+	s_memoryBudgetMB = 0;
+
+	ccLog::RegisterInstance(nullptr);
+
+	return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+ccCommandLineParser::ccCommandLineParser(const QString& jobName/*=QString()*/)
+	: ccCommandLineInterface()
+	, m_jobName(jobName)
+	, m_cloudExportFormat(BinFilter::GetFileFilter())
+	, m_cloudExportExt(BinFilter::GetDefaultExtension())
+	, m_meshExportFormat(BinFilter::GetFileFilter())
+	, m_meshExportExt(BinFilter::GetDefaultExtension())
+	, m_hierarchyExportFormat(BinFilter::GetFileFilter())
+	, m_hierarchyExportExt(BinFilter::GetDefaultExtension())
+	, m_currentStageWait_ms(0.0)
+	, m_reservedMemoryMB(0)
+{
+	registerBuiltInCommands();
+}
+
+ccCommandLineParser::~ccCommandLineParser()
+{
+	removeClouds();
+	removeMeshes();
+
+	releaseMemory();
+}
+
+void ccCommandLineParser::registerBuiltInCommands()
+{
+	registerCommand(Command::Shared(new CommandLoad));
+	registerCommand(Command::Shared(new CommandChangeCloudOutputFormat));
+	registerCommand(Command::Shared(new CommandSubsample));
+	registerCommand(Command::Shared(new CommandSOR));
+	registerCommand(Command::Shared(new CommandC2CDist));
+	registerCommand(Command::Shared(new CommandSaveClouds));
+	registerCommand(Command::Shared(new CommandAutoSave));
+	registerCommand(Command::Shared(new CommandNoTimestamp));
+	registerCommand(Command::Shared(new CommandRenderBenchmark));
+	registerCommand(Command::Shared(new CommandRenderTiled));
+}
+
+bool ccCommandLineParser::registerCommand(Command::Shared command)
+{
+	if (!command)
+	{
+		assert(false);
+		return false;
+	}
+
+	QString keyword = command->m_keyword.toUpper();
+	if (m_commands.contains(keyword))
+	{
+		assert(false);
+		warning(QString("Internal error: keyword '%1' already registered (by command '%2')").arg(keyword, m_commands[keyword]->m_name));
+		return false;
+	}
+
+	m_commands.insert(keyword, command);
+
+	return true;
+}
+
+bool ccCommandLineParser::start()
+{
+	while (!m_arguments.empty())
+	{
+		QString argument = m_arguments.takeFirst();
+		if (!argument.startsWith("-"))
+		{
+			return error(QString("Unexpected argument '%1' (a command was expected)").arg(argument));
+		}
+
+		QString keyword = argument.mid(1).toUpper();
+		QMap<QString, Command::Shared>::const_iterator it = m_commands.constFind(keyword);
+		if (it == m_commands.constEnd())
+		{
+			return error(QString("Unknown or misplaced command: '%1'").arg(argument));
+		}
+
+		QElapsedTimer timer;
+		timer.start();
+		m_currentStageWait_ms = 0.0;
+
+		bool success = (*it)->process(*this);
+
+		StageTiming timing;
+		timing.keyword = keyword;
+		timing.elapsed_ms = timer.nsecsElapsed() / 1.0e6;
+		timing.wait_ms = m_currentStageWait_ms;
+		m_timings.push_back(timing);
+
+		if (!success)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void ccCommandLineParser::runIOTask(const std::function<void()>& task)
+{
+	QCoreApplication* app = QCoreApplication::instance();
+	if (!app || QThread::currentThread() == app->thread())
+	{
+		task();
+		return;
+	}
+
+	QElapsedTimer timer;
+	timer.start();
+	qint64 startTime = 0;
+
+	//the main thread processes the I/O tasks one at a time
+	QMetaObject::invokeMethod(app, [&]()
+	{
+		startTime = timer.nsecsElapsed();
+		task();
+	}, Qt::BlockingQueuedConnection);
+
+	addWaitingTime(startTime / 1.0e6);
+}
+
+ccCommandLineParser::OctreeLocker::OctreeLocker(ccCommandLineParser& parser)
+{
+	QElapsedTimer timer;
+	timer.start();
+	s_octreeMutex.lock();
+	parser.addWaitingTime(timer.nsecsElapsed() / 1.0e6);
+}
+
+ccCommandLineParser::OctreeLocker::~OctreeLocker()
+{
+	s_octreeMutex.unlock();
+}
+
+const CCLib::Cloud2CloudReferenceIndex* ccCommandLineParser::sharedReferenceIndex(const QString& filename)
+{
+	QElapsedTimer timer;
+	timer.start();
+	QMutexLocker locker(&s_sharedReferencesMutex);
+	addWaitingTime(timer.nsecsElapsed() / 1.0e6);
+
+	QMap<QString, SharedReference>::iterator it = s_sharedReferences.find(filename);
+	if (it != s_sharedReferences.end())
+	{
+		//already loaded (or failed to load) by another job
+		return it->index;
+	}
+
+	//we only try once
+	SharedReference& reference = s_sharedReferences[filename];
+
+	//the reference file is loaded as any other file, then taken out of this job's clouds
+	size_t cloudCount = m_clouds.size();
+	if (!importFile(filename))
+	{
+		return nullptr;
+	}
+	if (m_clouds.size() == cloudCount)
+	{
+		error(QString("No point cloud in the reference file '%1'").arg(filename));
+		return nullptr;
+	}
+	reference.cloud = m_clouds[cloudCount].pc;
+	m_clouds[cloudCount].pc = nullptr;
+	while (m_clouds.size() > cloudCount)
+	{
+		removeClouds(true);
+	}
+
+	CCLib::Cloud2CloudReferenceIndex* index = new CCLib::Cloud2CloudReferenceIndex(reference.cloud);
+	if (!index->build())
+	{
+		delete index;
+		error("Failed to build the search structure of the reference cloud (not enough memory?)");
+		return nullptr;
+	}
+	reference.index = index;
+
+	print(QString("Reference cloud '%1' loaded (shared by all the jobs)").arg(reference.cloud->getName()));
+
+	return reference.index;
+}
+
+void ccCommandLineParser::ReleaseSharedReferences()
+{
+	QMutexLocker locker(&s_sharedReferencesMutex);
+
+	for (SharedReference& reference : s_sharedReferences)
+	{
+		delete reference.index;
+		delete reference.cloud;
+	}
+	s_sharedReferences.clear();
+}
+
+int ccCommandLineParser::EstimateMemoryForFile(const QString& filename)
+{
+	//rough estimation: the loaded entities + the processing structures
+	//(octree, subsampled or filtered copies, etc.) take about twice the
+	//size of the file
+	qint64 fileSize = QFileInfo(filename).size();
+	return static_cast<int>((2 * fileSize) >> 20) + 1;
+}
+
+void ccCommandLineParser::reserveMemory(int sizeMB)
+{
+	if (!s_memoryBudget || sizeMB <= 0)
+	{
+		return;
+	}
+
+	//a job can't reserve more than the whole budget
+	sizeMB = std::min(sizeMB, s_memoryBudgetMB - m_reservedMemoryMB);
+	if (sizeMB <= 0)
+	{
+		return;
+	}
+
+	s_memoryBudget->acquire(sizeMB);
+	m_reservedMemoryMB += sizeMB;
+}
+
+void ccCommandLineParser::releaseMemory()
+{
+	if (s_memoryBudget && m_reservedMemoryMB > 0)
+	{
+		s_memoryBudget->release(m_reservedMemoryMB);
+	}
+	m_reservedMemoryMB = 0;
+}
+
+QString ccCommandLineParser::getExportFilename(	const CLEntityDesc& entityDesc,
+												QString extension/*=QString()*/,
+												QString suffix/*=QString()*/,
+												QString* baseOutputFilename/*=nullptr*/,
+												bool forceNoTimestamp/*=false*/) const
+{
+	const ccHObject* entity = entityDesc.getEntity();
+	if (!entity)
+	{
+		assert(false);
+		return QString();
+	}
+
+	QString outputFilename = entityDesc.basename;
+	if (entityDesc.indexInFile >= 0)
+	{
+		outputFilename += QString("_%1").arg(entityDesc.indexInFile);
+	}
+	if (!suffix.isEmpty())
+	{
+		outputFilename += QString("_") + suffix;
+	}
+
+	if (baseOutputFilename)
+	{
+		*baseOutputFilename = outputFilename;
+	}
+
+	if (addTimestamp() && !forceNoTimestamp)
+	{
+		outputFilename += QString("_%1").arg(QDateTime::currentDateTime().toString("yyyy-MM-dd_hh'h'mm_ss_zzz"));
+	}
+
+	if (!extension.isEmpty())
+	{
+		outputFilename += QString(".%1").arg(extension);
+	}
+
+	if (!entityDesc.path.isEmpty())
+	{
+		outputFilename.prepend(entityDesc.path + QString("/"));
+	}
+
+	return outputFilename;
+}
+
+QString ccCommandLineParser::exportEntity(	CLEntityDesc& entityDesc,
+											const QString &suffix/*=QString()*/,
+											QString* _outputFilename/*=nullptr*/,
+											ccCommandLineInterface::ExportOptions options/*=ExportOption::NoOptions*/)
+{
+	print("[SAVING]");
+
+	ccHObject* entity = entityDesc.getEntity();
+	if (!entity)
+	{
+		assert(false);
+		return "[ExportEntity] Internal error: invalid input entity!";
+	}
+
+	bool asHierarchy = false;
+	bool asMesh = false;
+	if (options.testFlag(ExportOption::ForceHierarchy))
+	{
+		asHierarchy = true;
+	}
+	else if (options.testFlag(ExportOption::ForceMesh))
+	{
+		asMesh = true;
+	}
+	else if (!options.testFlag(ExportOption::ForceCloud))
+	{
+		asHierarchy = (entityDesc.getCLEntityType() == CL_ENTITY_TYPE::GROUP);
+		asMesh = entity->isKindOf(CC_TYPES::MESH);
+	}
+
+	QString format = m_cloudExportFormat;
+	QString extension = m_cloudExportExt;
+	if (asHierarchy)
+	{
+		format = m_hierarchyExportFormat;
+		extension = m_hierarchyExportExt;
+	}
+	else if (asMesh)
+	{
+		format = m_meshExportFormat;
+		extension = m_meshExportExt;
+	}
+
+	QString outputFilename = getExportFilename(entityDesc, extension, suffix, nullptr, options.testFlag(ExportOption::ForceNoTimestamp));
+	if (outputFilename.isEmpty())
+	{
+		return "[ExportEntity] Internal error: invalid output filename!";
+	}
+	if (_outputFilename)
+	{
+		*_outputFilename = outputFilename;
+	}
+
+	CC_FILE_ERROR result = CC_FERR_NO_ERROR;
+	runIOTask([&]()
+	{
+		FileIOFilter::SaveParameters parameters;
+		parameters.alwaysDisplaySaveDialog = false;
+		parameters.parentWidget = nullptr;
+		result = FileIOFilter::SaveToFile(entity, outputFilename, parameters, format);
+	});
+
+	if (result != CC_FERR_NO_ERROR)
+	{
+		return QString("Failed to save result in file '%1'").arg(outputFilename);
+	}
+
+	print(QString("File '%1' saved").arg(outputFilename));
+
+	return QString();
+}
+
+template <class EntityDesc> static bool SaveEntities(	ccCommandLineParser& parser,
+														std::vector<EntityDesc>& entities,
+														const QString& format,
+														CC_CLASS_ENUM type,
+														ccCommandLineInterface::ExportOption option,
+														QString suffix,
+														bool allAtOnce,
+														const QString* allAtOnceFileName)
+{
+	if (allAtOnce && entities.size() > 1)
+	{
+		//check that the output format supports multiple entities
+		FileIOFilter::Shared filter = FileIOFilter::GetFilter(format, false);
+		bool multiple = false;
+		bool exclusive = true;
+		if (filter && filter->canSave(type, multiple, exclusive) && multiple)
+		{
+			ccHObject tempContainer("Entities");
+			for (EntityDesc& desc : entities)
+			{
+				tempContainer.addChild(desc.getEntity(), ccHObject::DP_NONE);
+			}
+
+			QString basename = entities.front().basename + QString("_ALL");
+			QString path = entities.front().path;
+			if (allAtOnceFileName && !allAtOnceFileName->isEmpty())
+			{
+				QFileInfo fi(*allAtOnceFileName);
+				basename = fi.completeBaseName();
+				path = fi.path();
+			}
+
+			CLGroupDesc groupDesc(&tempContainer, basename, path);
+			QString errorStr = parser.exportEntity(groupDesc, suffix, nullptr, option);
+			if (!errorStr.isEmpty())
+			{
+				return parser.error(errorStr);
+			}
+			return true;
+		}
+
+		parser.warning("The output format doesn't support multiple entities: entities will be saved separately");
+	}
+
+	for (EntityDesc& desc : entities)
+	{
+		QString errorStr = parser.exportEntity(desc, suffix, nullptr, option);
+		if (!errorStr.isEmpty())
+		{
+			return parser.error(errorStr);
+		}
+	}
+
+	return true;
+}
+
+bool ccCommandLineParser::saveClouds(QString suffix/*=QString()*/, bool allAtOnce/*=false*/, const QString* allAtOnceFileName/*=nullptr*/)
+{
+	return SaveEntities(*this, m_clouds, m_cloudExportFormat, CC_TYPES::POINT_CLOUD, ExportOption::ForceCloud, suffix, allAtOnce, allAtOnceFileName);
+}
+
+bool ccCommandLineParser::saveMeshes(QString suffix/*=QString()*/, bool allAtOnce/*=false*/, const QString* allAtOnceFileName/*=nullptr*/)
+{
+	return SaveEntities(*this, m_meshes, m_meshExportFormat, CC_TYPES::MESH, ExportOption::ForceMesh, suffix, allAtOnce, allAtOnceFileName);
+}
+
+void ccCommandLineParser::removeClouds(bool onlyLast/*=false*/)
+{
+	while (!m_clouds.empty())
+	{
+		delete m_clouds.back().pc;
+		m_clouds.pop_back();
+		if (onlyLast)
+		{
+			break;
+		}
+	}
+}
+
+void ccCommandLineParser::removeMeshes(bool onlyLast/*=false*/)
+{
+	while (!m_meshes.empty())
+	{
+		delete m_meshes.back().mesh;
+		m_meshes.pop_back();
+		if (onlyLast)
+		{
+			break;
+		}
+	}
+}
+
+bool ccCommandLineParser::importFile(QString filename, FileIOFilter::Shared filter/*=FileIOFilter::Shared(nullptr)*/)
+{
+	print(QString("Opening file: '%1'").arg(filename));
+
+	ccHObject* db = nullptr;
+	CC_FILE_ERROR result = CC_FERR_NO_ERROR;
+	runIOTask([&]()
+	{
+		if (filter)
+		{
+			db = FileIOFilter::LoadFromFile(filename, m_loadingParameters, filter, result);
+		}
+		else
+		{
+			db = FileIOFilter::LoadFromFile(filename, m_loadingParameters, result, QString());
+		}
+	});
+
+	if (!db)
+	{
+		return error(QString("Failed to open file '%1'").arg(filename));
+	}
+
+	//look for the clouds and the meshes inside the file
+	ccHObject::Container meshes;
+	db->filterChildren(meshes, true, CC_TYPES::MESH);
+	for (size_t i = 0; i < meshes.size(); ++i)
+	{
+		ccGenericMesh* mesh = ccHObjectCaster::ToGenericMesh(meshes[i]);
+		if (mesh->getParent())
+		{
+			mesh->getParent()->detachChild(mesh);
+		}
+		m_meshes.emplace_back(mesh, filename, meshes.size() > 1 ? static_cast<int>(i) : -1);
+		print(QString("Found one mesh with %1 faces: '%2'").arg(mesh->size()).arg(mesh->getName()));
+	}
+
+	ccHObject::Container clouds;
+	db->filterChildren(clouds, true, CC_TYPES::POINT_CLOUD);
+	for (size_t i = 0; i < clouds.size(); ++i)
+	{
+		ccPointCloud* cloud = ccHObjectCaster::ToPointCloud(clouds[i]);
+		if (!cloud || (cloud->getParent() && cloud->getParent()->isKindOf(CC_TYPES::MESH)))
+		{
+			//mesh vertices are handled with the mesh
+			continue;
+		}
+		if (cloud->getParent())
+		{
+			cloud->getParent()->detachChild(cloud);
+		}
+		m_clouds.emplace_back(cloud, filename, clouds.size() > 1 ? static_cast<int>(i) : -1);
+		print(QString("Found one cloud with %1 points").arg(cloud->size()));
+	}
+
+	delete db;
+	db = nullptr;
+
+	return true;
+}
+
+void ccCommandLineParser::print(const QString& message) const
+{
+	ccLog::Print(m_jobName.isEmpty() ? message : QString("[%1] %2").arg(m_jobName, message));
+}
+
+void ccCommandLineParser::warning(const QString& message) const
+{
+	ccLog::Warning(m_jobName.isEmpty() ? message : QString("[%1] %2").arg(m_jobName, message));
+}
+
+bool ccCommandLineParser::error(const QString& message) const
+{
+	ccLog::Error(m_jobName.isEmpty() ? message : QString("[%1] %2").arg(m_jobName, message));
+
+	return false;
+}
@@ -0,0 +1,222 @@
+//##########################################################################
+//#                                                                        #
+//#                              CLOUDCOMPARE                              #
+//#                                                                        #
+//#  This program is free software; you can redistribute it and/or modify  #
+//#  it under the terms of the GNU General Public License as published by  #
+//#  the Free Software Foundation; version 2 or later of the License.      #
+//#                                                                        #
+//#  This program is distributed in the hope that it will be useful,       #
+//#  but WITHOUT ANY WARRANTY; without even the implied warranty of        #
+//#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the          #
+//#  GNU General Public License for more details.                          #
+//#                                                                        #
+//#                  COPYRIGHT: Daniel Girardeau-Montaut                   #
+//#                                                                        #
+//##########################################################################
+
+#ifndef CC_COMMAND_LINE_PARSER_HEADER
+#define CC_COMMAND_LINE_PARSER_HEADER
+
+//interface
+#include "ccCommandLineInterface.h"
+
+//Qt
+#include <QMap>
+#include <QMutex>
+#include <QSemaphore>
+
+//System
+#include <functional>
+#include <vector>
+
+namespace CCLib
+{
+	class Cloud2CloudReferenceIndex;
+}
+class ccPointCloud;
+
+//! Command line parser (headless mode)
+/** Implements the ccCommandLineInterface without any GUI (it can be run on a
+	server without any display). Several input files can be processed
+	concurrently (see the '-MAX_JOBS' option): each file then goes through the
+	same command sequence (load > process > save) independently of the others,
+	under a global memory budget (see the '-MEMORY_BUDGET' option). A reference
+	file ('-C2C_DIST -REF filename') is loaded only once and shared by all the
+	jobs.
+**/
+class ccCommandLineParser : public ccCommandLineInterface
+{
+public:
+
+	//! Parses the command line (main entry point)
+	/** \return the application exit code (0 = success)
+	**/
+	static int Parse(int nargs, char** args);
+
+	//! Default constructor
+	/** \param jobName job name (for logging)
+	**/
+	explicit ccCommandLineParser(const QString& jobName = QString());
+
+	//! Destructor
+	~ccCommandLineParser() override;
+
+	//! Processes the current arguments
+	/** \return success
+	**/
+	bool start();
+
+public: //ccCommandLineInterface
+
+	bool registerCommand(Command::Shared command) override;
+	QString getExportFilename(	const CLEntityDesc& entityDesc,
+								QString extension = QString(),
+								QString suffix = QString(),
+								QString* baseOutputFilename = nullptr,
+								bool forceNoTimestamp = false) const override;
+	QString exportEntity(	CLEntityDesc& entityDesc,
+							const QString &suffix = QString(),
+							QString* outputFilename = nullptr,
+							ccCommandLineInterface::ExportOptions options = ExportOption::NoOptions) override;
+	bool saveClouds(QString suffix = QString(), bool allAtOnce = false, const QString* allAtOnceFileName = nullptr) override;
+	bool saveMeshes(QString suffix = QString(), bool allAtOnce = false, const QString* allAtOnceFileName = nullptr) override;
+	void removeClouds(bool onlyLast = false) override;
+	void removeMeshes(bool onlyLast = false) override;
+	QStringList& arguments() override { return m_arguments; }
+	const QStringList& arguments() const override { return m_arguments; }
+	bool importFile(QString filename, FileIOFilter::Shared filter = FileIOFilter::Shared(nullptr)) override;
+	QString cloudExportFormat() const override { return m_cloudExportFormat; }
+	QString cloudExportExt() const override { return m_cloudExportExt; }
+	QString meshExportFormat() const override { return m_meshExportFormat; }
+	QString meshExportExt() const override { return m_meshExportExt; }
+	QString hierarchyExportFormat() const override { return m_hierarchyExportFormat; }
+	QString hierarchyExportExt() const override { return m_hierarchyExportExt; }
+	void setCloudExportFormat(QString format, QString ext) override { m_cloudExportFormat = format; m_cloudExportExt = ext; }
+	void setMeshExportFormat(QString format, QString ext) override { m_meshExportFormat = format; m_meshExportExt = ext; }
+	void setHierarchyExportFormat(QString format, QString ext) override { m_hierarchyExportFormat = format; m_hierarchyExportExt = ext; }
+	void print(const QString& message) const override;
+	void warning(const QString& message) const override;
+	bool error(const QString& message) const override;
+
+public: //pipeline stages
+
+	//! Stage timing
+	struct StageTiming
+	{
+		//! Command keyword
+		QString keyword;
+		//! Elapsed time (in ms)
+		double elapsed_ms;
+		//! Time spent waiting for a shared resource (stage lock or memory budget, in ms)
+		double wait_ms;
+	};
+
+	//! Returns the timings of the processed commands
+	const std::vector<StageTiming>& timings() const { return m_timings; }
+
+	//! Runs an I/O task (file loading or saving)
+	/** I/O filters rely on static states and on semi-persistent dialogs:
+		all I/O tasks are run by the main thread, one at a time. They can
+		still overlap with the processing stages of the other jobs.
+	**/
+	void runIOTask(const std::function<void()>& task);
+
+	//! Octree stage lock (scoped)
+	/** The multi-threaded octree traversal relies on static states: the
+		octree based processes are run by one job at a time (they are
+		already parallel internally).
+	**/
+	class OctreeLocker
+	{
+	public:
+		explicit OctreeLocker(ccCommandLineParser& parser);
+		~OctreeLocker();
+	};
+
+	//! Reserves some memory from the global budget (blocking)
+	/** \param sizeMB requested amount of memory (in MB)
+	**/
+	void reserveMemory(int sizeMB);
+	//! Releases all the memory reserved by this job
+	void releaseMemory();
+
+	//! Returns the amount of memory (in MB) required to process a given file (estimation)
+	static int EstimateMemoryForFile(const QString& filename);
+
+	//! Returns the global memory budget (in MB, or 0 if none)
+	static int MemoryBudgetMB() { return s_memoryBudgetMB; }
+
+	//! Returns the search structure of a reference cloud shared by all the jobs
+	/** The reference file is loaded (and its search structure is built) only
+		once, by the first job that requests it. The other jobs wait for it.
+		\param filename reference file (only its first cloud is used)
+		\return the search structure (or null if the file couldn't be loaded)
+	**/
+	const CCLib::Cloud2CloudReferenceIndex* sharedReferenceIndex(const QString& filename);
+
+	//! Releases the shared reference clouds (see sharedReferenceIndex)
+	static void ReleaseSharedReferences();
+
+protected: //methods
+
+	//! Registers all the default commands
+	void registerBuiltInCommands();
+
+	//! Adds some waiting time to the current stage
+	void addWaitingTime(double ms) { m_currentStageWait_ms += ms; }
+
+protected: //members
+
+	//! Job name (for logging)
+	QString m_jobName;
+
+	//! Arguments
+	QStringList m_arguments;
+
+	//! Registered commands
+	QMap<QString, Command::Shared> m_commands;
+
+	//! Clouds export format
+	QString m_cloudExportFormat;
+	//! Clouds export extension
+	QString m_cloudExportExt;
+	//! Meshes export format
+	QString m_meshExportFormat;
+	//! Meshes export extension
+	QString m_meshExportExt;
+	//! Hierarchies export format
+	QString m_hierarchyExportFormat;
+	//! Hierarchies export extension
+	QString m_hierarchyExportExt;
+
+	//! Timings of the processed commands
+	std::vector<StageTiming> m_timings;
+	//! Waiting time of the current stage
+	double m_currentStageWait_ms;
+
+	//! Amount of memory reserved by this job (in MB)
+	int m_reservedMemoryMB;
+
+	//! Global memory budget (in MB)
+	static QSemaphore* s_memoryBudget;
+	//! Global memory budget size (in MB)
+	static int s_memoryBudgetMB;
+	//! Octree stage lock
+	static QMutex s_octreeMutex;
+
+	//! Reference cloud shared by the jobs
+	struct SharedReference
+	{
+		//! Reference cloud
+		ccPointCloud* cloud = nullptr;
+		//! Search structure
+		CCLib::Cloud2CloudReferenceIndex* index = nullptr;
+	};
+	//! Shared reference clouds (by filename)
+	static QMap<QString, SharedReference> s_sharedReferences;
+	//! Shared reference clouds lock
+	static QMutex s_sharedReferencesMutex;
+};
+
+#endif //CC_COMMAND_LINE_PARSER_HEADER
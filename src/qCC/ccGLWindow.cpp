@@ -18,6 +18,10 @@
 //qCC
 #include "ccGLWindow.h"
 #include "ccRenderingTools.h"
+#include "ccTiledImageWriter.h"
+
+//CCLib
+#include <GenericProgressCallback.h>
 
 //qCC_db
 #include <cc2DLabel.h>
@@ -35,6 +39,11 @@
 
 //Qt
 #include <QApplication>
+#include <QDataStream>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
 #include <QLayout>
 #include <QMessageBox>
 #include <QMimeData>
@@ -44,6 +53,9 @@
 #include <QSettings>
 #include <QTouchEvent>
 #include <QWheelEvent>
+#ifndef QT_OPENGL_ES_2
+#include <QOpenGLTimerQuery>
+#endif
 
 #if defined( Q_OS_MAC ) || defined( Q_OS_LINUX )
 #include <QDir>
@@ -62,6 +74,11 @@ static OculusHMD s_oculus;
 #include <vld.h>
 #endif
 
+//system
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
 // These extra definitions are required in C++11.
 // In C++17, class-level "static constexpr" is implicitly inline, so these are not required.
 constexpr float ccGLWindow::MIN_POINT_SIZE_F;
@@ -350,6 +367,10 @@ ccGLWindow::ccGLWindow(	QSurfaceFormat* format/*=0*/,
 	, m_fbo2(nullptr)
 	, m_alwaysUseFBO(false)
 	, m_updateFBO(true)
+	, m_pickingFbo(nullptr)
+	, m_pickingShader(nullptr)
+	, m_pickingFboFlags(0)
+	, m_idBufferPickingSupported(true)
 	, m_colorRampShader(nullptr)
 	, m_customRenderingShader(nullptr)
 	, m_activeGLFilter(nullptr)
@@ -387,6 +408,8 @@ ccGLWindow::ccGLWindow(	QSurfaceFormat* format/*=0*/,
 	, m_ignoreMouseReleaseEvent(false)
 	, m_rotationAxisLocked(false)
 	, m_lockedRotationAxis(0, 0, 1)
+	, m_cameraPathRecording(false)
+	, m_benchmarkFrame(nullptr)
 {
 	//start internal timer
 	m_timer.start();
@@ -543,6 +566,12 @@ ccGLWindow::~ccGLWindow()
 	delete m_fbo2;
 	m_fbo2 = nullptr;
 
+	delete m_pickingFbo;
+	m_pickingFbo = nullptr;
+
+	delete m_pickingShader;
+	m_pickingShader = nullptr;
+
 #ifdef CC_GL_WINDOW_USE_QWINDOW
 	if (m_context)
 		m_context->doneCurrent();
@@ -1314,6 +1343,354 @@ void ccGLWindow::stopFrameRateTest()
 	redraw();
 }
 
+//Rendering benchmark
+static const char CAMERA_PATH_MAGIC[4] = { 'C', 'C', 'P', 'H' };
+static const unsigned BENCHMARK_MAX_LOD_PASSES = 256; //per frame
+
+void ccGLWindow::startCameraPathRecording()
+{
+	m_recordedCameraPath.clear();
+	m_cameraPathRecording = true;
+}
+
+bool ccGLWindow::SaveCameraPath(const QString& filename, const CameraPath& path)
+{
+	QFile out(filename);
+	if (!out.open(QIODevice::WriteOnly))
+	{
+		ccLog::Error(QString("Failed to open file '%1' for writing").arg(filename));
+		return false;
+	}
+
+	//header
+	{
+		QDataStream outStream(&out);
+		outStream.writeRawData(CAMERA_PATH_MAGIC, 4);
+		outStream << static_cast<quint32>(ccObject::GetCurrentDBVersion());
+		outStream << static_cast<quint32>(path.size());
+		if (outStream.status() != QDataStream::Ok)
+		{
+			return ccSerializableObject::WriteError();
+		}
+	}
+
+	for (const ccViewportParameters& params : path)
+	{
+		if (!params.toFile(out))
+		{
+			return ccSerializableObject::WriteError();
+		}
+	}
+
+	return true;
+}
+
+bool ccGLWindow::LoadCameraPath(const QString& filename, CameraPath& path)
+{
+	QFile in(filename);
+	if (!in.open(QIODevice::ReadOnly))
+	{
+		ccLog::Error(QString("Failed to open file '%1'").arg(filename));
+		return false;
+	}
+
+	//header
+	quint32 dataVersion = 0;
+	quint32 count = 0;
+	{
+		QDataStream inStream(&in);
+		char magic[4];
+		if (inStream.readRawData(magic, 4) != 4 || memcmp(magic, CAMERA_PATH_MAGIC, 4) != 0)
+		{
+			ccLog::Error(QString("File '%1' is not a camera path file").arg(filename));
+			return false;
+		}
+		inStream >> dataVersion;
+		inStream >> count;
+		if (inStream.status() != QDataStream::Ok)
+		{
+			return ccSerializableObject::ReadError();
+		}
+	}
+
+	path.clear();
+	try
+	{
+		path.reserve(count);
+	}
+	catch (const std::bad_alloc&)
+	{
+		ccLog::Error("Not enough memory!");
+		return false;
+	}
+
+	ccSerializableObject::LoadedIDMap oldToNewIDMap;
+	for (quint32 i = 0; i < count; ++i)
+	{
+		ccViewportParameters params;
+		if (!params.fromFile(in, static_cast<short>(dataVersion), 0, oldToNewIDMap))
+		{
+			path.clear();
+			return ccSerializableObject::CorruptError();
+		}
+		path.push_back(params);
+	}
+
+	return true;
+}
+
+//! Returns the p-th percentile of a (sorted) set of values (nearest rank)
+static double Percentile(const std::vector<double>& sortedValues, double p)
+{
+	if (sortedValues.empty())
+	{
+		return 0.0;
+	}
+	size_t rank = static_cast<size_t>(std::ceil(p / 100.0 * sortedValues.size()));
+	return sortedValues[std::min(std::max(rank, static_cast<size_t>(1)), sortedValues.size()) - 1];
+}
+
+//! Returns the mean and the p50/p95/p99 percentiles of a set of values
+static QJsonObject BenchmarkSummary(std::vector<double>& values)
+{
+	std::sort(values.begin(), values.end());
+
+	double sum = 0.0;
+	for (double v : values)
+	{
+		sum += v;
+	}
+
+	QJsonObject summary;
+	summary["mean"] = values.empty() ? 0.0 : sum / values.size();
+	summary["p50"] = Percentile(values, 50.0);
+	summary["p95"] = Percentile(values, 95.0);
+	summary["p99"] = Percentile(values, 99.0);
+	summary["max"] = values.empty() ? 0.0 : values.back();
+	return summary;
+}
+
+bool ccGLWindow::runRenderingBenchmark(	const CameraPath& path,
+										const QString& jsonFilename/*=QString()*/,
+										unsigned warmUpFrames/*=3*/,
+										std::vector<BenchmarkFrameStats>* frames/*=nullptr*/)
+{
+	if (path.empty())
+	{
+		ccLog::Error("[Benchmark] Empty camera path");
+		return false;
+	}
+	if (!m_initialized)
+	{
+		ccLog::Error("[Benchmark] The 3D view is not initialized");
+		return false;
+	}
+	if (s_frameRateTestInProgress)
+	{
+		ccLog::Error("Framerate test already in progress!");
+		return false;
+	}
+
+	std::vector<BenchmarkFrameStats> stats;
+	try
+	{
+		stats.resize(path.size());
+	}
+	catch (const std::bad_alloc&)
+	{
+		ccLog::Error("Not enough memory!");
+		return false;
+	}
+
+	makeCurrent();
+
+	ccQOpenGLFunctions* glFunc = functions();
+	assert(glFunc);
+
+	//GPU timer (OpenGL 3.3 or GL_ARB_timer_query)
+	bool gpuTimerSupported = false;
+#ifndef QT_OPENGL_ES_2
+	QOpenGLTimerQuery gpuTimer;
+	gpuTimerSupported = gpuTimer.create();
+#endif
+
+	//backup the current viewport
+	ccViewportParameters backupParams = m_viewportParams;
+	stopLODCycle();
+
+	auto renderFrame = [&](const ccViewportParameters& params, BenchmarkFrameStats& frameStats)
+	{
+		setViewportParameters(params);
+		m_benchmarkFrame = &frameStats;
+
+		QElapsedTimer frameTimer;
+		frameTimer.start();
+#ifndef QT_OPENGL_ES_2
+		if (gpuTimerSupported)
+		{
+			gpuTimer.begin();
+		}
+#endif
+
+		CC_DRAW_CONTEXT CONTEXT;
+		getContext(CONTEXT);
+		CONTEXT.renderingStats = &frameStats.renderingStats;
+
+		RenderingParams renderingParams;
+		renderingParams.useFBO = (m_fbo != nullptr);
+		renderingParams.draw3DCross = getDisplayParameters().displayCross;
+		renderingParams.passCount = m_stereoModeEnabled ? 2 : 1;
+
+		//all the LOD levels are rendered at once
+		while (true)
+		{
+			QElapsedTimer passTimer;
+			passTimer.start();
+			for (renderingParams.passIndex = 0; renderingParams.passIndex < renderingParams.passCount; ++renderingParams.passIndex)
+			{
+				fullRenderingPass(CONTEXT, renderingParams);
+			}
+			frameStats.fullRenderingPass_ms += passTimer.nsecsElapsed() / 1.0e6;
+			frameStats.lodLevel = m_currentLODState.level;
+			++frameStats.lodPassCount;
+
+			if (!renderingParams.nextLODState.inProgress || frameStats.lodPassCount >= BENCHMARK_MAX_LOD_PASSES)
+			{
+				break;
+			}
+			m_currentLODState = renderingParams.nextLODState;
+		}
+		stopLODCycle();
+
+#ifndef QT_OPENGL_ES_2
+		if (gpuTimerSupported)
+		{
+			gpuTimer.end();
+		}
+#endif
+		glFunc->glFinish();
+		frameStats.frame_ms = frameTimer.nsecsElapsed() / 1.0e6;
+
+#ifndef QT_OPENGL_ES_2
+		if (gpuTimerSupported)
+		{
+			frameStats.gpu_ms = gpuTimer.waitForResult() / 1.0e6;
+		}
+#endif
+
+		m_benchmarkFrame = nullptr;
+	};
+
+	//warm-up
+	for (unsigned i = 0; i < warmUpFrames; ++i)
+	{
+		BenchmarkFrameStats warmUpStats;
+		renderFrame(path.front(), warmUpStats);
+	}
+
+	for (size_t i = 0; i < path.size(); ++i)
+	{
+		stats[i].viewportIndex = static_cast<unsigned>(i);
+		renderFrame(path[i], stats[i]);
+	}
+
+	//restore the original viewport
+	setViewportParameters(backupParams);
+	redraw();
+
+	//summary
+	std::vector<double> frameTimes;
+	std::vector<double> gpuTimes;
+	size_t pointsDrawn = 0;
+	size_t vboBytesUploaded = 0;
+	QJsonArray frameArray;
+	try
+	{
+		frameTimes.reserve(stats.size());
+		if (gpuTimerSupported)
+		{
+			gpuTimes.reserve(stats.size());
+		}
+		for (const BenchmarkFrameStats& frameStats : stats)
+		{
+			frameTimes.push_back(frameStats.frame_ms);
+			if (gpuTimerSupported)
+			{
+				gpuTimes.push_back(frameStats.gpu_ms);
+			}
+			pointsDrawn += frameStats.renderingStats.pointsDrawn;
+			vboBytesUploaded += frameStats.renderingStats.vboBytesUploaded;
+
+			QJsonObject frame;
+			frame["viewport"] = static_cast<int>(frameStats.viewportIndex);
+			frame["lod_passes"] = static_cast<int>(frameStats.lodPassCount);
+			frame["lod_level"] = static_cast<int>(frameStats.lodLevel);
+			frame["frame_ms"] = frameStats.frame_ms;
+			frame["full_rendering_pass_ms"] = frameStats.fullRenderingPass_ms;
+			frame["draw_3d_ms"] = frameStats.draw3D_ms;
+			frame["gl_filter_ms"] = frameStats.glFilter_ms;
+			frame["draw_foreground_ms"] = frameStats.drawForeground_ms;
+			frame["gpu_ms"] = frameStats.gpu_ms;
+			frame["points_drawn"] = static_cast<double>(frameStats.renderingStats.pointsDrawn);
+			frame["vbo_bytes_uploaded"] = static_cast<double>(frameStats.renderingStats.vboBytesUploaded);
+			frameArray.append(frame);
+		}
+	}
+	catch (const std::bad_alloc&)
+	{
+		ccLog::Error("Not enough memory!");
+		return false;
+	}
+
+	QJsonObject frameTimesSummary = BenchmarkSummary(frameTimes);
+	ccLog::Print(QString("[Benchmark] %1 frames: mean = %2 ms / p50 = %3 ms / p95 = %4 ms / p99 = %5 ms")
+		.arg(stats.size())
+		.arg(frameTimesSummary["mean"].toDouble(), 0, 'f', 3)
+		.arg(frameTimesSummary["p50"].toDouble(), 0, 'f', 3)
+		.arg(frameTimesSummary["p95"].toDouble(), 0, 'f', 3)
+		.arg(frameTimesSummary["p99"].toDouble(), 0, 'f', 3));
+
+	if (!jsonFilename.isEmpty())
+	{
+		QJsonObject summary;
+		summary["frame_ms"] = frameTimesSummary;
+		if (gpuTimerSupported)
+		{
+			summary["gpu_ms"] = BenchmarkSummary(gpuTimes);
+		}
+		summary["points_drawn"] = static_cast<double>(pointsDrawn);
+		summary["vbo_bytes_uploaded"] = static_cast<double>(vboBytesUploaded);
+
+		QJsonObject root;
+		root["renderer"] = QString(reinterpret_cast<const char*>(glFunc->glGetString(GL_RENDERER)));
+		root["gl_version"] = QString(reinterpret_cast<const char*>(glFunc->glGetString(GL_VERSION)));
+		root["width"] = m_glViewport.width();
+		root["height"] = m_glViewport.height();
+		root["fbo"] = (m_fbo != nullptr);
+		root["gl_filter"] = (m_activeGLFilter != nullptr);
+		root["lod"] = isLODEnabled();
+		root["gpu_timer"] = gpuTimerSupported;
+		root["warm_up_frames"] = static_cast<int>(warmUpFrames);
+		root["summary"] = summary;
+		root["frames"] = frameArray;
+
+		QFile file(jsonFilename);
+		if (!file.open(QFile::WriteOnly | QFile::Text))
+		{
+			ccLog::Error(QString("Failed to write benchmark results in file '%1'").arg(jsonFilename));
+			return false;
+		}
+		file.write(QJsonDocument(root).toJson());
+	}
+
+	if (frames)
+	{
+		frames->swap(stats);
+	}
+
+	return true;
+}
+
 void ccGLWindow::drawClickableItems(int xStart0, int& yStart)
 {
 	//we init the necessary parameters the first time we need them
@@ -1518,6 +1895,9 @@ void ccGLWindow::refresh(bool only2D/*=false*/)
 
 void ccGLWindow::redraw(bool only2D/*=false*/, bool resetLOD/*=true*/)
 {
+	//the picking ID buffer is outdated
+	m_pickingFboFlags = 0;
+
 	if (m_currentLODState.inProgress && resetLOD)
 	{
 		//reset current LOD cycle
@@ -1565,6 +1945,12 @@ void ccGLWindow::requestUpdate()
 
 void ccGLWindow::paintGL()
 {
+	if (m_captureMode.tiled)
+	{
+		//a tiled capture is in progress (the progress dialog may process paint events)
+		return;
+	}
+
 #ifdef CC_GL_WINDOW_USE_QWINDOW
 	if (!isExposed())
 	{
@@ -1616,6 +2002,20 @@ void ccGLWindow::paintGL()
 		renderingParams.draw3DPass = true;
 	}
 
+	//camera path recording (only once per frame, i.e. not for the LOD passes)
+	if (m_cameraPathRecording && renderingParams.draw3DPass && !m_currentLODState.inProgress)
+	{
+		try
+		{
+			m_recordedCameraPath.push_back(m_viewportParams);
+		}
+		catch (const std::bad_alloc&)
+		{
+			ccLog::Warning("[Camera path] Not enough memory: recording stopped");
+			m_cameraPathRecording = false;
+		}
+	}
+
 	//other rendering options
 	renderingParams.useFBO = (m_fbo != nullptr);
 
@@ -2056,8 +2456,19 @@ void ccGLWindow::fullRenderingPass(CC_DRAW_CONTEXT& CONTEXT, RenderingParams& re
 			}
 		}
 
+		QElapsedTimer draw3DTimer;
+		if (m_benchmarkFrame)
+		{
+			draw3DTimer.start();
+		}
+
 		draw3D(CONTEXT, renderingParams);
 
+		if (m_benchmarkFrame)
+		{
+			m_benchmarkFrame->draw3D_ms += draw3DTimer.nsecsElapsed() / 1.0e6;
+		}
+
 		if (m_stereoModeEnabled && m_stereoParams.isAnaglyph())
 		{
 			//restore default color mask
@@ -2143,7 +2554,16 @@ void ccGLWindow::fullRenderingPass(CC_DRAW_CONTEXT& CONTEXT, RenderingParams& re
 					parameters.zoom = m_viewportParams.perspectiveView ? computePerspectiveZoom() : m_viewportParams.zoom; //TODO: doesn't work well with EDL in perspective mode!
 				}
 				//apply shader
+				QElapsedTimer glFilterTimer;
+				if (m_benchmarkFrame)
+				{
+					glFilterTimer.start();
+				}
 				m_activeGLFilter->shade(depthTex, colorTex, parameters);
+				if (m_benchmarkFrame)
+				{
+					m_benchmarkFrame->glFilter_ms += glFilterTimer.nsecsElapsed() / 1.0e6;
+				}
 				logGLError("ccGLWindow::paintGL/glFilter shade");
 				bindFBO(nullptr); //in case the active filter has used a FBOs!
 
@@ -2250,7 +2670,18 @@ void ccGLWindow::fullRenderingPass(CC_DRAW_CONTEXT& CONTEXT, RenderingParams& re
 	/******************/
 	if (renderingParams.drawForeground && !oculusMode)
 	{
+		QElapsedTimer drawForegroundTimer;
+		if (m_benchmarkFrame)
+		{
+			drawForegroundTimer.start();
+		}
+
 		drawForeground(CONTEXT, renderingParams);
+
+		if (m_benchmarkFrame)
+		{
+			m_benchmarkFrame->drawForeground_ms += drawForegroundTimer.nsecsElapsed() / 1.0e6;
+		}
 	}
 
 	glFunc->glFlush();
@@ -2400,6 +2831,12 @@ void ccGLWindow::draw3D(CC_DRAW_CONTEXT& CONTEXT, RenderingParams& renderingPara
 		projectionMat = getProjectionMatrix();
 	}
 
+	//tiled capture: restrict the projection to the current tile
+	if (m_captureMode.tiled)
+	{
+		projectionMat = computeTileMatrix() * projectionMat;
+	}
+
 	//setup the projection matrix
 	{
 		glFunc->glMatrixMode(GL_PROJECTION);
@@ -3422,11 +3859,13 @@ void ccGLWindow::updateProjectionMatrix()
 void ccGLWindow::deprecate3DLayer()
 {
 	m_updateFBO = true;
+	m_pickingFboFlags = 0;
 }
 
 void ccGLWindow::invalidateVisualization()
 {
 	m_validModelviewMatrix = false;
+	m_pickingFboFlags = 0;
 }
 
 ccGLMatrixd ccGLWindow::computeModelViewMatrix(const CCVector3d& cameraCenter) const
@@ -3552,7 +3991,10 @@ void ccGLWindow::setStandardOrthoCenter()
 	assert(glFunc);
 
 	glFunc->glMatrixMode(GL_PROJECTION);
-	glFunc->glLoadIdentity();
+	if (m_captureMode.tiled)
+		glFunc->glLoadMatrixd(computeTileMatrix().data());
+	else
+		glFunc->glLoadIdentity();
 	double halfW = m_glViewport.width() / 2.0;
 	double halfH = m_glViewport.height() / 2.0;
 	double maxS = std::max(halfW, halfH);
@@ -3567,7 +4009,10 @@ void ccGLWindow::setStandardOrthoCorner()
 	assert(glFunc);
 
 	glFunc->glMatrixMode(GL_PROJECTION);
-	glFunc->glLoadIdentity();
+	if (m_captureMode.tiled)
+		glFunc->glLoadMatrixd(computeTileMatrix().data());
+	else
+		glFunc->glLoadIdentity();
 	glFunc->glOrtho(0.0, m_glViewport.width(), 0.0, m_glViewport.height(), 0.0, 1.0);
 	glFunc->glMatrixMode(GL_MODELVIEW);
 	glFunc->glLoadIdentity();
@@ -4798,7 +5243,7 @@ void ccGLWindow::processPickingResult(	const PickingParameters& params,
 }
 
 //DGM: WARNING: OpenGL picking with the picking buffer is depreacted.
-//We need to get rid of this code or change it to color-based selection...
+//The color-based selection (ID buffer) is used first, and this code is only kept as a fallback.
 void ccGLWindow::startOpenGLPicking(const PickingParameters& params)
 {
 	if (!params.pickInLocalDB && !params.pickInSceneDB)
@@ -4833,172 +5278,177 @@ void ccGLWindow::startOpenGLPicking(const PickingParameters& params)
 	ccQOpenGLFunctions* glFunc = functions();
 	assert(glFunc);
 
-	//no need to clear display, we don't draw anything new!
-	//glFunc->glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	std::unordered_set<int> selectedIDs;
+	int pickedItemIndex = -1;
+	int selectedID = -1;
 
-	//OpenGL picking buffer size (= max hits number per 'OpenGL' selection pass)
-	static const GLsizei CC_PICKING_BUFFER_SIZE = 65536;
-	//GL names picking buffer
-	static GLuint s_pickingBuffer[CC_PICKING_BUFFER_SIZE];
+	//we use the ID buffer if possible (the GL_SELECT mode is not supported by all drivers)
+	if (!pickInIDBuffer(params, flags, selectedID, pickedItemIndex, selectedIDs))
+	{
+		//no need to clear display, we don't draw anything new!
+		//glFunc->glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-	//setup selection buffers
-	memset(s_pickingBuffer, 0, sizeof(GLuint)*CC_PICKING_BUFFER_SIZE);
-	glFunc->glSelectBuffer(CC_PICKING_BUFFER_SIZE, s_pickingBuffer);
-	glFunc->glRenderMode(GL_SELECT);
-	glFunc->glInitNames();
+		//OpenGL picking buffer size (= max hits number per 'OpenGL' selection pass)
+		static const GLsizei CC_PICKING_BUFFER_SIZE = 65536;
+		//GL names picking buffer
+		static GLuint s_pickingBuffer[CC_PICKING_BUFFER_SIZE];
 
-	//get viewport
-	GLint viewport[4] = { m_glViewport.left(), m_glViewport.top(), m_glViewport.width(), m_glViewport.height() };
-	//glFunc->glGetIntegerv(GL_VIEWPORT, viewport);
+		//setup selection buffers
+		memset(s_pickingBuffer, 0, sizeof(GLuint)*CC_PICKING_BUFFER_SIZE);
+		glFunc->glSelectBuffer(CC_PICKING_BUFFER_SIZE, s_pickingBuffer);
+		glFunc->glRenderMode(GL_SELECT);
+		glFunc->glInitNames();
 
-	//get context
-	CC_DRAW_CONTEXT CONTEXT;
-	getContext(CONTEXT);
+		//get viewport
+		GLint viewport[4] = { m_glViewport.left(), m_glViewport.top(), m_glViewport.width(), m_glViewport.height() };
+		//glFunc->glGetIntegerv(GL_VIEWPORT, viewport);
 
-	//3D objects picking
-	{
-		CONTEXT.drawingFlags = CC_DRAW_3D | flags;
+		//get context
+		CC_DRAW_CONTEXT CONTEXT;
+		getContext(CONTEXT);
 
-		//projection matrix
-		glFunc->glMatrixMode(GL_PROJECTION);
-		//restrict drawing to the picking area
+		//3D objects picking
 		{
-			double pickMatrix[16];
-			ccGL::PickMatrix(	static_cast<GLdouble>(params.centerX),
-								static_cast<GLdouble>(viewport[3] - params.centerY),
-								static_cast<GLdouble>(params.pickWidth),
-								static_cast<GLdouble>(params.pickWidth),
-								viewport,
-								pickMatrix);
-			glFunc->glLoadMatrixd(pickMatrix);
-		}
-		glFunc->glMultMatrixd(getProjectionMatrix().data());
+			CONTEXT.drawingFlags = CC_DRAW_3D | flags;
 
-		//model view matrix
-		glFunc->glMatrixMode(GL_MODELVIEW);
-		glFunc->glLoadMatrixd(getModelViewMatrix().data());
+			//projection matrix
+			glFunc->glMatrixMode(GL_PROJECTION);
+			//restrict drawing to the picking area
+			{
+				double pickMatrix[16];
+				ccGL::PickMatrix(	static_cast<GLdouble>(params.centerX),
+									static_cast<GLdouble>(viewport[3] - params.centerY),
+									static_cast<GLdouble>(params.pickWidth),
+									static_cast<GLdouble>(params.pickWidth),
+									viewport,
+									pickMatrix);
+				glFunc->glLoadMatrixd(pickMatrix);
+			}
+			glFunc->glMultMatrixd(getProjectionMatrix().data());
 
-		glFunc->glPushAttrib(GL_DEPTH_BUFFER_BIT);
-		glFunc->glEnable(GL_DEPTH_TEST);
+			//model view matrix
+			glFunc->glMatrixMode(GL_MODELVIEW);
+			glFunc->glLoadMatrixd(getModelViewMatrix().data());
 
-		//display 3D objects
-		//DGM: all of them, even if we don't pick the own DB for instance, as they can hide the other objects!
-		if (m_globalDBRoot)
-			m_globalDBRoot->draw(CONTEXT);
-		if (m_winDBRoot)
-			m_winDBRoot->draw(CONTEXT);
+			glFunc->glPushAttrib(GL_DEPTH_BUFFER_BIT);
+			glFunc->glEnable(GL_DEPTH_TEST);
 
-		glFunc->glPopAttrib(); //GL_DEPTH_BUFFER_BIT
+			//display 3D objects
+			//DGM: all of them, even if we don't pick the own DB for instance, as they can hide the other objects!
+			if (m_globalDBRoot)
+				m_globalDBRoot->draw(CONTEXT);
+			if (m_winDBRoot)
+				m_winDBRoot->draw(CONTEXT);
 
-		logGLError("ccGLWindow::startPicking.draw(3D)");
-	}
+			glFunc->glPopAttrib(); //GL_DEPTH_BUFFER_BIT
 
-	//2D objects picking
-	if (params.mode == ENTITY_PICKING || params.mode == ENTITY_RECT_PICKING || params.mode == FAST_PICKING)
-	{
-		CONTEXT.drawingFlags = CC_DRAW_2D | flags;
+			logGLError("ccGLWindow::startPicking.draw(3D)");
+		}
 
-		//we must first grab the 2D ortho view projection matrix
-		setStandardOrthoCenter();
-		glFunc->glMatrixMode(GL_PROJECTION);
-		double orthoProjMatd[OPENGL_MATRIX_SIZE];
-		glFunc->glGetDoublev(GL_PROJECTION_MATRIX, orthoProjMatd);
-		//restrict drawing to the picking area
-		{
-			double pickMatrix[16];
-			ccGL::PickMatrix(	static_cast<GLdouble>(params.centerX),
-								static_cast<GLdouble>(viewport[3] - params.centerY),
-								static_cast<GLdouble>(params.pickWidth),
-								static_cast<GLdouble>(params.pickWidth),
-								viewport,
-								pickMatrix);
-			glFunc->glLoadMatrixd(pickMatrix);
-		}
-		glFunc->glMultMatrixd(orthoProjMatd);
-		glFunc->glMatrixMode(GL_MODELVIEW);
+		//2D objects picking
+		if (params.mode == ENTITY_PICKING || params.mode == ENTITY_RECT_PICKING || params.mode == FAST_PICKING)
+		{
+			CONTEXT.drawingFlags = CC_DRAW_2D | flags;
 
-		glFunc->glPushAttrib(GL_DEPTH_BUFFER_BIT);
-		glFunc->glDisable(GL_DEPTH_TEST);
+			//we must first grab the 2D ortho view projection matrix
+			setStandardOrthoCenter();
+			glFunc->glMatrixMode(GL_PROJECTION);
+			double orthoProjMatd[OPENGL_MATRIX_SIZE];
+			glFunc->glGetDoublev(GL_PROJECTION_MATRIX, orthoProjMatd);
+			//restrict drawing to the picking area
+			{
+				double pickMatrix[16];
+				ccGL::PickMatrix(	static_cast<GLdouble>(params.centerX),
+									static_cast<GLdouble>(viewport[3] - params.centerY),
+									static_cast<GLdouble>(params.pickWidth),
+									static_cast<GLdouble>(params.pickWidth),
+									viewport,
+									pickMatrix);
+				glFunc->glLoadMatrixd(pickMatrix);
+			}
+			glFunc->glMultMatrixd(orthoProjMatd);
+			glFunc->glMatrixMode(GL_MODELVIEW);
 
-		//we display 2D objects
-		//DGM: all of them, even if we don't pick the own DB for instance, as they can hide the other objects!
-		if (m_globalDBRoot)
-			m_globalDBRoot->draw(CONTEXT);
-		if (m_winDBRoot)
-			m_winDBRoot->draw(CONTEXT);
+			glFunc->glPushAttrib(GL_DEPTH_BUFFER_BIT);
+			glFunc->glDisable(GL_DEPTH_TEST);
 
-		glFunc->glPopAttrib(); //GL_DEPTH_BUFFER_BIT
+			//we display 2D objects
+			//DGM: all of them, even if we don't pick the own DB for instance, as they can hide the other objects!
+			if (m_globalDBRoot)
+				m_globalDBRoot->draw(CONTEXT);
+			if (m_winDBRoot)
+				m_winDBRoot->draw(CONTEXT);
 
-		logGLError("ccGLWindow::startPicking.draw(2D)");
-	}
+			glFunc->glPopAttrib(); //GL_DEPTH_BUFFER_BIT
 
-	glFunc->glFlush();
+			logGLError("ccGLWindow::startPicking.draw(2D)");
+		}
 
-	//back to the standard rendering mode
-	int hits = glFunc->glRenderMode(GL_RENDER);
+		glFunc->glFlush();
 
-	logGLError("ccGLWindow::startPicking.render");
+		//back to the standard rendering mode
+		int hits = glFunc->glRenderMode(GL_RENDER);
 
-	ccLog::PrintDebug("[Picking] hits: %i", hits);
-	if (hits < 0)
-	{
-		ccLog::Warning("[Picking] Too many items inside the picking area! Try to zoom in...");
-		//we must always emit a signal!
-		processPickingResult(params, nullptr, -1);
-	}
+		logGLError("ccGLWindow::startPicking.render");
 
-	//process hits
-	std::unordered_set<int> selectedIDs;
-	int pickedItemIndex = -1;
-	int selectedID = -1;
-	try
-	{
-		GLuint minMinDepth = (~0);
-		const GLuint* _selectBuf = s_pickingBuffer;
+		ccLog::PrintDebug("[Picking] hits: %i", hits);
+		if (hits < 0)
+		{
+			ccLog::Warning("[Picking] Too many items inside the picking area! Try to zoom in...");
+			//we must always emit a signal!
+			processPickingResult(params, nullptr, -1);
+		}
 
-		for (int i = 0; i < hits; ++i)
+		//process hits
+		try
 		{
-			const GLuint& n = _selectBuf[0]; //number of names on stack
-			if (n) //if we draw anything outside of 'glPushName()... glPopName()' then it will appear here with as an empty set!
-			{
-				//n should be equal to 1 (CC_DRAW_ENTITY_NAMES mode) or 2 (CC_DRAW_POINT_NAMES/CC_DRAW_TRIANGLES_NAMES modes)!
-				assert(n == 1 || n == 2);
-				const GLuint& minDepth = _selectBuf[1];
-				//const GLuint& maxDepth = _selectBuf[2];
-				const GLuint& currentID = _selectBuf[3];
+			GLuint minMinDepth = (~0);
+			const GLuint* _selectBuf = s_pickingBuffer;
 
-				if (params.mode == ENTITY_RECT_PICKING)
-				{
-					//pick them all!
-					selectedIDs.insert(currentID);
-				}
-				else
+			for (int i = 0; i < hits; ++i)
+			{
+				const GLuint& n = _selectBuf[0]; //number of names on stack
+				if (n) //if we draw anything outside of 'glPushName()... glPopName()' then it will appear here with as an empty set!
 				{
-					//if there are multiple hits, we keep only the nearest
-					if (selectedID < 0 || minDepth < minMinDepth)
+					//n should be equal to 1 (CC_DRAW_ENTITY_NAMES mode) or 2 (CC_DRAW_POINT_NAMES/CC_DRAW_TRIANGLES_NAMES modes)!
+					assert(n == 1 || n == 2);
+					const GLuint& minDepth = _selectBuf[1];
+					//const GLuint& maxDepth = _selectBuf[2];
+					const GLuint& currentID = _selectBuf[3];
+
+					if (params.mode == ENTITY_RECT_PICKING)
+					{
+						//pick them all!
+						selectedIDs.insert(currentID);
+					}
+					else
 					{
-						selectedID = currentID;
-						pickedItemIndex = (n > 1 ? _selectBuf[4] : -1);
-						minMinDepth = minDepth;
+						//if there are multiple hits, we keep only the nearest
+						if (selectedID < 0 || minDepth < minMinDepth)
+						{
+							selectedID = currentID;
+							pickedItemIndex = (n > 1 ? _selectBuf[4] : -1);
+							minMinDepth = minDepth;
+						}
 					}
 				}
+
+				_selectBuf += (3 + n);
 			}
 
-			_selectBuf += (3 + n);
+			//standard output is made through the 'selectedIDs' set
+			if (params.mode != ENTITY_RECT_PICKING
+				&&	selectedID != -1)
+			{
+				selectedIDs.insert(selectedID);
+			}
 		}
-
-		//standard output is made through the 'selectedIDs' set
-		if (params.mode != ENTITY_RECT_PICKING
-			&&	selectedID != -1)
+		catch (const std::bad_alloc&)
 		{
-			selectedIDs.insert(selectedID);
+			//not enough memory
+			ccLog::Warning("[Picking] Not enough memory!");
 		}
 	}
-	catch (const std::bad_alloc&)
-	{
-		//not enough memory
-		ccLog::Warning("[Picking] Not enough memory!");
-	}
 
 	ccHObject* pickedEntity = nullptr;
 	if (selectedID >= 0)
@@ -5043,6 +5493,280 @@ void ccGLWindow::startOpenGLPicking(const PickingParameters& params)
 	processPickingResult(params, pickedEntity, pickedItemIndex, pickedPoint, pickedBarycenter, &selectedIDs);
 }
 
+bool ccGLWindow::updatePickingIDBuffer(int flags)
+{
+	if (m_pickingFbo && m_pickingFboFlags == flags)
+	{
+		//the current ID buffer is still valid
+		return true;
+	}
+	m_pickingFboFlags = 0;
+	m_pickingNames.clear();
+
+	ccQOpenGLFunctions* glFunc = functions();
+	assert(glFunc);
+
+	int w = m_glViewport.width();
+	int h = m_glViewport.height();
+	if (w <= 0 || h <= 0)
+	{
+		return false;
+	}
+
+	//init the FBO (color = IDs, depth = nearest entity)
+	if (!m_pickingFbo || m_pickingFbo->width() != static_cast<unsigned>(w) || m_pickingFbo->height() != static_cast<unsigned>(h))
+	{
+		if (!m_pickingFbo)
+		{
+			m_pickingFbo = new ccFrameBufferObject();
+		}
+
+		bool success = (	m_pickingFbo->init(w, h)
+						&&	m_pickingFbo->initColor(GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, GL_NEAREST)
+						&&	m_pickingFbo->initDepth());
+		if (!success)
+		{
+			ccLog::Warning("[Picking] Failed to initialize the picking FBO");
+			delete m_pickingFbo;
+			m_pickingFbo = nullptr;
+			return false;
+		}
+	}
+
+	//init the flat color shader
+	if (!m_pickingShader)
+	{
+		static const char* s_pickingVertShader =	"void main()\n"
+													"{\n"
+													"	gl_Position = ftransform();\n"
+													"	gl_ClipVertex = gl_ModelViewMatrix * gl_Vertex;\n"
+													"}\n";
+		static const char* s_pickingFragShader =	"uniform vec4 idColor;\n"
+													"void main()\n"
+													"{\n"
+													"	gl_FragColor = idColor;\n"
+													"}\n";
+
+		m_pickingShader = new ccShader();
+		if (	!m_pickingShader->addShaderFromSourceCode(QOpenGLShader::Vertex, s_pickingVertShader)
+			||	!m_pickingShader->addShaderFromSourceCode(QOpenGLShader::Fragment, s_pickingFragShader)
+			||	!m_pickingShader->link())
+		{
+			ccLog::Warning(QString("[Picking] Failed to load the picking shader: %1").arg(m_pickingShader->log().trimmed()));
+			delete m_pickingShader;
+			m_pickingShader = nullptr;
+			return false;
+		}
+	}
+
+	m_pickingNames.colorUniformLocation = m_pickingShader->uniformLocation("idColor");
+
+	if (!bindFBO(m_pickingFbo))
+	{
+		return false;
+	}
+
+	glFunc->glPushAttrib(GL_ENABLE_BIT | GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_VIEWPORT_BIT);
+	glFunc->glViewport(0, 0, w, h);
+
+	//IDs must not be altered!
+	glFunc->glDisable(GL_LIGHTING);
+	glFunc->glDisable(GL_BLEND);
+	glFunc->glDisable(GL_TEXTURE_2D);
+	glFunc->glDisable(GL_MULTISAMPLE);
+	glFunc->glDisable(GL_POINT_SMOOTH);
+	glFunc->glDisable(GL_LINE_SMOOTH);
+	glFunc->glDisable(GL_DITHER);
+
+	glFunc->glClearColor(0.0f, 0.0f, 0.0f, 0.0f); //0 = background
+	glFunc->glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+	m_pickingShader->bind();
+
+	//get context
+	CC_DRAW_CONTEXT CONTEXT;
+	getContext(CONTEXT);
+	CONTEXT.pickingNames = &m_pickingNames;
+	//entities must not bind their own shaders
+	CONTEXT.colorRampShader = nullptr;
+	CONTEXT.customRenderingShader = nullptr;
+
+	//3D objects
+	{
+		CONTEXT.drawingFlags = CC_DRAW_3D | flags;
+
+		glFunc->glMatrixMode(GL_PROJECTION);
+		glFunc->glLoadMatrixd(getProjectionMatrix().data());
+		glFunc->glMatrixMode(GL_MODELVIEW);
+		glFunc->glLoadMatrixd(getModelViewMatrix().data());
+
+		glFunc->glEnable(GL_DEPTH_TEST);
+
+		//DGM: all of them, even if we don't pick the own DB for instance, as they can hide the other objects!
+		if (m_globalDBRoot)
+			m_globalDBRoot->draw(CONTEXT);
+		if (m_winDBRoot)
+			m_winDBRoot->draw(CONTEXT);
+
+		logGLError("ccGLWindow::updatePickingIDBuffer.draw(3D)");
+	}
+
+	//2D objects (drawn over the 3D ones)
+	{
+		CONTEXT.drawingFlags = CC_DRAW_2D | flags;
+
+		setStandardOrthoCenter();
+		glFunc->glDisable(GL_DEPTH_TEST);
+
+		if (m_globalDBRoot)
+			m_globalDBRoot->draw(CONTEXT);
+		if (m_winDBRoot)
+			m_winDBRoot->draw(CONTEXT);
+
+		logGLError("ccGLWindow::updatePickingIDBuffer.draw(2D)");
+	}
+
+	m_pickingShader->release();
+
+	glFunc->glPopAttrib();
+
+	bindFBO(nullptr);
+
+	if (m_pickingNames.overflow)
+	{
+		//some entities have been drawn as background, they wouldn't be pickable
+		ccLog::Warning(QString("[Picking] Too many names for the ID buffer (max %1), falling back to the (slower) selection mode").arg(ccGLPickingNameTable::MaxNameCount()));
+		return false;
+	}
+
+	m_pickingFboFlags = flags;
+
+	return true;
+}
+
+bool ccGLWindow::pickInIDBuffer(const PickingParameters& params,
+								int flags,
+								int& selectedID,
+								int& pickedItemIndex,
+								std::unordered_set<int>& selectedIDs)
+{
+	if (!m_idBufferPickingSupported || !m_glExtFuncSupported)
+	{
+		return false;
+	}
+
+	int w = m_glViewport.width();
+	int h = m_glViewport.height();
+	if (w <= 0 || h <= 0)
+	{
+		//nothing to pick
+		return true;
+	}
+
+	flags |= CC_DRAW_ID_BUFFER;
+
+	if (!updatePickingIDBuffer(flags))
+	{
+		if (!m_pickingNames.overflow)
+		{
+			//we won't try again
+			ccLog::Warning("[Picking] ID buffer picking is not supported, falling back to the (slower) selection mode");
+			m_idBufferPickingSupported = false;
+		}
+		return false;
+	}
+
+	ccQOpenGLFunctions* glFunc = functions();
+	assert(glFunc);
+
+	//picking area (OpenGL convention: Y axis pointing upwards)
+	int pickW = std::max(params.pickWidth, 1);
+	int pickH = std::max(params.mode == ENTITY_RECT_PICKING ? params.pickHeight : params.pickWidth, 1);
+	int centerX = params.centerX;
+	int centerY = h - 1 - params.centerY;
+	int x0 = std::max(centerX - pickW / 2, 0);
+	int y0 = std::max(centerY - pickH / 2, 0);
+	int x1 = std::min(centerX - pickW / 2 + pickW, w); //excluded
+	int y1 = std::min(centerY - pickH / 2 + pickH, h); //excluded
+	if (x0 >= x1 || y0 >= y1)
+	{
+		//outside of the viewport
+		return true;
+	}
+
+	std::vector<unsigned char> pixels;
+	try
+	{
+		pixels.resize(static_cast<size_t>(x1 - x0) * (y1 - y0) * 4);
+	}
+	catch (const std::bad_alloc&)
+	{
+		ccLog::Warning("[Picking] Not enough memory!");
+		return true;
+	}
+
+	bindFBO(m_pickingFbo);
+	glFunc->glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glFunc->glReadBuffer(GL_COLOR_ATTACHMENT0_EXT);
+	glFunc->glReadPixels(x0, y0, x1 - x0, y1 - y0, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+	glFunc->glReadBuffer(GL_NONE);
+	bindFBO(nullptr);
+
+	logGLError("ccGLWindow::pickInIDBuffer");
+
+	//process the pixels
+	int nearestIndex = -1;
+	int nearestSquareDist = -1;
+	try
+	{
+		const unsigned char* rgba = pixels.data();
+		for (int y = y0; y < y1; ++y)
+		{
+			for (int x = x0; x < x1; ++x, rgba += 4)
+			{
+				int index = ccGLPickingNameTable::ColorToIndex(rgba);
+				if (index < 0 || static_cast<size_t>(index) >= m_pickingNames.names.size())
+				{
+					//background (or unknown value)
+					continue;
+				}
+
+				if (params.mode == ENTITY_RECT_PICKING)
+				{
+					//pick them all!
+					selectedIDs.insert(static_cast<int>(m_pickingNames.names[index].entityID));
+				}
+				else
+				{
+					//the depth test already kept the nearest entity: we keep the pixel the closest to the picking center
+					int squareDist = (x - centerX) * (x - centerX) + (y - centerY) * (y - centerY);
+					if (nearestSquareDist < 0 || squareDist < nearestSquareDist)
+					{
+						nearestIndex = index;
+						nearestSquareDist = squareDist;
+					}
+				}
+			}
+		}
+
+		//standard output is made through the 'selectedIDs' set
+		if (nearestIndex >= 0)
+		{
+			const ccGLPickingNameTable::Name& name = m_pickingNames.names[nearestIndex];
+			selectedID = static_cast<int>(name.entityID);
+			pickedItemIndex = name.itemIndex;
+			selectedIDs.insert(selectedID);
+		}
+	}
+	catch (const std::bad_alloc&)
+	{
+		//not enough memory
+		ccLog::Warning("[Picking] Not enough memory!");
+	}
+
+	return true;
+}
+
 void ccGLWindow::startCPUBasedPointPicking(const PickingParameters& params)
 {
 	//qint64 t0 = m_timer.elapsed();
@@ -6052,6 +6776,16 @@ void ccGLWindow::setView(CC_VIEW_ORIENTATION orientation, bool forceRedraw/*=tru
 		redraw();
 }
 
+//! Returns the size (in pixels) of a snapshot rendered with a given zoom factor
+/** Same rounding and HD screens correction as ccGLWindow::setGLViewport.
+**/
+static QSize SnapshotSize(const ccGLWindow* win, float zoomFactor)
+{
+	const int retinaScale = win->devicePixelRatio();
+	return QSize(	static_cast<int>(win->width() * zoomFactor) * retinaScale,
+					static_cast<int>(win->height() * zoomFactor) * retinaScale);
+}
+
 bool ccGLWindow::renderToFile(	QString filename,
 								float zoomFactor/*=1.0*/,
 								bool dontScaleFeatures/*=false*/,
@@ -6062,6 +6796,22 @@ bool ccGLWindow::renderToFile(	QString filename,
 		return false;
 	}
 
+	//images bigger than the max texture size are rendered tile by tile (if the format supports it)
+	ccTiledImageWriter::Format tiledFormat;
+	if (m_glExtFuncSupported && ccTiledImageWriter::FormatFromFilename(filename, tiledFormat))
+	{
+		makeCurrent();
+		GLint maxTextureSize = 0;
+		functions()->glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxTextureSize);
+
+		const QSize snapshotSize = SnapshotSize(this, zoomFactor);
+		if (	snapshotSize.width() > maxTextureSize
+			||	snapshotSize.height() > maxTextureSize)
+		{
+			return renderToFileTiled(filename, zoomFactor, dontScaleFeatures, renderOverlayItems);
+		}
+	}
+
 	QImage outputImage = renderToImage(zoomFactor, dontScaleFeatures, renderOverlayItems);
 
 	if (outputImage.isNull())
@@ -6383,6 +7133,361 @@ QImage ccGLWindow::renderToImage(	float zoomFactor/*=1.0f*/,
 	return outputImage;
 }
 
+ccGLMatrixd ccGLWindow::computeTileMatrix() const
+{
+	ccGLMatrixd tileMatrix; //identity by default
+
+	const QRect& tile = m_captureMode.tileRect;
+	if (m_captureMode.tiled && tile.width() > 0 && tile.height() > 0)
+	{
+		//scale and shift the full image NDC so that the tile covers [-1,1]
+		double* mat = tileMatrix.data();
+		mat[0] = static_cast<double>(m_glViewport.width()) / tile.width();
+		mat[5] = static_cast<double>(m_glViewport.height()) / tile.height();
+		mat[12] = static_cast<double>(m_glViewport.width() - 2 * tile.x() - tile.width()) / tile.width();
+		mat[13] = static_cast<double>(m_glViewport.height() - 2 * tile.y() - tile.height()) / tile.height();
+	}
+
+	return tileMatrix;
+}
+
+bool ccGLWindow::renderToFileTiled(	const QString& filename,
+									float zoomFactor/*=1.0f*/,
+									bool dontScaleFeatures/*=false*/,
+									bool renderOverlayItems/*=false*/,
+									int tileSize/*=1024*/,
+									CCLib::GenericProgressCallback* progressCb/*=nullptr*/)
+{
+	if (filename.isEmpty() || zoomFactor < 1.0e-2f || tileSize < 16)
+	{
+		return false;
+	}
+
+	ccTiledImageWriter::Format format;
+	if (!ccTiledImageWriter::FormatFromFilename(filename, format))
+	{
+		ccLog::Error("[Tiled snapshot] Only BigTIFF ('tif') and PNG files are supported");
+		return false;
+	}
+
+	if (!m_glExtFuncSupported) //no FBO support?!
+	{
+		ccLog::Error("[Tiled snapshot] FBOs are not supported");
+		return false;
+	}
+
+	makeCurrent();
+
+	ccQOpenGLFunctions* glFunc = functions();
+	assert(glFunc);
+
+	//full image size (in pixels, i.e. with the HD screens correction, as in renderToFile)
+	const QSize snapshotSize = SnapshotSize(this, zoomFactor);
+	const int fullW = snapshotSize.width();
+	const int fullH = snapshotSize.height();
+	setGLViewport(0, 0, static_cast<int>(width() * zoomFactor), static_cast<int>(height() * zoomFactor)); //warning: this will modify m_glViewport
+	assert(m_glViewport.size() == snapshotSize);
+
+	//we activate 'capture' mode
+	m_captureMode.enabled = true;
+	m_captureMode.zoomFactor = zoomFactor;
+	m_captureMode.renderOverlayItems = renderOverlayItems;
+
+	//current viewport parameters backup
+	float _defaultPointSize = m_viewportParams.defaultPointSize;
+	float _defaultLineWidth = m_viewportParams.defaultLineWidth;
+
+	if (!dontScaleFeatures)
+	{
+		//we update point size (for point clouds)
+		setPointSize(_defaultPointSize * zoomFactor, true);
+		//we update line width (for bounding-boxes, etc.)
+		setLineWidth(_defaultLineWidth * zoomFactor);
+		//we update font size (for text display)
+		setFontPointSize(getFontPointSize());
+	}
+
+	//each tile is rendered with a margin, as the points (or the GL filter kernels)
+	//centered outside of a tile may still cover some of its pixels
+	const int margin = 16 + static_cast<int>(std::ceil(m_viewportParams.defaultPointSize));
+
+	//the tile size is limited by the GL capabilities
+	{
+		GLint maxTextureSize = 0;
+		glFunc->glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxTextureSize);
+		GLint maxViewportDims[2] = { 0, 0 };
+		glFunc->glGetIntegerv(GL_MAX_VIEWPORT_DIMS, maxViewportDims);
+		int maxTileSize = std::min<int>(maxTextureSize, std::min(maxViewportDims[0], maxViewportDims[1])) - 2 * margin;
+		//no need for tiles bigger than the image
+		maxTileSize = std::min(maxTileSize, ((std::max(fullW, fullH) + 15) / 16) * 16);
+
+		tileSize = std::max(16, (std::min(tileSize, maxTileSize) / 16) * 16);
+	}
+	const int fboSize = tileSize + 2 * margin;
+
+	ccTiledImageWriter writer;
+	bool success = writer.open(filename, format, fullW, fullH, tileSize);
+	bool fileCreated = success;
+	if (!success)
+	{
+		ccLog::Error(QString("[Tiled snapshot] %1").arg(writer.errorString()));
+	}
+
+	ccFrameBufferObject* fbo = nullptr;
+	ccGlFilter* glFilter = nullptr;
+	if (success)
+	{
+		fbo = new ccFrameBufferObject();
+		success = (	fbo->init(fboSize, fboSize)
+				&&	fbo->initColor()
+				&&	fbo->initDepth());
+		if (!success)
+		{
+			ccLog::Error("[FBO] Initialization failed! (not enough memory?)");
+		}
+		else if (m_activeGLFilter)
+		{
+			//we change the current GL filter size (temporarily)
+			QString error;
+			if (!m_activeGLFilter->init(fboSize, fboSize, *s_shaderPath, error))
+			{
+				ccLog::Warning(QString("[GL Filter] GL filter can't be used for rendering: %1").arg(error));
+			}
+			else
+			{
+				glFilter = m_activeGLFilter;
+			}
+		}
+	}
+
+	QImage tileImage;
+	if (success)
+	{
+		tileImage = QImage(tileSize, tileSize, QImage::Format_RGB888);
+		if (tileImage.isNull())
+		{
+			ccLog::Error("Not enough memory!");
+			success = false;
+		}
+	}
+
+	if (success)
+	{
+		const int tileCount = writer.tileCols() * writer.tileRows();
+		ccLog::Print(QString("[Tiled snapshot] %1 x %2 pixels (%3 tiles of %4 x %4 pixels)").arg(fullW).arg(fullH).arg(tileCount).arg(tileSize));
+
+		CCLib::NormalizedProgress nprogress(progressCb, static_cast<unsigned>(tileCount));
+		if (progressCb)
+		{
+			if (progressCb->textCanBeEdited())
+			{
+				progressCb->setMethodTitle("Tiled snapshot");
+				progressCb->setInfo(qPrintable(QString("%1 x %2 pixels\n%3 tiles").arg(fullW).arg(fullH).arg(tileCount)));
+			}
+			progressCb->update(0);
+			progressCb->start();
+		}
+
+		CC_DRAW_CONTEXT CONTEXT;
+		getContext(CONTEXT);
+		CONTEXT.renderZoom = zoomFactor;
+
+		//just to be sure
+		stopLODCycle();
+
+		RenderingParams renderingParams;
+		renderingParams.drawForeground = false;
+		renderingParams.useFBO = false; //DGM: make sure that no FBO is used internally!
+		bool stereoModeWasEnabled = m_stereoModeEnabled;
+		m_stereoModeEnabled = false;
+
+		float originalZoom = m_viewportParams.zoom;
+		setZoom(m_viewportParams.zoom * zoomFactor);
+
+		//disable LOD!
+		bool wasLODEnabled = isLODEnabled();
+		setLODEnabled(false);
+
+		//minimal set of viewport parameters necessary for GL filters
+		ccGlFilter::ViewportParameters filterParameters;
+		{
+			filterParameters.perspectiveMode = m_viewportParams.perspectiveView;
+			filterParameters.zFar = m_viewportParams.zFar;
+			filterParameters.zNear = m_viewportParams.zNear;
+			filterParameters.zoom = m_viewportParams.perspectiveView ? computePerspectiveZoom() : m_viewportParams.zoom; //TODO: doesn't work well with EDL in perspective mode!
+		}
+
+		m_captureMode.tiled = true;
+
+		//the tiles are rendered row by row, from the top of the image
+		for (int row = 0; row < writer.tileRows() && success; ++row)
+		{
+			for (int col = 0; col < writer.tileCols(); ++col)
+			{
+				const int x0 = col * tileSize;
+				const int y0 = row * tileSize;
+				const int tileW = std::min(tileSize, fullW - x0);
+				const int tileH = std::min(tileSize, fullH - y0);
+				const int renderW = tileW + 2 * margin;
+				const int renderH = tileH + 2 * margin;
+				m_captureMode.tileRect = QRect(x0 - margin, fullH - (y0 + tileH) - margin, renderW, renderH);
+
+				makeCurrent();
+
+				//3D pass
+				bindFBO(fbo);
+				glFunc->glViewport(0, 0, renderW, renderH);
+				RenderingParams tileRenderingParams = renderingParams;
+				fullRenderingPass(CONTEXT, tileRenderingParams);
+				bindFBO(nullptr);
+
+				CONTEXT.drawingFlags = CC_DRAW_2D | CC_DRAW_FOREGROUND;
+				if (m_interactionFlags == INTERACT_TRANSFORM_ENTITIES)
+				{
+					CONTEXT.drawingFlags |= CC_VIRTUAL_TRANS_ENABLED;
+				}
+
+				glFunc->glPushAttrib(GL_DEPTH_BUFFER_BIT);
+				glFunc->glDisable(GL_DEPTH_TEST);
+
+				if (glFilter)
+				{
+					//we process GL filter
+					glFilter->shade(fbo->getDepthTexture(), fbo->getColorTexture(), filterParameters);
+					logGLError("ccGLWindow::renderToFileTiled/glFilter shade");
+
+					//in render mode we only want to capture it, not to display it
+					bindFBO(fbo);
+
+					//the filter texture has the size of the FBO (the last row and column of
+					//tiles only use a part of it): it is copied texel by texel, without the tile matrix
+					glFunc->glViewport(0, 0, fboSize, fboSize);
+					glFunc->glMatrixMode(GL_PROJECTION);
+					glFunc->glLoadIdentity();
+					glFunc->glOrtho(0.0, fboSize, 0.0, fboSize, 0.0, 1.0);
+					glFunc->glMatrixMode(GL_MODELVIEW);
+					glFunc->glLoadIdentity();
+					ccGLUtils::DisplayTexture2DPosition(glFilter->getTexture(), 0, 0, fboSize, fboSize);
+
+					bindFBO(nullptr);
+				}
+
+				bindFBO(fbo);
+				glFunc->glViewport(0, 0, renderW, renderH);
+				setStandardOrthoCenter();
+
+				//we draw 2D entities (mainly for the color ramp!)
+				if (m_globalDBRoot)
+					m_globalDBRoot->draw(CONTEXT);
+				if (m_winDBRoot)
+					m_winDBRoot->draw(CONTEXT);
+
+				//current displayed scalar field color ramp (if any)
+				ccRenderingTools::DrawColorRamp(CONTEXT);
+
+				if (m_displayOverlayEntities && m_captureMode.renderOverlayItems)
+				{
+					//scale: only in ortho mode
+					if (!m_viewportParams.perspectiveView)
+					{
+						drawScale(getDisplayParameters().textDefaultCol);
+					}
+
+					//trihedron
+					drawTrihedron();
+				}
+
+				glFunc->glFlush();
+
+				//read the tile (without its margin) from the fbo, line by line
+				glFunc->glReadBuffer(GL_COLOR_ATTACHMENT0_EXT);
+				for (int i = 0; i < tileH; ++i)
+				{
+					glFunc->glReadPixels(margin, margin + i, tileW, 1, GL_RGB, GL_UNSIGNED_BYTE, tileImage.scanLine(tileH - 1 - i));
+				}
+				glFunc->glReadBuffer(GL_NONE);
+
+				//restore the default FBO
+				bindFBO(nullptr);
+
+				glFunc->glPopAttrib(); //GL_DEPTH_BUFFER_BIT
+
+				if (!writer.writeTile(tileImage, col, row))
+				{
+					ccLog::Error(QString("[Tiled snapshot] %1").arg(writer.errorString()));
+					success = false;
+					break;
+				}
+
+				if (progressCb && !nprogress.oneStep())
+				{
+					//process cancelled by the user
+					ccLog::Warning("[Tiled snapshot] Process cancelled by the user");
+					success = false;
+					break;
+				}
+			}
+		}
+
+		m_captureMode.tiled = false;
+		m_captureMode.tileRect = QRect();
+
+		logGLError("ccGLWindow::renderToFileTiled");
+
+		if (progressCb)
+		{
+			progressCb->stop();
+		}
+
+		setZoom(originalZoom);
+		setLODEnabled(wasLODEnabled);
+		m_stereoModeEnabled = stereoModeWasEnabled;
+	}
+
+	if (success)
+	{
+		success = writer.close();
+		if (success)
+		{
+			ccLog::Print(QString("[Snapshot] File '%1' saved! (%2 x %3 pixels)").arg(filename).arg(fullW).arg(fullH));
+		}
+		else
+		{
+			ccLog::Error(QString("[Tiled snapshot] %1").arg(writer.errorString()));
+		}
+	}
+	else if (fileCreated)
+	{
+		//remove the incomplete file
+		writer.close();
+		QFile::remove(filename);
+	}
+
+	delete fbo;
+	fbo = nullptr;
+
+	setGLViewport(0, 0, width(), height()); //restore m_glViewport
+
+	if (glFilter)
+	{
+		QString error;
+		m_activeGLFilter->init(m_glViewport.width(), m_glViewport.height(), *s_shaderPath, error);
+	}
+
+	//we restore viewport parameters
+	setPointSize(_defaultPointSize, true);
+	setLineWidth(_defaultLineWidth);
+	m_captureMode.enabled = false;
+	m_captureMode.zoomFactor = 1.0f;
+	setFontPointSize(getFontPointSize());
+
+	invalidateViewport();
+	invalidateVisualization();
+	redraw(true);
+
+	return success;
+}
+
 void ccGLWindow::removeFBO()
 {
 	removeFBOSafe(m_fbo);
@@ -6954,7 +8059,10 @@ void ccGLWindow::renderText(int x, int y, const QString & str, const QFont & fon
 		//set ortho view with center in the upper-left corner
 		glFunc->glMatrixMode(GL_PROJECTION);
 		glFunc->glPushMatrix();
-		glFunc->glLoadIdentity();
+		if (m_captureMode.tiled)
+			glFunc->glLoadMatrixd(computeTileMatrix().data());
+		else
+			glFunc->glLoadIdentity();
 		glFunc->glOrtho(0, m_glViewport.width(), 0, m_glViewport.height(), -1, 1);
 		glFunc->glMatrixMode(GL_MODELVIEW);
 		glFunc->glPushMatrix();
@@ -7005,6 +8113,12 @@ void ccGLWindow::renderText(double x, double y, double z, const QString & str, c
 	CCVector3d Q2D(0, 0, 0);
 	if (camera.project(CCVector3d(x, y, z), Q2D))
 	{
+		if (m_captureMode.tiled)
+		{
+			//the current GL viewport only covers the current tile
+			Q2D.x += m_captureMode.tileRect.x();
+			Q2D.y += m_captureMode.tileRect.y();
+		}
 		Q2D.y = m_glViewport.height() - 1 - Q2D.y;
 		renderText(Q2D.x, Q2D.y, str, font);
 	}
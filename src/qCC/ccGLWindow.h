@@ -41,9 +41,15 @@
 //system
 #include <list>
 #include <unordered_set>
+#include <vector>
 
 class QOpenGLDebugMessage;
 
+namespace CCLib
+{
+	class GenericProgressCallback;
+}
+
 class ccBBox;
 class ccColorRampShader;
 class ccFrameBufferObject;
@@ -444,6 +450,27 @@ public:
 								bool dontScaleFeatures = false,
 								bool renderOverlayItems = false);
 
+	//! Renders screen to a (potentially huge) file, tile by tile
+	/** The projection is split in sub-frusta rendered one after the other in an
+		offscreen FBO (with the full LOD and GL filter pipeline). Each tile is
+		directly streamed to the output file, so that the full size image is never
+		stored in memory. Only BigTIFF ('tif' or 'tiff') and PNG files are supported.
+		Warning: 2D labels attached to 3D points may be misplaced.
+		\param filename output filename
+		\param zoomFactor zoom factor (the output image size is the window size multiplied by this factor)
+		\param dontScaleFeatures whether the point size, line width, etc. should be scaled as well
+		\param renderOverlayItems whether overlay items (scale, trihedron) should be rendered
+		\param tileSize tile size (in pixels, may be reduced depending on the GL capabilities)
+		\param progressCb progress callback (optional)
+		\return success
+	**/
+	virtual bool renderToFileTiled(	const QString& filename,
+									float zoomFactor = 1.0f,
+									bool dontScaleFeatures = false,
+									bool renderOverlayItems = false,
+									int tileSize = 1024,
+									CCLib::GenericProgressCallback* progressCb = nullptr);
+
 	static void setShaderPath( const QString &path );
 	
 	virtual void setShader(ccShader* shader);
@@ -563,6 +590,75 @@ public: //debug traces on screen
 	//! Toggles debug info on screen
 	inline void toggleDebugTrace() { m_showDebugTraces = !m_showDebugTraces; }
 
+public: //rendering benchmark
+
+	//! Camera path (sequence of viewports)
+	using CameraPath = std::vector<ccViewportParameters>;
+
+	//! Starts recording the camera path
+	/** The current viewport is recorded each time the 3D layer is redrawn.
+	**/
+	void startCameraPathRecording();
+
+	//! Stops recording the camera path
+	inline void stopCameraPathRecording() { m_cameraPathRecording = false; }
+
+	//! Returns whether the camera path is being recorded
+	inline bool isRecordingCameraPath() const { return m_cameraPathRecording; }
+
+	//! Returns the recorded camera path
+	inline const CameraPath& recordedCameraPath() const { return m_recordedCameraPath; }
+
+	//! Saves a camera path
+	static bool SaveCameraPath(const QString& filename, const CameraPath& path);
+
+	//! Loads a camera path
+	static bool LoadCameraPath(const QString& filename, CameraPath& path);
+
+	//! Rendering benchmark: per-frame statistics
+	/** CPU times only measure the submission of the OpenGL commands (the
+		whole frame time includes the final glFinish).
+	**/
+	struct BenchmarkFrameStats
+	{
+		//! Index of the viewport in the camera path
+		unsigned viewportIndex = 0;
+		//! Number of rendering passes (one per LOD level/chunk)
+		unsigned lodPassCount = 0;
+		//! Last rendered LOD level
+		unsigned char lodLevel = 0;
+		//! Whole frame time (CPU, in ms)
+		double frame_ms = 0.0;
+		//! Time spent in fullRenderingPass (CPU, in ms)
+		double fullRenderingPass_ms = 0.0;
+		//! Time spent in draw3D (CPU, in ms)
+		double draw3D_ms = 0.0;
+		//! Time spent in the GL filter (CPU, in ms)
+		double glFilter_ms = 0.0;
+		//! Time spent in drawForeground (CPU, in ms)
+		double drawForeground_ms = 0.0;
+		//! GPU time (in ms, or -1 if timer queries are not supported)
+		double gpu_ms = -1.0;
+		//! Points drawn and bytes uploaded to the VBOs
+		ccGLRenderingStats renderingStats;
+	};
+
+	//! Replays a camera path and measures the rendering performances
+	/** Each viewport is rendered synchronously (with all its LOD levels). The
+		first viewport is rendered 'warmUpFrames' times before the measurements
+		start (VBO uploads, shaders compilation, etc.). A summary with the
+		p50/p95/p99 frame times is logged and saved in the JSON file (if any).
+		\param path camera path
+		\param jsonFilename output JSON filename (optional)
+		\param warmUpFrames number of warm-up frames
+		\param frames per-frame statistics (optional)
+		\return success
+	**/
+	bool runRenderingBenchmark(	const CameraPath& path,
+								const QString& jsonFilename = QString(),
+								unsigned warmUpFrames = 3,
+								std::vector<BenchmarkFrameStats>* frames = nullptr);
+
 public: //stereo mode
 
 	//! Seterovision parameters
@@ -918,6 +1014,8 @@ protected: //other methods
 	void updateProjectionMatrix();
 	void setStandardOrthoCenter();
 	void setStandardOrthoCorner();
+	//! Returns the matrix mapping the full image NDC to the current tile NDC (tiled capture mode)
+	ccGLMatrixd computeTileMatrix() const;
 
 	//Lights controls (OpenGL scripts)
 	void glEnableSunLight();
@@ -940,6 +1038,23 @@ protected: //other methods
 	//! Performs the picking with OpenGL
 	void startOpenGLPicking(const PickingParameters& params);
 
+	//! Performs the picking with an offscreen ID buffer (see CC_DRAW_ID_BUFFER)
+	/** \param params picking parameters
+		\param flags drawing flags
+		\param selectedID picked entity ID (nearest to the picking center)
+		\param pickedItemIndex picked item index (if any)
+		\param selectedIDs all the entities inside the picking area (ENTITY_RECT_PICKING mode only)
+		\return false if the ID buffer couldn't be used (the legacy picking mode should be used instead)
+	**/
+	bool pickInIDBuffer(const PickingParameters& params,
+						int flags,
+						int& selectedID,
+						int& pickedItemIndex,
+						std::unordered_set<int>& selectedIDs);
+
+	//! Renders the whole scene in the picking ID buffer (if not already up to date)
+	bool updatePickingIDBuffer(int flags);
+
 	//! Starts OpenGL picking process
 	void startCPUBasedPointPicking(const PickingParameters& params);
 
@@ -1118,11 +1233,16 @@ protected: //members
 			: enabled(false)
 			, zoomFactor(1.0f)
 			, renderOverlayItems(false)
+			, tiled(false)
 		{}
 
 		bool enabled;
 		float zoomFactor;
 		bool renderOverlayItems;
+		//! Whether the capture is rendered tile by tile
+		bool tiled;
+		//! Current tile (including its margin), in full image pixels (OpenGL convention: origin at the bottom-left corner)
+		QRect tileRect;
 	};
 
 	//! Display capturing mode options
@@ -1208,6 +1328,17 @@ protected: //members
 	//! Whether FBO should be updated (or simply displayed as a texture = faster!)
 	bool m_updateFBO;
 
+	//! ID buffer used for picking
+	ccFrameBufferObject* m_pickingFbo;
+	//! Flat color shader used to render the picking ID buffer
+	ccShader* m_pickingShader;
+	//! Name table associated to the current picking ID buffer
+	ccGLPickingNameTable m_pickingNames;
+	//! Drawing flags used to render the current picking ID buffer (0 = outdated)
+	int m_pickingFboFlags;
+	//! Whether ID buffer picking is supported (otherwise the deprecated GL_SELECT mode is used)
+	bool m_idBufferPickingSupported;
+
 	// Color ramp shader
 	ccColorRampShader* m_colorRampShader;
 	// Custom rendering shader (OpenGL 3.3+)
@@ -1330,6 +1461,14 @@ protected: //members
 	bool m_rotationAxisLocked;
 	//! Locked rotation axis
 	CCVector3d m_lockedRotationAxis;
+
+	//! Whether the camera path is being recorded
+	bool m_cameraPathRecording;
+	//! Recorded camera path
+	CameraPath m_recordedCameraPath;
+
+	//! Statistics of the current benchmark frame (if any)
+	BenchmarkFrameStats* m_benchmarkFrame;
 };
 
 Q_DECLARE_OPERATORS_FOR_FLAGS(ccGLWindow::INTERACTION_FLAGS);
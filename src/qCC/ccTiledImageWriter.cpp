@@ -0,0 +1,542 @@
+//##########################################################################
+//#                                                                        #
+//#                              CLOUDCOMPARE                              #
+//#                                                                        #
+//#  This program is free software; you can redistribute it and/or modify  #
+//#  it under the terms of the GNU General Public License as published by  #
+//#  the Free Software Foundation; version 2 or later of the License.      #
+//#                                                                        #
+//#  This program is distributed in the hope that it will be useful,       #
+//#  but WITHOUT ANY WARRANTY; without even the implied warranty of        #
+//#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the          #
+//#  GNU General Public License for more details.                          #
+//#                                                                        #
+//#          COPYRIGHT: EDF R&D / TELECOM ParisTech (ENST-TSI)             #
+//#                                                                        #
+//##########################################################################
+
+#include "ccTiledImageWriter.h"
+
+//Qt
+#include <QFileInfo>
+
+//system
+#include <algorithm>
+#include <cstring>
+
+//BigTIFF tags
+static const uint16_t TIFF_TAG_IMAGE_WIDTH			= 256;
+static const uint16_t TIFF_TAG_IMAGE_LENGTH			= 257;
+static const uint16_t TIFF_TAG_BITS_PER_SAMPLE		= 258;
+static const uint16_t TIFF_TAG_COMPRESSION			= 259;
+static const uint16_t TIFF_TAG_PHOTOMETRIC			= 262;
+static const uint16_t TIFF_TAG_SAMPLES_PER_PIXEL	= 277;
+static const uint16_t TIFF_TAG_PLANAR_CONFIG		= 284;
+static const uint16_t TIFF_TAG_TILE_WIDTH			= 322;
+static const uint16_t TIFF_TAG_TILE_LENGTH			= 323;
+static const uint16_t TIFF_TAG_TILE_OFFSETS			= 324;
+static const uint16_t TIFF_TAG_TILE_BYTE_COUNTS		= 325;
+
+//BigTIFF types
+static const uint16_t TIFF_TYPE_SHORT	= 3;
+static const uint16_t TIFF_TYPE_LONG	= 4;
+static const uint16_t TIFF_TYPE_LONG8	= 16;
+
+//PNG: maximum size of a deflate 'stored' block
+static const size_t PNG_MAX_STORED_BLOCK_SIZE = 65535;
+
+static void PutLE16(std::vector<unsigned char>& buffer, uint16_t value)
+{
+	buffer.push_back(static_cast<unsigned char>(value & 0xFF));
+	buffer.push_back(static_cast<unsigned char>(value >> 8));
+}
+
+static void PutLE64(std::vector<unsigned char>& buffer, uint64_t value)
+{
+	for (int i = 0; i < 8; ++i)
+	{
+		buffer.push_back(static_cast<unsigned char>((value >> (8 * i)) & 0xFF));
+	}
+}
+
+static void PutBE32(std::vector<unsigned char>& buffer, uint32_t value)
+{
+	for (int i = 3; i >= 0; --i)
+	{
+		buffer.push_back(static_cast<unsigned char>((value >> (8 * i)) & 0xFF));
+	}
+}
+
+//! Adds a BigTIFF IFD entry (the value must fit in 8 bytes)
+static void PutTiffEntry(std::vector<unsigned char>& buffer, uint16_t tag, uint16_t type, uint64_t count, const std::vector<uint64_t>& values)
+{
+	PutLE16(buffer, tag);
+	PutLE16(buffer, type);
+	PutLE64(buffer, count);
+
+	size_t valueSize = (type == TIFF_TYPE_SHORT ? 2 : type == TIFF_TYPE_LONG ? 4 : 8);
+	std::vector<unsigned char> field;
+	for (uint64_t value : values)
+	{
+		for (size_t i = 0; i < valueSize; ++i)
+		{
+			field.push_back(static_cast<unsigned char>((value >> (8 * i)) & 0xFF));
+		}
+	}
+	field.resize(8, 0);
+	buffer.insert(buffer.end(), field.begin(), field.end());
+}
+
+//! Standard CRC-32 (PNG chunks)
+static uint32_t UpdateCRC32(uint32_t crc, const unsigned char* data, size_t size)
+{
+	static uint32_t s_table[256] = { 0 };
+	static bool s_tableInitialized = false;
+	if (!s_tableInitialized)
+	{
+		for (uint32_t n = 0; n < 256; ++n)
+		{
+			uint32_t c = n;
+			for (int k = 0; k < 8; ++k)
+			{
+				c = (c & 1) ? (0xEDB88320U ^ (c >> 1)) : (c >> 1);
+			}
+			s_table[n] = c;
+		}
+		s_tableInitialized = true;
+	}
+
+	crc = ~crc;
+	for (size_t i = 0; i < size; ++i)
+	{
+		crc = s_table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+	}
+	return ~crc;
+}
+
+//! Adler-32 checksum (zlib stream)
+static uint32_t UpdateAdler32(uint32_t adler, const unsigned char* data, size_t size)
+{
+	static const uint32_t BASE = 65521;
+	static const size_t NMAX = 5552; //largest n such that 255n(n+1)/2 + (n+1)(BASE-1) <= 2^32-1
+
+	uint32_t a = adler & 0xFFFF;
+	uint32_t b = adler >> 16;
+	while (size != 0)
+	{
+		size_t n = std::min(size, NMAX);
+		size -= n;
+		for (size_t i = 0; i < n; ++i)
+		{
+			a += *data++;
+			b += a;
+		}
+		a %= BASE;
+		b %= BASE;
+	}
+	return (b << 16) | a;
+}
+
+bool ccTiledImageWriter::FormatFromFilename(const QString& filename, Format& format)
+{
+	QString ext = QFileInfo(filename).suffix().toLower();
+	if (ext == "tif" || ext == "tiff")
+	{
+		format = BIGTIFF;
+		return true;
+	}
+	else if (ext == "png")
+	{
+		format = PNG;
+		return true;
+	}
+
+	return false;
+}
+
+ccTiledImageWriter::ccTiledImageWriter()
+	: m_format(BIGTIFF)
+	, m_width(0)
+	, m_height(0)
+	, m_tileSize(0)
+	, m_tileCols(0)
+	, m_tileRows(0)
+	, m_writtenTiles(0)
+	, m_bandRow(0)
+	, m_bandTiles(0)
+	, m_adler32(1)
+	, m_zlibHeaderWritten(false)
+{
+}
+
+ccTiledImageWriter::~ccTiledImageWriter()
+{
+	if (m_file.isOpen())
+	{
+		m_file.close();
+	}
+}
+
+bool ccTiledImageWriter::error(const QString& message)
+{
+	m_error = message;
+	return false;
+}
+
+bool ccTiledImageWriter::writeRaw(const void* data, qint64 size)
+{
+	if (m_file.write(static_cast<const char*>(data), size) != size)
+	{
+		return error(QString("Failed to write in file '%1' (disk full?)").arg(m_file.fileName()));
+	}
+	return true;
+}
+
+bool ccTiledImageWriter::open(const QString& filename, Format format, int width, int height, int tileSize)
+{
+	if (width <= 0 || height <= 0 || tileSize <= 0 || (tileSize % 16) != 0)
+	{
+		return error("Invalid image or tile size");
+	}
+
+	m_format = format;
+	m_width = width;
+	m_height = height;
+	m_tileSize = tileSize;
+	m_tileCols = (width + tileSize - 1) / tileSize;
+	m_tileRows = (height + tileSize - 1) / tileSize;
+	m_writtenTiles = 0;
+	m_error.clear();
+
+	try
+	{
+		if (m_format == BIGTIFF)
+		{
+			m_tileOffsets.assign(static_cast<size_t>(m_tileCols) * m_tileRows, 0);
+		}
+		else
+		{
+			m_band.assign(static_cast<size_t>(tileSize) * (1 + 3 * static_cast<size_t>(width)), 0);
+			m_block.clear();
+			m_block.reserve(PNG_MAX_STORED_BLOCK_SIZE);
+			m_bandRow = 0;
+			m_bandTiles = 0;
+			m_adler32 = 1;
+			m_zlibHeaderWritten = false;
+		}
+	}
+	catch (const std::bad_alloc&)
+	{
+		return error("Not enough memory");
+	}
+
+	m_file.setFileName(filename);
+	if (!m_file.open(QFile::WriteOnly))
+	{
+		return error(QString("Failed to open file '%1' for writing").arg(filename));
+	}
+
+	if (m_format == BIGTIFF)
+	{
+		//header (the first IFD offset will be updated at the end)
+		std::vector<unsigned char> header = { 'I', 'I' };
+		PutLE16(header, 43); //BigTIFF
+		PutLE16(header, 8); //bytesize of offsets
+		PutLE16(header, 0);
+		PutLE64(header, 0); //first IFD offset
+		return writeRaw(header.data(), header.size());
+	}
+	else
+	{
+		static const unsigned char PNG_SIGNATURE[8] = { 137, 80, 78, 71, 13, 10, 26, 10 };
+		if (!writeRaw(PNG_SIGNATURE, 8))
+		{
+			return false;
+		}
+
+		std::vector<unsigned char> ihdr;
+		PutBE32(ihdr, static_cast<uint32_t>(width));
+		PutBE32(ihdr, static_cast<uint32_t>(height));
+		ihdr.push_back(8); //bit depth
+		ihdr.push_back(2); //color type: RGB
+		ihdr.push_back(0); //compression method
+		ihdr.push_back(0); //filter method
+		ihdr.push_back(0); //no interlace
+		return writePngChunk("IHDR", ihdr.data(), ihdr.size());
+	}
+}
+
+bool ccTiledImageWriter::writeTile(const QImage& tile, int tileCol, int tileRow)
+{
+	if (!m_file.isOpen())
+	{
+		return error("File is not opened");
+	}
+	if (tileCol < 0 || tileCol >= m_tileCols || tileRow < 0 || tileRow >= m_tileRows)
+	{
+		return error("Invalid tile index");
+	}
+
+	QImage rgbTile = tile.convertToFormat(QImage::Format_RGB888);
+	if (rgbTile.isNull())
+	{
+		return error("Not enough memory");
+	}
+
+	bool success = true;
+	if (m_format == BIGTIFF)
+	{
+		success = writeTiffTile(rgbTile, tileCol, tileRow);
+	}
+	else
+	{
+		if (tileRow != m_bandRow)
+		{
+			return error("PNG tiles must be written row by row");
+		}
+
+		//copy the tile in the current row of tiles
+		int x0 = tileCol * m_tileSize;
+		int w = std::min(rgbTile.width(), m_width - x0);
+		int h = std::min(rgbTile.height(), std::min(m_tileSize, m_height - tileRow * m_tileSize));
+		size_t rowSize = 1 + 3 * static_cast<size_t>(m_width);
+		for (int j = 0; j < h; ++j)
+		{
+			memcpy(m_band.data() + j * rowSize + 1 + 3 * static_cast<size_t>(x0), rgbTile.constScanLine(j), 3 * static_cast<size_t>(w));
+		}
+
+		if (++m_bandTiles == m_tileCols)
+		{
+			success = flushPngBand();
+		}
+	}
+
+	if (success)
+	{
+		++m_writtenTiles;
+	}
+	return success;
+}
+
+bool ccTiledImageWriter::writeTiffTile(const QImage& tile, int tileCol, int tileRow)
+{
+	//TIFF tiles always have the same size (the tiles of the last column/row are padded)
+	size_t rowSize = 3 * static_cast<size_t>(m_tileSize);
+	std::vector<unsigned char> buffer;
+	try
+	{
+		buffer.resize(rowSize * m_tileSize, 0);
+	}
+	catch (const std::bad_alloc&)
+	{
+		return error("Not enough memory");
+	}
+
+	int w = std::min(tile.width(), m_tileSize);
+	int h = std::min(tile.height(), m_tileSize);
+	for (int j = 0; j < h; ++j)
+	{
+		memcpy(buffer.data() + j * rowSize, tile.constScanLine(j), 3 * static_cast<size_t>(w));
+	}
+
+	m_tileOffsets[static_cast<size_t>(tileRow) * m_tileCols + tileCol] = static_cast<quint64>(m_file.pos());
+	return writeRaw(buffer.data(), buffer.size());
+}
+
+bool ccTiledImageWriter::writeTiffDirectory()
+{
+	quint64 tileByteCount = 3 * static_cast<quint64>(m_tileSize) * m_tileSize;
+	size_t tileCount = m_tileOffsets.size();
+
+	//word alignment
+	if (m_file.pos() & 1)
+	{
+		unsigned char padding = 0;
+		if (!writeRaw(&padding, 1))
+			return false;
+	}
+
+	//tile offsets and byte counts (stored outside of the IFD if they don't fit in 8 bytes)
+	quint64 offsetsPos = 0;
+	quint64 byteCountsPos = 0;
+	if (tileCount > 1)
+	{
+		std::vector<unsigned char> arrays;
+		try
+		{
+			arrays.reserve(16 * tileCount);
+		}
+		catch (const std::bad_alloc&)
+		{
+			return error("Not enough memory");
+		}
+		for (quint64 offset : m_tileOffsets)
+		{
+			PutLE64(arrays, offset);
+		}
+		for (size_t i = 0; i < tileCount; ++i)
+		{
+			PutLE64(arrays, tileByteCount);
+		}
+
+		offsetsPos = static_cast<quint64>(m_file.pos());
+		byteCountsPos = offsetsPos + 8 * tileCount;
+		if (!writeRaw(arrays.data(), arrays.size()))
+		{
+			return false;
+		}
+	}
+
+	quint64 ifdPos = static_cast<quint64>(m_file.pos());
+
+	std::vector<unsigned char> ifd;
+	PutLE64(ifd, 11); //number of entries
+	PutTiffEntry(ifd, TIFF_TAG_IMAGE_WIDTH, TIFF_TYPE_LONG, 1, { static_cast<uint64_t>(m_width) });
+	PutTiffEntry(ifd, TIFF_TAG_IMAGE_LENGTH, TIFF_TYPE_LONG, 1, { static_cast<uint64_t>(m_height) });
+	PutTiffEntry(ifd, TIFF_TAG_BITS_PER_SAMPLE, TIFF_TYPE_SHORT, 3, { 8, 8, 8 });
+	PutTiffEntry(ifd, TIFF_TAG_COMPRESSION, TIFF_TYPE_SHORT, 1, { 1 }); //none
+	PutTiffEntry(ifd, TIFF_TAG_PHOTOMETRIC, TIFF_TYPE_SHORT, 1, { 2 }); //RGB
+	PutTiffEntry(ifd, TIFF_TAG_SAMPLES_PER_PIXEL, TIFF_TYPE_SHORT, 1, { 3 });
+	PutTiffEntry(ifd, TIFF_TAG_PLANAR_CONFIG, TIFF_TYPE_SHORT, 1, { 1 }); //contiguous
+	PutTiffEntry(ifd, TIFF_TAG_TILE_WIDTH, TIFF_TYPE_LONG, 1, { static_cast<uint64_t>(m_tileSize) });
+	PutTiffEntry(ifd, TIFF_TAG_TILE_LENGTH, TIFF_TYPE_LONG, 1, { static_cast<uint64_t>(m_tileSize) });
+	if (tileCount > 1)
+	{
+		PutTiffEntry(ifd, TIFF_TAG_TILE_OFFSETS, TIFF_TYPE_LONG8, tileCount, { offsetsPos });
+		PutTiffEntry(ifd, TIFF_TAG_TILE_BYTE_COUNTS, TIFF_TYPE_LONG8, tileCount, { byteCountsPos });
+	}
+	else
+	{
+		PutTiffEntry(ifd, TIFF_TAG_TILE_OFFSETS, TIFF_TYPE_LONG8, 1, { m_tileOffsets.front() });
+		PutTiffEntry(ifd, TIFF_TAG_TILE_BYTE_COUNTS, TIFF_TYPE_LONG8, 1, { tileByteCount });
+	}
+	PutLE64(ifd, 0); //no other IFD
+
+	if (!writeRaw(ifd.data(), ifd.size()))
+	{
+		return false;
+	}
+
+	//update the first IFD offset in the header
+	std::vector<unsigned char> ifdOffset;
+	PutLE64(ifdOffset, ifdPos);
+	if (!m_file.seek(8))
+	{
+		return error("Failed to update the file header");
+	}
+	return writeRaw(ifdOffset.data(), ifdOffset.size());
+}
+
+bool ccTiledImageWriter::writePngChunk(const char type[4], const unsigned char* data, size_t size)
+{
+	std::vector<unsigned char> header;
+	PutBE32(header, static_cast<uint32_t>(size));
+	header.insert(header.end(), type, type + 4);
+
+	uint32_t crc = UpdateCRC32(0, reinterpret_cast<const unsigned char*>(type), 4);
+	crc = UpdateCRC32(crc, data, size);
+	std::vector<unsigned char> footer;
+	PutBE32(footer, crc);
+
+	return	writeRaw(header.data(), header.size())
+		&&	(size == 0 || writeRaw(data, static_cast<qint64>(size)))
+		&&	writeRaw(footer.data(), footer.size());
+}
+
+bool ccTiledImageWriter::writePngData(const unsigned char* data, size_t size, bool last)
+{
+	m_adler32 = UpdateAdler32(m_adler32, data, size);
+
+	while (true)
+	{
+		size_t count = std::min(size, PNG_MAX_STORED_BLOCK_SIZE - m_block.size());
+		m_block.insert(m_block.end(), data, data + count);
+		data += count;
+		size -= count;
+
+		bool finalBlock = (last && size == 0);
+		if (m_block.size() < PNG_MAX_STORED_BLOCK_SIZE && !finalBlock)
+		{
+			//wait for more data
+			return true;
+		}
+
+		//one 'stored' block per IDAT chunk
+		std::vector<unsigned char> chunk;
+		chunk.reserve(m_block.size() + 11);
+		if (!m_zlibHeaderWritten)
+		{
+			chunk.push_back(0x78); //deflate, 32K window
+			chunk.push_back(0x01); //no preset dictionary, fastest level
+			m_zlibHeaderWritten = true;
+		}
+		uint16_t len = static_cast<uint16_t>(m_block.size());
+		chunk.push_back(finalBlock ? 1 : 0); //BFINAL + BTYPE=00 (no compression)
+		PutLE16(chunk, len);
+		PutLE16(chunk, static_cast<uint16_t>(~len));
+		chunk.insert(chunk.end(), m_block.begin(), m_block.end());
+		if (finalBlock)
+		{
+			PutBE32(chunk, m_adler32);
+		}
+		m_block.clear();
+
+		if (!writePngChunk("IDAT", chunk.data(), chunk.size()))
+		{
+			return false;
+		}
+		if (finalBlock)
+		{
+			return true;
+		}
+	}
+}
+
+bool ccTiledImageWriter::flushPngBand()
+{
+	int rows = std::min(m_tileSize, m_height - m_bandRow * m_tileSize);
+	size_t rowSize = 1 + 3 * static_cast<size_t>(m_width);
+	bool last = (m_bandRow + 1 == m_tileRows);
+
+	if (!writePngData(m_band.data(), rows * rowSize, last))
+	{
+		return false;
+	}
+
+	//the filter bytes (0 = none) are left unchanged
+	std::fill(m_band.begin(), m_band.end(), 0);
+	++m_bandRow;
+	m_bandTiles = 0;
+
+	return true;
+}
+
+bool ccTiledImageWriter::close()
+{
+	if (!m_file.isOpen())
+	{
+		return error("File is not opened");
+	}
+
+	bool success = true;
+	if (m_writtenTiles != m_tileCols * m_tileRows)
+	{
+		success = error(QString("Incomplete image (%1 tiles written out of %2)").arg(m_writtenTiles).arg(m_tileCols * m_tileRows));
+	}
+	else if (m_format == BIGTIFF)
+	{
+		success = writeTiffDirectory();
+	}
+	else
+	{
+		success = writePngChunk("IEND", nullptr, 0);
+	}
+
+	m_file.close();
+	m_tileOffsets.clear();
+	m_tileOffsets.shrink_to_fit();
+	m_band.clear();
+	m_band.shrink_to_fit();
+
+	return success;
+}
@@ -0,0 +1,144 @@
+//##########################################################################
+//#                                                                        #
+//#                              CLOUDCOMPARE                              #
+//#                                                                        #
+//#  This program is free software; you can redistribute it and/or modify  #
+//#  it under the terms of the GNU General Public License as published by  #
+//#  the Free Software Foundation; version 2 or later of the License.      #
+//#                                                                        #
+//#  This program is distributed in the hope that it will be useful,       #
+//#  but WITHOUT ANY WARRANTY; without even the implied warranty of        #
+//#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the          #
+//#  GNU General Public License for more details.                          #
+//#                                                                        #
+//#          COPYRIGHT: EDF R&D / TELECOM ParisTech (ENST-TSI)             #
+//#                                                                        #
+//##########################################################################
+
+#ifndef CC_TILED_IMAGE_WRITER_HEADER
+#define CC_TILED_IMAGE_WRITER_HEADER
+
+//Qt
+#include <QFile>
+#include <QImage>
+#include <QString>
+
+//system
+#include <cstdint>
+#include <vector>
+
+//! Streams a (very large) RGB image to a file, tile by tile
+/** The whole image is never stored in memory:
+	- BigTIFF files are tiled (uncompressed): each tile is directly written to the file
+	- PNG files only keep one row of tiles in memory (the image data is stored
+		in non-compressed deflate blocks, as no compression library is available)
+	With PNG files, the tiles must be written row by row (from top to bottom).
+**/
+class ccTiledImageWriter
+{
+public:
+
+	//! Output formats
+	enum Format { BIGTIFF, PNG };
+
+	//! Returns the format corresponding to a filename (based on its extension)
+	/** \return false if the format is not supported
+	**/
+	static bool FormatFromFilename(const QString& filename, Format& format);
+
+	//! Default constructor
+	ccTiledImageWriter();
+
+	//! Destructor
+	/** The file is closed (but not finalized) if necessary.
+	**/
+	~ccTiledImageWriter();
+
+	//! Creates the file and writes its header
+	/** \param filename output filename
+		\param format output format
+		\param width image width (in pixels)
+		\param height image height (in pixels)
+		\param tileSize tile size (in pixels, must be a multiple of 16)
+		\return success
+	**/
+	bool open(const QString& filename, Format format, int width, int height, int tileSize);
+
+	//! Writes a tile
+	/** \param tile tile image (the tiles of the last column/row can be smaller)
+		\param tileCol tile column index
+		\param tileRow tile row index (from the top)
+		\return success
+	**/
+	bool writeTile(const QImage& tile, int tileCol, int tileRow);
+
+	//! Finalizes and closes the file
+	/** \return success (all the tiles must have been written)
+	**/
+	bool close();
+
+	//! Returns the number of tile columns
+	int tileCols() const { return m_tileCols; }
+	//! Returns the number of tile rows
+	int tileRows() const { return m_tileRows; }
+
+	//! Returns the last error message
+	const QString& errorString() const { return m_error; }
+
+protected:
+
+	//! Sets the error message and returns false
+	bool error(const QString& message);
+
+	//! Writes raw data
+	bool writeRaw(const void* data, qint64 size);
+
+	//! BigTIFF specific: writes a tile
+	bool writeTiffTile(const QImage& tile, int tileCol, int tileRow);
+	//! BigTIFF specific: writes the IFD (Image File Directory)
+	bool writeTiffDirectory();
+
+	//! PNG specific: writes a chunk
+	bool writePngChunk(const char type[4], const unsigned char* data, size_t size);
+	//! PNG specific: adds image data (deflate 'stored' blocks)
+	bool writePngData(const unsigned char* data, size_t size, bool last);
+	//! PNG specific: writes the current row of tiles
+	bool flushPngBand();
+
+	//! Output file
+	QFile m_file;
+	//! Output format
+	Format m_format;
+	//! Image width
+	int m_width;
+	//! Image height
+	int m_height;
+	//! Tile size
+	int m_tileSize;
+	//! Number of tile columns
+	int m_tileCols;
+	//! Number of tile rows
+	int m_tileRows;
+	//! Number of written tiles
+	int m_writtenTiles;
+	//! Last error message
+	QString m_error;
+
+	//! BigTIFF: tiles offsets
+	std::vector<quint64> m_tileOffsets;
+
+	//! PNG: current row of tiles (filter byte + RGB values for each image row)
+	std::vector<unsigned char> m_band;
+	//! PNG: current row index
+	int m_bandRow;
+	//! PNG: number of tiles in the current row
+	int m_bandTiles;
+	//! PNG: pending (uncompressed) block data
+	std::vector<unsigned char> m_block;
+	//! PNG: Adler-32 checksum of the image data
+	uint32_t m_adler32;
+	//! PNG: whether the zlib header has been written
+	bool m_zlibHeaderWritten;
+};
+
+#endif //CC_TILED_IMAGE_WRITER_HEADER
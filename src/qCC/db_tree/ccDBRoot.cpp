@@ -2139,9 +2139,9 @@ void ccDBRoot::editLabelScalarValue()
 	ScalarType newS = static_cast<ScalarType>(newValue);
 	if (s != newS)
 	{
-		//update the value and update the display
-		sf->setValue(P.index, newS);
-		sf->computeMinAndMax();
+		//update the value and update the display (only the colors of the
+		//corresponding chunk are updated if the SF range doesn't change)
+		sf->setValues(P.index, &newS, 1);
 		pc->redrawDisplay();
 	}
 }
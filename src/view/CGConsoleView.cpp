@@ -1,4 +1,6 @@
 ﻿#include "CGConsoleView.h"
+#include <QAbstractListModel>
+#include <QBrush>
 #include <QFont>
 #include <QLabel>
 #include <QMessageBox>
@@ -8,12 +10,119 @@
 #include <QVBoxLayout>
 #include <QGridLayout>
 
+#include <algorithm>
+#include <deque>
+
+//! Drain timer interval (ms)
+static const int s_drainInterval_ms = 100;
+//! Default max number of messages kept in the console
+static const int s_defaultMaxHistory = 1000;
+
+//! Console messages (the most recent first)
+/** The messages are only formatted when they are actually displayed.
+**/
+class CGConsoleModel : public QAbstractListModel
+{
+public:
+    explicit CGConsoleModel(QObject *parent = nullptr)
+        : QAbstractListModel(parent)
+        , m_maxHistory(s_defaultMaxHistory)
+    {}
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override
+    {
+        return parent.isValid() ? 0 : static_cast<int>(m_entries.size());
+    }
+
+    QVariant data(const QModelIndex &index, int role) const override
+    {
+        if (!index.isValid() || index.row() >= static_cast<int>(m_entries.size()))
+            return QVariant();
+
+        const ccRingBufferLog::Entry &entry = m_entries[index.row()];
+        switch (role)
+        {
+        case Qt::DisplayRole:
+            return ccRingBufferLog::Format(entry);
+        case Qt::ForegroundRole:
+            if (entry.level & ccLog::LOG_ERROR)
+                return QBrush(Qt::red);
+            if (entry.level & ccLog::LOG_WARNING)
+                return QBrush(QColor(192, 96, 0));
+            break;
+        default:
+            break;
+        }
+        return QVariant();
+    }
+
+    //! Adds messages (in chronological order)
+    void Append(std::vector<ccRingBufferLog::Entry> &entries)
+    {
+        if (entries.empty())
+            return;
+
+        //only the most recent messages are kept
+        size_t first = entries.size() > static_cast<size_t>(m_maxHistory) ? entries.size() - m_maxHistory : 0;
+
+        beginInsertRows(QModelIndex(), 0, static_cast<int>(entries.size() - first) - 1);
+        for (size_t i = first; i < entries.size(); ++i)
+        {
+            m_entries.push_front(std::move(entries[i]));
+        }
+        endInsertRows();
+
+        Trim();
+    }
+
+    void SetMaxHistory(int count)
+    {
+        m_maxHistory = std::max(1, count);
+        Trim();
+    }
+
+    int MaxHistory() const { return m_maxHistory; }
+
+private:
+    //! Removes the oldest messages
+    void Trim()
+    {
+        if (m_entries.size() > static_cast<size_t>(m_maxHistory))
+        {
+            beginRemoveRows(QModelIndex(), m_maxHistory, static_cast<int>(m_entries.size()) - 1);
+            m_entries.resize(m_maxHistory);
+            endRemoveRows();
+        }
+    }
+
+    std::deque<ccRingBufferLog::Entry> m_entries;
+    int m_maxHistory;
+};
+
 CGConsoleView *CGConsoleView::m_CGConsoleView = nullptr;
 
 CGConsoleView::CGConsoleView(QWidget *parent) : QWidget(parent)
 {
     InitUi();
     InitConnections();
+
+    //all the ccLog messages are now sent to the console
+    ccLog::RegisterInstance(&m_logBuffer);
+}
+
+CGConsoleView::~CGConsoleView()
+{
+    if (ccLog::TheInstance() == &m_logBuffer)
+    {
+        ccLog::RegisterInstance(nullptr);
+    }
+    m_drainTimer.stop();
+    DisableLogFile();
+
+    if (m_CGConsoleView == this)
+    {
+        m_CGConsoleView = nullptr;
+    }
 }
 
 CGConsoleView *CGConsoleView::getInstance()
@@ -29,11 +138,16 @@ void CGConsoleView::InitUi()
 {
     QFont font;
     font.setBold(true);
-    m_pListWidget = new QListWidget(this);
-    m_pListWidget->setStyleSheet("background-color:rgb(220, 220, 220)");
+    m_pModel = new CGConsoleModel(this);
+    m_pListView = new QListView(this);
+    m_pListView->setModel(m_pModel);
+    //all the rows have the same height: only the visible ones are laid out
+    m_pListView->setUniformItemSizes(true);
+    m_pListView->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    m_pListView->setStyleSheet("background-color:rgb(220, 220, 220)");
 
     QVBoxLayout *pMainLayout = new QVBoxLayout();
-    pMainLayout->addWidget(m_pListWidget);
+    pMainLayout->addWidget(m_pListView);
 
     setLayout(pMainLayout);
     setFixedHeight(120);
@@ -42,23 +156,66 @@ void CGConsoleView::InitUi()
 
 void CGConsoleView::InitConnections()
 {
-
+    connect(&m_drainTimer, &QTimer::timeout, this, &CGConsoleView::DrainMessages);
+    m_drainTimer.start(s_drainInterval_ms);
 }
 
 void CGConsoleView::ConsoleOut(const QString msg)
 {
-    QDateTime CurrentDataTime = QDateTime::currentDateTime();
-    QString current_date_time = "[" + CurrentDataTime.toString("yyyy/MM/dd hh:mm:ss:zzz") + "]";
-    QString str;
-    str.append(current_date_time);
-    str.append(" : ");
-    str.append(msg);
-
-    QListWidgetItem *item = new QListWidgetItem(str);
-    m_pListWidget->insertItem(0, item);
-
-    int num = m_pListWidget->count();
-    if (num >= 12) {
-        m_pListWidget->clear();
+    m_logBuffer.logMessage(msg, ccLog::LOG_STANDARD);
+}
+
+void CGConsoleView::SetMaxHistory(int count)
+{
+    m_pModel->SetMaxHistory(count);
+}
+
+int CGConsoleView::MaxHistory() const
+{
+    return m_pModel->MaxHistory();
+}
+
+bool CGConsoleView::EnableLogFile(const QString &filename, unsigned maxMessagesPerSecond/*=100*/)
+{
+    //flush the pending messages first (they won't be written to the new file)
+    DrainMessages();
+
+    return m_logFile.open(filename, maxMessagesPerSecond);
+}
+
+void CGConsoleView::DisableLogFile()
+{
+    m_logFile.close();
+}
+
+void CGConsoleView::DrainMessages()
+{
+    m_drainedEntries.clear();
+    m_logBuffer.drain(m_drainedEntries);
+
+    size_t droppedCount = m_logBuffer.takeDroppedCount();
+    if (droppedCount != 0)
+    {
+        ccRingBufferLog::Entry entry;
+        entry.text = QString("%1 message(s) lost (too many messages at once)").arg(droppedCount);
+        entry.level = ccLog::LOG_WARNING;
+        entry.timestamp_ms = QDateTime::currentMSecsSinceEpoch();
+        m_drainedEntries.push_back(entry);
     }
+
+    if (m_drainedEntries.empty())
+    {
+        return;
+    }
+
+    if (m_logFile.isOpen())
+    {
+        for (const ccRingBufferLog::Entry &entry : m_drainedEntries)
+        {
+            m_logFile.write(entry);
+        }
+        m_logFile.flush();
+    }
+
+    m_pModel->Append(m_drainedEntries);
 }
@@ -2,8 +2,20 @@
 #define CGCONSOLEVIEW_H
 
 #include <QWidget>
-#include <QListWidget>
+#include <QListView>
+#include <QTimer>
 
+#include <vector>
+
+#include "ccRateLimitedFileLog.h"
+#include "ccRingBufferLog.h"
+
+class CGConsoleModel;
+
+//! Console (displays the ccLog messages)
+/** The messages are pushed (by any thread) to a lock-free buffer that is
+    drained by a GUI timer. Only the last 'MaxHistory' messages are kept.
+**/
 class CGConsoleView : public QWidget
 {
     Q_OBJECT
@@ -11,19 +23,42 @@ class CGConsoleView : public QWidget
 private:
     explicit CGConsoleView(QWidget *parent = nullptr);
 
-signals:
-
 public:
+    ~CGConsoleView() override;
+
     static CGConsoleView *getInstance();
     void InitUi();
     void InitConnections();
+    //! Queues a message (can be called from any thread)
     void ConsoleOut(const QString msg);
 
-    QListWidget *m_pListWidget;
+    //! Sets the max number of messages kept in the console
+    void SetMaxHistory(int count);
+    //! Returns the max number of messages kept in the console
+    int MaxHistory() const;
+
+    //! Enables the log file (the messages are appended to it)
+    /** \param filename log filename
+        \param maxMessagesPerSecond max number of (standard) messages written per second (0 = no limit)
+    **/
+    bool EnableLogFile(const QString &filename, unsigned maxMessagesPerSecond = 100);
+    //! Disables the log file
+    void DisableLogFile();
+
+    QListView *m_pListView;
+
+private slots:
+    //! Moves the pending messages to the console (and to the log file)
+    void DrainMessages();
 
 private:
     static CGConsoleView *m_CGConsoleView;
 
+    ccRingBufferLog m_logBuffer;
+    ccRateLimitedFileLog m_logFile;
+    CGConsoleModel *m_pModel;
+    QTimer m_drainTimer;
+    std::vector<ccRingBufferLog::Entry> m_drainedEntries;
 };
 
 #endif // CGCONSOLEVIEW_H